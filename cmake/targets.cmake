@@ -64,6 +64,7 @@ set(MEGATOY_CORE_SOURCES
   src/audio/scope_buffer.cpp
   src/audio/scope_trigger.cpp
   src/audio/spectrum_analyzer.cpp
+  src/audio/sound_descriptors.cpp
   src/audio/audio_manager.cpp
   src/audio/sdl_audio_transport.cpp
   src/changelog.cpp
@@ -73,9 +74,11 @@ set(MEGATOY_CORE_SOURCES
   src/core/status.cpp
   src/core/utf8_utils.cpp
   src/formats/ginpkg.cpp
+  src/formats/json_delta.cpp
   src/formats/patch_loader.cpp
   src/formats/ym2612_format_adapter.cpp
   src/formats/patch_registry.cpp
+  src/formats/zip_append.cpp
   src/gui/components/about_dialog.cpp
   src/gui/components/changelog_dialog.cpp
   src/gui/components/confirmation_dialog.cpp
@@ -94,6 +97,12 @@ set(MEGATOY_CORE_SOURCES
   src/gui/components/patch_lab_window.cpp
   src/gui/components/patch_selector.cpp
   src/gui/components/patch_selector_shared.cpp
+  src/gui/components/patch_table_duplicates.cpp
+  src/gui/components/patch_table_listing.cpp
+  src/gui/components/patch_table_shared.cpp
+  src/gui/components/patch_table_similar.cpp
+  src/gui/components/patch_table_sound.cpp
+  src/gui/components/patch_table_suggestions.cpp
   src/gui/components/patch_table_view.cpp
   src/gui/components/patch_tree_flatten.cpp
   src/gui/components/patch_tree_view.cpp
@@ -113,7 +122,10 @@ set(MEGATOY_CORE_SOURCES
   src/platform/clipboard.cpp
   src/gui/styles/megatoy_style.cpp
   src/gui/styles/theme.cpp
+  src/history/delta_history.cpp
+  src/history/edit_journal.cpp
   src/history/history_manager.cpp
+  src/history/patch_delta.cpp
   src/drop_actions.cpp
   src/midi/midi_input_manager.cpp
 
@@ -124,6 +136,17 @@ set(MEGATOY_CORE_SOURCES
   src/patches/patch_lab.cpp
   src/patches/persistent_parse_cache.cpp
   src/patches/patch_repository.cpp
+  src/patches/patch_index.cpp
+  src/patches/patch_search_index.cpp
+  src/patches/patch_sort_index.cpp
+  src/patches/patch_metadata_index.cpp
+  src/patches/decoded_container_cache.cpp
+  src/patches/async_patch_loader.cpp
+  src/patches/duplicate_finder.cpp
+  src/patches/similarity_index.cpp
+  src/patches/sound_descriptor_index.cpp
+  src/patches/category_suggester.cpp
+  src/patches/category_suggestion_index.cpp
   src/patches/patch_write.cpp
   src/patches/filesystem_patch_storage.cpp
   src/patches/folder_metadata.cpp
@@ -131,7 +154,9 @@ set(MEGATOY_CORE_SOURCES
   src/preferences/preference_manager.cpp
   src/preferences/preference_storage_json.cpp
 
+  src/platform/file_view.cpp
   src/platform/std_file_system.cpp
+  src/platform/zip_file_system.cpp
   src/platform/import_pipeline.cpp
   src/system/path_service.cpp
   src/update/update_checker.cpp
@@ -166,6 +191,7 @@ else()
     src/gui/components/folder_scan_dialog.cpp
     src/midi/rtmidi_backend.cpp
     src/patches/background_folder_scan.cpp
+    src/patches/bulk_convert.cpp
     src/patches/legacy_metadata_migration.cpp
     src/platform/native/native_file_system.cpp
     src/platform/native/desktop_platform_services.cpp
@@ -311,6 +337,13 @@ if(UNIX AND NOT APPLE AND NOT CMAKE_SYSTEM_NAME STREQUAL "Emscripten")
   target_link_libraries(megatoy PRIVATE ${X11_LIBRARIES})
 endif()
 
+# Command-line conversion of whole patch libraries; desktop only.
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Emscripten")
+  add_executable(megatoy_convert src/tools/megatoy_convert.cpp)
+  target_link_libraries(megatoy_convert PRIVATE megatoy_core)
+  install(TARGETS megatoy_convert RUNTIME DESTINATION .)
+endif()
+
 add_embedded_assets(megatoy
   EXCLUDE_PATTERNS "\\.DS_Store$" "\\.ase$" "\\.gitkeep$" "^presets/" "\\.txt$"
 )
@@ -11,6 +11,7 @@
 #include "platform/web/web_patch_url.hpp"
 #endif
 #include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <string>
 
@@ -29,6 +30,25 @@ std::unique_ptr<patches::PersistentParseCache> load_persistent_parse_cache() {
   return cache;
 }
 
+std::filesystem::path sound_descriptor_cache_path() {
+#if defined(MEGATOY_PLATFORM_WEB)
+  return megatoy::system::PathService::web_storage_root() /
+         ".sound-descriptors.json";
+#else
+  return megatoy::system::PathService::preferences_file_path().parent_path() /
+         "sound_descriptors.json";
+#endif
+}
+
+std::filesystem::path edit_journal_path() {
+#if defined(MEGATOY_PLATFORM_WEB)
+  return megatoy::system::PathService::web_storage_root() / ".edit-journal";
+#else
+  return megatoy::system::PathService::preferences_file_path().parent_path() /
+         "edit_journal";
+#endif
+}
+
 } // namespace
 
 AppServices::AppServices(platform::PlatformServicesProvider &platform_services)
@@ -79,6 +99,7 @@ void AppServices::initialize_app(AppState &state) {
   patches::background_folder_scan::configure(persistent_parse_cache.get());
 #endif
   patch_session.initialize_patch_defaults();
+  patch_session.sound_descriptors().load(sound_descriptor_cache_path());
   bool loaded_url_patch = false;
 #if defined(MEGATOY_PLATFORM_WEB)
   if (auto patch = platform::web::patch_url::load_patch_from_current_url(
@@ -91,6 +112,10 @@ void AppServices::initialize_app(AppState &state) {
   if (!loaded_url_patch) {
     patch_session.restore_patch(preference_manager.last_patch_path());
   }
+#if defined(MEGATOY_PLATFORM_DESKTOP)
+  // Startup has its tree; rescans from here on happen behind the UI.
+  patch_session.repository().enable_background_refresh();
+#endif
 
   if (!audio_manager.initialize(
           SampleRate,
@@ -118,6 +143,7 @@ void AppServices::initialize_app(AppState &state) {
       state.ui_state().prefs.steal_oldest_note_when_full);
   audio_manager.set_performance_options(state.ui_state().prefs.use_pitch_bend,
                                         state.ui_state().prefs.use_mod_wheel);
+  patch_session.set_loudness_matching(state.ui_state().prefs.match_loudness);
 
   const auto &prefs = state.ui_state().prefs;
   auto &input = state.input_state();
@@ -134,10 +160,21 @@ void AppServices::initialize_app(AppState &state) {
   input.keyboard_typing_octave =
       static_cast<uint8_t>(std::clamp(prefs.midi_keyboard_typing_octave, 0, 7));
   history.clear();
+  history.open_journal(edit_journal_path());
+  // The patch reopened from last time comes back with its undo steps, once
+  // the journal has been indexed.
+  history.restore_journal(patch_session.capture_snapshot());
 }
 
 void AppServices::shutdown_app() {
   patch_session.release_all_notes();
+  history.close_journal();
+  patch_session.category_suggestions().shutdown();
+  // Whatever a running analysis finished is kept for the next launch.
+  patch_session.sound_descriptors().shutdown();
+  if (patch_session.sound_descriptors().dirty()) {
+    patch_session.sound_descriptors().save();
+  }
 #if defined(MEGATOY_PLATFORM_DESKTOP)
   // Join first: a scan still running writes into the same cache.
   patches::background_folder_scan::shutdown();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ym2612/note.hpp"
+#include "ym2612/packed_patch.hpp"
 #include "ym2612/types.hpp"
 #include "ym2612/ymfm_chip.hpp"
 
@@ -32,6 +33,7 @@ struct AudioCommand {
     PitchBend,
     ModWheel,
     SetChipType,
+    SetGain,
   };
 
   Type type = Type::AllNotesOff;
@@ -43,12 +45,14 @@ struct AudioCommand {
   uint8_t mod_wheel_value = 0;
   ym2612::ChipType chip_type = ym2612::ChipType::Ym2612;
 
-  // ApplyPatch only. The patch *name* is deliberately absent: it never
-  // reaches a register, and keeping the command trivially copyable keeps the
-  // queue free of allocation.
-  ym2612::GlobalSettings global{};
-  ym2612::ChannelSettings channel{};
-  ym2612::ChannelInstrument instrument{};
+  // ApplyPatch only, as the register image. The patch *name* is deliberately
+  // absent: it never reaches a register, and keeping the command trivially
+  // copyable keeps the queue free of allocation.
+  ym2612::PackedPatch patch{};
+  // ApplyPatch and SetGain: the output level to ramp to, linear. Loudness
+  // matching sends it with the patch, so the level is right from the first
+  // note rather than corrected after it.
+  float gain = 1.0f;
 
   static AudioCommand note_on(ym2612::Note note, uint8_t velocity) {
     AudioCommand command;
@@ -73,12 +77,12 @@ struct AudioCommand {
 
   static AudioCommand apply_patch(const ym2612::GlobalSettings &global,
                                   const ym2612::ChannelSettings &channel,
-                                  const ym2612::ChannelInstrument &instrument) {
+                                  const ym2612::ChannelInstrument &instrument,
+                                  float gain = 1.0f) {
     AudioCommand command;
     command.type = Type::ApplyPatch;
-    command.global = global;
-    command.channel = channel;
-    command.instrument = instrument;
+    command.patch = ym2612::pack(global, channel, instrument);
+    command.gain = gain;
     return command;
   }
 
@@ -102,6 +106,13 @@ struct AudioCommand {
     command.chip_type = type;
     return command;
   }
+
+  static AudioCommand set_gain(float gain) {
+    AudioCommand command;
+    command.type = Type::SetGain;
+    command.gain = gain;
+    return command;
+  }
 };
 
 /**
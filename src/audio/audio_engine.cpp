@@ -1,6 +1,7 @@
 #include "audio/audio_engine.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <thread>
 
@@ -16,6 +17,12 @@ constexpr uint32_t kFallbackSampleRate = 44100;
 // 44.1 kHz -- far below anything audible, and fast enough that the offset is
 // gone within a fraction of a second of startup.
 constexpr float kDcBlockerPole = 0.9995f;
+// Time constant of the output gain's glide: long enough not to click, short
+// enough to have settled before the attack of a note played right after the
+// patch changed.
+constexpr float kGainGlideSeconds = 0.01f;
+// Closer than this, the gain snaps to its target and the stage goes idle.
+constexpr float kGainSnap = 1.0e-4f;
 // How long a note-off will wait for queue space before being abandoned.
 constexpr int kFullQueueRetries = 1000;
 constexpr uint32_t kDefaultFrameSize = sizeof(int16_t) * 2; // stereo s16
@@ -41,6 +48,10 @@ bool AudioEngine::initialize(uint32_t sample_rate) {
   midi_release_recovery_pending_.store(false, std::memory_order_relaxed);
   dc_x_[0] = dc_x_[1] = 0.0f;
   dc_y_[0] = dc_y_[1] = 0.0f;
+  gain_ = target_gain_;
+  gain_coefficient_ =
+      1.0f - std::exp(-1.0f / (kGainGlideSeconds *
+                               static_cast<float>(sample_rate_)));
   bend_semitones_ = 0.0f;
   mod_wheel_ = 0;
   device_.init(sample_rate_);
@@ -90,6 +101,7 @@ uint32_t AudioEngine::render(uint32_t buf_size, void *data) {
   // seconds while the app sat idle. Blocking DC restores the coupling the
   // hardware had: idle output decays to true digital silence.
   remove_dc(mix_buffer_.data(), frames);
+  apply_gain(mix_buffer_.data(), frames);
 
   scope_buffer_.write(mix_buffer_.data(), frames);
 
@@ -113,6 +125,26 @@ void AudioEngine::remove_dc(float *interleaved, uint32_t frames) {
   }
 }
 
+void AudioEngine::apply_gain(float *interleaved, uint32_t frames) {
+  if (gain_ == target_gain_) {
+    if (gain_ == 1.0f) {
+      return;
+    }
+    for (uint32_t i = 0; i < frames * 2; ++i) {
+      interleaved[i] *= gain_;
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < frames; ++i) {
+    gain_ += (target_gain_ - gain_) * gain_coefficient_;
+    interleaved[i * 2] *= gain_;
+    interleaved[i * 2 + 1] *= gain_;
+  }
+  if (std::abs(target_gain_ - gain_) < kGainSnap) {
+    gain_ = target_gain_;
+  }
+}
+
 void AudioEngine::set_note_options(bool use_velocity,
                                    uint8_t velocity_sensitivity_depth,
                                    bool steal_oldest) {
@@ -231,9 +263,9 @@ void AudioEngine::apply(const audio::AudioCommand &command) {
 
   switch (command.type) {
   case Type::ApplyPatch: {
-    current_global_ = command.global;
-    current_channel_ = command.channel;
-    current_instrument_ = command.instrument;
+    target_gain_ = std::max(command.gain, 0.0f);
+    ym2612::unpack(command.patch, current_global_, current_channel_,
+                   current_instrument_);
     const auto effective_global = audio::performance::compose_global_settings(
         current_global_, mod_wheel_);
     const auto effective_channel = audio::performance::compose_channel_settings(
@@ -246,8 +278,8 @@ void AudioEngine::apply(const audio::AudioCommand &command) {
       channel.write_settings(effective_channel);
       const auto velocity = allocator_.active_velocity(index);
       channel.write_instrument(
-          velocity ? command.instrument.clone_with_velocity(*velocity, depth)
-                   : command.instrument);
+          velocity ? current_instrument_.clone_with_velocity(*velocity, depth)
+                   : current_instrument_);
     }
     break;
   }
@@ -322,9 +354,13 @@ void AudioEngine::apply(const audio::AudioCommand &command) {
   case Type::SetChipType:
     device_.set_chip_type(command.chip_type);
     apply(audio::AudioCommand::apply_patch(current_global_, current_channel_,
-                                           current_instrument_));
+                                           current_instrument_, target_gain_));
     apply(audio::AudioCommand::all_notes_off());
     break;
+
+  case Type::SetGain:
+    target_gain_ = std::max(command.gain, 0.0f);
+    break;
   }
 }
 
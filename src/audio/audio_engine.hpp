@@ -81,6 +81,7 @@ private:
   void drain(audio::AudioCommandQueue &queue);
   void apply(const audio::AudioCommand &command);
   void remove_dc(float *interleaved, uint32_t frames);
+  void apply_gain(float *interleaved, uint32_t frames);
   bool try_push_midi_command(const audio::AudioCommand &command,
                              bool &queue_full);
 
@@ -88,6 +89,11 @@ private:
   // DC blocker state, one x/y pair per channel.
   float dc_x_[2] = {0.0f, 0.0f};
   float dc_y_[2] = {0.0f, 0.0f};
+  // Output gain, easing toward the last ApplyPatch/SetGain's target so a
+  // change of level never clicks. Audio thread only.
+  float gain_ = 1.0f;
+  float target_gain_ = 1.0f;
+  float gain_coefficient_ = 0.0f;
   ym2612::Device device_;
   audio::ScopeBuffer scope_buffer_;
   audio::AudioCommandQueue commands_;
@@ -0,0 +1,258 @@
+#include "audio/sound_descriptors.hpp"
+
+#include "audio/spectrum_analyzer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace audio {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+/// Envelope resolution for attack and decay.
+constexpr double kEnvelopeHopSeconds = 0.005;
+constexpr std::size_t kSpectrumSize = 4096;
+/// Bins either side of a harmonic that still count as on it: the Hann
+/// window's main lobe.
+constexpr float kHarmonicBins = 2.0f;
+
+/// Where loudness matching puts every patch.
+constexpr float kMatchedLoudnessLufs = -20.0f;
+constexpr float kMaxBoostDb = 6.0f;
+constexpr float kMaxCutDb = 24.0f;
+
+struct Biquad {
+  double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+  double z1 = 0.0, z2 = 0.0;
+
+  double process(double x) {
+    const double y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+};
+
+/**
+ * The two K-weighting stages: a +4 dB shelf above ~1.7 kHz for the head,
+ * then a high-pass at ~38 Hz. The standard tabulates them for 48 kHz only;
+ * these are the analog prototypes behind that table, bilinear-transformed
+ * for `sample_rate`, and reproduce it at 48 kHz.
+ */
+std::array<Biquad, 2> k_weighting(std::uint32_t sample_rate) {
+  const double fs = static_cast<double>(sample_rate);
+
+  Biquad shelf;
+  {
+    const double q = 0.7071752369554193;
+    const double k = std::tan(kPi * 1681.9744509555319 / fs);
+    const double vh = std::pow(10.0, 3.99984385397 / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+  }
+
+  Biquad high_pass;
+  {
+    const double q = 0.5003270373253953;
+    const double k = std::tan(kPi * 38.13547087613982 / fs);
+    const double a0 = 1.0 + k / q + k * k;
+    high_pass.b0 = 1.0;
+    high_pass.b1 = -2.0;
+    high_pass.b2 = 1.0;
+    high_pass.a1 = 2.0 * (k * k - 1.0) / a0;
+    high_pass.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  return {shelf, high_pass};
+}
+
+float to_db(double ratio) {
+  if (ratio <= 0.0) {
+    return SoundDescriptors::kSilenceDb;
+  }
+  return std::max(static_cast<float>(20.0 * std::log10(ratio)),
+                  SoundDescriptors::kSilenceDb);
+}
+
+double block_loudness(double mean_square) {
+  return -0.691 + 10.0 * std::log10(mean_square);
+}
+
+} // namespace
+
+float integrated_loudness(std::span<const float> stereo,
+                          std::uint32_t sample_rate) {
+  const std::size_t frames = stereo.size() / 2;
+  if (frames == 0 || sample_rate == 0) {
+    return SoundDescriptors::kSilenceDb;
+  }
+
+  // Weighted power per frame, both channels at unit gain, as a running sum
+  // so each block's mean is one subtraction.
+  auto left = k_weighting(sample_rate);
+  auto right = k_weighting(sample_rate);
+  std::vector<double> cumulative(frames + 1, 0.0);
+  for (std::size_t i = 0; i < frames; ++i) {
+    const double l = left[1].process(left[0].process(stereo[i * 2]));
+    const double r = right[1].process(right[0].process(stereo[i * 2 + 1]));
+    cumulative[i + 1] = cumulative[i] + l * l + r * r;
+  }
+
+  // 400 ms blocks overlapping by 75%.
+  std::size_t block = static_cast<std::size_t>(0.4 * sample_rate);
+  std::size_t step = block / 4;
+  if (frames < block) {
+    block = frames;
+    step = frames;
+  }
+  std::vector<double> blocks;
+  for (std::size_t start = 0; start + block <= frames; start += step) {
+    const double mean =
+        (cumulative[start + block] - cumulative[start]) / block;
+    if (mean > 0.0 && block_loudness(mean) > -70.0) {
+      blocks.push_back(mean);
+    }
+  }
+  if (blocks.empty()) {
+    return SoundDescriptors::kSilenceDb;
+  }
+
+  double sum = 0.0;
+  for (const double mean : blocks) {
+    sum += mean;
+  }
+  const double relative_gate =
+      block_loudness(sum / static_cast<double>(blocks.size())) - 10.0;
+  double gated = 0.0;
+  std::size_t count = 0;
+  for (const double mean : blocks) {
+    if (block_loudness(mean) > relative_gate) {
+      gated += mean;
+      ++count;
+    }
+  }
+  return std::max(static_cast<float>(block_loudness(gated / count)),
+                  SoundDescriptors::kSilenceDb);
+}
+
+SoundDescriptors measure_sound(std::span<const float> stereo,
+                               const NoteRender &render) {
+  SoundDescriptors result;
+  const std::size_t frames = stereo.size() / 2;
+  if (frames == 0 || render.sample_rate == 0) {
+    return result;
+  }
+  const std::size_t held = std::clamp<std::size_t>(render.held_frames, 1,
+                                                   frames);
+
+  // The YM2612's DAC idles at a small offset, which is not sound.
+  double mean_left = 0.0;
+  double mean_right = 0.0;
+  for (std::size_t i = 0; i < frames; ++i) {
+    mean_left += stereo[i * 2];
+    mean_right += stereo[i * 2 + 1];
+  }
+  mean_left /= static_cast<double>(frames);
+  mean_right /= static_cast<double>(frames);
+
+  std::vector<float> mono(frames);
+  double peak = 0.0;
+  double held_power = 0.0;
+  for (std::size_t i = 0; i < frames; ++i) {
+    const double l = stereo[i * 2] - mean_left;
+    const double r = stereo[i * 2 + 1] - mean_right;
+    peak = std::max({peak, std::abs(l), std::abs(r)});
+    if (i < held) {
+      held_power += (l * l + r * r) / 2.0;
+    }
+    mono[i] = static_cast<float>((l + r) / 2.0);
+  }
+  result.peak_db = to_db(peak);
+  result.rms_db = to_db(std::sqrt(held_power / static_cast<double>(held)));
+  result.loudness_lufs = integrated_loudness(stereo, render.sample_rate);
+  if (result.peak_db <= SoundDescriptors::kSilenceDb) {
+    return result;
+  }
+
+  // Envelope, as RMS per hop.
+  const std::size_t hop = std::max<std::size_t>(
+      1, static_cast<std::size_t>(kEnvelopeHopSeconds * render.sample_rate));
+  std::vector<double> envelope;
+  for (std::size_t start = 0; start < frames; start += hop) {
+    const std::size_t end = std::min(frames, start + hop);
+    double power = 0.0;
+    for (std::size_t i = start; i < end; ++i) {
+      power += static_cast<double>(mono[i]) * mono[i];
+    }
+    envelope.push_back(std::sqrt(power / static_cast<double>(end - start)));
+  }
+  const auto loudest = std::max_element(envelope.begin(), envelope.end());
+  const double hop_ms = 1000.0 * static_cast<double>(hop) / render.sample_rate;
+  const auto attack_end = std::find_if(
+      envelope.begin(), envelope.end(),
+      [&](double level) { return level >= 0.9 * *loudest; });
+  result.attack_ms =
+      static_cast<float>(hop_ms * (attack_end - envelope.begin()));
+  // From the end of the attack rather than the loudest hop, which on a
+  // steady tone is wherever the hops happen to cut the waveform best.
+  const auto decay_end =
+      std::find_if(attack_end, envelope.end(),
+                   [&](double level) { return level < 0.1 * *loudest; });
+  result.decay_ms = static_cast<float>(hop_ms * (decay_end - attack_end));
+
+  // The held part's power spectrum, summed over consecutive whole frames:
+  // a partial one would be cut off mid-window and smear every bin.
+  SpectrumAnalyzer analyzer(kSpectrumSize);
+  std::vector<double> power(analyzer.bin_count(), 0.0);
+  const std::size_t spectra = std::max<std::size_t>(1, held / kSpectrumSize);
+  for (std::size_t n = 0; n < spectra; ++n) {
+    const std::size_t start = n * kSpectrumSize;
+    const std::size_t count = std::min(kSpectrumSize, held - start);
+    analyzer.analyze(mono.data() + start, count, 0.0f);
+    const auto &magnitudes = analyzer.magnitudes_db();
+    for (std::size_t bin = 0; bin < power.size(); ++bin) {
+      power[bin] += std::pow(10.0, magnitudes[bin] / 10.0);
+    }
+  }
+  const float bin_width = analyzer.bin_frequency(1, render.sample_rate);
+  double total = 0.0;
+  double weighted = 0.0;
+  double harmonic = 0.0;
+  for (std::size_t bin = 1; bin < power.size(); ++bin) {
+    const float frequency = analyzer.bin_frequency(bin, render.sample_rate);
+    total += power[bin];
+    weighted += power[bin] * frequency;
+    if (render.fundamental_hz > 0.0f) {
+      const float multiple = std::round(frequency / render.fundamental_hz);
+      if (multiple >= 1.0f &&
+          std::abs(frequency - multiple * render.fundamental_hz) <=
+              kHarmonicBins * bin_width) {
+        harmonic += power[bin];
+      }
+    }
+  }
+  if (total > 0.0) {
+    result.centroid_hz = static_cast<float>(weighted / total);
+    result.harmonicity = static_cast<float>(harmonic / total);
+  }
+  return result;
+}
+
+float loudness_matching_gain(float loudness_lufs) {
+  if (loudness_lufs <= SoundDescriptors::kSilenceDb) {
+    return 1.0f;
+  }
+  const float db = std::clamp(kMatchedLoudnessLufs - loudness_lufs,
+                              -kMaxCutDb, kMaxBoostDb);
+  return std::pow(10.0f, db / 20.0f);
+}
+
+} // namespace audio
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace audio {
+
+/**
+ * How one rendered note sounds, reduced to a few numbers a library can be
+ * sorted by.
+ *
+ * Levels are relative to full scale. Loudness follows ITU-R BS.1770
+ * (K-weighted, gated), so two sounds with the same value are heard as
+ * equally loud; peak and RMS do not promise that.
+ */
+struct SoundDescriptors {
+  /// Reported for silence, and the floor of every level.
+  static constexpr float kSilenceDb = -100.0f;
+
+  float peak_db = kSilenceDb;
+  /// RMS while the key is held.
+  float rms_db = kSilenceDb;
+  /// Integrated loudness of the whole render, in LUFS.
+  float loudness_lufs = kSilenceDb;
+  /// Spectral centroid while the key is held: where the brightness sits.
+  float centroid_hz = 0.0f;
+  /// From key-on until the level first reaches 90% of its peak.
+  float attack_ms = 0.0f;
+  /// From the end of the attack until the level first falls 20 dB below
+  /// the peak, or to the end of the render for a sound that never does.
+  float decay_ms = 0.0f;
+  /// Share of the held spectrum's energy at multiples of the played pitch,
+  /// 0..1: high for clean tones, low for noise and clangorous ratios.
+  float harmonicity = 0.0f;
+
+  bool operator==(const SoundDescriptors &other) const = default;
+};
+
+/// How a render passed to measure_sound() was played.
+struct NoteRender {
+  std::uint32_t sample_rate = 44100;
+  /// Frames from key-on to key-off; the rest is the release.
+  std::size_t held_frames = 0;
+  /// The pitch the note sounds at.
+  float fundamental_hz = 0.0f;
+};
+
+/// Descriptors of one note, rendered as interleaved stereo from key-on.
+SoundDescriptors measure_sound(std::span<const float> stereo,
+                               const NoteRender &render);
+
+/**
+ * BS.1770 integrated loudness of interleaved stereo, in LUFS, or
+ * SoundDescriptors::kSilenceDb when nothing passes the -70 LUFS gate.
+ * Signals shorter than one 400 ms block are measured as a single block.
+ */
+float integrated_loudness(std::span<const float> stereo,
+                          std::uint32_t sample_rate);
+
+/**
+ * The linear gain that brings a sound measured at `loudness_lufs` to a
+ * common auditioning level, so patches browsed one after another are heard
+ * equally loud. Boost is limited, since a quiet patch is often quiet on
+ * purpose and the chip's full scale is close; silence gets none at all.
+ */
+float loudness_matching_gain(float loudness_lufs);
+
+} // namespace audio
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace megatoy {
+
+/// One worker per core, and at least one.
+inline std::size_t default_thread_count() {
+  return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+/**
+ * Runs `body(i)` for every i below `count` on up to `threads` threads, and
+ * returns once all have finished. Work is handed out one index at a time, so
+ * uneven items -- a 128-instrument bank next to a single patch -- balance
+ * out. With one thread, or one item, it all runs on the caller's.
+ */
+template <typename Body>
+void parallel_for(std::size_t count, std::size_t threads, Body body) {
+  threads = std::min(threads, count);
+  if (threads <= 1) {
+    for (std::size_t i = 0; i < count; ++i) {
+      body(i);
+    }
+    return;
+  }
+  std::atomic<std::size_t> next{0};
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+        body(i);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+} // namespace megatoy
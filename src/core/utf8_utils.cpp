@@ -23,6 +23,60 @@ std::size_t sequence_length(unsigned char lead) {
   return 0;
 }
 
+char32_t fold_code_point(char32_t cp) {
+  if (cp >= U'A' && cp <= U'Z') {
+    return cp + 0x20;
+  }
+  if (cp < 0xc0) {
+    return cp;
+  }
+  if (cp <= 0xde) {
+    return cp == 0xd7 ? cp : cp + 0x20; // U+00D7 is the multiplication sign.
+  }
+  // Latin Extended-A pairs upper and lower case on adjacent code points,
+  // with the parity of the uppercase one flipping at U+0139 and U+0179.
+  if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14a && cp <= 0x177)) {
+    return (cp & 1u) == 0 ? cp + 1 : cp;
+  }
+  if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17e)) {
+    return (cp & 1u) == 1 ? cp + 1 : cp;
+  }
+  if (cp == 0x178) {
+    return 0xff;
+  }
+  if (cp >= 0x391 && cp <= 0x3a9 && cp != 0x3a2) {
+    return cp + 0x20;
+  }
+  if (cp >= 0x400 && cp <= 0x40f) {
+    return cp + 0x50;
+  }
+  if (cp >= 0x410 && cp <= 0x42f) {
+    return cp + 0x20;
+  }
+  if (cp >= 0xff21 && cp <= 0xff3a) {
+    return cp + 0x20;
+  }
+  return cp;
+}
+
+void append_code_point(std::string &out, char32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+  } else {
+    out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+  }
+}
+
 } // namespace
 
 std::string trim_incomplete_suffix(std::string_view input) {
@@ -60,4 +114,43 @@ std::string truncate(std::string_view input, std::size_t max_bytes) {
       input.substr(0, std::min(input.size(), max_bytes)));
 }
 
+std::string fold_case(std::string_view input) {
+  std::string folded;
+  folded.reserve(input.size());
+
+  std::size_t i = 0;
+  while (i < input.size()) {
+    const auto lead = static_cast<unsigned char>(input[i]);
+    if (lead < 0x80u) {
+      folded.push_back(static_cast<char>(
+          lead >= 'A' && lead <= 'Z' ? lead + 0x20 : lead));
+      ++i;
+      continue;
+    }
+
+    const std::size_t length = sequence_length(lead);
+    bool valid = length > 1 && i + length <= input.size();
+    char32_t cp = valid ? lead & (0xffu >> (length + 1)) : 0;
+    for (std::size_t k = 1; valid && k < length; ++k) {
+      const auto byte = static_cast<unsigned char>(input[i + k]);
+      valid = is_continuation(byte);
+      cp = (cp << 6) | (byte & 0x3fu);
+    }
+    if (!valid) {
+      folded.push_back(input[i]);
+      ++i;
+      continue;
+    }
+
+    const char32_t lower = fold_code_point(cp);
+    if (lower == cp) {
+      folded.append(input.substr(i, length));
+    } else {
+      append_code_point(folded, lower);
+    }
+    i += length;
+  }
+  return folded;
+}
+
 } // namespace megatoy::utf8
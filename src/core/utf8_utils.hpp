@@ -9,4 +9,12 @@ namespace megatoy::utf8 {
 std::string trim_incomplete_suffix(std::string_view input);
 std::string truncate(std::string_view input, std::size_t max_bytes);
 
+/**
+ * Simple one-to-one case folding for search keys: ASCII, Latin-1, Latin
+ * Extended-A, Greek, Cyrillic and fullwidth Latin letters fold to lowercase.
+ * Scripts without case (kana, kanji) and malformed bytes pass through as-is,
+ * so a folded string is always a valid search key for the folded query.
+ */
+std::string fold_case(std::string_view input);
+
 } // namespace megatoy::utf8
@@ -3,6 +3,7 @@
 #include "app_services.hpp"
 #include "core/status.hpp"
 #include "formats/patch_loader.hpp"
+#include "workspace/workspace.hpp"
 #include <system_error>
 #include <utility>
 #include <vector>
@@ -53,17 +54,21 @@ void handle_drop(Environment &env, const std::filesystem::path &path) {
   auto &drop = env.ui_state.drop_state;
 
   // A dropped directory is a workspace addition, not a patch load: the same
-  // gesture as dragging a folder into an editor. Files keep the old behavior.
+  // gesture as dragging a folder into an editor. A dropped .zip is mounted
+  // the same way, read in place. Files keep the old behavior. Several
+  // folders dropped together are scanned side by side and each joins as soon
+  // as its own scan is done.
   std::error_code ec;
-  if (std::filesystem::is_directory(path, ec)) {
-    if (env.services.preference_manager.add_workspace_folder(path)) {
-      env.services.patch_session.sync_workspace();
-      megatoy::status::success("Added \"" + path.filename().string() +
-                               "\" to the workspace.");
-    } else {
-      megatoy::status::warning("\"" + path.filename().string() +
-                               "\" is already in the workspace.");
-    }
+  if (std::filesystem::is_directory(path, ec) ||
+      megatoy::workspace::is_archive(path)) {
+    auto *session = &env.services.patch_session;
+    const auto folder_name = path.filename().string();
+    env.services.preference_manager.add_workspace_folder_after_scan(
+        path, [session, folder_name]() {
+          session->sync_workspace();
+          megatoy::status::success("Added \"" + folder_name +
+                                   "\" to the workspace.");
+        });
     reset_drop_state(drop);
     return;
   }
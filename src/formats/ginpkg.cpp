@@ -1,5 +1,9 @@
 #include "ginpkg.hpp"
 
+#include "json_delta.hpp"
+#include "platform/file_view.hpp"
+#include "zip_append.hpp"
+
 #include <miniz.h>
 
 #include <algorithm>
@@ -10,19 +14,27 @@
 #include <cstring>
 #include <ctime>
 #include <filesystem>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <random>
 #include <sstream>
 #include <string>
 #include <system_error>
+#include <unordered_map>
+#include <utility>
 
 namespace {
 
 constexpr const char *kCurrentFile = "current.gin";
 constexpr const char *kHistoryFile = "history.json";
+constexpr const char *kVersionsDir = "versions/";
+/// history.json's "format"; packages without one use the legacy layout.
+constexpr int kLayoutVersion = 2;
+constexpr std::size_t kKeyframeInterval = 32;
 
 std::string to_native_string(const std::filesystem::path &path) {
 #if defined(_WIN32)
@@ -75,14 +87,19 @@ std::string generate_uuid() {
 
 std::optional<std::string> read_zip_entry(mz_zip_archive &archive,
                                           const std::string &name) {
-  size_t size = 0;
-  char *buffer = static_cast<char *>(
-      mz_zip_reader_extract_file_to_heap(&archive, name.c_str(), &size, 0));
-  if (!buffer) {
+  // Inflated straight into the string rather than via a heap copy.
+  const int index =
+      mz_zip_reader_locate_file(&archive, name.c_str(), nullptr, 0);
+  mz_zip_archive_file_stat stat;
+  if (index < 0 ||
+      !mz_zip_reader_file_stat(&archive, static_cast<mz_uint>(index), &stat)) {
+    return std::nullopt;
+  }
+  std::string contents(static_cast<std::size_t>(stat.m_uncomp_size), '\0');
+  if (!mz_zip_reader_extract_to_mem(&archive, static_cast<mz_uint>(index),
+                                    contents.data(), contents.size(), 0)) {
     return std::nullopt;
   }
-  std::string contents(buffer, buffer + size);
-  mz_free(buffer);
   return contents;
 }
 
@@ -93,20 +110,180 @@ bool write_zip_entry(mz_zip_archive &archive, const std::string &name,
                                   0, 0) != 0;
 }
 
-nlohmann::json
-history_to_json(const std::vector<formats::ginpkg::HistoryEntry> &history) {
+std::string fnv1a_hex(const std::string &text) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const unsigned char c : text) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  std::ostringstream oss;
+  oss << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return oss.str();
+}
+
+/// Sets the name and hash history.json keeps for a version.
+void describe(formats::ginpkg::HistoryEntry &entry,
+              const nlohmann::json &snapshot) {
+  entry.name = snapshot.value("name", std::string());
+  entry.hash = fnv1a_hex(snapshot.dump());
+}
+
+/// Where a version is in the file and how it is encoded.
+struct VersionLayout {
+  std::string entry;
+  std::string base;
+};
+
+std::string index_document(
+    const std::vector<formats::ginpkg::HistoryEntry> &history,
+    const std::unordered_map<std::string, VersionLayout> &layout,
+    const std::string &current_timestamp) {
   nlohmann::json versions = nlohmann::json::array();
   for (const auto &entry : history) {
+    const auto it = layout.find(entry.uuid);
+    if (it == layout.end()) {
+      continue;
+    }
     nlohmann::json node = {{"uuid", entry.uuid},
-                           {"timestamp", entry.timestamp}};
+                           {"timestamp", entry.timestamp},
+                           {"entry", it->second.entry}};
+    if (!it->second.base.empty()) {
+      node["base"] = it->second.base;
+    }
     if (entry.comment && !entry.comment->empty()) {
       node["comment"] = *entry.comment;
     }
+    if (entry.name) {
+      node["name"] = *entry.name;
+    }
+    if (entry.hash) {
+      node["hash"] = *entry.hash;
+    }
     versions.push_back(std::move(node));
   }
-  return nlohmann::json{{"versions", versions}};
+  nlohmann::json current_meta;
+  if (!current_timestamp.empty()) {
+    current_meta["timestamp"] = current_timestamp;
+  }
+  nlohmann::json document{{"format", kLayoutVersion},
+                          {"versions", std::move(versions)}};
+  document["current"] = std::move(current_meta);
+  return document.dump();
 }
 
+/**
+ * Decides, version by version in history order, whether to store a version
+ * whole or as a delta against the last keyframe. Deltas always point at a
+ * keyframe rather than at the version before, so reading any version costs
+ * two entries however long the history. A new keyframe is cut every
+ * kKeyframeInterval versions, or sooner when the patch has drifted so far
+ * that the delta is no longer much smaller than the patch.
+ */
+class VersionEncoder {
+public:
+  struct Encoded {
+    VersionLayout layout;
+    std::string body;
+  };
+
+  /// A keyframe already in the file; `snapshot` is read only if needed.
+  void keep_keyframe(std::string uuid,
+                     std::function<std::optional<std::string>()> snapshot) {
+    keyframe_ = std::move(uuid);
+    keyframe_json_.reset();
+    read_keyframe_ = std::move(snapshot);
+    since_keyframe_ = 0;
+  }
+
+  /// A delta already in the file.
+  void keep_delta() { ++since_keyframe_; }
+
+  Encoded encode(const std::string &uuid, const std::string &snapshot) {
+    auto json = nlohmann::json::parse(snapshot);
+    if (!keyframe_.empty() && since_keyframe_ + 1 < kKeyframeInterval) {
+      if (!keyframe_json_ && read_keyframe_) {
+        if (auto text = read_keyframe_()) {
+          keyframe_json_ = nlohmann::json::parse(*text);
+        }
+      }
+      if (keyframe_json_) {
+        auto delta = formats::json_delta::diff(*keyframe_json_, json);
+        if (delta) {
+          auto body = delta->dump();
+          if (body.size() * 2 <= snapshot.size()) {
+            ++since_keyframe_;
+            return {{std::string(kVersionsDir) + uuid + ".delta", keyframe_},
+                    std::move(body)};
+          }
+        }
+      }
+    }
+    keyframe_ = uuid;
+    keyframe_json_ = std::move(json);
+    read_keyframe_ = nullptr;
+    since_keyframe_ = 0;
+    return {{std::string(kVersionsDir) + uuid + ".gin", {}}, snapshot};
+  }
+
+private:
+  std::string keyframe_;
+  std::optional<nlohmann::json> keyframe_json_;
+  std::function<std::optional<std::string>()> read_keyframe_;
+  std::size_t since_keyframe_ = 0;
+};
+
+/// A package on disk opened for reading entries on demand.
+class ArchiveReader {
+public:
+  explicit ArchiveReader(const std::filesystem::path &path) {
+    std::memset(&archive_, 0, sizeof(archive_));
+    std::error_code error;
+    if (!path.empty() && std::filesystem::exists(path, error)) {
+      open_ = mz_zip_reader_init_file(&archive_,
+                                      to_native_string(path).c_str(), 0) != 0;
+    }
+  }
+  ~ArchiveReader() { close(); }
+  ArchiveReader(const ArchiveReader &) = delete;
+  ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+  bool is_open() const { return open_; }
+
+  void close() {
+    if (open_) {
+      mz_zip_reader_end(&archive_);
+      open_ = false;
+    }
+  }
+
+  std::optional<std::string> read(const std::string &name) {
+    return open_ ? read_zip_entry(archive_, name) : std::nullopt;
+  }
+
+  /// Entry names in the order their data appears in the file.
+  std::vector<std::string> names_in_file_order() {
+    std::vector<std::pair<mz_uint64, std::string>> entries;
+    const mz_uint count = open_ ? mz_zip_reader_get_num_files(&archive_) : 0;
+    for (mz_uint i = 0; i < count; ++i) {
+      mz_zip_archive_file_stat stat;
+      if (mz_zip_reader_file_stat(&archive_, i, &stat)) {
+        entries.emplace_back(stat.m_local_header_ofs, stat.m_filename);
+      }
+    }
+    std::sort(entries.begin(), entries.end());
+    std::vector<std::string> names;
+    names.reserve(entries.size());
+    for (auto &entry : entries) {
+      names.push_back(std::move(entry.second));
+    }
+    return names;
+  }
+
+private:
+  mz_zip_archive archive_;
+  bool open_ = false;
+};
+
 } // namespace
 
 namespace formats::ginpkg {
@@ -117,7 +294,11 @@ void GinPackage::Clear() {
   current_data_.clear();
   current_timestamp_.clear();
   history_.clear();
-  snapshots_.clear();
+  stored_.clear();
+  added_.clear();
+  origin_.clear();
+  legacy_layout_ = false;
+  deleted_ = false;
 }
 
 bool GinPackage::empty() const { return current_data_.empty(); }
@@ -135,12 +316,59 @@ const std::vector<HistoryEntry> &GinPackage::history() const {
   return history_;
 }
 
+bool GinPackage::in_history(const std::string &uuid) const {
+  return std::any_of(
+      history_.begin(), history_.end(),
+      [&](const HistoryEntry &entry) { return entry.uuid == uuid; });
+}
+
+std::optional<std::string>
+GinPackage::stored_snapshot(const std::string &uuid,
+                            const EntryReader &read_entry) const {
+  const auto body_of =
+      [&](const StoredVersion &version) -> std::optional<std::string> {
+    if (version.body) {
+      return version.body;
+    }
+    return read_entry ? read_entry(version.entry) : std::nullopt;
+  };
+
+  const auto it = stored_.find(uuid);
+  if (it == stored_.end()) {
+    return std::nullopt;
+  }
+  auto body = body_of(it->second);
+  if (!body || it->second.base.empty()) {
+    return body;
+  }
+  const auto base = stored_.find(it->second.base);
+  if (base == stored_.end() || !base->second.base.empty()) {
+    return std::nullopt;
+  }
+  const auto base_body = body_of(base->second);
+  if (!base_body) {
+    return std::nullopt;
+  }
+  try {
+    return json_delta::apply(nlohmann::json::parse(*base_body),
+                             nlohmann::json::parse(*body))
+        .dump(2);
+  } catch (const std::exception &e) {
+    std::cerr << "Failed to decode ginpkg version '" << uuid
+              << "': " << e.what() << std::endl;
+    return std::nullopt;
+  }
+}
+
 std::optional<std::string> GinPackage::snapshot(const std::string &uuid) const {
-  auto it = snapshots_.find(uuid);
-  if (it != snapshots_.end()) {
-    return it->second;
+  if (!in_history(uuid)) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  const auto added = added_.find(uuid);
+  if (added != added_.end()) {
+    return added->second;
+  }
+  return stored_snapshot(uuid, nullptr);
 }
 
 bool GinPackage::DeleteVersion(const std::string &uuid) {
@@ -150,8 +378,14 @@ bool GinPackage::DeleteVersion(const std::string &uuid) {
                                   return entry.uuid == uuid;
                                 }),
                  history_.end());
-  snapshots_.erase(uuid);
-  return history_.size() != before_size;
+  added_.erase(uuid);
+  // A deleted keyframe stays in stored_ until the rewrite has decoded the
+  // versions that are deltas against it.
+  if (history_.size() == before_size) {
+    return false;
+  }
+  deleted_ = true;
+  return true;
 }
 
 void GinPackage::AddVersion(const std::string &json_snapshot,
@@ -166,23 +400,44 @@ void GinPackage::AddVersion(const std::string &json_snapshot,
   if (!comment.empty()) {
     entry.comment = comment;
   }
+  try {
+    describe(entry, nlohmann::json::parse(json_snapshot));
+  } catch (const std::exception &) {
+    // Not JSON; the save that encodes it will say so.
+  }
   history_.push_back(entry);
-  snapshots_[entry.uuid] = json_snapshot;
+  added_[entry.uuid] = json_snapshot;
   current_timestamp_.clear();
 }
 
-bool GinPackage::Load(const std::filesystem::path &path) {
+bool GinPackage::Load(const std::filesystem::path &path, LoadScope scope) {
   Clear();
   if (!std::filesystem::exists(path)) {
     std::cerr << "ginpkg file not found: " << path << std::endl;
     return false;
   }
 
+  const auto view = platform::FileView::open(path);
+  if (!view) {
+    std::cerr << "Failed to open ginpkg: " << path << std::endl;
+    return false;
+  }
+  std::ostringstream source;
+  source << path;
+  if (!LoadFromMemory(view->data(), view->size(), source.str(), scope)) {
+    return false;
+  }
+  origin_ = path;
+  return true;
+}
+
+bool GinPackage::LoadFromMemory(const void *data, std::size_t size,
+                                const std::string &source, LoadScope scope) {
+  Clear();
   mz_zip_archive archive;
   std::memset(&archive, 0, sizeof(archive));
-  const std::string native_path = to_native_string(path);
-  if (!mz_zip_reader_init_file(&archive, native_path.c_str(), 0)) {
-    std::cerr << "Failed to open ginpkg: " << path << std::endl;
+  if (!mz_zip_reader_init_mem(&archive, data, size, 0)) {
+    std::cerr << "Failed to open ginpkg: " << source << std::endl;
     return false;
   }
   struct ReaderGuard {
@@ -197,19 +452,20 @@ bool GinPackage::Load(const std::filesystem::path &path) {
 
   auto current = read_zip_entry(archive, kCurrentFile);
   if (!current) {
-    std::cerr << "ginpkg missing " << kCurrentFile << ": " << path << std::endl;
+    std::cerr << "ginpkg missing " << kCurrentFile << ": " << source
+              << std::endl;
     return false;
   }
 
   current_data_ = std::move(*current);
 
   auto history_doc = read_zip_entry(archive, kHistoryFile);
-  history_.clear();
-  snapshots_.clear();
+  legacy_layout_ = true;
 
   if (history_doc) {
     try {
       nlohmann::json j = nlohmann::json::parse(*history_doc);
+      legacy_layout_ = !j.contains("format");
       if (j.contains("versions") && j["versions"].is_array()) {
         for (const auto &version : j["versions"]) {
           HistoryEntry entry;
@@ -226,9 +482,20 @@ bool GinPackage::Load(const std::filesystem::path &path) {
               entry.comment = value;
             }
           }
-          if (!entry.uuid.empty() && !entry.timestamp.empty()) {
-            history_.push_back(entry);
+          if (version.contains("name") && version["name"].is_string()) {
+            entry.name = version["name"].get<std::string>();
           }
+          if (version.contains("hash") && version["hash"].is_string()) {
+            entry.hash = version["hash"].get<std::string>();
+          }
+          if (entry.uuid.empty() || entry.timestamp.empty()) {
+            continue;
+          }
+          StoredVersion stored;
+          stored.entry = version.value("entry", entry.uuid + ".gin");
+          stored.base = version.value("base", std::string());
+          stored_[entry.uuid] = std::move(stored);
+          history_.push_back(entry);
         }
       }
       if (j.contains("current") && j["current"].is_object()) {
@@ -238,20 +505,22 @@ bool GinPackage::Load(const std::filesystem::path &path) {
         }
       }
     } catch (const std::exception &e) {
-      std::cerr << "Failed to parse history.json in " << path << ": "
+      std::cerr << "Failed to parse history.json in " << source << ": "
                 << e.what() << std::endl;
       history_.clear();
+      stored_.clear();
       current_timestamp_.clear();
     }
   }
 
+  if (scope == LoadScope::Index) {
+    return true;
+  }
   for (const auto &entry : history_) {
-    const std::string snapshot_name = entry.uuid + ".gin";
-    auto snapshot = read_zip_entry(archive, snapshot_name);
-    if (snapshot) {
-      snapshots_[entry.uuid] = std::move(*snapshot);
-    } else {
-      std::cerr << "Missing snapshot " << snapshot_name << " in " << path
+    auto &stored = stored_[entry.uuid];
+    stored.body = read_zip_entry(archive, stored.entry);
+    if (!stored.body) {
+      std::cerr << "Missing snapshot " << stored.entry << " in " << source
                 << std::endl;
     }
   }
@@ -276,6 +545,60 @@ bool GinPackage::Save(const std::filesystem::path &path) const {
     }
   }
 
+  // Versions not held in memory come from the file the package was read
+  // from, which for an in-place save is the file about to change.
+  ArchiveReader origin(origin_);
+  const EntryReader read_entry = [&](const std::string &entry) {
+    return origin.read(entry);
+  };
+
+  std::error_code error;
+  const bool same_file = origin.is_open() &&
+                         std::filesystem::equivalent(origin_, path, error);
+  bool appendable = same_file && !legacy_layout_ && !deleted_;
+  if (appendable) {
+    // The file must still be the one loaded: every stored version there,
+    // none of the new ones yet, and the two entries that change last.
+    const auto names = origin.names_in_file_order();
+    const auto has = [&](const std::string &name) {
+      return std::find(names.begin(), names.end(), name) != names.end();
+    };
+    appendable =
+        names.size() >= 2 &&
+        ((names[names.size() - 2] == kCurrentFile &&
+          names.back() == kHistoryFile) ||
+         (names[names.size() - 2] == kHistoryFile &&
+          names.back() == kCurrentFile)) &&
+        std::all_of(stored_.begin(), stored_.end(),
+                    [&](const auto &item) { return has(item.second.entry); }) &&
+        std::none_of(added_.begin(), added_.end(), [&](const auto &item) {
+          return has(std::string(kVersionsDir) + item.first + ".gin") ||
+                 has(std::string(kVersionsDir) + item.first + ".delta");
+        });
+  }
+
+  std::vector<formats::zip_append::Entry> entries;
+  try {
+    for (auto &[name, data] : appendable ? AppendedEntries(read_entry)
+                                         : AllEntries(read_entry)) {
+      entries.push_back({std::move(name), std::move(data)});
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Failed to encode ginpkg " << path << ": " << e.what()
+              << std::endl;
+    return false;
+  }
+  origin.close();
+
+  if (appendable) {
+    if (!formats::zip_append::replace_tail(
+            path, {kCurrentFile, kHistoryFile}, entries)) {
+      std::cerr << "Failed to append to ginpkg: " << path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
   mz_zip_archive archive;
   std::memset(&archive, 0, sizeof(archive));
   const std::string native_path = to_native_string(path);
@@ -284,28 +607,11 @@ bool GinPackage::Save(const std::filesystem::path &path) const {
     return false;
   }
 
-  bool ok = write_zip_entry(archive, kCurrentFile, current_data_);
-  if (ok) {
-    nlohmann::json current_meta;
-    if (!current_timestamp_.empty()) {
-      current_meta["timestamp"] = current_timestamp_;
-    }
-    auto history_json = history_to_json(history_);
-    history_json["current"] = std::move(current_meta);
-    const auto history_text = history_json.dump(2);
-    ok = write_zip_entry(archive, kHistoryFile, history_text);
-  }
-  if (ok) {
-    for (const auto &entry : history_) {
-      auto it = snapshots_.find(entry.uuid);
-      if (it == snapshots_.end()) {
-        continue;
-      }
-      const std::string filename = entry.uuid + ".gin";
-      if (!write_zip_entry(archive, filename, it->second)) {
-        ok = false;
-        break;
-      }
+  bool ok = true;
+  for (const auto &entry : entries) {
+    if (!write_zip_entry(archive, entry.name, entry.data)) {
+      ok = false;
+      break;
     }
   }
 
@@ -321,6 +627,89 @@ bool GinPackage::Save(const std::filesystem::path &path) const {
   return true;
 }
 
+std::vector<HistoryEntry>
+GinPackage::IndexedHistory(const EntryReader &read_entry) const {
+  auto history = history_;
+  for (auto &entry : history) {
+    if (entry.name && entry.hash) {
+      continue;
+    }
+    const auto added = added_.find(entry.uuid);
+    const auto snapshot = added != added_.end()
+                              ? std::optional<std::string>(added->second)
+                              : stored_snapshot(entry.uuid, read_entry);
+    if (snapshot) {
+      describe(entry, nlohmann::json::parse(*snapshot));
+    }
+  }
+  return history;
+}
+
+GinPackage::ZipEntries
+GinPackage::AppendedEntries(const EntryReader &read_entry) const {
+  std::unordered_map<std::string, VersionLayout> layout;
+  ZipEntries entries;
+  VersionEncoder encoder;
+  for (const auto &entry : history_) {
+    const auto added = added_.find(entry.uuid);
+    if (added != added_.end()) {
+      auto encoded = encoder.encode(entry.uuid, added->second);
+      entries.emplace_back(encoded.layout.entry, std::move(encoded.body));
+      layout[entry.uuid] = std::move(encoded.layout);
+      continue;
+    }
+    const auto &stored = stored_.at(entry.uuid);
+    layout[entry.uuid] = {stored.entry, stored.base};
+    if (stored.base.empty()) {
+      encoder.keep_keyframe(entry.uuid, [this, &read_entry,
+                                         uuid = entry.uuid]() {
+        return stored_snapshot(uuid, read_entry);
+      });
+    } else {
+      encoder.keep_delta();
+    }
+  }
+  entries.emplace_back(kCurrentFile, current_data_);
+  entries.emplace_back(kHistoryFile,
+                       index_document(IndexedHistory(read_entry), layout,
+                                      current_timestamp_));
+  return entries;
+}
+
+GinPackage::ZipEntries
+GinPackage::AllEntries(const EntryReader &read_entry) const {
+  std::unordered_map<std::string, VersionLayout> layout;
+  ZipEntries entries;
+  VersionEncoder encoder;
+  auto history = history_;
+  for (auto &entry : history) {
+    const auto added = added_.find(entry.uuid);
+    auto snapshot = added != added_.end()
+                        ? std::optional<std::string>(added->second)
+                        : stored_snapshot(entry.uuid, read_entry);
+    if (!snapshot) {
+      std::cerr << "Dropping unreadable ginpkg version " << entry.uuid
+                << std::endl;
+      continue;
+    }
+    if (!entry.name || !entry.hash) {
+      describe(entry, nlohmann::json::parse(*snapshot));
+    }
+    auto encoded = encoder.encode(entry.uuid, *snapshot);
+    entries.emplace_back(encoded.layout.entry, std::move(encoded.body));
+    layout[entry.uuid] = std::move(encoded.layout);
+  }
+  // current.gin and history.json last, where the next save can replace them.
+  entries.emplace_back(kCurrentFile, current_data_);
+  entries.emplace_back(kHistoryFile,
+                       index_document(history, layout, current_timestamp_));
+  return entries;
+}
+
+std::string content_hash(const std::string &json_snapshot) {
+  return fnv1a_hex(nlohmann::json::parse(json_snapshot).dump());
+}
+
 std::filesystem::path
 build_package_path(const std::filesystem::path &patches_dir,
                    const std::string &filename) {
@@ -342,7 +731,8 @@ save_patch(const std::filesystem::path &patches_dir, const ym2612::Patch &patch,
     auto package_path = build_package_path(patches_dir, filename);
     GinPackage package;
     if (std::filesystem::exists(package_path)) {
-      if (!package.Load(package_path)) {
+      // Saving appends, so the versions already saved need not be read.
+      if (!package.Load(package_path, LoadScope::Index)) {
         return std::nullopt;
       }
       if (!package.current_data().empty()) {
@@ -389,6 +779,18 @@ std::optional<GinPackage> load_package(const std::filesystem::path &path) {
   return package;
 }
 
+std::optional<GinPackage>
+load_package_from_memory(const std::uint8_t *data, std::size_t size,
+                         const std::filesystem::path &path) {
+  GinPackage package;
+  std::ostringstream source;
+  source << path;
+  if (!package.LoadFromMemory(data, size, source.str())) {
+    return std::nullopt;
+  }
+  return package;
+}
+
 std::optional<ym2612::Patch> read_current(const GinPackage &package) {
   try {
     auto json = nlohmann::json::parse(package.current_data());
@@ -449,4 +851,18 @@ bool delete_version(const std::filesystem::path &path,
   }
 }
 
+bool migrate_package(const std::filesystem::path &path) {
+  try {
+    GinPackage package;
+    if (!package.Load(path, LoadScope::Index)) {
+      return false;
+    }
+    return !package.legacy_layout() || package.Save(path);
+  } catch (const std::exception &e) {
+    std::cerr << "Failed to migrate ginpkg " << path << ": " << e.what()
+              << std::endl;
+    return false;
+  }
+}
+
 } // namespace formats::ginpkg
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "../ym2612/patch.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace formats::ginpkg {
@@ -13,13 +17,53 @@ struct HistoryEntry {
   std::string uuid;
   std::string timestamp;
   std::optional<std::string> comment;
+  /// The version's patch name and content_hash(), kept in history.json so a
+  /// package can be listed without decoding its versions. Unset for
+  /// versions saved before the index carried them, until the next save.
+  std::optional<std::string> name;
+  std::optional<std::string> hash;
 };
 
+/// A hash of a snapshot's patch that does not depend on how its JSON is
+/// formatted, stable across runs and platforms (64-bit FNV-1a, in hex).
+/// Throws if `json_snapshot` is not JSON.
+std::string content_hash(const std::string &json_snapshot);
+
+/// How much of a package Load reads.
+enum class LoadScope {
+  Everything,
+  /// current.gin and history.json only: enough to list the versions and to
+  /// save a new one. snapshot() has nothing for versions already saved.
+  Index,
+};
+
+/**
+ * A patch and its saved versions, stored as a zip.
+ *
+ * Versions live under versions/, either whole (a keyframe, `<uuid>.gin`) or
+ * as a json_delta against the keyframe before them (`<uuid>.delta`), so any
+ * version decodes from at most two entries. history.json lists them and
+ * which is which. current.gin and history.json are always the last two
+ * entries, so saving a new version appends it and rewrites only those two;
+ * the versions already in the file are never copied again.
+ *
+ * Packages from before this layout keep each version whole as `<uuid>.gin`
+ * after current.gin. They load as before; the first save rewrites them in
+ * the new layout.
+ */
 class GinPackage {
 public:
   GinPackage();
 
-  bool Load(const std::filesystem::path &path);
+  bool Load(const std::filesystem::path &path,
+            LoadScope scope = LoadScope::Everything);
+  /// Load a package already in memory; `source` names it in error messages.
+  bool LoadFromMemory(const void *data, std::size_t size,
+                      const std::string &source,
+                      LoadScope scope = LoadScope::Everything);
+  /// Saving back to the file the package was loaded from appends the
+  /// versions added since; any other save writes the whole package, reading
+  /// versions it does not hold from that file.
   bool Save(const std::filesystem::path &path) const;
 
   void Clear();
@@ -33,14 +77,48 @@ public:
                   const std::string &comment = "");
 
   const std::vector<HistoryEntry> &history() const;
+  /// The version as the JSON it was added with.
   std::optional<std::string> snapshot(const std::string &uuid) const;
   bool DeleteVersion(const std::string &uuid);
 
+  /// Whether the package was read in the layout from before keyframes.
+  bool legacy_layout() const { return legacy_layout_; }
+
 private:
+  /// A version as it is in the file.
+  struct StoredVersion {
+    std::string entry;
+    /// The keyframe this version is a delta against; empty for a keyframe.
+    std::string base;
+    /// The entry's contents; unset when loaded with LoadScope::Index.
+    std::optional<std::string> body;
+  };
+
+  using EntryReader =
+      std::function<std::optional<std::string>(const std::string &entry)>;
+  std::optional<std::string>
+  stored_snapshot(const std::string &uuid,
+                  const EntryReader &read_entry) const;
+  bool in_history(const std::string &uuid) const;
+  /// history_ with every name and hash filled in, decoding the versions
+  /// whose index entry predates them.
+  std::vector<HistoryEntry> IndexedHistory(const EntryReader &read_entry) const;
+  /// Zip entries as (name, contents).
+  using ZipEntries = std::vector<std::pair<std::string, std::string>>;
+  /// The versions added since Load, then current.gin and history.json.
+  ZipEntries AppendedEntries(const EntryReader &read_entry) const;
+  /// Every version, re-encoded, then current.gin and history.json.
+  ZipEntries AllEntries(const EntryReader &read_entry) const;
+
   std::string current_data_;
   std::string current_timestamp_;
   std::vector<HistoryEntry> history_;
-  std::unordered_map<std::string, std::string> snapshots_;
+  std::unordered_map<std::string, StoredVersion> stored_;
+  /// Versions added since Load, whole.
+  std::unordered_map<std::string, std::string> added_;
+  std::filesystem::path origin_;
+  bool legacy_layout_ = false;
+  bool deleted_ = false;
 };
 
 std::filesystem::path
@@ -54,11 +132,17 @@ save_patch(const std::filesystem::path &patches_dir, const ym2612::Patch &patch,
 std::vector<ym2612::Patch> read_file(const std::filesystem::path &package_path);
 
 std::optional<GinPackage> load_package(const std::filesystem::path &path);
+std::optional<GinPackage>
+load_package_from_memory(const std::uint8_t *data, std::size_t size,
+                         const std::filesystem::path &path);
 std::optional<ym2612::Patch> read_current(const GinPackage &package);
 std::optional<ym2612::Patch> read_version(const GinPackage &package,
                                           const std::string &uuid);
 std::optional<ym2612::Patch> read_version(const std::filesystem::path &path,
                                           const std::string &uuid);
 bool delete_version(const std::filesystem::path &path, const std::string &uuid);
+/// Rewrites a package saved in the legacy layout in the current one,
+/// keeping every version. True when the package is current afterwards.
+bool migrate_package(const std::filesystem::path &path);
 
 } // namespace formats::ginpkg
@@ -0,0 +1,103 @@
+#include "json_delta.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace formats::json_delta {
+
+namespace {
+
+bool contains_null(const nlohmann::json &value) {
+  if (value.is_null()) {
+    return true;
+  }
+  if (value.is_structured()) {
+    for (const auto &item : value) {
+      if (contains_null(item)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+std::optional<nlohmann::json> diff(const nlohmann::json &base,
+                                   const nlohmann::json &target) {
+  if (contains_null(target)) {
+    return std::nullopt;
+  }
+
+  nlohmann::json delta = nlohmann::json::object();
+  if (base.is_object() && target.is_object()) {
+    for (const auto &[key, value] : target.items()) {
+      const auto it = base.find(key);
+      if (it == base.end()) {
+        delta[key] = value;
+      } else if (*it != value) {
+        auto change = diff(*it, value);
+        if (!change) {
+          return std::nullopt;
+        }
+        delta[key] = std::move(*change);
+      }
+    }
+    for (const auto &[key, value] : base.items()) {
+      if (!target.contains(key)) {
+        delta[key] = nullptr;
+      }
+    }
+    return delta;
+  }
+
+  if (base.is_array() && target.is_array() && base.size() == target.size()) {
+    for (std::size_t i = 0; i < target.size(); ++i) {
+      if (base[i] != target[i]) {
+        auto change = diff(base[i], target[i]);
+        if (!change) {
+          return std::nullopt;
+        }
+        delta[std::to_string(i)] = std::move(*change);
+      }
+    }
+    return delta;
+  }
+
+  // apply() reads an object against an array as per-index changes, so an
+  // array that becomes an object has no delta.
+  if (base.is_array() && target.is_object()) {
+    return std::nullopt;
+  }
+  return target;
+}
+
+nlohmann::json apply(nlohmann::json base, const nlohmann::json &delta) {
+  if (!delta.is_object()) {
+    return delta;
+  }
+  if (base.is_array()) {
+    for (const auto &[key, value] : delta.items()) {
+      const auto index = static_cast<std::size_t>(std::stoul(key));
+      if (index < base.size()) {
+        base[index] = apply(std::move(base[index]), value);
+      }
+    }
+    return base;
+  }
+  if (!base.is_object()) {
+    return delta;
+  }
+  for (const auto &[key, value] : delta.items()) {
+    if (value.is_null()) {
+      base.erase(key);
+    } else if (base.contains(key)) {
+      base[key] = apply(std::move(base[key]), value);
+    } else {
+      base[key] = value;
+    }
+  }
+  return base;
+}
+
+} // namespace formats::json_delta
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <optional>
+
+namespace formats::json_delta {
+
+/**
+ * The parts of `target` that differ from `base`, for storing one patch as a
+ * change against another.
+ *
+ * Objects are compared key by key and keep only the keys that changed; a key
+ * `target` no longer has maps to null. An array becomes an object of the
+ * indices that changed when both sides have the same length, and is replaced
+ * whole otherwise. Any other value is replaced whole. A patch that differs
+ * in one operator's attack rate therefore encodes as
+ * {"instrument":{"operators":{"2":{"attack_rate":12}}}}.
+ *
+ * Nothing when the change cannot be written this way: a null in `target`, or
+ * an array that turns into an object. Store the whole value instead.
+ */
+std::optional<nlohmann::json> diff(const nlohmann::json &base,
+                                   const nlohmann::json &target);
+
+/// `base` with `delta` from diff() applied; apply(base, *diff(base, t)) == t.
+nlohmann::json apply(nlohmann::json base, const nlohmann::json &delta);
+
+} // namespace formats::json_delta
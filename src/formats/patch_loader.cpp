@@ -10,6 +10,12 @@ PatchLoadResult load_patch_from_file(const std::filesystem::path &path) {
   return PatchRegistry::instance().load(path);
 }
 
+PatchLoadResult load_patch_from_memory(const std::filesystem::path &path,
+                                       const std::uint8_t *data,
+                                       std::size_t size) {
+  return PatchRegistry::instance().load(path, data, size);
+}
+
 std::string get_patch_name_from_file(const std::filesystem::path &path,
                                      const std::string &) {
   // Formats that carry a name of their own (.rym2612, .gin, .fui, ...) fill
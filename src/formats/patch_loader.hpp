@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../ym2612/patch.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <string>
 #include <vector>
@@ -20,6 +22,11 @@ struct PatchLoadResult {
 };
 
 PatchLoadResult load_patch_from_file(const std::filesystem::path &path);
+/// load_patch_from_file() for a file read some other way, e.g. out of an
+/// archive: `path` still picks the format and names unnamed patches.
+PatchLoadResult load_patch_from_memory(const std::filesystem::path &path,
+                                       const std::uint8_t *data,
+                                       std::size_t size);
 std::string get_patch_name_from_file(const std::filesystem::path &path,
                                      const std::string &format);
 
@@ -38,36 +38,30 @@ PatchRegistry::handler_for_extension(const std::string &extension) const {
   return nullptr;
 }
 
-PatchLoadResult PatchRegistry::load(const std::filesystem::path &path) const {
-  PatchLoadResult result;
-
-  if (!std::filesystem::exists(path) ||
-      !std::filesystem::is_regular_file(path)) {
-    result.status = PatchLoadStatus::Failure;
-    result.message = "File not found: " + path.string();
-    return result;
-  }
+namespace {
 
+std::string lowercase_extension(const std::filesystem::path &path) {
   std::string ext = path.extension().string();
   std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
     return static_cast<char>(std::tolower(c));
   });
+  return ext;
+}
 
-  auto handler = handler_for_extension(ext);
-  if (!handler || !handler->read_file) {
-    result.status = PatchLoadStatus::Failure;
-    result.message = "Unsupported file extension: " + ext;
-    return result;
-  }
-
-  auto patches = handler->read_file(path);
+/// Shared tail of both load() overloads: classify what the handler read and
+/// name the patches that came without one.
+PatchLoadResult finish_load(std::vector<ym2612::Patch> patches,
+                            const std::filesystem::path &path,
+                            const std::string &ext,
+                            const PatchFormatHandler &handler) {
+  PatchLoadResult result;
   const auto patches_size = patches.size();
   if (patches_size == 0) {
     result.status = PatchLoadStatus::Failure;
     if (ext == ".mml") {
       result.message = "No instruments found in MML file.";
     } else {
-      result.message = "Failed to load " + handler->label + " patch.";
+      result.message = "Failed to load " + handler.label + " patch.";
     }
   } else if (patches_size == 1) {
     if (patches[0].name.empty()) {
@@ -87,6 +81,45 @@ PatchLoadResult PatchRegistry::load(const std::filesystem::path &path) const {
   return result;
 }
 
+} // namespace
+
+PatchLoadResult PatchRegistry::load(const std::filesystem::path &path) const {
+  PatchLoadResult result;
+
+  if (!std::filesystem::exists(path) ||
+      !std::filesystem::is_regular_file(path)) {
+    result.status = PatchLoadStatus::Failure;
+    result.message = "File not found: " + path.string();
+    return result;
+  }
+
+  const auto ext = lowercase_extension(path);
+  auto handler = handler_for_extension(ext);
+  if (!handler || !handler->read_file) {
+    result.status = PatchLoadStatus::Failure;
+    result.message = "Unsupported file extension: " + ext;
+    return result;
+  }
+
+  return finish_load(handler->read_file(path), path, ext, *handler);
+}
+
+PatchLoadResult PatchRegistry::load(const std::filesystem::path &path,
+                                    const std::uint8_t *data,
+                                    std::size_t size) const {
+  const auto ext = lowercase_extension(path);
+  auto handler = handler_for_extension(ext);
+  if (!handler || !handler->read_memory) {
+    PatchLoadResult result;
+    result.status = PatchLoadStatus::Failure;
+    result.message = "Unsupported file extension: " + ext;
+    return result;
+  }
+
+  return finish_load(handler->read_memory(data, size, path), path, ext,
+                     *handler);
+}
+
 bool PatchRegistry::write(const std::string &extension,
                           const ym2612::Patch &patch,
                           const std::filesystem::path &target) const {
@@ -183,6 +216,11 @@ void PatchRegistry::register_defaults() {
       handler.read_file = [format](const std::filesystem::path &path) {
         return adapter::read_file(format, path);
       };
+      handler.read_memory = [format](const std::uint8_t *data,
+                                     std::size_t size,
+                                     const std::filesystem::path &path) {
+        return adapter::read_memory(format, data, size, path.stem().string());
+      };
     }
 
     if (info.can_write && info.is_text) {
@@ -228,13 +266,23 @@ void PatchRegistry::register_defaults() {
     register_format(adapter::extension_for(format), std::move(handler));
   }
 
-  register_format(".ginpkg",
-                  {formats::ginpkg::read_file,
-                   [](const std::filesystem::path &dir,
-                      const ym2612::Patch &patch, const std::string &name) {
-                     return formats::ginpkg::save_patch(dir, patch, name);
-                   },
-                   nullptr, nullptr, "GINPKG"});
+  register_format(
+      ".ginpkg",
+      {formats::ginpkg::read_file,
+       [](const std::filesystem::path &dir, const ym2612::Patch &patch,
+          const std::string &name) {
+         return formats::ginpkg::save_patch(dir, patch, name);
+       },
+       nullptr, nullptr, "GINPKG",
+       [](const std::uint8_t *data, std::size_t size,
+          const std::filesystem::path &path) {
+         auto package =
+             formats::ginpkg::load_package_from_memory(data, size, path);
+         auto patch = package ? formats::ginpkg::read_current(*package)
+                              : std::nullopt;
+         return patch ? std::vector<ym2612::Patch>{std::move(*patch)}
+                      : std::vector<ym2612::Patch>{};
+       }});
 }
 
 } // namespace formats
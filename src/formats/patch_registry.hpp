@@ -2,6 +2,8 @@
 
 #include "../ym2612/patch.hpp"
 #include "patch_loader.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <optional>
@@ -26,6 +28,11 @@ struct PatchFormatHandler {
       write_text;
   // Label to present in UI.
   std::string label;
+  // read_file for bytes already in memory, such as an entry of a mounted
+  // archive; the path only names them.
+  std::function<std::vector<ym2612::Patch>(
+      const std::uint8_t *, std::size_t, const std::filesystem::path &)>
+      read_memory;
 };
 
 struct SaveFormatInfo {
@@ -45,6 +52,9 @@ public:
   handler_for_extension(const std::string &extension) const;
 
   PatchLoadResult load(const std::filesystem::path &path) const;
+  /// load() for the contents of `path` already read into memory.
+  PatchLoadResult load(const std::filesystem::path &path,
+                       const std::uint8_t *data, std::size_t size) const;
   // Optional single-patch writer by extension.
   bool write(const std::string &extension, const ym2612::Patch &patch,
              const std::filesystem::path &target) const;
@@ -1,23 +1,15 @@
 #include "formats/ym2612_format_adapter.hpp"
 
+#include "platform/file_view.hpp"
+
 #include <algorithm>
 #include <cctype>
 #include <fstream>
-#include <iterator>
 
 namespace formats::adapter {
 
 namespace {
 
-std::vector<uint8_t> read_bytes(const std::filesystem::path &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file) {
-    return {};
-  }
-  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
-                              std::istreambuf_iterator<char>());
-}
-
 bool write_bytes(const std::filesystem::path &path,
                  const std::vector<uint8_t> &bytes) {
   std::ofstream file(path, std::ios::binary);
@@ -176,13 +168,23 @@ uint8_t detune_from_linear(int linear) {
 
 std::vector<ym2612::Patch> read_file(ym2612_format::Format format,
                                      const std::filesystem::path &path) {
-  const auto bytes = read_bytes(path);
-  if (bytes.empty()) {
+  const auto view = platform::FileView::open(path);
+  if (!view) {
+    return {};
+  }
+  return read_memory(format, view->data(), view->size(),
+                     path.stem().string());
+}
+
+std::vector<ym2612::Patch> read_memory(ym2612_format::Format format,
+                                       const std::uint8_t *data,
+                                       std::size_t size,
+                                       const std::string &name) {
+  if (size == 0) {
     return {};
   }
 
-  auto result = ym2612_format::parse_as(format, bytes.data(), bytes.size(),
-                                        path.stem().string());
+  auto result = ym2612_format::parse_as(format, data, size, name);
   if (!ym2612_format::is_ok(result)) {
     return {};
   }
@@ -2,6 +2,8 @@
 
 #include "ym2612/patch.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
@@ -63,6 +65,13 @@ uint8_t detune_from_linear(int linear);
 std::vector<ym2612::Patch> read_file(ym2612_format::Format format,
                                      const std::filesystem::path &path);
 
+/// read_file() for bytes already in memory; `name` stands in for the file's
+/// stem where a format takes its patch name from it.
+std::vector<ym2612::Patch> read_memory(ym2612_format::Format format,
+                                       const std::uint8_t *data,
+                                       std::size_t size,
+                                       const std::string &name);
+
 bool write_file(ym2612_format::Format format, const ym2612::Patch &patch,
                 const std::filesystem::path &path);
 
@@ -0,0 +1,250 @@
+#include "zip_append.hpp"
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+namespace formats::zip_append {
+
+namespace {
+
+constexpr std::uint32_t kLocalHeader = 0x04034b50;
+constexpr std::uint32_t kCentralHeader = 0x02014b50;
+constexpr std::uint32_t kEndOfCentralDirectory = 0x06054b50;
+constexpr std::size_t kLocalHeaderSize = 30;
+constexpr std::size_t kCentralHeaderSize = 46;
+constexpr std::size_t kEndSize = 22;
+
+std::uint16_t read16(const std::string &bytes, std::size_t offset) {
+  return static_cast<std::uint16_t>(
+      static_cast<unsigned char>(bytes[offset]) |
+      static_cast<unsigned char>(bytes[offset + 1]) << 8);
+}
+
+std::uint32_t read32(const std::string &bytes, std::size_t offset) {
+  return static_cast<std::uint32_t>(read16(bytes, offset)) |
+         static_cast<std::uint32_t>(read16(bytes, offset + 2)) << 16;
+}
+
+void write16(std::string &out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value & 0xFF));
+  out.push_back(static_cast<char>((value >> 8) & 0xFF));
+}
+
+void write32(std::string &out, std::uint32_t value) {
+  write16(out, value & 0xFFFF);
+  write16(out, value >> 16);
+}
+
+/// MS-DOS time and date, which is what zip headers store.
+std::pair<std::uint16_t, std::uint16_t> dos_time_now() {
+  const std::time_t now = std::time(nullptr);
+  std::tm tm = {};
+#if defined(_WIN32)
+  localtime_s(&tm, &now);
+#else
+  localtime_r(&now, &tm);
+#endif
+  const auto time = static_cast<std::uint16_t>(
+      (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+  const auto date = static_cast<std::uint16_t>(
+      (std::max(tm.tm_year - 80, 0) << 9) | ((tm.tm_mon + 1) << 5) |
+      tm.tm_mday);
+  return {time, date};
+}
+
+struct CentralRecord {
+  std::string name;
+  std::uint32_t local_offset = 0;
+  std::size_t begin = 0; ///< Within the central directory bytes.
+  std::size_t end = 0;
+};
+
+} // namespace
+
+bool replace_tail(const std::filesystem::path &path,
+                  const std::vector<std::string> &tail,
+                  const std::vector<Entry> &entries) {
+  std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+  if (!file) {
+    return false;
+  }
+  file.seekg(0, std::ios::end);
+  const auto file_size = static_cast<std::uint64_t>(file.tellg());
+  if (file_size < kEndSize) {
+    return false;
+  }
+
+  std::string end(kEndSize, '\0');
+  file.seekg(static_cast<std::streamoff>(file_size - kEndSize));
+  file.read(end.data(), kEndSize);
+  if (!file || read32(end, 0) != kEndOfCentralDirectory ||
+      read16(end, 20) != 0 || read16(end, 4) != 0) {
+    return false;
+  }
+  const std::uint16_t count = read16(end, 10);
+  const std::uint32_t directory_size = read32(end, 12);
+  const std::uint32_t directory_offset = read32(end, 16);
+  if (count == 0xFFFF || directory_offset == 0xFFFFFFFF ||
+      std::uint64_t{directory_offset} + directory_size !=
+          file_size - kEndSize) {
+    return false;
+  }
+
+  std::string directory(directory_size, '\0');
+  file.seekg(directory_offset);
+  file.read(directory.data(), directory_size);
+  if (!file) {
+    return false;
+  }
+
+  std::vector<CentralRecord> records;
+  std::size_t offset = 0;
+  for (std::uint16_t i = 0; i < count; ++i) {
+    if (offset + kCentralHeaderSize > directory.size() ||
+        read32(directory, offset) != kCentralHeader) {
+      return false;
+    }
+    const std::size_t name_size = read16(directory, offset + 28);
+    const std::size_t record_size = kCentralHeaderSize + name_size +
+                                    read16(directory, offset + 30) +
+                                    read16(directory, offset + 32);
+    if (offset + record_size > directory.size()) {
+      return false;
+    }
+    CentralRecord record;
+    record.name = directory.substr(offset + kCentralHeaderSize, name_size);
+    record.local_offset = read32(directory, offset + 42);
+    record.begin = offset;
+    record.end = offset + record_size;
+    records.push_back(std::move(record));
+    offset += record_size;
+  }
+
+  // The tail must follow every entry that stays.
+  const auto in_tail = [&](const CentralRecord &record) {
+    return std::find(tail.begin(), tail.end(), record.name) != tail.end();
+  };
+  std::uint32_t cut = directory_offset;
+  std::size_t found = 0;
+  for (const auto &record : records) {
+    if (in_tail(record)) {
+      cut = std::min(cut, record.local_offset);
+      ++found;
+    }
+  }
+  const bool tail_is_last =
+      std::none_of(records.begin(), records.end(), [&](const auto &record) {
+        return !in_tail(record) && record.local_offset >= cut;
+      });
+  if (found != tail.size() || !tail_is_last ||
+      records.size() - found + entries.size() >= 0xFFFF) {
+    return false;
+  }
+
+  // Build everything from the cut onwards, then write it in one go.
+  const auto [time, date] = dos_time_now();
+  std::string out;
+  std::string new_directory;
+  std::uint64_t position = cut;
+  for (const auto &entry : entries) {
+    if (entry.data.size() >= std::numeric_limits<std::uint32_t>::max() ||
+        entry.name.size() > 0xFFFF) {
+      return false;
+    }
+    const auto crc = static_cast<std::uint32_t>(
+        mz_crc32(MZ_CRC32_INIT,
+                 reinterpret_cast<const unsigned char *>(entry.data.data()),
+                 entry.data.size()));
+    const auto size = static_cast<std::uint32_t>(entry.data.size());
+    const auto name_size = static_cast<std::uint32_t>(entry.name.size());
+
+    write32(out, kLocalHeader);
+    write16(out, 20); // version needed
+    write16(out, 0);  // flags
+    write16(out, 0);  // stored
+    write16(out, time);
+    write16(out, date);
+    write32(out, crc);
+    write32(out, size);
+    write32(out, size);
+    write16(out, name_size);
+    write16(out, 0); // extra
+    out += entry.name;
+    out += entry.data;
+
+    write32(new_directory, kCentralHeader);
+    write16(new_directory, 20); // made by
+    write16(new_directory, 20); // needed
+    write16(new_directory, 0);
+    write16(new_directory, 0);
+    write16(new_directory, time);
+    write16(new_directory, date);
+    write32(new_directory, crc);
+    write32(new_directory, size);
+    write32(new_directory, size);
+    write16(new_directory, name_size);
+    write16(new_directory, 0); // extra
+    write16(new_directory, 0); // comment
+    write16(new_directory, 0); // disk
+    write16(new_directory, 0); // internal attributes
+    write32(new_directory, 0); // external attributes
+    write32(new_directory, static_cast<std::uint32_t>(position));
+    new_directory += entry.name;
+
+    position += kLocalHeaderSize + entry.name.size() + entry.data.size();
+    if (position >= std::numeric_limits<std::uint32_t>::max()) {
+      return false;
+    }
+  }
+
+  const auto new_directory_offset = static_cast<std::uint32_t>(position);
+  std::uint16_t new_count = 0;
+  for (const auto &record : records) {
+    if (!in_tail(record)) {
+      out.append(directory, record.begin, record.end - record.begin);
+      ++new_count;
+    }
+  }
+  out += new_directory;
+  new_count = static_cast<std::uint16_t>(new_count + entries.size());
+  const auto new_directory_size = static_cast<std::uint32_t>(
+      out.size() - (new_directory_offset - cut));
+
+  write32(out, kEndOfCentralDirectory);
+  write16(out, 0);
+  write16(out, 0);
+  write16(out, new_count);
+  write16(out, new_count);
+  write32(out, new_directory_size);
+  write32(out, new_directory_offset);
+  write16(out, 0);
+
+  file.seekp(cut);
+  file.write(out.data(), static_cast<std::streamsize>(out.size()));
+  file.close();
+  if (!file) {
+    std::cerr << "Failed to write " << path << std::endl;
+    return false;
+  }
+  const std::uint64_t new_size = std::uint64_t{cut} + out.size();
+  if (new_size < file_size) {
+    std::error_code error;
+    std::filesystem::resize_file(path, new_size, error);
+    if (error) {
+      std::cerr << "Failed to truncate " << path << ": " << error.message()
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace formats::zip_append
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace formats::zip_append {
+
+struct Entry {
+  std::string name;
+  std::string data;
+};
+
+/**
+ * Replace the last entries of the zip archive at `path` in place.
+ *
+ * The entries named in `tail` must be the last ones in the file. Everything
+ * before them is left byte for byte where it is: the file is cut where the
+ * tail began, `entries` are written there uncompressed, and the central
+ * directory is rebuilt from the surviving records plus the new ones. Saving
+ * a file that keeps its changing parts at the end therefore costs the size
+ * of those parts, not the size of the file.
+ *
+ * Returns false without touching the file when the archive is not laid out
+ * that way, or is one this writer does not handle (a zip64 archive, a
+ * trailing comment, or more than 65535 entries); write the whole archive
+ * instead. False after writing has started means an I/O error.
+ */
+bool replace_tail(const std::filesystem::path &path,
+                  const std::vector<std::string> &tail,
+                  const std::vector<Entry> &entries);
+
+} // namespace formats::zip_append
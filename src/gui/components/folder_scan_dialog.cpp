@@ -28,6 +28,31 @@ void close_scan_popup() {
   }
 }
 
+/// One line per queued or running folder, each cancelled on its own; a
+/// queued one can be moved to the front.
+void render_folder_rows(const patches::background_folder_scan::Status &status) {
+  namespace scan = patches::background_folder_scan;
+  ImGui::Spacing();
+  for (const auto &folder : status.folders) {
+    ImGui::PushID(folder.folder.string().c_str());
+    if (folder.running) {
+      ImGui::Text("%s: %zu files", folder.folder_name.c_str(),
+                  folder.files_seen);
+    } else {
+      ImGui::TextDisabled("%s: queued", folder.folder_name.c_str());
+      ImGui::SameLine();
+      if (ImGui::SmallButton("Next")) {
+        scan::prioritize(folder.folder);
+      }
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Cancel")) {
+      scan::cancel(folder.folder);
+    }
+    ImGui::PopID();
+  }
+}
+
 } // namespace
 
 void render_folder_scan_dialog() {
@@ -60,8 +85,14 @@ void render_folder_scan_dialog() {
   // No way out but the button: Cancel stops the scan, and a dismissal that
   // only hid the dialog would leave it running with nothing to stop it.
   if (begin_modal(kScanPopupTitle, ModalDismiss::None).visible) {
-    ImGui::Text("Scanning \"%s\"... %zu files", status.folder_name.c_str(),
-                status.files_seen);
+    if (status.folders_total > 1) {
+      ImGui::Text("Scanning folders... %zu of %zu done, %zu files",
+                  status.folders_finished, status.folders_total,
+                  status.files_seen);
+    } else {
+      ImGui::Text("Scanning \"%s\"... %zu files", status.folder_name.c_str(),
+                  status.files_seen);
+    }
     if (status.containers_parsed > 0) {
       ImGui::TextDisabled("%zu banks parsed", status.containers_parsed);
     }
@@ -69,9 +100,13 @@ void render_folder_scan_dialog() {
     // fills: a negative fraction is ImGui's indeterminate mode.
     ImGui::ProgressBar(static_cast<float>(-ImGui::GetTime()),
                        ImVec2(-FLT_MIN, 0));
+    if (status.folders.size() > 1) {
+      render_folder_rows(status);
+    }
     ImGui::Spacing();
     align_buttons_right({kDialogButtonWidth});
-    if (ImGui::Button("Cancel", ImVec2(kDialogButtonWidth, 0))) {
+    if (ImGui::Button(status.folders.size() > 1 ? "Cancel All" : "Cancel",
+                      ImVec2(kDialogButtonWidth, 0))) {
       scan::request_cancel();
     }
     end_modal();
@@ -7,10 +7,10 @@
 namespace ui {
 
 /**
- * Drive the background folder scan and show its progress modal.
+ * Drive the background folder scans and show their progress modal.
  *
- * Called every frame: this is also what runs a finished scan's completion
- * callback on the UI thread. The modal only appears once a scan has run long
+ * Called every frame: this is also what starts queued folders and runs each
+ * finished scan's completion callback on the UI thread. The modal only appears once a scan has run long
  * enough to be worth interrupting the user for.
  */
 void render_folder_scan_dialog();
@@ -1,45 +1,69 @@
 #include "patch_filter.hpp"
 
+#include "core/utf8_utils.hpp"
+
 #include <cctype>
+#include <string_view>
 
 namespace ui::selector_detail {
 
 std::string to_lower(const std::string &value) {
-  std::string lowered;
-  lowered.reserve(value.size());
-  for (unsigned char ch : value) {
-    lowered.push_back(static_cast<char>(std::tolower(ch)));
-  }
-  return lowered;
+  return megatoy::utf8::fold_case(value);
 }
 
-bool contains_case_insensitive(const std::string &haystack,
-                               const std::string &needle_lower) {
-  if (needle_lower.empty()) {
-    return true;
-  }
-  return to_lower(haystack).find(needle_lower) != std::string::npos;
-}
+ParsedQuery parse_query(const std::string &query, int min_star_rating) {
+  constexpr std::string_view kCategory = "category:";
+  constexpr std::string_view kTag = "tag:";
 
-bool entry_passes_star_filter(const patches::PatchEntry &entry,
-                              int min_star_rating) {
-  if (min_star_rating <= 0) {
-    return true;
+  const auto is_space = [](char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+  };
+
+  ParsedQuery parsed;
+  parsed.metadata.min_stars = min_star_rating;
+  std::size_t pos = 0;
+  while (pos < query.size()) {
+    if (is_space(query[pos])) {
+      parsed.text += query[pos++];
+      continue;
+    }
+    const auto start = pos;
+    while (pos < query.size() && !is_space(query[pos])) {
+      ++pos;
+    }
+    const std::string_view word(query.data() + start, pos - start);
+    const auto folded = to_lower(std::string(word));
+    if (folded.size() > kCategory.size() && folded.starts_with(kCategory)) {
+      parsed.metadata.category = folded.substr(kCategory.size());
+    } else if (folded.size() > kTag.size() && folded.starts_with(kTag)) {
+      parsed.metadata.tags.push_back(folded.substr(kTag.size()));
+    } else {
+      parsed.text += word;
+      continue;
+    }
+    // A term goes with the spaces after it, or at the end of the query the
+    // ones before it, so taking it out leaves no stray separator behind.
+    while (pos < query.size() && is_space(query[pos])) {
+      ++pos;
+    }
+    if (pos == query.size()) {
+      while (!parsed.text.empty() && is_space(parsed.text.back())) {
+        parsed.text.pop_back();
+      }
+    }
   }
-  const int rating = entry.metadata ? entry.metadata->star_rating : 0;
-  return rating >= min_star_rating;
+  return parsed;
 }
 
-bool entry_matches_query(const patches::PatchEntry &entry,
-                         const std::string &query_lower) {
+bool node_matches_query(const patches::PatchIndex &index,
+                        patches::PatchIndex::NodeId node,
+                        const std::string &query_lower) {
   if (query_lower.empty()) {
     return true;
   }
-  if (contains_case_insensitive(entry.name, query_lower)) {
-    return true;
-  }
-  return entry.metadata &&
-         contains_case_insensitive(entry.metadata->category, query_lower);
+  return index.folded_name(node).find(query_lower) != std::string_view::npos ||
+         index.folded_category(node).find(query_lower) !=
+             std::string_view::npos;
 }
 
 } // namespace ui::selector_detail
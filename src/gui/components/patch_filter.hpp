@@ -4,19 +4,31 @@
 // patch_selector_shared.hpp so the tree flattening pass -- and its unit test
 // -- can use them without pulling in ImGui.
 
-#include "patches/patch_repository.hpp"
+#include "patches/patch_index.hpp"
+#include "patches/patch_metadata_index.hpp"
 
 #include <string>
 
 namespace ui::selector_detail {
 
+/// Case-folds the search box text the same way the indexes fold names.
 std::string to_lower(const std::string &value);
-bool contains_case_insensitive(const std::string &haystack,
-                               const std::string &needle_lower);
 
-bool entry_passes_star_filter(const patches::PatchEntry &entry,
-                              int min_star_rating);
-bool entry_matches_query(const patches::PatchEntry &entry,
-                         const std::string &query_lower);
+/**
+ * The search box split in two. `category:bass` and `tag:lead` terms join the
+ * star filter as a PatchMetadataIndex filter; the rest, spaces and all, is
+ * the text PatchSearchIndex matches, exactly as typed.
+ */
+struct ParsedQuery {
+  std::string text;
+  patches::PatchMetadataIndex::Filter metadata;
+};
+ParsedQuery parse_query(const std::string &query, int min_star_rating);
+
+/// Patches are matched through PatchSearchIndex; this per-node predicate
+/// covers directory rows, which are not in that index.
+bool node_matches_query(const patches::PatchIndex &index,
+                        patches::PatchIndex::NodeId node,
+                        const std::string &query_lower);
 
 } // namespace ui::selector_detail
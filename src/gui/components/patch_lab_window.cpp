@@ -2,6 +2,7 @@
 
 #include "common.hpp"
 #include "imgui_internal.h"
+#include "patches/patch_index.hpp"
 #include "patches/patch_lab.hpp"
 #include <IconsFontAwesome7.h>
 #include <algorithm>
@@ -17,37 +18,28 @@
 namespace ui {
 namespace {
 
-using EntryPtr = const patches::PatchEntry *;
-
 struct EntryDisplay {
-  EntryPtr entry = nullptr;
+  std::string relative_path;
   std::string label;
 };
 
-void collect_entries(const std::vector<patches::PatchEntry> &tree,
-                     std::vector<EntryDisplay> &out) {
-  for (const auto &entry : tree) {
-    if (entry.is_directory) {
-      collect_entries(entry.children, out);
-    } else {
-      EntryDisplay display;
-      display.entry = &entry;
-      if (!entry.relative_path.empty()) {
-        display.label = display_preset_path(entry.relative_path);
-      } else if (!entry.name.empty()) {
-        display.label = entry.name;
-      } else {
-        display.label = "(unnamed patch)";
-      }
-      out.push_back(std::move(display));
-    }
-  }
-}
-
 std::vector<EntryDisplay>
 build_entry_list(const patches::PatchRepository &repository) {
+  const auto &index = repository.index();
   std::vector<EntryDisplay> entries;
-  collect_entries(repository.tree(), entries);
+  entries.reserve(index.patch_count());
+  for (const auto node : index.patches()) {
+    EntryDisplay display;
+    display.relative_path = index.relative_path(node);
+    if (!display.relative_path.empty()) {
+      display.label = display_preset_path(display.relative_path);
+    } else if (!index.name(node).empty()) {
+      display.label = std::string(index.name(node));
+    } else {
+      display.label = "(unnamed patch)";
+    }
+    entries.push_back(std::move(display));
+  }
   std::sort(entries.begin(), entries.end(),
             [](const EntryDisplay &lhs, const EntryDisplay &rhs) {
               return lhs.label < rhs.label;
@@ -55,26 +47,26 @@ build_entry_list(const patches::PatchRepository &repository) {
   return entries;
 }
 
-EntryPtr sanitize_selection(EntryPtr selection,
-                            const std::vector<EntryDisplay> &entries) {
+std::string sanitize_selection(const std::string &selection,
+                               const std::vector<EntryDisplay> &entries) {
   const bool contains = std::any_of(entries.begin(), entries.end(),
-                                    [selection](const EntryDisplay &item) {
-                                      return item.entry == selection;
+                                    [&selection](const EntryDisplay &item) {
+                                      return item.relative_path == selection;
                                     });
   if (contains || entries.empty()) {
-    return contains ? selection : nullptr;
+    return contains ? selection : std::string();
   }
-  return entries.front().entry;
+  return entries.front().relative_path;
 }
 
-std::string combo_preview_label(EntryPtr selection,
+std::string combo_preview_label(const std::string &selection,
                                 const std::vector<EntryDisplay> &entries) {
-  if (!selection) {
+  if (selection.empty()) {
     return "<select>";
   }
   auto it = std::find_if(entries.begin(), entries.end(),
-                         [selection](const EntryDisplay &item) {
-                           return item.entry == selection;
+                         [&selection](const EntryDisplay &item) {
+                           return item.relative_path == selection;
                          });
   if (it != entries.end()) {
     return it->label;
@@ -84,7 +76,7 @@ std::string combo_preview_label(EntryPtr selection,
 
 bool render_patch_combo(const char *label,
                         const std::vector<EntryDisplay> &entries,
-                        EntryPtr &selection, std::string &filter_text,
+                        std::string &selection, std::string &filter_text,
                         float &min_width) {
   const std::string preview = combo_preview_label(selection, entries);
   bool changed = false;
@@ -141,9 +133,9 @@ bool render_patch_combo(const char *label,
       }
 
       if (should_show) {
-        const bool is_selected = selection == item.entry;
+        const bool is_selected = selection == item.relative_path;
         if (ImGui::Selectable(item.label.c_str(), is_selected)) {
-          selection = item.entry;
+          selection = item.relative_path;
           changed = true;
           filter_text.clear();
         }
@@ -163,11 +155,14 @@ bool render_patch_combo(const char *label,
 }
 
 bool load_patch_from_entry(const patches::PatchRepository &repository,
-                           EntryPtr entry, ym2612::Patch &out_patch) {
-  if (!entry) {
+                           const std::string &relative_path,
+                           ym2612::Patch &out_patch) {
+  const auto &index = repository.index();
+  const auto node = index.find(relative_path);
+  if (relative_path.empty() || !node || index.is_directory(*node)) {
     return false;
   }
-  return repository.load_patch(*entry, out_patch);
+  return repository.load_patch(index.entry(*node), out_patch);
 }
 
 void apply_patch_result(PatchLabContext &context,
@@ -437,11 +432,14 @@ void render_patch_lab(const char *title, PatchLabContext &context,
         ImGui::EndTabItem();
       }
       if (ImGui::BeginTabItem(ICON_FA_SHUFFLE " Mix")) {
+        // Both pickers list every patch, not just the folders opened so far.
+        repository.require_full_listing();
         const auto entries = build_entry_list(repository);
         render_merge_section(context, state, entries);
         ImGui::EndTabItem();
       }
       if (ImGui::BeginTabItem(ICON_FA_FLASK_VIAL " Morph")) {
+        repository.require_full_listing();
         const auto entries = build_entry_list(repository);
         render_morph_section(context, state, entries);
         ImGui::EndTabItem();
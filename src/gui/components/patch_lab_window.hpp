@@ -37,9 +37,9 @@ struct PatchLabState {
   int random_seed = -1;
   int random_template_iterations = 4;
 
-  // Shared sources for blend/morph
-  const patches::PatchEntry *source_a = nullptr;
-  const patches::PatchEntry *source_b = nullptr;
+  // Shared sources for blend/morph, by relative path; empty for none
+  std::string source_a;
+  std::string source_b;
   int merge_seed = -1;
   std::uint32_t merge_last_seed = 0;
   bool merge_has_result = false;
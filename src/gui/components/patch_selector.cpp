@@ -2,6 +2,7 @@
 
 #include "gui/styles/megatoy_style.hpp"
 #include "patch_selector_shared.hpp"
+#include "patch_selector_state.hpp"
 #include "patch_table_view.hpp"
 #include "patch_tree_view.hpp"
 
@@ -34,14 +35,18 @@ void render_add_folder_action(PatchSelectorContext &context) {
   ImGui::Separator();
 }
 
-void render_tree_tab(PatchSelectorContext &context) {
+void render_tree_tab(PatchSelectorContext &context, TreeRowCache &rows) {
   render_filter_bar(context);
   if (ImGui::BeginChild("PresetTree", ImGui::GetContentRegionAvail(), true)) {
     const std::string query_lower =
         to_lower(context.prefs.metadata_search_query);
+    // A filter has to see into folders nobody has opened yet.
+    if (!query_lower.empty() || context.prefs.metadata_star_filter > 0) {
+      context.repository.require_full_listing();
+    }
     const bool rendered =
-        render_patch_tree(context.repository.tree(), context, query_lower,
-                          context.prefs.metadata_star_filter);
+        render_patch_tree(context.repository.index(), context, rows,
+                          query_lower, context.prefs.metadata_star_filter);
     if (!rendered &&
         (!query_lower.empty() || context.prefs.metadata_star_filter > 0)) {
       ImGui::TextColored(styles::color(styles::MegatoyCol::TextMuted),
@@ -53,7 +58,8 @@ void render_tree_tab(PatchSelectorContext &context) {
 
 } // namespace
 
-void render_patch_selector(const char *title, PatchSelectorContext &context) {
+void render_patch_selector(const char *title, PatchSelectorContext &context,
+                           PatchSelectorState &state) {
   auto &prefs = context.prefs;
   if (!prefs.show_patch_selector) {
     return;
@@ -84,12 +90,19 @@ void render_patch_selector(const char *title, PatchSelectorContext &context) {
 
   if (ImGui::BeginTabBar("##PatchViewMode")) {
     if (ImGui::BeginTabItem(ICON_FA_FOLDER_TREE " Tree view")) {
-      render_tree_tab(context);
+      render_tree_tab(context, state.tree);
       ImGui::EndTabItem();
     }
-    if (ImGui::BeginTabItem(ICON_FA_TABLE " Table view")) {
+    // "Find Similar" shows its results in the table, from either view.
+    const auto table_flags = context.pending_similar_search
+                                 ? ImGuiTabItemFlags_SetSelected
+                                 : ImGuiTabItemFlags_None;
+    if (ImGui::BeginTabItem(ICON_FA_TABLE " Table view", nullptr,
+                            table_flags)) {
       render_filter_bar(context);
-      render_patch_table(context);
+      // The table is flat, so it lists every patch there is.
+      context.repository.require_full_listing();
+      render_patch_table(context, state.table);
       ImGui::EndTabItem();
     }
     ImGui::EndTabBar();
@@ -7,10 +7,20 @@
 #include <functional>
 #include <imgui.h>
 #include <optional>
+#include <string>
 
 namespace ui {
 
-enum class TableSortColumn { Name, Category, StarRating, Format, Path };
+enum class TableSortColumn {
+  Name,
+  Category,
+  StarRating,
+  Format,
+  Path,
+  Loudness,
+  Brightness,
+  Attack
+};
 
 enum class SortOrder { Ascending, Descending };
 
@@ -35,6 +45,8 @@ struct PatchSelectorContext {
   std::function<void(const patches::PatchEntry &)> delete_patch;
   std::optional<std::filesystem::path> pending_remove_folder;
   std::optional<PendingMenuAction> pending_menu_action;
+  /// "Find Similar" on this relative path; the table view takes it up.
+  std::optional<std::string> pending_similar_search;
 
   TableSortColumn get_sort_column() const {
     return static_cast<TableSortColumn>(prefs.patch_sort_column);
@@ -53,7 +65,11 @@ struct PatchSelectorContext {
   }
 };
 
+/// What the browser keeps across frames; see patch_selector_state.hpp.
+struct PatchSelectorState;
+
 // Function to render patch browser panel
-void render_patch_selector(const char *title, PatchSelectorContext &context);
+void render_patch_selector(const char *title, PatchSelectorContext &context,
+                           PatchSelectorState &state);
 
 } // namespace ui
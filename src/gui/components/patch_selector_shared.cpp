@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <cstring>
 #include <imgui.h>
+#include <vector>
 
 namespace ui::selector_detail {
 
@@ -49,13 +50,12 @@ void show_patch_tooltip(const patches::PatchEntry &entry) {
   ImGui::SetTooltip("%s", tooltip.c_str());
 }
 
-void entry_context_menu(PatchSelectorContext &context,
-                        const patches::PatchEntry &entry,
-                        bool allow_remove_folder) {
-  if (!ImGui::BeginPopupContextItem(nullptr)) {
-    return;
-  }
+namespace {
 
+/// The menu's items, inside a popup the caller has begun.
+void entry_context_menu_items(PatchSelectorContext &context,
+                              const patches::PatchEntry &entry,
+                              bool allow_remove_folder) {
   const bool is_current =
       !entry.is_directory &&
       entry.relative_path == context.session.current_patch_selection_path();
@@ -81,6 +81,10 @@ void entry_context_menu(PatchSelectorContext &context,
     }
   }
 
+  if (!entry.is_directory && ImGui::MenuItem("Find Similar")) {
+    context.pending_similar_search = entry.relative_path;
+  }
+
   if (context.download_entry) {
     if (ImGui::MenuItem("Download")) {
       context.download_entry(entry);
@@ -102,6 +106,21 @@ void entry_context_menu(PatchSelectorContext &context,
     ImGui::Separator();
   }
 
+  if (!entry.is_directory && context.repository.can_edit_metadata(entry)) {
+    const bool hidden = entry.metadata && entry.metadata->hidden;
+    if (ImGui::MenuItem(hidden ? "Show in Browser" : "Hide from Browser")) {
+      // The listing only carries what it displays; start from the stored
+      // record so its hash and dates survive the edit.
+      auto metadata =
+          context.repository.get_patch_metadata(entry.relative_path)
+              .value_or(patches::PatchMetadata{});
+      metadata.path = entry.relative_path;
+      metadata.hidden = !hidden;
+      context.repository.update_patch_metadata(entry.relative_path, metadata);
+    }
+    ImGui::Separator();
+  }
+
   const bool protected_folder = context.folder_is_protected &&
                                 context.folder_is_protected(entry.full_path);
 
@@ -130,7 +149,35 @@ void entry_context_menu(PatchSelectorContext &context,
   if (ImGui::MenuItem("Refresh repository")) {
     context.pending_menu_action = PendingMenuAction::Refresh;
   }
+}
+
+} // namespace
+
+void show_patch_tooltip(const patches::PatchIndex &index,
+                        patches::PatchIndex::NodeId node) {
+  if (ImGui::IsItemHovered()) {
+    show_patch_tooltip(index.entry(node));
+  }
+}
+
+void entry_context_menu(PatchSelectorContext &context,
+                        const patches::PatchEntry &entry,
+                        bool allow_remove_folder) {
+  if (!ImGui::BeginPopupContextItem(nullptr)) {
+    return;
+  }
+  entry_context_menu_items(context, entry, allow_remove_folder);
+  ImGui::EndPopup();
+}
 
+void entry_context_menu(PatchSelectorContext &context,
+                        const patches::PatchIndex &index,
+                        patches::PatchIndex::NodeId node,
+                        bool allow_remove_folder) {
+  if (!ImGui::BeginPopupContextItem(nullptr)) {
+    return;
+  }
+  entry_context_menu_items(context, index.entry(node), allow_remove_folder);
   ImGui::EndPopup();
 }
 
@@ -147,6 +194,9 @@ void render_filter_bar(PatchSelectorContext &context) {
                                search_buffer, sizeof(search_buffer))) {
     prefs.metadata_search_query = std::string(search_buffer);
   }
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip("Add category:<name> or tag:<name> to filter by them.");
+  }
   prefs.patch_search_query = prefs.metadata_search_query;
 
   ImGui::SameLine();
@@ -174,4 +224,53 @@ void render_filter_bar(PatchSelectorContext &context) {
   ImGui::EndDisabled();
 }
 
+void prefetch_around(
+    PatchSelectorContext &context, std::size_t current, std::size_t row_count,
+    const std::function<std::optional<patches::PatchEntry>(std::size_t)>
+        &entry_at) {
+  std::vector<patches::PatchEntry> neighbours;
+  neighbours.reserve(kPrefetchRadius * 2);
+  // Walk outwards in both directions, skipping directory rows, until each
+  // side has its share or runs out of rows.
+  std::size_t after = current + 1;
+  std::size_t before = current;
+  std::size_t wanted_after = kPrefetchRadius;
+  std::size_t wanted_before = kPrefetchRadius;
+  const auto more_after = [&] { return wanted_after > 0 && after < row_count; };
+  const auto more_before = [&] { return wanted_before > 0 && before > 0; };
+  while (more_after() || more_before()) {
+    if (more_after()) {
+      if (auto entry = entry_at(after++)) {
+        neighbours.push_back(std::move(*entry));
+        --wanted_after;
+      }
+    }
+    if (more_before()) {
+      if (auto entry = entry_at(--before)) {
+        neighbours.push_back(std::move(*entry));
+        --wanted_before;
+      }
+    }
+  }
+  std::vector<const patches::PatchEntry *> pointers;
+  pointers.reserve(neighbours.size());
+  for (const auto &entry : neighbours) {
+    pointers.push_back(&entry);
+  }
+  context.session.prefetch_patches(pointers);
+}
+
+bool nav_arrived(const std::string &relative_path) {
+  // One browser, one navigation cursor: the two views can share this.
+  static std::string last_focused;
+  if (!ImGui::IsItemFocused() || !ImGui::GetIO().NavVisible) {
+    return false;
+  }
+  if (last_focused == relative_path) {
+    return false;
+  }
+  last_focused = relative_path;
+  return true;
+}
+
 } // namespace ui::selector_detail
@@ -5,8 +5,12 @@
 
 #include "patch_filter.hpp"
 #include "patch_selector.hpp"
+#include "patches/patch_index.hpp"
 
 #include <array>
+#include <cstddef>
+#include <functional>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -24,7 +28,35 @@ void entry_context_menu(PatchSelectorContext &context,
                         const patches::PatchEntry &entry,
                         bool allow_remove_folder = false);
 
+/// The same two for a node of `index`, whose PatchEntry is built only while
+/// the tooltip or menu is actually showing.
+void show_patch_tooltip(const patches::PatchIndex &index,
+                        patches::PatchIndex::NodeId node);
+void entry_context_menu(PatchSelectorContext &context,
+                        const patches::PatchIndex &index,
+                        patches::PatchIndex::NodeId node,
+                        bool allow_remove_folder = false);
+
 /// The search box, star filter and "Clear filters" row above either view.
 void render_filter_bar(PatchSelectorContext &context);
 
+/// Patches either side of the current one that are kept decoded.
+inline constexpr std::size_t kPrefetchRadius = 4;
+
+/**
+ * Ask the session to keep the patches around row `current` decoded, nearest
+ * first, so stepping to a neighbour switches sounds without touching the
+ * disk. `entry_at` returns a row's patch, or nothing for a directory row.
+ */
+void prefetch_around(
+    PatchSelectorContext &context, std::size_t current, std::size_t row_count,
+    const std::function<std::optional<patches::PatchEntry>(std::size_t)>
+        &entry_at);
+
+/**
+ * True on the frame keyboard navigation lands on the last drawn item. Loading
+ * then is what lets the arrow keys audition patch after patch.
+ */
+bool nav_arrived(const std::string &relative_path);
+
 } // namespace ui::selector_detail
@@ -0,0 +1,17 @@
+#pragma once
+
+// What the patch browser keeps from one frame to the next. Apart from
+// patch_selector.hpp, which the views' own headers include.
+
+#include "patch_selector.hpp"
+#include "patch_table_view.hpp"
+#include "patch_tree_flatten.hpp"
+
+namespace ui {
+
+struct PatchSelectorState {
+  selector_detail::TreeRowCache tree;
+  selector_detail::PatchTableState table;
+};
+
+} // namespace ui
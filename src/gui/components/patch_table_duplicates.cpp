@@ -0,0 +1,190 @@
+#include "patch_table_duplicates.hpp"
+
+#include "core/status.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <string>
+#include <utility>
+
+namespace ui::selector_detail {
+
+namespace {
+
+using patches::PatchIndex;
+
+/// Mark `rows` hidden or not, in one metadata write; rows that already
+/// agree, or whose folder takes no metadata, are skipped.
+void set_hidden(PatchSelectorContext &context, const DuplicateRows &duplicates,
+                const std::vector<std::size_t> &rows, bool hidden) {
+  const auto &index = context.repository.index();
+  std::vector<std::pair<std::string, patches::PatchMetadata>> updates;
+  for (const auto r : rows) {
+    const auto &row = duplicates.rows[r];
+    const auto &entry = index.entry(row.node);
+    if (index.hidden(row.node) == hidden ||
+        !context.repository.can_edit_metadata(entry)) {
+      continue;
+    }
+    auto metadata = context.repository.get_patch_metadata(entry.relative_path)
+                        .value_or(patches::PatchMetadata{});
+    metadata.path = entry.relative_path;
+    metadata.hidden = hidden;
+    if (metadata.hash.empty()) {
+      metadata.hash = row.sound.hex();
+    }
+    updates.emplace_back(entry.relative_path, std::move(metadata));
+  }
+  if (updates.empty()) {
+    return;
+  }
+  const auto written = context.repository.update_patch_metadata(updates);
+  megatoy::status::info((hidden ? "Hid " : "Showed ") +
+                        std::to_string(written) +
+                        (written == 1 ? " patch." : " patches."));
+}
+
+/// Every member but the first, optionally only the exact copies.
+std::vector<std::size_t> copies(const DuplicateRows &duplicates,
+                                std::size_t group, bool exact_only) {
+  std::vector<std::size_t> result;
+  const auto &rows = duplicates.members[group];
+  for (std::size_t k = 1; k < rows.size(); ++k) {
+    if (!exact_only || duplicates.rows[rows[k]].exact) {
+      result.push_back(rows[k]);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+bool DuplicateRows::stale(const patches::PatchRepository &source,
+                          const patches::DuplicateFinder &finder) const {
+  return repository != &source ||
+         repository_revision != source.revision() ||
+         finder_revision != finder.revision();
+}
+
+void DuplicateRows::rebuild(const patches::PatchRepository &source,
+                            const patches::DuplicateFinder &finder) {
+  repository = &source;
+  repository_revision = source.revision();
+  finder_revision = finder.revision();
+  rows.clear();
+  members.clear();
+  const auto &index = source.index();
+  for (const auto &group : finder.groups()) {
+    std::vector<Row> resolved;
+    for (std::size_t k = 0; k < group.paths.size(); ++k) {
+      if (const auto node = index.find(group.paths[k])) {
+        resolved.push_back({*node, members.size(), group.sounds[k],
+                            group.sounds[k] == group.sounds.front()});
+      }
+    }
+    if (resolved.size() < 2) {
+      continue;
+    }
+    rows.push_back({PatchIndex::kNoNode, members.size()});
+    auto &group_rows = members.emplace_back();
+    for (auto &row : resolved) {
+      group_rows.push_back(rows.size());
+      rows.push_back(row);
+    }
+  }
+}
+
+void render_duplicates_toolbar(PatchSelectorContext &context,
+                               const DuplicateRows &duplicates) {
+  const auto &finder = context.session.duplicate_finder();
+  ImGui::SameLine();
+  if (finder.running()) {
+    const auto progress = finder.progress();
+    ImGui::TextDisabled("Comparing sounds... %zu / %zu",
+                        progress.patches_done, progress.patches_total);
+  }
+  if (!finder.revision()) {
+    return;
+  }
+  std::vector<std::size_t> hideable;
+  for (std::size_t g = 0; g < duplicates.members.size(); ++g) {
+    for (const auto r : copies(duplicates, g, /*exact_only=*/true)) {
+      if (!context.repository.index().hidden(duplicates.rows[r].node)) {
+        hideable.push_back(r);
+      }
+    }
+  }
+  if (!finder.running()) {
+    ImGui::TextDisabled("%zu groups", duplicates.members.size());
+  }
+  ImGui::SameLine();
+  ImGui::BeginDisabled(hideable.empty());
+  if (ImGui::Button("Hide exact copies")) {
+    set_hidden(context, duplicates, hideable, true);
+  }
+  ImGui::EndDisabled();
+  if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+    ImGui::SetTooltip("Hide every patch that sounds exactly like the first "
+                      "of its group (%zu).",
+                      hideable.size());
+  }
+}
+
+void render_duplicates(PatchSelectorContext &context, const TableMode &mode,
+                       const DuplicateRows &duplicates, PendingEdits &edits) {
+  const auto &index = context.repository.index();
+  if (begin_patch_table("PatchDuplicateTable", mode.sound_columns)) {
+    // Groups keep their own order; the headers only size the columns.
+    if (auto *sort_specs = ImGui::TableGetSortSpecs()) {
+      sort_specs->SpecsDirty = false;
+    }
+
+    // Header rows hold framed buttons, so every row is still one framed
+    // line high.
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(duplicates.rows.size()));
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+        const auto &row = duplicates.rows[static_cast<std::size_t>(i)];
+        ImGui::PushID(i);
+        ImGui::TableNextRow();
+        if (row.node != PatchIndex::kNoNode) {
+          render_patch_cells(context, row.node, edits, row.exact ? "" : "~ ");
+          ImGui::PopID();
+          continue;
+        }
+
+        const auto &members = duplicates.members[row.group];
+        const bool all_exact = std::all_of(
+            members.begin(), members.end(),
+            [&](std::size_t r) { return duplicates.rows[r].exact; });
+        ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0,
+                               ImGui::GetColorU32(ImGuiCol_TableHeaderBg));
+        ImGui::TableSetColumnIndex(0);
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text("%zu %s", members.size(),
+                    all_exact ? "identical" : "similar");
+        ImGui::TableSetColumnIndex(2);
+        if (ImGui::Button("Hide copies")) {
+          set_hidden(context, duplicates,
+                     copies(duplicates, row.group, /*exact_only=*/false),
+                     true);
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("Hide all but %s.",
+                            index.name(duplicates.rows[members.front()].node)
+                                .data());
+        }
+        ImGui::TableSetColumnIndex(3);
+        if (ImGui::Button("Show all")) {
+          set_hidden(context, duplicates, members, false);
+        }
+        ImGui::PopID();
+      }
+    }
+
+    ImGui::EndTable();
+  }
+}
+
+} // namespace ui::selector_detail
@@ -0,0 +1,62 @@
+#pragma once
+
+// The patch table's duplicate listing: groups of patches that sound the same
+// or nearly so, with buttons to hide the copies. Internal to the selector.
+
+#include "patch_selector.hpp"
+#include "patch_table_shared.hpp"
+#include "patches/duplicate_finder.hpp"
+#include "patches/patch_index.hpp"
+#include "ym2612/patch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ui::selector_detail {
+
+/**
+ * The duplicate groups as table rows: a header row per group, then its
+ * members, resolved against the current index.
+ *
+ * Groups name their members by path, so groups from a job that ran against
+ * an older revision still show while the next job runs; a member the tree
+ * no longer has is left out.
+ */
+struct DuplicateRows {
+  struct Row {
+    /// kNoNode for a group's header row.
+    patches::PatchIndex::NodeId node = patches::PatchIndex::kNoNode;
+    std::size_t group = 0;
+    /// Members only: the sound, and whether it is exactly the first's.
+    ym2612::PackedPatch sound{};
+    bool exact = false;
+  };
+
+  const patches::PatchRepository *repository = nullptr;
+  std::uint64_t repository_revision = 0;
+  std::optional<std::uint64_t> finder_revision;
+  std::vector<Row> rows;
+  /// Per group: its member rows, first member first.
+  std::vector<std::vector<std::size_t>> members;
+
+  bool stale(const patches::PatchRepository &source,
+             const patches::DuplicateFinder &finder) const;
+  void rebuild(const patches::PatchRepository &source,
+               const patches::DuplicateFinder &finder);
+};
+
+/// The finder's progress, the group count and "Hide exact copies".
+void render_duplicates_toolbar(PatchSelectorContext &context,
+                               const DuplicateRows &duplicates);
+
+/**
+ * Groups of patches that sound the same or nearly so, each under a header
+ * row with its own hide and show buttons. Hidden members stay listed here,
+ * dimmed, so hiding can be undone.
+ */
+void render_duplicates(PatchSelectorContext &context, const TableMode &mode,
+                       const DuplicateRows &duplicates, PendingEdits &edits);
+
+} // namespace ui::selector_detail
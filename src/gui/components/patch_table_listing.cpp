@@ -0,0 +1,219 @@
+#include "patch_table_listing.hpp"
+
+#include "patch_selector_shared.hpp"
+#include "patch_table_sound.hpp"
+#include "patches/patch_metadata_index.hpp"
+#include "patches/patch_search_index.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+
+namespace ui::selector_detail {
+
+namespace {
+
+using patches::PatchIndex;
+
+patches::PatchSortIndex::Key sort_key(TableSortColumn column) {
+  using Key = patches::PatchSortIndex::Key;
+  switch (column) {
+  case TableSortColumn::Name:
+    return Key::Name;
+  case TableSortColumn::Category:
+    return Key::Category;
+  case TableSortColumn::StarRating:
+    return Key::StarRating;
+  case TableSortColumn::Format:
+    return Key::Format;
+  case TableSortColumn::Path:
+    return Key::Path;
+  case TableSortColumn::Loudness:
+  case TableSortColumn::Brightness:
+  case TableSortColumn::Attack:
+    break;
+  }
+  return Key::Name;
+}
+
+/**
+ * The rows for the current filters, in the current column order: one walk
+ * over the column's precomputed order that skips rejected patches, so no
+ * comparison sort runs when the query or a filter changes.
+ *
+ * While searching -- and unlike the tree, the table also matches paths, since
+ * it has no hierarchy to show them by -- better-ranked matches come first and
+ * the column order applies within each rank.
+ */
+std::vector<PatchIndex::NodeId> ordered_rows(PatchSelectorContext &context,
+                                             patches::PatchSortIndex &orders,
+                                             bool show_hidden) {
+  using patches::PatchSearchIndex;
+  constexpr std::uint8_t kRejected = 0xff;
+
+  const auto &index = context.repository.index();
+  const auto parsed = parse_query(context.prefs.metadata_search_query,
+                                  context.prefs.metadata_star_filter);
+  const auto &query = parsed.text;
+  // Stars, category and tags are a few ANDs over the bitsets, done once
+  // here rather than once per patch below.
+  std::optional<patches::PatchMetadataIndex::Bits> allowed;
+  if (!parsed.metadata.empty()) {
+    allowed = context.repository.metadata_index().select(parsed.metadata);
+  }
+
+  std::vector<std::uint8_t> tier(index.patch_count(),
+                                 query.empty() ? 0 : kRejected);
+  std::size_t tier_count = 1;
+  if (!query.empty()) {
+    tier_count = PatchSearchIndex::kRankCount;
+    for (const auto &hit : context.repository.search_index().search(
+             query, PatchSearchIndex::kAllFields)) {
+      tier[hit.patch] = static_cast<std::uint8_t>(hit.rank);
+    }
+  }
+
+  std::vector<std::vector<PatchIndex::NodeId>> tiers(tier_count);
+  const auto visit = [&](PatchIndex::PatchId patch) {
+    if (tier[patch] == kRejected) {
+      return;
+    }
+    if (!show_hidden && index.hidden(index.patches()[patch])) {
+      return;
+    }
+    if (!allowed || allowed->test(patch)) {
+      tiers[tier[patch]].push_back(index.patches()[patch]);
+    }
+  };
+  const auto column = context.get_sort_column();
+  if (is_sound_column(column)) {
+    const auto order = sound_order(context, column);
+    std::for_each(order.begin(), order.end(), visit);
+  } else {
+    const auto order = orders.ascending(sort_key(column));
+    if (context.get_sort_order() == SortOrder::Ascending) {
+      std::for_each(order.begin(), order.end(), visit);
+    } else {
+      std::for_each(order.rbegin(), order.rend(), visit);
+    }
+  }
+
+  if (tier_count == 1) {
+    return std::move(tiers.front());
+  }
+  std::vector<PatchIndex::NodeId> rows;
+  for (const auto &matches : tiers) {
+    rows.insert(rows.end(), matches.begin(), matches.end());
+  }
+  return rows;
+}
+
+void apply_table_sort_specs(PatchSelectorContext &context) {
+  ImGuiTableSortSpecs *sort_specs = ImGui::TableGetSortSpecs();
+  if (sort_specs == nullptr || !sort_specs->SpecsDirty) {
+    return;
+  }
+  if (sort_specs->SpecsCount > 0) {
+    // Column order in the table: Name, Stars, Category, Format, Path, then
+    // the sound columns when shown.
+    static constexpr TableSortColumn kByIndex[] = {
+        TableSortColumn::Name,       TableSortColumn::StarRating,
+        TableSortColumn::Category,   TableSortColumn::Format,
+        TableSortColumn::Path,       TableSortColumn::Loudness,
+        TableSortColumn::Brightness, TableSortColumn::Attack};
+    const ImGuiTableColumnSortSpecs *spec = &sort_specs->Specs[0];
+    if (spec->ColumnIndex < IM_ARRAYSIZE(kByIndex)) {
+      context.set_sort_column(kByIndex[spec->ColumnIndex]);
+    }
+    context.set_sort_order(spec->SortDirection == ImGuiSortDirection_Ascending
+                               ? SortOrder::Ascending
+                               : SortOrder::Descending);
+  }
+  sort_specs->SpecsDirty = false;
+}
+
+} // namespace
+
+const std::vector<PatchIndex::NodeId> &
+PatchTableCache::get(PatchSelectorContext &context, bool with_hidden) {
+  // Filtered and sorted on metadata as well as on the listing.
+  const auto listing_revision = context.repository.revision();
+  const auto metadata_revision = context.repository.metadata_revision();
+  const auto column = context.get_sort_column();
+  const auto order = context.get_sort_order();
+  // Sorted by a sound column, rows move as measurements arrive.
+  const auto current_sounds =
+      is_sound_column(column)
+          ? std::pair(context.session.duplicate_finder().revision(),
+                      context.session.sound_descriptors().generation())
+          : decltype(sounds_){};
+  rebuilt_ = false;
+  if (repository_ != &context.repository ||
+      metadata_revision_ != metadata_revision ||
+      search_query_ != context.prefs.metadata_search_query ||
+      star_filter_ != context.prefs.metadata_star_filter ||
+      sort_column_ != column || sort_order_ != order ||
+      show_hidden_ != with_hidden || sounds_ != current_sounds) {
+    if (repository_ != &context.repository ||
+        listing_revision_ != listing_revision) {
+      orders_.reset(context.repository.index());
+    } else if (metadata_revision_ != metadata_revision) {
+      // The edit went into the index in place; only the columns read from
+      // metadata can have moved.
+      orders_.invalidate(patches::PatchSortIndex::Key::Category);
+      orders_.invalidate(patches::PatchSortIndex::Key::StarRating);
+    }
+    repository_ = &context.repository;
+    listing_revision_ = listing_revision;
+    metadata_revision_ = metadata_revision;
+    search_query_ = context.prefs.metadata_search_query;
+    star_filter_ = context.prefs.metadata_star_filter;
+    sort_column_ = column;
+    sort_order_ = order;
+    show_hidden_ = with_hidden;
+    sounds_ = current_sounds;
+    rows_ = ordered_rows(context, orders_, show_hidden_);
+    rebuilt_ = true;
+  }
+  return rows_;
+}
+
+void render_listing(PatchSelectorContext &context, const TableMode &mode,
+                    PatchTableCache &cache, PendingEdits &edits) {
+  const auto &index = context.repository.index();
+  const auto &patches = cache.get(context, mode.show_hidden);
+  if (cache.rebuilt()) {
+    edits.drop_stale(index, patches);
+  }
+
+  std::optional<std::size_t> current_row;
+  if (begin_patch_table("PatchMetadataTable", mode.sound_columns)) {
+    apply_table_sort_specs(context);
+
+    // Every row is one framed line high, so the clipper can size the list
+    // from the first one it draws.
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(patches.size()));
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+        ImGui::PushID(i);
+        ImGui::TableNextRow();
+        if (render_patch_cells(context, patches[static_cast<size_t>(i)],
+                               edits)) {
+          current_row = static_cast<std::size_t>(i);
+        }
+        ImGui::PopID();
+      }
+    }
+
+    ImGui::EndTable();
+  }
+
+  if (current_row) {
+    prefetch_around(context, *current_row, patches.size(),
+                    [&](std::size_t i) -> std::optional<patches::PatchEntry> {
+                      return index.entry(patches[i]);
+                    });
+  }
+}
+
+} // namespace ui::selector_detail
@@ -0,0 +1,56 @@
+#pragma once
+
+// The patch table's default listing: every patch that passes the filters,
+// sorted by any column. Internal to the selector.
+
+#include "patch_selector.hpp"
+#include "patch_table_shared.hpp"
+#include "patches/patch_index.hpp"
+#include "patches/patch_sort_index.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ui::selector_detail {
+
+/**
+ * The listing's rows, kept across frames and rebuilt only when the
+ * repository's metadata, the filters, the sort or -- sorted by a sound
+ * column -- the measurements change.
+ */
+class PatchTableCache {
+public:
+  const std::vector<patches::PatchIndex::NodeId> &
+  get(PatchSelectorContext &context, bool with_hidden);
+
+  /// Whether the last get() rebuilt the row set, i.e. whether entries may
+  /// have disappeared since the previous frame.
+  bool rebuilt() const { return rebuilt_; }
+
+private:
+  const patches::PatchRepository *repository_ = nullptr;
+  /// The listing revision orders_ were reset at, and the metadata revision
+  /// rows_ were filtered at.
+  std::uint64_t listing_revision_ = 0;
+  std::uint64_t metadata_revision_ = 0;
+  std::string search_query_;
+  int star_filter_ = 0;
+  TableSortColumn sort_column_ = TableSortColumn::Name;
+  SortOrder sort_order_ = SortOrder::Ascending;
+  bool show_hidden_ = false;
+  /// What a sound column's order was computed from: the finder's revision
+  /// and the descriptors' generation.
+  std::pair<std::optional<std::uint64_t>, std::uint64_t> sounds_;
+  /// Per-column orders of the repository's current index.
+  patches::PatchSortIndex orders_;
+  std::vector<patches::PatchIndex::NodeId> rows_;
+  bool rebuilt_ = false;
+};
+
+void render_listing(PatchSelectorContext &context, const TableMode &mode,
+                    PatchTableCache &cache, PendingEdits &edits);
+
+} // namespace ui::selector_detail
@@ -0,0 +1,207 @@
+#include "patch_table_shared.hpp"
+
+#include "common.hpp"
+#include "gui/styles/megatoy_style.hpp"
+#include "patch_selector_shared.hpp"
+#include "patch_table_sound.hpp"
+
+#include <cstring>
+#include <imgui.h>
+#include <unordered_set>
+#include <utility>
+
+namespace ui::selector_detail {
+
+namespace {
+
+using patches::PatchIndex;
+
+patches::PatchMetadata prepare_metadata(PatchSelectorContext &context,
+                                        const patches::PatchEntry &entry) {
+  patches::PatchMetadata metadata =
+      context.repository.get_patch_metadata(entry.relative_path)
+          .value_or(patches::PatchMetadata{});
+  metadata.path = entry.relative_path;
+  if (metadata.hash.empty()) {
+    ym2612::Patch patch;
+    if (context.repository.load_patch(entry, patch)) {
+      metadata.hash = patch.hash();
+    }
+  }
+  return metadata;
+}
+
+/// Star slider cell; a finished edit is written straight to the sidecar.
+void render_star_cell(PatchSelectorContext &context,
+                      const patches::PatchEntry &entry, PendingEdits &edits) {
+  int star_rating = entry.metadata ? entry.metadata->star_rating : 0;
+  if (auto pending = edits.stars.find(entry.relative_path);
+      pending != edits.stars.end()) {
+    star_rating = pending->second;
+  }
+
+  ImGui::SetNextItemWidth(-1);
+  const float available_width = ImGui::GetContentRegionAvail().x;
+  if (ImGui::SliderInt("##star", &star_rating, 0, 5,
+                       available_width > 60
+                           ? kStarLabels[star_rating].data()
+                           : kStarLabelsMini[star_rating].data(),
+                       ImGuiSliderFlags_AlwaysClamp)) {
+    edits.stars[entry.relative_path] = star_rating;
+  }
+
+  if (ImGui::IsItemDeactivatedAfterEdit()) {
+    if (!entry.metadata || entry.metadata->star_rating != star_rating) {
+      auto metadata = prepare_metadata(context, entry);
+      metadata.star_rating = star_rating;
+      context.repository.update_patch_metadata(entry.relative_path, metadata);
+    }
+    edits.stars.erase(entry.relative_path);
+  }
+}
+
+/// Category text cell; a finished edit is written straight to the sidecar.
+void render_category_cell(PatchSelectorContext &context,
+                          const patches::PatchEntry &entry,
+                          PendingEdits &edits) {
+  std::string category = entry.metadata ? entry.metadata->category : "";
+  if (auto pending = edits.categories.find(entry.relative_path);
+      pending != edits.categories.end()) {
+    category = pending->second;
+  }
+
+  char buffer[64];
+  std::strncpy(buffer, category.c_str(), sizeof(buffer));
+  buffer[sizeof(buffer) - 1] = '\0';
+
+  ImGui::SetNextItemWidth(-1);
+  if (ImGui::InputText("##category", buffer, sizeof(buffer))) {
+    edits.categories[entry.relative_path] = std::string(buffer);
+  }
+
+  if (ImGui::IsItemDeactivatedAfterEdit()) {
+    std::string new_category;
+    if (auto pending = edits.categories.find(entry.relative_path);
+        pending != edits.categories.end()) {
+      new_category = pending->second;
+    } else {
+      new_category = std::string(buffer);
+    }
+
+    if (!entry.metadata || entry.metadata->category != new_category) {
+      auto metadata = prepare_metadata(context, entry);
+      metadata.category = std::move(new_category);
+      context.repository.update_patch_metadata(entry.relative_path, metadata);
+    }
+    edits.categories.erase(entry.relative_path);
+  }
+}
+
+} // namespace
+
+void PendingEdits::drop_stale(const PatchIndex &index,
+                              const std::vector<PatchIndex::NodeId> &visible) {
+  std::unordered_set<std::string> paths;
+  paths.reserve(visible.size());
+  for (const auto node : visible) {
+    paths.insert(index.relative_path(node));
+  }
+  std::erase_if(stars,
+                [&](const auto &kv) { return !paths.count(kv.first); });
+  std::erase_if(categories,
+                [&](const auto &kv) { return !paths.count(kv.first); });
+}
+
+bool begin_patch_table(const char *id, bool sound_columns) {
+  // The column widths below are proportional weights, which ImGui only
+  // accepts under an explicit stretch sizing policy -- 1.92 turned that
+  // former silent assumption into a user-error report.
+  if (!ImGui::BeginTable(id, sound_columns ? 8 : 5,
+                         ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable |
+                             ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg |
+                             ImGuiTableFlags_SizingStretchProp)) {
+    return false;
+  }
+  ImGui::TableSetupScrollFreeze(0, 1);
+  ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_DefaultSort, 0.3f);
+  ImGui::TableSetupColumn("Stars", ImGuiTableColumnFlags_None, 0.1f);
+  ImGui::TableSetupColumn("Category", ImGuiTableColumnFlags_None, 0.2f);
+  ImGui::TableSetupColumn("Format", ImGuiTableColumnFlags_None, 0.15f);
+  ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_None, 0.25f);
+  if (sound_columns) {
+    ImGui::TableSetupColumn("Loudness", ImGuiTableColumnFlags_None, 0.1f);
+    ImGui::TableSetupColumn("Brightness", ImGuiTableColumnFlags_None, 0.1f);
+    ImGui::TableSetupColumn("Attack", ImGuiTableColumnFlags_None, 0.1f);
+  }
+  ImGui::TableHeadersRow();
+  return true;
+}
+
+bool render_patch_cells(PatchSelectorContext &context, PatchIndex::NodeId node,
+                        PendingEdits &edits, const char *prefix) {
+  const auto &index = context.repository.index();
+  const auto entry = index.entry(node);
+  const std::string &current_selection_path =
+      context.session.current_patch_selection_path();
+
+  ImGui::TableSetColumnIndex(0);
+  const bool is_current = !current_selection_path.empty() &&
+                          current_selection_path == entry.relative_path;
+  const bool hidden = index.hidden(node);
+  if (is_current) {
+    ImGui::PushStyleColor(ImGuiCol_Text,
+                          styles::color(styles::MegatoyCol::TextHighlight));
+  } else if (hidden) {
+    ImGui::PushStyleColor(ImGuiCol_Text,
+                          ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+  }
+  const bool name_selected =
+      *prefix == '\0'
+          ? ImGui::Selectable(index.name(node).data(), false)
+          : ImGui::Selectable((prefix + std::string(index.name(node))).c_str(),
+                              false);
+  const bool name_arrived = nav_arrived(entry.relative_path);
+  if (is_current || hidden) {
+    ImGui::PopStyleColor();
+  }
+  // As in the tree, arrowing onto a row auditions it.
+  const bool audition =
+      name_arrived && !is_current && !context.session.is_modified();
+  if ((name_selected || audition) && context.safe_load_patch) {
+    context.safe_load_patch(entry);
+  }
+  entry_context_menu(context, entry);
+
+  const bool can_edit_metadata = context.repository.can_edit_metadata(entry);
+  ImGui::BeginDisabled(!can_edit_metadata);
+  ImGui::TableSetColumnIndex(1);
+  render_star_cell(context, entry, edits);
+
+  ImGui::TableSetColumnIndex(2);
+  render_category_cell(context, entry, edits);
+  ImGui::EndDisabled();
+
+  ImGui::TableSetColumnIndex(3);
+  if (is_current) {
+    ImGui::TextColored(styles::color(styles::MegatoyCol::TextHighlight), "%s",
+                       index.format(node).data());
+  } else {
+    ImGui::Text("%s", index.format(node).data());
+  }
+
+  ImGui::TableSetColumnIndex(4);
+  const std::string display_path = display_preset_path(entry.relative_path);
+  if (is_current) {
+    ImGui::TextColored(styles::color(styles::MegatoyCol::TextHighlight), "%s",
+                       display_path.c_str());
+  } else {
+    ImGui::TextDisabled("%s", display_path.c_str());
+  }
+
+  if (ImGui::TableGetColumnCount() > 5) {
+    render_sound_cells(context, entry, 5);
+  }
+  return is_current;
+}
+
+} // namespace ui::selector_detail
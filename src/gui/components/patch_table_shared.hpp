@@ -0,0 +1,58 @@
+#pragma once
+
+// What the patch table's listings share: which one is up, cell edits in
+// flight, and the table and patch rows they all draw. Internal to the
+// selector.
+
+#include "patch_selector.hpp"
+#include "patches/patch_index.hpp"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ui::selector_detail {
+
+/// Which rows the table lists; kept for the session only.
+struct TableMode {
+  bool duplicates = false;
+  bool show_hidden = false;
+  /// Loudness, brightness and attack columns, measured in the background.
+  bool sound_columns = false;
+  /// List suggested categories for the patches without one.
+  bool suggestions = false;
+  /// Suggestions below this, in percent, are listed but not applied.
+  int min_confidence = 60;
+  /// Set by "Find Similar": list the patches nearest this one instead.
+  std::optional<std::string> similar_to;
+};
+
+/**
+ * In-flight cell edits, keyed by relative path.
+ *
+ * ImGui reports a value every frame while a slider or text box is being
+ * dragged or typed in; committing to the sidecar on each of those would
+ * rewrite the file dozens of times per edit. The value is parked here until
+ * the widget deactivates, then written once.
+ */
+struct PendingEdits {
+  std::unordered_map<std::string, int> stars;
+  std::unordered_map<std::string, std::string> categories;
+
+  void drop_stale(const patches::PatchIndex &index,
+                  const std::vector<patches::PatchIndex::NodeId> &visible);
+};
+
+/// Begin a table with the patch columns, and the sound columns if asked.
+bool begin_patch_table(const char *id, bool sound_columns);
+
+/**
+ * One patch's cells. `prefix` goes before the name. Returns whether this is
+ * the current patch.
+ */
+bool render_patch_cells(PatchSelectorContext &context,
+                        patches::PatchIndex::NodeId node, PendingEdits &edits,
+                        const char *prefix = "");
+
+} // namespace ui::selector_detail
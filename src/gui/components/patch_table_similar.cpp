@@ -0,0 +1,113 @@
+#include "patch_table_similar.hpp"
+
+#include "patches/similarity_index.hpp"
+
+#include <IconsFontAwesome7.h>
+#include <cmath>
+#include <cstddef>
+#include <imgui.h>
+
+namespace ui::selector_detail {
+
+namespace {
+
+/// How many neighbours "Find Similar" lists.
+constexpr std::size_t kSimilarCount = 50;
+
+} // namespace
+
+bool SimilarRows::stale(const patches::PatchRepository &source,
+                        const patches::DuplicateFinder &finder,
+                        const TableMode &mode) const {
+  return repository != &source ||
+         repository_revision != source.metadata_revision() ||
+         finder_revision != finder.revision() || query != *mode.similar_to ||
+         show_hidden != mode.show_hidden;
+}
+
+void SimilarRows::rebuild(const patches::PatchRepository &source,
+                          const patches::DuplicateFinder &finder,
+                          const TableMode &mode) {
+  repository = &source;
+  repository_revision = source.metadata_revision();
+  finder_revision = finder.revision();
+  query = *mode.similar_to;
+  show_hidden = mode.show_hidden;
+  rows.clear();
+  const auto sound = finder.sound(query);
+  found = sound.has_value();
+  if (!found) {
+    return;
+  }
+  const auto &index = source.index();
+  const float ceiling = patches::max_similarity_distance();
+  // Hidden patches are dropped after the search, so ask for enough that
+  // a library full of hidden copies still fills the list.
+  for (const auto &match : finder.similar(*sound, kSimilarCount * 2, query)) {
+    const auto node = index.find(match.path);
+    if (!node || (!show_hidden && index.hidden(*node))) {
+      continue;
+    }
+    const auto score = 100.0f * (1.0f - match.distance / ceiling);
+    rows.push_back({*node, static_cast<int>(std::lround(score))});
+    if (rows.size() == kSimilarCount) {
+      break;
+    }
+  }
+}
+
+void render_similar_toolbar(PatchSelectorContext &context, TableMode &mode,
+                            const SimilarRows &similar) {
+  if (ImGui::Button(ICON_FA_XMARK)) {
+    mode.similar_to.reset();
+    return;
+  }
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip("Back to all patches");
+  }
+  ImGui::SameLine();
+  const auto &index = context.repository.index();
+  const auto node = index.find(*mode.similar_to);
+  ImGui::AlignTextToFramePadding();
+  ImGui::Text("Similar to %s",
+              node ? index.name(*node).data() : mode.similar_to->c_str());
+  ImGui::SameLine();
+  ImGui::Checkbox(ICON_FA_EYE_SLASH " Show hidden", &mode.show_hidden);
+
+  const auto &finder = context.session.duplicate_finder();
+  ImGui::SameLine();
+  if (finder.running()) {
+    const auto progress = finder.progress();
+    ImGui::TextDisabled("Indexing sounds... %zu / %zu",
+                        progress.patches_done, progress.patches_total);
+  } else if (finder.revision() && !similar.found) {
+    ImGui::TextDisabled("This patch could not be read.");
+  }
+}
+
+void render_similar(PatchSelectorContext &context, const TableMode &mode,
+                    const SimilarRows &similar, PendingEdits &edits) {
+  if (begin_patch_table("PatchSimilarTable", mode.sound_columns)) {
+    // Nearest first is the order; the headers only size the columns.
+    if (auto *sort_specs = ImGui::TableGetSortSpecs()) {
+      sort_specs->SpecsDirty = false;
+    }
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(similar.rows.size()));
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+        const auto &row = similar.rows[static_cast<std::size_t>(i)];
+        ImGui::PushID(i);
+        ImGui::TableNextRow();
+        const auto prefix = std::to_string(row.score) + "%  ";
+        render_patch_cells(context, row.node, edits, prefix.c_str());
+        ImGui::PopID();
+      }
+    }
+
+    ImGui::EndTable();
+  }
+}
+
+} // namespace ui::selector_detail
@@ -0,0 +1,50 @@
+#pragma once
+
+// The patch table's "Find Similar" listing: the patches nearest one patch,
+// nearest first. Internal to the selector.
+
+#include "patch_selector.hpp"
+#include "patch_table_shared.hpp"
+#include "patches/duplicate_finder.hpp"
+#include "patches/patch_index.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ui::selector_detail {
+
+/// The patches nearest `query`, as rows, from the finder's last job.
+struct SimilarRows {
+  struct Row {
+    patches::PatchIndex::NodeId node = patches::PatchIndex::kNoNode;
+    /// 100 for the same settings, 0 for the furthest apart two can be.
+    int score = 0;
+  };
+
+  const patches::PatchRepository *repository = nullptr;
+  std::uint64_t repository_revision = 0;
+  std::optional<std::uint64_t> finder_revision;
+  std::string query;
+  bool show_hidden = false;
+  /// False when the last job could not read the patch asked about.
+  bool found = false;
+  std::vector<Row> rows;
+
+  bool stale(const patches::PatchRepository &source,
+             const patches::DuplicateFinder &finder,
+             const TableMode &mode) const;
+  void rebuild(const patches::PatchRepository &source,
+               const patches::DuplicateFinder &finder, const TableMode &mode);
+};
+
+/// Which patch the list is for, and a way back to all patches.
+void render_similar_toolbar(PatchSelectorContext &context, TableMode &mode,
+                            const SimilarRows &similar);
+
+/// The neighbours of one patch, nearest first, each with its score.
+void render_similar(PatchSelectorContext &context, const TableMode &mode,
+                    const SimilarRows &similar, PendingEdits &edits);
+
+} // namespace ui::selector_detail
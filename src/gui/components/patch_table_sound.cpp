@@ -0,0 +1,110 @@
+#include "patch_table_sound.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <utility>
+
+namespace ui::selector_detail {
+
+namespace {
+
+using patches::PatchIndex;
+
+float sound_value(const audio::SoundDescriptors &descriptors,
+                  TableSortColumn column) {
+  switch (column) {
+  case TableSortColumn::Brightness:
+    return descriptors.centroid_hz;
+  case TableSortColumn::Attack:
+    return descriptors.attack_ms;
+  default:
+    return descriptors.loudness_lufs;
+  }
+}
+
+} // namespace
+
+bool is_sound_column(TableSortColumn column) {
+  return column == TableSortColumn::Loudness ||
+         column == TableSortColumn::Brightness ||
+         column == TableSortColumn::Attack;
+}
+
+std::optional<audio::SoundDescriptors>
+sound_descriptors(PatchSelectorContext &context,
+                  const patches::PatchEntry &entry) {
+  const auto sound =
+      context.session.duplicate_finder().sound(entry.relative_path);
+  if (!sound) {
+    return std::nullopt;
+  }
+  return context.session.sound_descriptors().find(*sound);
+}
+
+std::vector<PatchIndex::PatchId> sound_order(PatchSelectorContext &context,
+                                             TableSortColumn column) {
+  const auto &index = context.repository.index();
+  std::vector<std::pair<float, PatchIndex::PatchId>> measured;
+  std::vector<PatchIndex::PatchId> unmeasured;
+  for (PatchIndex::PatchId patch = 0; patch < index.patch_count(); ++patch) {
+    const auto &entry = index.entry(index.patches()[patch]);
+    if (const auto descriptors = sound_descriptors(context, entry)) {
+      measured.emplace_back(sound_value(*descriptors, column), patch);
+    } else {
+      unmeasured.push_back(patch);
+    }
+  }
+  const bool ascending = context.get_sort_order() == SortOrder::Ascending;
+  std::stable_sort(measured.begin(), measured.end(),
+                   [ascending](const auto &a, const auto &b) {
+                     return ascending ? a.first < b.first
+                                      : a.first > b.first;
+                   });
+  std::vector<PatchIndex::PatchId> order;
+  order.reserve(index.patch_count());
+  for (const auto &[value, patch] : measured) {
+    order.push_back(patch);
+  }
+  order.insert(order.end(), unmeasured.begin(), unmeasured.end());
+  return order;
+}
+
+void render_sound_cells(PatchSelectorContext &context,
+                        const patches::PatchEntry &entry, int first) {
+  const auto descriptors = sound_descriptors(context, entry);
+  ImGui::TableSetColumnIndex(first);
+  if (!descriptors) {
+    ImGui::TextDisabled("...");
+  } else if (descriptors->loudness_lufs <=
+             audio::SoundDescriptors::kSilenceDb) {
+    ImGui::TextDisabled("silent");
+  } else {
+    ImGui::Text("%.1f LUFS", descriptors->loudness_lufs);
+    ImGui::TableSetColumnIndex(first + 1);
+    ImGui::Text("%.0f Hz", descriptors->centroid_hz);
+    ImGui::TableSetColumnIndex(first + 2);
+    ImGui::Text("%.0f ms", descriptors->attack_ms);
+  }
+}
+
+void render_sound_progress(PatchSelectorContext &context,
+                           const TableMode &mode) {
+  if (!mode.sound_columns) {
+    return;
+  }
+  const auto &finder = context.session.duplicate_finder();
+  const auto &descriptors = context.session.sound_descriptors();
+  if (finder.running()) {
+    const auto progress = finder.progress();
+    ImGui::SameLine();
+    ImGui::TextDisabled("Reading patches... %zu / %zu",
+                        progress.patches_done, progress.patches_total);
+  } else if (descriptors.running()) {
+    const auto progress = descriptors.progress();
+    ImGui::SameLine();
+    ImGui::TextDisabled("Measuring sounds... %zu / %zu",
+                        progress.sounds_done, progress.sounds_total);
+  }
+}
+
+} // namespace ui::selector_detail
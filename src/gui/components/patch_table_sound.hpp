@@ -0,0 +1,41 @@
+#pragma once
+
+// The patch table's loudness, brightness and attack columns: measured by
+// playing each patch in the background, and sortable like the others once
+// they are in. Internal to the selector.
+
+#include "audio/sound_descriptors.hpp"
+#include "patch_selector.hpp"
+#include "patch_table_shared.hpp"
+#include "patches/patch_index.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace ui::selector_detail {
+
+/// Columns measured by playing the patch rather than read from the index.
+bool is_sound_column(TableSortColumn column);
+
+/// The descriptors of `entry`'s sound, once it has been read and measured.
+std::optional<audio::SoundDescriptors>
+sound_descriptors(PatchSelectorContext &context,
+                  const patches::PatchEntry &entry);
+
+/**
+ * Every PatchId by a sound column, in the table's direction. Patches not
+ * measured yet go last either way, in tree order.
+ */
+std::vector<patches::PatchIndex::PatchId>
+sound_order(PatchSelectorContext &context, TableSortColumn column);
+
+/// The three sound cells of `entry`'s row, from column `first`.
+void render_sound_cells(PatchSelectorContext &context,
+                        const patches::PatchEntry &entry, int first);
+
+/// What the sound columns are waiting for, if anything.
+void render_sound_progress(PatchSelectorContext &context,
+                           const TableMode &mode);
+
+} // namespace ui::selector_detail
@@ -0,0 +1,153 @@
+#include "patch_table_suggestions.hpp"
+
+#include "common.hpp"
+#include "patch_selector_shared.hpp"
+#include "patch_table_sound.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <utility>
+
+namespace ui::selector_detail {
+
+bool SuggestionRows::stale(
+    const patches::PatchRepository &source,
+    const patches::CategorySuggestionIndex &suggestions) const {
+  return repository != &source ||
+         repository_revision != source.metadata_revision() ||
+         suggestion_generation != suggestions.generation();
+}
+
+void SuggestionRows::rebuild(
+    const patches::PatchRepository &source,
+    const patches::CategorySuggestionIndex &suggestions) {
+  repository = &source;
+  repository_revision = source.metadata_revision();
+  suggestion_generation = suggestions.generation();
+  rows.clear();
+  const auto &index = source.index();
+  for (const auto &suggestion : suggestions.suggestions()) {
+    const auto node = index.find(suggestion.relative_path);
+    if (!node) {
+      continue;
+    }
+    const auto &entry = index.entry(*node);
+    if (entry.metadata && !entry.metadata->category.empty()) {
+      continue;
+    }
+    rows.push_back({*node, suggestion.category, suggestion.confidence});
+  }
+}
+
+std::size_t SuggestionRows::confident(int min_confidence) const {
+  return static_cast<std::size_t>(
+      std::partition_point(rows.begin(), rows.end(),
+                           [&](const Row &row) {
+                             return row.confidence >= min_confidence;
+                           }) -
+      rows.begin());
+}
+
+void render_suggestion_toolbar(PatchSelectorContext &context,
+                               TableMode &mode,
+                               const SuggestionRows &suggestions) {
+  const auto &finder = context.session.duplicate_finder();
+  ImGui::SameLine();
+  if (finder.running()) {
+    const auto progress = finder.progress();
+    ImGui::TextDisabled("Reading patches... %zu / %zu",
+                        progress.patches_done, progress.patches_total);
+    return;
+  }
+  if (!finder.revision()) {
+    return;
+  }
+  if (context.session.category_suggestions().running()) {
+    ImGui::TextDisabled("Suggesting categories...");
+    ImGui::SameLine();
+  }
+
+  ImGui::SetNextItemWidth(140.0f);
+  ImGui::SliderInt("##min_confidence", &mode.min_confidence, 0, 100,
+                   "At least %d%%", ImGuiSliderFlags_AlwaysClamp);
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip("Only apply suggestions at least this sure.");
+  }
+  const auto count = suggestions.confident(mode.min_confidence);
+  ImGui::SameLine();
+  ImGui::BeginDisabled(count == 0);
+  const std::string label = "Apply " + std::to_string(count);
+  if (ImGui::Button(label.c_str())) {
+    const auto &index = context.repository.index();
+    std::vector<std::pair<std::string, std::string>> categories;
+    categories.reserve(count);
+    for (std::size_t r = 0; r < count; ++r) {
+      categories.emplace_back(index.relative_path(suggestions.rows[r].node),
+                              suggestions.rows[r].category);
+    }
+    context.repository.add_missing_categories(categories);
+  }
+  ImGui::EndDisabled();
+  if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+    ImGui::SetTooltip("Set the suggested category of the %zu patches above "
+                      "the threshold. Patches that have a category keep it.",
+                      count);
+  }
+  render_sound_progress(context, mode);
+}
+
+void render_suggestions(PatchSelectorContext &context, const TableMode &mode,
+                        const SuggestionRows &suggestions) {
+  if (!ImGui::BeginTable("PatchSuggestionTable", 4,
+                         ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY |
+                             ImGuiTableFlags_RowBg |
+                             ImGuiTableFlags_SizingStretchProp)) {
+    return;
+  }
+  ImGui::TableSetupScrollFreeze(0, 1);
+  ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_None, 0.35f);
+  ImGui::TableSetupColumn("Suggested", ImGuiTableColumnFlags_None, 0.2f);
+  ImGui::TableSetupColumn("Confidence", ImGuiTableColumnFlags_None, 0.15f);
+  ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_None, 0.3f);
+  ImGui::TableHeadersRow();
+
+  const auto &index = context.repository.index();
+  ImGuiListClipper clipper;
+  clipper.Begin(static_cast<int>(suggestions.rows.size()));
+  while (clipper.Step()) {
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+      const auto &row = suggestions.rows[static_cast<std::size_t>(i)];
+      const auto &entry = index.entry(row.node);
+      ImGui::PushID(i);
+      ImGui::TableNextRow();
+      ImGui::TableSetColumnIndex(0);
+      const bool selected = ImGui::Selectable(index.name(row.node).data());
+      if ((selected || nav_arrived(entry.relative_path)) &&
+          !context.session.is_modified() && context.safe_load_patch) {
+        context.safe_load_patch(entry);
+      }
+      entry_context_menu(context, entry);
+
+      const bool applies = row.confidence >= mode.min_confidence;
+      ImGui::TableSetColumnIndex(1);
+      if (applies) {
+        ImGui::Text("%s", row.category.c_str());
+      } else {
+        ImGui::TextDisabled("%s", row.category.c_str());
+      }
+      ImGui::TableSetColumnIndex(2);
+      if (applies) {
+        ImGui::Text("%d%%", row.confidence);
+      } else {
+        ImGui::TextDisabled("%d%%", row.confidence);
+      }
+      ImGui::TableSetColumnIndex(3);
+      ImGui::TextDisabled("%s",
+                          display_preset_path(entry.relative_path).c_str());
+      ImGui::PopID();
+    }
+  }
+  ImGui::EndTable();
+}
+
+} // namespace ui::selector_detail
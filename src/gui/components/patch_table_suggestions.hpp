@@ -0,0 +1,56 @@
+#pragma once
+
+// The patch table's category suggestions: a category proposed for each patch
+// without one, and a way to apply the confident ones. Internal to the
+// selector.
+
+#include "patch_selector.hpp"
+#include "patch_table_shared.hpp"
+#include "patches/category_suggestion_index.hpp"
+#include "patches/patch_index.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ui::selector_detail {
+
+/**
+ * The session's category suggestions, resolved against the index. Patches
+ * that have a category by now are left out, so an edit only drops rows:
+ * the grouping itself runs in patches::CategorySuggestionIndex.
+ */
+struct SuggestionRows {
+  struct Row {
+    patches::PatchIndex::NodeId node = patches::PatchIndex::kNoNode;
+    std::string category;
+    /// 0..100.
+    int confidence = 0;
+  };
+
+  const patches::PatchRepository *repository = nullptr;
+  std::uint64_t repository_revision = 0;
+  std::uint64_t suggestion_generation = 0;
+  /// Most certain first.
+  std::vector<Row> rows;
+
+  bool stale(const patches::PatchRepository &source,
+             const patches::CategorySuggestionIndex &suggestions) const;
+  void rebuild(const patches::PatchRepository &source,
+               const patches::CategorySuggestionIndex &suggestions);
+
+  /// How many rows, from the top, reach `min_confidence`.
+  std::size_t confident(int min_confidence) const;
+};
+
+/// The confidence threshold and the button that applies what passes it.
+void render_suggestion_toolbar(PatchSelectorContext &context,
+                               TableMode &mode,
+                               const SuggestionRows &suggestions);
+
+/// Each patch without a category, with the one suggested for it.
+void render_suggestions(PatchSelectorContext &context, const TableMode &mode,
+                        const SuggestionRows &suggestions);
+
+} // namespace ui::selector_detail
@@ -1,12 +1,27 @@
 #pragma once
 
-// The patch browser's flat, sortable table with editable metadata. Internal
-// to the selector.
+// The patch browser's flat, sortable table with editable metadata, and the
+// other listings it switches to. Internal to the selector.
 
 #include "patch_selector.hpp"
+#include "patch_table_duplicates.hpp"
+#include "patch_table_listing.hpp"
+#include "patch_table_shared.hpp"
+#include "patch_table_similar.hpp"
+#include "patch_table_suggestions.hpp"
 
 namespace ui::selector_detail {
 
-void render_patch_table(PatchSelectorContext &context);
+/// Everything the table keeps from one frame to the next.
+struct PatchTableState {
+  TableMode mode;
+  PendingEdits edits;
+  PatchTableCache listing;
+  DuplicateRows duplicates;
+  SimilarRows similar;
+  SuggestionRows suggestions;
+};
+
+void render_patch_table(PatchSelectorContext &context, PatchTableState &state);
 
 } // namespace ui::selector_detail
@@ -2,82 +2,242 @@
 
 #include "patch_filter.hpp"
 
-#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <optional>
 
 namespace ui::selector_detail {
 
 namespace {
 
-bool subtree_has_visible_file(const std::vector<patches::PatchEntry> &items,
-                              const std::string &query_lower,
-                              int min_star_rating) {
-  for (const auto &item : items) {
-    if (item.is_directory) {
-      if (subtree_has_visible_file(item.children, query_lower,
-                                   min_star_rating)) {
+using patches::PatchIndex;
+
+using Bits = patches::PatchMetadataIndex::Bits;
+
+struct FlattenPass {
+  const PatchIndex &index;
+  /// The query without its metadata terms.
+  const std::string &text;
+  /// Patches passing the star, category and tag filters; empty when there
+  /// are none.
+  const std::optional<Bits> &allowed;
+  /// Indexed by NodeId; resolved once so no directory compares paths.
+  const std::vector<char> &open;
+  /// Indexed by PatchId; empty when there is no text to match.
+  const std::vector<char> &matched;
+  std::vector<TreeRow> &out;
+
+  bool file_visible(PatchIndex::NodeId node) const {
+    const auto patch = index.patch_id(node);
+    return !index.hidden(node) && (!allowed || allowed->test(patch)) &&
+           (text.empty() || matched[patch] != 0);
+  }
+
+  bool subtree_has_visible_file(PatchIndex::NodeId directory) const {
+    for (const auto child : index.children(directory)) {
+      if (index.is_directory(child) ? subtree_has_visible_file(child)
+                                    : file_visible(child)) {
         return true;
       }
-    } else if (entry_passes_star_filter(item, min_star_rating) &&
-               entry_matches_query(item, query_lower)) {
-      return true;
     }
+    return false;
   }
-  return false;
-}
 
-/**
- * Appends one level's visible rows and reports whether a file below it
- * survived the filters -- the same answer the parent needs to decide whether
- * it is listed at all, so no directory's subtree is walked twice.
- */
-bool collect_level(const std::vector<patches::PatchEntry> &items, int depth,
-                   const std::string &query_lower, int min_star_rating,
-                   const std::unordered_set<std::string> &open_directories,
-                   std::vector<TreeRow> &out) {
-  bool any_visible_file = false;
-
-  for (const auto &item : items) {
-    if (item.is_directory) {
-      const bool is_open = open_directories.count(item.relative_path) > 0;
-      const std::size_t mark = out.size();
-      out.push_back(TreeRow{&item, depth, true, is_open});
-
-      // A closed directory still has to be searched: whether it holds a
-      // visible file is what decides if its own row is drawn.
-      const bool has_children =
-          is_open ? collect_level(item.children, depth + 1, query_lower,
-                                  min_star_rating, open_directories, out)
-                  : subtree_has_visible_file(item.children, query_lower,
-                                             min_star_rating);
-      const bool matches_self =
-          !query_lower.empty() && entry_matches_query(item, query_lower);
-      if (!has_children && !matches_self) {
-        out.resize(mark);
+  /**
+   * Appends one level's visible rows and reports whether a file below it
+   * survived the filters -- the same answer the parent needs to decide whether
+   * it is listed at all, so no directory's subtree is walked twice.
+   */
+  bool collect_level(PatchIndex::ChildRange items, int depth) {
+    bool any_visible_file = false;
+
+    for (const auto item : items) {
+      if (index.is_directory(item)) {
+        const bool is_open = open[item] != 0;
+        const std::size_t mark = out.size();
+        out.push_back(TreeRow{item, depth, true, is_open, false});
+
+        // A closed directory still has to be searched: whether it holds a
+        // visible file is what decides if its own row is drawn.
+        const bool has_children =
+            is_open ? collect_open(item, depth + 1)
+                    : subtree_has_visible_file(item);
+        const bool matches_self =
+            !text.empty() && node_matches_query(index, item, text);
+        // An unread folder may hold anything, so it stays listed until a
+        // filter asks for more than it can know.
+        const bool unread =
+            index.children_pending(item) && text.empty() && !allowed;
+        if (!has_children && !matches_self && !unread) {
+          out.resize(mark);
+        }
+        any_visible_file = any_visible_file || has_children;
+        continue;
       }
-      any_visible_file = any_visible_file || has_children;
-      continue;
+
+      if (!file_visible(item)) {
+        continue;
+      }
+      out.push_back(TreeRow{item, depth, false, false, false});
+      any_visible_file = true;
     }
 
-    if (!entry_passes_star_filter(item, min_star_rating) ||
-        !entry_matches_query(item, query_lower)) {
-      continue;
+    return any_visible_file;
+  }
+
+  /// The rows under an open directory; one that is not read yet has only
+  /// its loading row, which does not count as a visible file.
+  bool collect_open(PatchIndex::NodeId directory, int depth) {
+    if (index.children_pending(directory)) {
+      out.push_back(TreeRow{directory, depth, false, false, true});
+      return false;
     }
-    out.push_back(TreeRow{&item, depth, false, false});
-    any_visible_file = true;
+    return collect_level(index.children(directory), depth);
+  }
+};
+
+void resolve_open(const PatchIndex &index,
+                  const std::unordered_set<std::string> &open_directories,
+                  std::vector<char> &open) {
+  open.assign(index.node_count(), 0);
+  for (const auto &path : open_directories) {
+    if (const auto node = index.find(path)) {
+      open[*node] = 1;
+    }
+  }
+}
+
+void resolve_matches(const PatchIndex &index,
+                     const patches::PatchSearchIndex &search,
+                     const std::string &text, std::vector<char> &matched) {
+  matched.clear();
+  if (text.empty()) {
+    return;
+  }
+  matched.assign(index.patch_count(), 0);
+  for (const auto &hit :
+       search.search(text, patches::PatchSearchIndex::kBrowserFields)) {
+    matched[hit.patch] = 1;
   }
+}
 
-  return any_visible_file;
+std::optional<Bits>
+resolve_allowed(const PatchIndex &index,
+                const patches::PatchMetadataIndex *metadata,
+                const patches::PatchMetadataIndex::Filter &filter) {
+  if (filter.empty()) {
+    return std::nullopt;
+  }
+  if (metadata == nullptr) {
+    return patches::PatchMetadataIndex::build(index).select(filter);
+  }
+  return metadata->select(filter);
 }
 
 } // namespace
 
 std::vector<TreeRow>
-flatten_visible_rows(const std::vector<patches::PatchEntry> &tree,
+flatten_visible_rows(const patches::PatchIndex &index,
+                     const patches::PatchSearchIndex &search,
                      const std::string &query_lower, int min_star_rating,
-                     const std::unordered_set<std::string> &open_directories) {
+                     const std::unordered_set<std::string> &open_directories,
+                     const patches::PatchMetadataIndex *metadata) {
+  const auto parsed = parse_query(query_lower, min_star_rating);
+  std::vector<char> open;
+  std::vector<char> matched;
+  resolve_open(index, open_directories, open);
+  resolve_matches(index, search, parsed.text, matched);
+  const auto allowed = resolve_allowed(index, metadata, parsed.metadata);
+
   std::vector<TreeRow> rows;
-  collect_level(tree, 0, query_lower, min_star_rating, open_directories, rows);
+  FlattenPass pass{index, parsed.text, allowed, open, matched, rows};
+  pass.collect_level(index.roots(), 0);
   return rows;
 }
 
+const std::vector<TreeRow> &
+TreeRowCache::get(const patches::PatchIndex &index,
+                  const patches::PatchSearchIndex &search,
+                  std::uint64_t revision, const std::string &query_lower,
+                  int min_star_rating,
+                  const patches::PatchMetadataIndex *metadata) {
+  if (!built_ || index_ != &index || revision_ != revision ||
+      query_ != query_lower || star_filter_ != min_star_rating) {
+    index_ = &index;
+    revision_ = revision;
+    query_ = query_lower;
+    star_filter_ = min_star_rating;
+    pending_toggles_.clear();
+    rebuild(index, search, metadata);
+    return rows_;
+  }
+
+  for (const auto &[path, open] : pending_toggles_) {
+    splice(path, open);
+  }
+  pending_toggles_.clear();
+  return rows_;
+}
+
+void TreeRowCache::set_open(const std::string &relative_path, bool open) {
+  const bool changed = open ? open_directories_.insert(relative_path).second
+                            : open_directories_.erase(relative_path) > 0;
+  if (!changed) {
+    return;
+  }
+  ++open_generation_;
+  if (built_) {
+    pending_toggles_.emplace_back(relative_path, open);
+  }
+}
+
+void TreeRowCache::rebuild(const patches::PatchIndex &index,
+                           const patches::PatchSearchIndex &search,
+                           const patches::PatchMetadataIndex *metadata) {
+  const auto parsed = parse_query(query_, star_filter_);
+  text_ = parsed.text;
+  resolve_open(index, open_directories_, open_nodes_);
+  resolve_matches(index, search, text_, matched_);
+  allowed_ = resolve_allowed(index, metadata, parsed.metadata);
+  rows_.clear();
+  FlattenPass pass{index, text_, allowed_, open_nodes_, matched_, rows_};
+  pass.collect_level(index.roots(), 0);
+  built_ = true;
+  ++rebuild_count_;
+}
+
+void TreeRowCache::splice(const std::string &relative_path, bool open) {
+  const auto &index = *index_;
+  const auto node = index.find(relative_path);
+  if (!node || !index.is_directory(*node)) {
+    return;
+  }
+  open_nodes_[*node] = open ? 1 : 0;
+
+  // A directory filtered out of the list has no row to splice under; its
+  // open flag is all there is to update.
+  const auto row =
+      std::find_if(rows_.begin(), rows_.end(),
+                   [&](const TreeRow &r) { return r.node == *node; });
+  if (row == rows_.end() || row->is_open == open) {
+    return;
+  }
+  row->is_open = open;
+  const int depth = row->depth;
+  const auto first_child = std::next(row);
+
+  if (!open) {
+    const auto past_subtree =
+        std::find_if(first_child, rows_.end(),
+                     [depth](const TreeRow &r) { return r.depth <= depth; });
+    rows_.erase(first_child, past_subtree);
+    return;
+  }
+
+  std::vector<TreeRow> spliced;
+  FlattenPass pass{index, text_, allowed_, open_nodes_, matched_, spliced};
+  pass.collect_open(*node, depth + 1);
+  rows_.insert(first_child, spliced.begin(), spliced.end());
+}
+
 } // namespace ui::selector_detail
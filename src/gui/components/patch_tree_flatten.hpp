@@ -3,34 +3,112 @@
 // Turns the workspace tree into the flat row list the tree view draws. Pure
 // data transform -- deliberately free of ImGui so it can be unit tested.
 
-#include "patches/patch_repository.hpp"
+#include "patches/patch_index.hpp"
+#include "patches/patch_metadata_index.hpp"
+#include "patches/patch_search_index.hpp"
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace ui::selector_detail {
 
 struct TreeRow {
-  const patches::PatchEntry *entry;
+  patches::PatchIndex::NodeId node;
   int depth; ///< 0 = workspace root level.
   bool is_directory;
   bool is_open; ///< Directories only.
+  /// Stands in for the children of an open folder that is not read yet;
+  /// `node` is the folder.
+  bool is_loading;
 };
 
 /**
  * The rows visible under the given filters and expansion state, in draw order.
  *
  * A directory is listed when a file anywhere below it passes both filters, or
- * -- while searching -- when the directory itself matches the query. Its
- * children follow only when its relative_path is in `open_directories`.
+ * -- while searching -- when the directory itself matches the query, or,
+ * unfiltered, when a lazy walk left it unread. Files
+ * are matched through `search`, which must have been built from `index`. Its
+ * children follow only when its relative_path is in `open_directories`, and
+ * an open folder that is not read yet gets one is_loading row instead.
  *
- * The returned rows point into `tree`, so they stay valid only as long as the
- * repository does not rebuild it.
+ * The star filter and any `category:` or `tag:` terms in the query are
+ * answered by `metadata`, or by an index built on the spot when it is null.
+ * Patches marked hidden are never listed.
+ *
+ * The returned rows name nodes of the index, so they stay valid only as long
+ * as the repository does not rebuild it.
  */
 std::vector<TreeRow>
-flatten_visible_rows(const std::vector<patches::PatchEntry> &tree,
+flatten_visible_rows(const patches::PatchIndex &index,
+                     const patches::PatchSearchIndex &search,
                      const std::string &query_lower, int min_star_rating,
-                     const std::unordered_set<std::string> &open_directories);
+                     const std::unordered_set<std::string> &open_directories,
+                     const patches::PatchMetadataIndex *metadata = nullptr);
+
+/**
+ * flatten_visible_rows() memoized across frames, plus the expansion state it
+ * reads. Expansion lives here because ImGui's own tree state is unreachable
+ * for rows the clipper never draws.
+ *
+ * The rows are rebuilt in full only when the repository's metadata revision,
+ * the query or the star filter change. An expand or collapse splices just the
+ * toggled directory's rows in or out: whether a directory is listed never
+ * depends on its own open state, so the rest of the list is unaffected.
+ */
+class TreeRowCache {
+public:
+  /**
+   * The current rows. `search` and `metadata` are read only on a rebuild;
+   * `search` may be any index while `query_lower` is empty.
+   */
+  const std::vector<TreeRow> &
+  get(const patches::PatchIndex &index, const patches::PatchSearchIndex &search,
+      std::uint64_t revision, const std::string &query_lower,
+      int min_star_rating,
+      const patches::PatchMetadataIndex *metadata = nullptr);
+
+  /// Takes effect on the next get(), by splicing when the rows are current.
+  void set_open(const std::string &relative_path, bool open);
+  bool is_open(const std::string &relative_path) const {
+    return open_directories_.count(relative_path) > 0;
+  }
+
+  /// Bumped on every expand/collapse that changed the open set.
+  std::uint64_t open_generation() const { return open_generation_; }
+  /// How many times get() re-flattened the whole tree.
+  std::size_t rebuild_count() const { return rebuild_count_; }
+
+private:
+  void rebuild(const patches::PatchIndex &index,
+               const patches::PatchSearchIndex &search,
+               const patches::PatchMetadataIndex *metadata);
+  void splice(const std::string &relative_path, bool open);
+
+  const patches::PatchIndex *index_ = nullptr;
+  std::uint64_t revision_ = 0;
+  std::string query_;
+  int star_filter_ = 0;
+  bool built_ = false;
+
+  std::unordered_set<std::string> open_directories_;
+  std::vector<std::pair<std::string, bool>> pending_toggles_;
+  std::uint64_t open_generation_ = 0;
+  std::size_t rebuild_count_ = 0;
+
+  /// Indexed by NodeId and PatchId respectively, for the current index.
+  std::vector<char> open_nodes_;
+  std::vector<char> matched_;
+  /// query_ without its metadata terms, and the patches those terms and the
+  /// star filter allow.
+  std::string text_;
+  std::optional<patches::PatchMetadataIndex::Bits> allowed_;
+  std::vector<TreeRow> rows_;
+};
 
 } // namespace ui::selector_detail
@@ -6,10 +6,10 @@
 #include "patch_tree_flatten.hpp"
 
 #include <cstddef>
-#include <cstdint>
 #include <imgui.h>
+#include <optional>
 #include <string>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace ui::selector_detail {
@@ -18,50 +18,6 @@ namespace {
 
 constexpr float kDepthIndent = 4.0f;
 
-/**
- * The visible rows, rebuilt only when the tree, the filters or the expansion
- * state change. Expansion lives here too, because ImGui's own tree state is
- * unreachable for rows the clipper never draws.
- */
-struct PatchTreeCache {
-  const std::vector<patches::PatchEntry> *tree = nullptr;
-  std::uint64_t repository_revision = 0;
-  std::string search_query;
-  int star_filter = 0;
-  std::uint64_t built_open_revision = 0;
-
-  /// Bumped on every expand/collapse, so the rows rebuild on the next frame.
-  std::uint64_t open_revision = 1;
-  std::unordered_set<std::string> open_directories;
-  std::vector<TreeRow> rows;
-
-  const std::vector<TreeRow> &
-  get(const std::vector<patches::PatchEntry> &source, std::uint64_t revision,
-      const std::string &query_lower, int min_star_rating) {
-    if (tree != &source || repository_revision != revision ||
-        search_query != query_lower || star_filter != min_star_rating ||
-        built_open_revision != open_revision) {
-      tree = &source;
-      repository_revision = revision;
-      search_query = query_lower;
-      star_filter = min_star_rating;
-      built_open_revision = open_revision;
-      rows = flatten_visible_rows(source, query_lower, min_star_rating,
-                                  open_directories);
-    }
-    return rows;
-  }
-
-  void set_open(const std::string &relative_path, bool open) {
-    if (open) {
-      open_directories.insert(relative_path);
-    } else {
-      open_directories.erase(relative_path);
-    }
-    ++open_revision;
-  }
-};
-
 /**
  * Reproduces the layout of the recursion this list replaced: each level used
  * to sit inside one more TreePush (one IndentSpacing each) and file rows added
@@ -79,38 +35,59 @@ float row_indent(const TreeRow &row, float indent_spacing) {
   return base + kDepthIndent * static_cast<float>(row.depth);
 }
 
-void render_directory_row(PatchSelectorContext &context, const TreeRow &row,
-                          PatchTreeCache &cache) {
-  const auto &item = *row.entry;
+/// Opening a folder a lazy walk left unread asks for it to be read, which the
+/// caller does once the rows are drawn. `path` is scratch space for the row's
+/// relative path, reused from row to row.
+void render_directory_row(PatchSelectorContext &context,
+                          const patches::PatchIndex &index, const TreeRow &row,
+                          TreeRowCache &cache, std::string &path,
+                          std::optional<std::string> &read_request) {
+  path.clear();
+  index.append_relative_path(row.node, path);
+  const bool builtin = path == kBuiltinPresetRoot;
 
-  ImGui::PushID(item.relative_path.c_str());
-  std::string display_name = item.name;
-  if (item.relative_path == kBuiltinPresetRoot) {
-    display_name = std::string(kBuiltinPresetDisplayName);
-  }
+  ImGui::PushID(path.c_str());
+  const auto name = builtin ? kBuiltinPresetDisplayName : index.name(row.node);
 
   // The row list owns the open state, so the node is driven rather than left
   // to ImGui's storage; a toggle is picked up from the returned value.
   ImGui::SetNextItemOpen(row.is_open, ImGuiCond_Always);
-  const bool open = ImGui::TreeNodeEx(display_name.c_str(),
+  const bool open = ImGui::TreeNodeEx(name.data(),
                                       ImGuiTreeNodeFlags_SpanFullWidth |
                                           ImGuiTreeNodeFlags_NoTreePushOnOpen);
-  entry_context_menu(context, item,
-                     row.depth == 0 &&
-                         item.relative_path != kBuiltinPresetRoot);
+  entry_context_menu(context, index, row.node, row.depth == 0 && !builtin);
   if (open != row.is_open) {
-    cache.set_open(item.relative_path, open);
+    cache.set_open(path, open);
+    if (open && index.children_pending(row.node)) {
+      read_request = path;
+    }
   }
   ImGui::PopID();
 }
 
-void render_patch_row(PatchSelectorContext &context, const TreeRow &row) {
-  const auto &item = *row.entry;
+/// Stands in for an open folder's children while they are read. A folder
+/// left open from before it was listed lazily has not been asked for yet.
+void render_loading_row(PatchSelectorContext &context, const TreeRow &row,
+                        std::optional<std::string> &read_request) {
+  auto path = context.repository.index().relative_path(row.node);
+  ImGui::TextDisabled("Loading...");
+  if (!context.repository.directory_loading(path)) {
+    read_request = std::move(path);
+  }
+}
+
+/// True when the patch was clicked or arrowed onto this frame, which is when
+/// its neighbours are worth decoding.
+bool render_patch_row(PatchSelectorContext &context,
+                      const patches::PatchIndex &index, const TreeRow &row,
+                      std::string &path) {
+  path.clear();
+  index.append_relative_path(row.node, path);
 
-  ImGui::PushID(item.relative_path.c_str());
+  ImGui::PushID(path.c_str());
 
   const bool is_current =
-      item.relative_path == context.session.current_patch_selection_path();
+      path == context.session.current_patch_selection_path();
   if (is_current) {
     ImGui::PushStyleColor(ImGuiCol_Text,
                           styles::color(styles::MegatoyCol::TextHighlight));
@@ -119,12 +96,14 @@ void render_patch_row(PatchSelectorContext &context, const TreeRow &row) {
   // Name and dimmed format label, either of which loads the patch. The
   // context menu and tooltip attach to whichever was drawn last, so both
   // are registered after each selectable.
-  const bool name_clicked = ImGui::Selectable(item.name.c_str(), false);
+  const auto name = index.name(row.node);
+  const bool name_clicked = ImGui::Selectable(name.data(), false);
+  const bool name_arrived = nav_arrived(path);
   if (is_current) {
     ImGui::PopStyleColor();
   }
-  entry_context_menu(context, item);
-  show_patch_tooltip(item);
+  entry_context_menu(context, index, row.node);
+  show_patch_tooltip(index, row.node);
 
   ImGui::SameLine();
   const ImVec4 format_color =
@@ -132,26 +111,46 @@ void render_patch_row(PatchSelectorContext &context, const TreeRow &row) {
                  : ImGui::GetStyleColorVec4(ImGuiCol_Text);
   ImGui::PushStyleColor(ImGuiCol_Text,
                         color_with_alpha_vec4(format_color, 0.5f));
-  const bool format_clicked = ImGui::Selectable(item.format.c_str(), false);
+  const bool format_clicked =
+      ImGui::Selectable(index.format(row.node).data(), false);
   ImGui::PopStyleColor();
-  entry_context_menu(context, item);
-  show_patch_tooltip(item);
-
-  if ((name_clicked || format_clicked) && context.safe_load_patch) {
-    context.safe_load_patch(item);
+  entry_context_menu(context, index, row.node);
+  show_patch_tooltip(index, row.node);
+
+  // Arrowing onto a patch auditions it, unless that would mean asking to
+  // discard edits on every keypress.
+  const bool audition =
+      name_arrived && !is_current && !context.session.is_modified();
+  if ((name_clicked || format_clicked || audition) &&
+      context.safe_load_patch) {
+    context.safe_load_patch(index.entry(row.node));
   }
 
   ImGui::PopID();
+  return name_clicked || format_clicked || name_arrived;
 }
 
 } // namespace
 
-bool render_patch_tree(const std::vector<patches::PatchEntry> &tree,
-                       PatchSelectorContext &context,
+bool render_patch_tree(const patches::PatchIndex &index,
+                       PatchSelectorContext &context, TreeRowCache &cache,
                        const std::string &query_lower, int min_star_rating) {
-  static PatchTreeCache cache;
-  const auto &rows = cache.get(tree, context.repository.revision(), query_lower,
-                               min_star_rating);
+  // The search index is built on first use, so it is only asked for while
+  // there is something to search.
+  static const patches::PatchSearchIndex kNoSearch;
+  const auto &search =
+      query_lower.empty() ? kNoSearch : context.repository.search_index();
+  // Likewise the metadata bitsets, only while a star, category or tag
+  // filter is set.
+  const bool metadata_filtered =
+      !parse_query(query_lower, min_star_rating).metadata.empty();
+  const auto *metadata =
+      metadata_filtered ? &context.repository.metadata_index() : nullptr;
+  // Rows are filtered on stars, categories and hidden, so a metadata edit
+  // re-filters them too.
+  const auto &rows = cache.get(index, search,
+                               context.repository.metadata_revision(),
+                               query_lower, min_star_rating, metadata);
   if (rows.empty()) {
     return false;
   }
@@ -159,6 +158,9 @@ bool render_patch_tree(const std::vector<patches::PatchEntry> &tree,
   // Every row is exactly one text line high, which is what lets the clipper
   // skip the rows outside the view.
   const float indent_spacing = ImGui::GetStyle().IndentSpacing;
+  std::optional<std::size_t> visited_row;
+  std::optional<std::string> read_request;
+  std::string path;
   ImGuiListClipper clipper;
   clipper.Begin(static_cast<int>(rows.size()));
   while (clipper.Step()) {
@@ -169,9 +171,13 @@ bool render_patch_tree(const std::vector<patches::PatchEntry> &tree,
         ImGui::Indent(offset);
       }
       if (row.is_directory) {
-        render_directory_row(context, row, cache);
+        render_directory_row(context, index, row, cache, path, read_request);
+      } else if (row.is_loading) {
+        render_loading_row(context, row, read_request);
       } else {
-        render_patch_row(context, row);
+        if (render_patch_row(context, index, row, path)) {
+          visited_row = static_cast<std::size_t>(i);
+        }
       }
       if (offset > 0.0f) {
         ImGui::Unindent(offset);
@@ -179,6 +185,22 @@ bool render_patch_tree(const std::vector<patches::PatchEntry> &tree,
     }
   }
 
+  // After the loop: reading the folder rebuilds the rows drawn above.
+  if (read_request) {
+    context.repository.expand_directory(*read_request);
+  }
+
+  // Once per patch clicked or arrowed onto, not every frame: the neighbours
+  // do not change until the cursor moves again.
+  if (visited_row) {
+    prefetch_around(context, *visited_row, rows.size(),
+                    [&](std::size_t i) -> std::optional<patches::PatchEntry> {
+                      if (rows[i].is_directory || rows[i].is_loading) {
+                        return std::nullopt;
+                      }
+                      return index.entry(rows[i].node);
+                    });
+  }
   return true;
 }
 
@@ -3,19 +3,21 @@
 // The patch browser's folder-hierarchy view. Internal to the selector.
 
 #include "patch_selector.hpp"
+#include "patch_tree_flatten.hpp"
+#include "patches/patch_index.hpp"
 
 #include <string>
-#include <vector>
 
 namespace ui::selector_detail {
 
 /**
  * Render the workspace tree, filtered by search text and minimum stars.
+ * `rows` carries the rows and the open folders from one frame to the next.
  * Returns true if anything was drawn, so the caller can show an empty-result
  * notice.
  */
-bool render_patch_tree(const std::vector<patches::PatchEntry> &tree,
-                       PatchSelectorContext &context,
+bool render_patch_tree(const patches::PatchIndex &index,
+                       PatchSelectorContext &context, TreeRowCache &rows,
                        const std::string &query_lower, int min_star_rating);
 
 } // namespace ui::selector_detail
@@ -472,6 +472,10 @@ void render_sound_tab(PreferencesContext &context) {
   // keyboard the note arrived from.
   ImGui::Checkbox("Steal oldest note when all 6 channels are busy",
                   &ui_prefs.steal_oldest_note_when_full);
+
+  ImGui::Checkbox("Match patch loudness", &ui_prefs.match_loudness);
+  ImGui::TextWrapped("Plays every patch at the same loudness while browsing. "
+                     "Each patch is measured once, in the background.");
 }
 
 // MIDI and the typing keyboard share a tab because they answer the same
@@ -11,12 +11,12 @@
 #include "gui/components/patch_editor.hpp"
 #include "gui/components/patch_lab_window.hpp"
 #include "gui/components/patch_selector.hpp"
+#include "gui/components/patch_selector_state.hpp"
 #include "gui/components/preferences.hpp"
 #include "gui/components/status_toasts.hpp"
 #include "gui/components/waveform.hpp"
 #include "gui/save_export_actions.hpp"
 #include "gui/window_title.hpp"
-#include "history/snapshot_entry.hpp"
 #include "midi/midi_input_manager.hpp"
 #include "patch_actions.hpp"
 #include "patches/filename_utils.hpp"
@@ -51,23 +51,8 @@ struct PatchHistoryActions {
 
   void begin_snapshot(const std::string &label,
                       const std::string &merge_key) const {
-    auto before_snapshot = ctx.services.patch_session.capture_snapshot();
-    auto label_copy = label;
-    auto key_copy = merge_key;
     ctx.services.history.begin_transaction(
-        label_copy, key_copy,
-        [label_copy = std::move(label_copy), key_copy = std::move(key_copy),
-         before_snapshot](AppContext &context) mutable {
-          auto &patch_session = context.services.patch_session;
-          auto after_snapshot = patch_session.capture_snapshot();
-          return history::make_snapshot_entry<
-              patches::PatchSession::PatchSnapshot>(
-              label_copy, key_copy, before_snapshot, after_snapshot,
-              [](AppContext &context,
-                 const patches::PatchSession::PatchSnapshot &snapshot) {
-                context.services.patch_session.restore_snapshot(snapshot);
-              });
-        });
+        label, merge_key, ctx.services.patch_session.capture_snapshot());
   }
 
   void commit() const { ctx.services.history.commit_transaction(ctx); }
@@ -124,6 +109,11 @@ PatchLabState &patch_lab_state() {
   return state;
 }
 
+PatchSelectorState &patch_selector_state() {
+  static PatchSelectorState state;
+  return state;
+}
+
 MidiKeyboardState &midi_keyboard_state() {
   static MidiKeyboardState state;
   return state;
@@ -627,6 +617,11 @@ void render_all(AppContext &ctx) {
     }
   }
 
+  // Before anything is drawn, so the browser and the editor show a rescan
+  // or a patch load that finished this frame.
+  ctx.services.patch_session.repository().poll_background_refresh();
+  patch_actions::poll_load(ctx);
+
   // Per-frame values; everything else in the contexts is stable references.
   contexts.patch_selector.workspace_is_empty =
       ctx.services.preference_manager.workspace().empty();
@@ -653,7 +648,8 @@ void render_all(AppContext &ctx) {
 #endif
   render_patch_editor(PATCH_EDITOR_TITLE, contexts.patch_editor,
                       ctx.app_state().ui_state().save_export_state);
-  render_patch_selector(PATCH_BROWSER_TITLE, contexts.patch_selector);
+  render_patch_selector(PATCH_BROWSER_TITLE, contexts.patch_selector,
+                        patch_selector_state());
   render_preferences_window(PREFERENCES_TITLE, contexts.preferences);
   render_midi_keyboard(SOFT_KEYBOARD_TITLE, contexts.midi_keyboard);
   render_mml_console(MML_CONSOLE_TITLE, contexts.mml_console);
@@ -0,0 +1,198 @@
+#include "delta_history.hpp"
+
+#include <algorithm>
+
+namespace history {
+
+namespace {
+
+using patch_delta::Direction;
+
+constexpr std::size_t kFrameBytes = 4;
+
+void put_u32(std::uint8_t *out, std::uint32_t value) {
+  for (std::size_t i = 0; i < kFrameBytes; ++i) {
+    out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+  }
+}
+
+std::uint32_t get_u32(const std::uint8_t *in) {
+  std::uint32_t value = 0;
+  for (std::size_t i = 0; i < kFrameBytes; ++i) {
+    value |= std::uint32_t{in[i]} << (8 * i);
+  }
+  return value;
+}
+
+void append_text(std::string_view text, std::vector<std::uint8_t> &out) {
+  patch_delta::append_varint(text.size(), out);
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+} // namespace
+
+DeltaHistory::DeltaHistory(std::size_t budget_bytes)
+    : budget_(std::max<std::size_t>(budget_bytes, 1)) {}
+
+void DeltaHistory::clear() {
+  bytes_.clear();
+  head_ = cursor_ = end_ = 0;
+  steps_ = undoable_ = 0;
+  state_ = {};
+}
+
+bool DeltaHistory::record(std::string_view label, std::string_view merge_key,
+                          const patches::PatchSnapshot &before,
+                          const patches::PatchSnapshot &after) {
+  if (before == after) {
+    return false;
+  }
+  drop_redo();
+
+  if (steps_ > 0 && !merge_key.empty()) {
+    const auto newest = step_before(end_);
+    const auto step = step_at(newest);
+    if (step.merge_key == merge_key) {
+      // The merged step starts where the newest did and ends at `after`.
+      auto start = state_;
+      patch_delta::apply(step.change, start, Direction::Backward);
+      gap_.assign(step.gap.begin(), step.gap.end());
+      bytes_.resize(newest);
+      cursor_ = end_ = newest;
+      --steps_;
+      --undoable_;
+      append_step(label, merge_key, gap_, start, after);
+      state_ = after;
+      return true;
+    }
+  }
+
+  gap_.clear();
+  if (steps_ > 0) {
+    patch_delta::append(state_, before, gap_);
+  }
+  append_step(label, merge_key, gap_, before, after);
+  state_ = after;
+  while (bytes_used() > budget_ && steps_ > 1) {
+    drop_oldest();
+  }
+  return true;
+}
+
+std::string_view DeltaHistory::undo_label() const {
+  return can_undo() ? step_at(step_before(cursor_)).label : std::string_view{};
+}
+
+std::string_view DeltaHistory::redo_label() const {
+  return can_redo() ? step_at(cursor_).label : std::string_view{};
+}
+
+std::optional<patches::PatchSnapshot> DeltaHistory::undo() {
+  if (!can_undo()) {
+    return std::nullopt;
+  }
+  const auto offset = step_before(cursor_);
+  const auto step = step_at(offset);
+  patch_delta::apply(step.change, state_, Direction::Backward);
+  auto restored = state_;
+  // Back across the unrecorded gap to the step before, unless there is none.
+  if (offset != head_) {
+    patch_delta::apply(step.gap, state_, Direction::Backward);
+  }
+  cursor_ = offset;
+  --undoable_;
+  return restored;
+}
+
+std::optional<patches::PatchSnapshot> DeltaHistory::redo() {
+  if (!can_redo()) {
+    return std::nullopt;
+  }
+  const auto step = step_at(cursor_);
+  if (cursor_ != head_) {
+    patch_delta::apply(step.gap, state_, Direction::Forward);
+  }
+  patch_delta::apply(step.change, state_, Direction::Forward);
+  cursor_ += step.size;
+  ++undoable_;
+  return state_;
+}
+
+DeltaHistory::Step DeltaHistory::step_at(std::size_t offset) const {
+  Step step;
+  const auto size = get_u32(&bytes_[offset]);
+  step.size = size + 2 * kFrameBytes;
+  const std::span<const std::uint8_t> body(&bytes_[offset + kFrameBytes],
+                                           size);
+  // Steps are only ever written by append_step, so the body is well formed.
+  std::size_t at = 0;
+  std::uint64_t length = 0;
+  const auto text = [&] {
+    patch_delta::read_varint(body, at, length);
+    const std::string_view value(reinterpret_cast<const char *>(&body[at]),
+                                 static_cast<std::size_t>(length));
+    at += static_cast<std::size_t>(length);
+    return value;
+  };
+  step.label = text();
+  step.merge_key = text();
+  patch_delta::read_varint(body, at, length);
+  step.gap = body.subspan(at, static_cast<std::size_t>(length));
+  step.change = body.subspan(at + static_cast<std::size_t>(length));
+  return step;
+}
+
+std::size_t DeltaHistory::step_before(std::size_t offset) const {
+  return offset - get_u32(&bytes_[offset - kFrameBytes]) - 2 * kFrameBytes;
+}
+
+void DeltaHistory::append_step(std::string_view label,
+                               std::string_view merge_key,
+                               std::span<const std::uint8_t> gap,
+                               const patches::PatchSnapshot &from,
+                               const patches::PatchSnapshot &to) {
+  scratch_.clear();
+  append_text(label, scratch_);
+  append_text(merge_key, scratch_);
+  patch_delta::append_varint(gap.size(), scratch_);
+  scratch_.insert(scratch_.end(), gap.begin(), gap.end());
+  patch_delta::append(from, to, scratch_);
+
+  const auto size = static_cast<std::uint32_t>(scratch_.size());
+  bytes_.resize(end_ + scratch_.size() + 2 * kFrameBytes);
+  put_u32(&bytes_[end_], size);
+  std::copy(scratch_.begin(), scratch_.end(), &bytes_[end_ + kFrameBytes]);
+  put_u32(&bytes_[end_ + kFrameBytes + size], size);
+  end_ = cursor_ = bytes_.size();
+  ++steps_;
+  ++undoable_;
+}
+
+void DeltaHistory::drop_redo() {
+  if (cursor_ == end_) {
+    return;
+  }
+  if (undoable_ == 0) {
+    clear();
+    return;
+  }
+  // state_ is already the state after the newest step that stays.
+  bytes_.resize(cursor_);
+  end_ = cursor_;
+  steps_ = undoable_;
+}
+
+void DeltaHistory::drop_oldest() {
+  head_ += step_at(head_).size;
+  --steps_;
+  --undoable_;
+  if (head_ * 2 > bytes_.size()) {
+    bytes_.erase(bytes_.begin(),
+                 bytes_.begin() + static_cast<std::ptrdiff_t>(head_));
+    cursor_ -= head_;
+    end_ -= head_;
+    head_ = 0;
+  }
+}
+
+} // namespace history
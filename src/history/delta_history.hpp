@@ -0,0 +1,103 @@
+#pragma once
+
+#include "patch_delta.hpp"
+#include "patches/patch_snapshot.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace history {
+
+/**
+ * Undo steps as patch deltas, packed one after another in a single buffer
+ * that holds at most a byte budget rather than a number of steps.
+ *
+ * A step is its label, its merge key and the patch_delta of what it changed,
+ * framed by its length on both ends so the buffer can be walked either way:
+ * undo reads the step before the cursor, redo the one after, and both cost
+ * the size of that step's delta. The oldest steps fall off the front when a
+ * new one would go over budget; the front is reclaimed in bulk once it is
+ * half the buffer, so dropping a step does not move the rest.
+ *
+ * Deltas need something to apply to, so the history keeps the one snapshot
+ * at the cursor. Whatever happened between two steps without being recorded
+ * is stored with the later step, as the gap between them, so undo still
+ * lands exactly on each step's recorded before-state, as whole snapshots
+ * did.
+ */
+class DeltaHistory {
+public:
+  /// Thousands of edits; a patch load, which changes everything, is a few
+  /// hundred bytes.
+  static constexpr std::size_t kDefaultBudgetBytes = 256 * 1024;
+
+  explicit DeltaHistory(std::size_t budget_bytes = kDefaultBudgetBytes);
+
+  void clear();
+
+  /**
+   * Record a step from `before` to `after`, dropping anything to redo.
+   * Nothing happens when the two are equal. A step whose non-empty merge key
+   * matches the newest undoable step's folds into it: one drag, one step.
+   * Returns whether anything was recorded.
+   */
+  bool record(std::string_view label, std::string_view merge_key,
+              const patches::PatchSnapshot &before,
+              const patches::PatchSnapshot &after);
+
+  bool can_undo() const { return undoable_ > 0; }
+  bool can_redo() const { return undoable_ < steps_; }
+  /// Valid until the history next changes.
+  std::string_view undo_label() const;
+  std::string_view redo_label() const;
+
+  /// The snapshot to restore, or nothing when there is no step.
+  std::optional<patches::PatchSnapshot> undo();
+  std::optional<patches::PatchSnapshot> redo();
+
+  std::size_t steps() const { return steps_; }
+  /// Bytes the steps take, framing included.
+  std::size_t bytes_used() const { return end_ - head_; }
+
+private:
+  struct Step {
+    std::string_view label;
+    std::string_view merge_key;
+    std::span<const std::uint8_t> gap;
+    std::span<const std::uint8_t> change;
+    std::size_t size = 0;
+  };
+
+  Step step_at(std::size_t offset) const;
+  /// The start of the step that ends at `offset`.
+  std::size_t step_before(std::size_t offset) const;
+  void append_step(std::string_view label, std::string_view merge_key,
+                   std::span<const std::uint8_t> gap,
+                   const patches::PatchSnapshot &from,
+                   const patches::PatchSnapshot &to);
+  void drop_redo();
+  void drop_oldest();
+
+  std::size_t budget_;
+  std::vector<std::uint8_t> bytes_;
+  /// Steps live in [head_, end_); the ones before cursor_ can be undone.
+  std::size_t head_ = 0;
+  std::size_t cursor_ = 0;
+  std::size_t end_ = 0;
+  std::size_t steps_ = 0;
+  std::size_t undoable_ = 0;
+  /**
+   * The state at the cursor: after the step before it, or before the oldest
+   * step when everything is undone. Meaningless while there are no steps.
+   */
+  patches::PatchSnapshot state_;
+  /// Scratch for building a step and its gap, kept to avoid allocating per
+  /// edit.
+  std::vector<std::uint8_t> scratch_;
+  std::vector<std::uint8_t> gap_;
+};
+
+} // namespace history
@@ -0,0 +1,591 @@
+#include "edit_journal.hpp"
+
+#include "patch_delta.hpp"
+#include "platform/platform_config.hpp"
+#if defined(MEGATOY_PLATFORM_WEB)
+#include "platform/web/web_storage_persistence.hpp"
+#endif
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <system_error>
+#include <utility>
+
+namespace history {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/// How long edits wait to be written with the ones that follow them.
+constexpr auto kFlushInterval = std::chrono::seconds(1);
+/// Edits queued before they are written without waiting any longer.
+constexpr std::size_t kBatchEdits = 256;
+
+/// Record header: body size, then the body's checksum.
+constexpr std::size_t kHeaderBytes = 8;
+constexpr const char *kSegmentExtension = ".journal";
+
+/// Bump when the record layout changes: segments in another format are then
+/// left unread.
+constexpr std::uint8_t kFormatVersion = 1;
+/// What every segment starts with: a tag, then the format version.
+constexpr std::array<std::uint8_t, 4> kSegmentHeader = {'M', 'T', 'J',
+                                                        kFormatVersion};
+constexpr std::size_t kSegmentHeaderBytes = kSegmentHeader.size();
+
+void set_u32(std::vector<std::uint8_t> &out, std::size_t offset,
+             std::uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out[offset + i] = static_cast<std::uint8_t>(value >> (8 * i));
+  }
+}
+
+void put_u64(std::uint64_t value, std::vector<std::uint8_t> &out) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+std::uint64_t get_le(std::span<const std::uint8_t> bytes, std::size_t offset,
+                     std::size_t width) {
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < width; ++i) {
+    value |= std::uint64_t{bytes[offset + i]} << (8 * i);
+  }
+  return value;
+}
+
+/// 32-bit FNV-1a; it only has to catch a record cut short by a crash.
+std::uint32_t checksum(std::span<const std::uint8_t> bytes) {
+  std::uint32_t hash = 2166136261u;
+  for (const auto byte : bytes) {
+    hash = (hash ^ byte) * 16777619u;
+  }
+  return hash;
+}
+
+void put_text(std::string_view text, std::vector<std::uint8_t> &out) {
+  patch_delta::append_varint(text.size(), out);
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+bool read_text(std::span<const std::uint8_t> bytes, std::size_t &offset,
+               std::string &text) {
+  std::uint64_t size = 0;
+  if (!patch_delta::read_varint(bytes, offset, size) ||
+      size > bytes.size() - offset) {
+    return false;
+  }
+  text.assign(reinterpret_cast<const char *>(bytes.data() + offset),
+              static_cast<std::size_t>(size));
+  offset += static_cast<std::size_t>(size);
+  return true;
+}
+
+/// The size of the whole record at `offset`, or 0 when there is no intact
+/// record there.
+std::size_t record_size(std::span<const std::uint8_t> bytes,
+                        std::size_t offset) {
+  if (bytes.size() - offset < kHeaderBytes) {
+    return 0;
+  }
+  const auto body = static_cast<std::size_t>(get_le(bytes, offset, 4));
+  if (body > bytes.size() - offset - kHeaderBytes) {
+    return 0;
+  }
+  const auto stored = static_cast<std::uint32_t>(get_le(bytes, offset + 4, 4));
+  if (checksum(bytes.subspan(offset + kHeaderBytes, body)) != stored) {
+    return 0;
+  }
+  return kHeaderBytes + body;
+}
+
+/// The sequence number and key at the front of an intact record's body;
+/// `at` is left on what follows them.
+bool read_record_key(std::span<const std::uint8_t> record,
+                     std::uint64_t &sequence, std::string &key,
+                     std::size_t &at) {
+  if (record.size() < kHeaderBytes + 8) {
+    return false;
+  }
+  sequence = get_le(record, kHeaderBytes, 8);
+  at = kHeaderBytes + 8;
+  return read_text(record, at, key);
+}
+
+bool read_step(std::span<const std::uint8_t> record, EditJournal::Step &step) {
+  std::uint64_t sequence = 0;
+  std::string key;
+  std::size_t at = 0;
+  if (!read_record_key(record, sequence, key, at)) {
+    return false;
+  }
+  if (record.size() - at < 16) {
+    return false;
+  }
+  step.before_hash = get_le(record, at, 8);
+  step.after_hash = get_le(record, at + 8, 8);
+  at += 16;
+  if (!read_text(record, at, step.label) ||
+      !read_text(record, at, step.merge_key)) {
+    return false;
+  }
+  step.change.assign(record.begin() + static_cast<std::ptrdiff_t>(at),
+                     record.end());
+  return true;
+}
+
+/// Whether `bytes` start with the header of a segment this build reads.
+bool current_format(std::span<const std::uint8_t> bytes) {
+  return bytes.size() >= kSegmentHeaderBytes &&
+         std::equal(kSegmentHeader.begin(), kSegmentHeader.end(),
+                    bytes.begin());
+}
+
+std::vector<std::uint8_t> read_file(const fs::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return {};
+  }
+  return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+} // namespace
+
+EditJournal::~EditJournal() { shutdown(); }
+
+void EditJournal::open(std::filesystem::path directory) {
+  if (is_open() || directory.empty()) {
+    return;
+  }
+  std::error_code error;
+  fs::create_directories(directory, error);
+  if (error) {
+    std::cerr << "Edit journal unavailable: " << error.message() << std::endl;
+    return;
+  }
+  directory_ = std::move(directory);
+#if defined(MEGATOY_PLATFORM_WEB)
+  build_index();
+#else
+  worker_ = std::thread([this] { run_worker(); });
+#endif
+}
+
+void EditJournal::append(std::string_view label, std::string_view merge_key,
+                         const patches::PatchSnapshot &before,
+                         const patches::PatchSnapshot &after) {
+  if (!is_open() || before.selection_path.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    return;
+  }
+  seen_.insert(before.selection_path);
+  // Every frame of a drag commits under one merge key and the history folds
+  // them into one step; the queue keeps one edit for them the same way.
+  if (!merge_key.empty() && !pending_.empty()) {
+    auto &last = pending_.back();
+    if (last.merge_key == merge_key &&
+        last.before.selection_path == before.selection_path) {
+      last.label = label;
+      last.after = after;
+      return;
+    }
+  }
+  pending_.push_back(
+      Pending{std::string(label), std::string(merge_key), before, after});
+  if (pending_.size() == 1) {
+    queued_at_ = std::chrono::steady_clock::now();
+  }
+#if !defined(MEGATOY_PLATFORM_WEB)
+  // The worker waits out the flush interval on its own; it only needs a
+  // nudge to start waiting, or to stop.
+  if (pending_.size() == 1 || pending_.size() == kBatchEdits) {
+    wake_.notify_one();
+  }
+#endif
+}
+
+bool EditJournal::ready() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_ready_;
+}
+
+std::vector<EditJournal::Step> EditJournal::take_steps(const std::string &key) {
+  if (!is_open() || key.empty()) {
+    return {};
+  }
+  // Held while reading: compaction deletes segments under the same lock.
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!index_ready_ || !seen_.insert(key).second) {
+    return {};
+  }
+  const auto found = index_.find(key);
+  if (found == index_.end()) {
+    return {};
+  }
+
+  std::vector<Step> steps;
+  std::ifstream file;
+  std::uint32_t open_segment = 0;
+  std::vector<std::uint8_t> record;
+  for (const auto &location : found->second) {
+    if (!file.is_open() || open_segment != location.segment) {
+      file.close();
+      file.clear();
+      file.open(segment_path(location.segment), std::ios::binary);
+      open_segment = location.segment;
+    }
+    record.resize(location.size);
+    file.seekg(static_cast<std::streamoff>(location.offset));
+    file.read(reinterpret_cast<char *>(record.data()),
+              static_cast<std::streamsize>(record.size()));
+    Step step;
+    if (!file || record_size(record, 0) != record.size() ||
+        !read_step(record, step)) {
+      file.clear();
+      continue;
+    }
+    steps.push_back(std::move(step));
+  }
+  return steps;
+}
+
+void EditJournal::poll() {
+#if defined(MEGATOY_PLATFORM_WEB)
+  std::vector<Pending> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.empty() ||
+        (pending_.size() < kBatchEdits &&
+         std::chrono::steady_clock::now() - queued_at_ < kFlushInterval)) {
+      return;
+    }
+    batch = std::move(pending_);
+    pending_.clear();
+  }
+  flush(batch);
+#endif
+}
+
+void EditJournal::shutdown() {
+  std::vector<Pending> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+#if defined(MEGATOY_PLATFORM_WEB)
+    // No worker drains the queue here.
+    batch = std::move(pending_);
+    pending_.clear();
+#endif
+  }
+  wake_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+  if (!batch.empty()) {
+    flush(batch);
+  }
+}
+
+std::size_t EditJournal::bytes_on_disk() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t total = 0;
+  for (const auto &[segment, size] : segments_) {
+    total += size;
+  }
+  return total;
+}
+
+void EditJournal::trim(std::vector<Location> &locations) {
+  std::size_t kept = 0;
+  auto first = locations.end();
+  while (first != locations.begin()) {
+    const auto size = std::prev(first)->size;
+    if (kept > 0 && kept + size > kPatchBytes) {
+      break;
+    }
+    kept += size;
+    --first;
+  }
+  locations.erase(locations.begin(), first);
+}
+
+void EditJournal::run_worker() {
+  build_index();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+    // Edits come in bursts; the ones that follow within the interval go in
+    // the same write.
+    wake_.wait_for(lock, kFlushInterval, [this] {
+      return stopping_ || pending_.size() >= kBatchEdits;
+    });
+    auto batch = std::move(pending_);
+    pending_.clear();
+    lock.unlock();
+    if (!batch.empty()) {
+      flush(batch);
+    }
+    lock.lock();
+    if (stopping_ && pending_.empty()) {
+      return;
+    }
+  }
+}
+
+void EditJournal::build_index() {
+  std::vector<std::uint32_t> ids;
+  std::error_code error;
+  for (fs::directory_iterator it(directory_, error), end; !error && it != end;
+       it.increment(error)) {
+    const auto &path = it->path();
+    unsigned id = 0;
+    if (path.extension() == kSegmentExtension &&
+        std::sscanf(path.stem().string().c_str(), "%u", &id) == 1) {
+      ids.push_back(static_cast<std::uint32_t>(id));
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+
+  std::unordered_map<std::string, std::vector<Location>> index;
+  std::unordered_map<std::uint32_t, std::size_t> segments;
+  std::uint64_t next_sequence = 0;
+  bool newest_is_foreign = false;
+  std::string key;
+  for (const auto id : ids) {
+    const auto bytes = read_file(segment_path(id));
+    if (!current_format(bytes)) {
+      if (id == ids.back() && bytes.size() < kSegmentHeaderBytes) {
+        // A crash before the header was whole; nothing follows it.
+        fs::resize_file(segment_path(id), 0, error);
+        segments[id] = 0;
+      } else {
+        // Another format: counted against the budget until compaction
+        // retires it, but never read or appended to.
+        segments[id] = bytes.size();
+        newest_is_foreign = id == ids.back();
+      }
+      continue;
+    }
+    std::size_t offset = kSegmentHeaderBytes;
+    while (const auto size = record_size(bytes, offset)) {
+      std::uint64_t sequence = 0;
+      std::size_t at = 0;
+      const auto record = std::span(bytes).subspan(offset, size);
+      if (read_record_key(record, sequence, key, at)) {
+        index[key].push_back(Location{id, static_cast<std::uint32_t>(offset),
+                                      static_cast<std::uint32_t>(size),
+                                      sequence});
+        next_sequence = std::max(next_sequence, sequence + 1);
+      }
+      offset += size;
+    }
+    // Only the newest segment is appended to, so only it can end in a record
+    // torn by a crash. Appending after one would hide everything behind it.
+    auto size = bytes.size();
+    if (offset < size && id == ids.back()) {
+      fs::resize_file(segment_path(id), offset, error);
+      std::cerr << "Edit journal: dropped a torn record" << std::endl;
+      size = offset;
+    }
+    segments[id] = size;
+  }
+
+  for (auto &[path, locations] : index) {
+    // Compaction copies records forward before deleting the originals; a
+    // crash in between leaves both, and the copy is the one kept.
+    std::stable_sort(locations.begin(), locations.end(),
+                     [](const Location &a, const Location &b) {
+                       return a.sequence < b.sequence;
+                     });
+    const auto duplicates = std::unique(
+        locations.rbegin(), locations.rend(),
+        [](const Location &a, const Location &b) {
+          return a.sequence == b.sequence;
+        });
+    locations.erase(locations.begin(), duplicates.base());
+    trim(locations);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_ = std::move(index);
+  segments_ = std::move(segments);
+  newest_segment_ = ids.empty() ? 0 : ids.back() + (newest_is_foreign ? 1 : 0);
+  next_sequence_ = next_sequence;
+  index_ready_ = true;
+}
+
+void EditJournal::flush(std::vector<Pending> &batch) {
+  write(batch);
+  compact();
+#if defined(MEGATOY_PLATFORM_WEB)
+  platform::web::request_storage_persist();
+#endif
+}
+
+void EditJournal::write(std::vector<Pending> &batch) {
+  records_.clear();
+  std::vector<std::pair<std::string, Location>> added;
+  added.reserve(batch.size());
+  for (const auto &edit : batch) {
+    const auto start = records_.size();
+    records_.resize(start + kHeaderBytes);
+    const auto sequence = next_sequence_++;
+    put_u64(sequence, records_);
+    put_text(edit.before.selection_path, records_);
+    put_u64(edit.before.patch.packed().hash(), records_);
+    put_u64(edit.after.patch.packed().hash(), records_);
+    put_text(edit.label, records_);
+    put_text(edit.merge_key, records_);
+    patch_delta::append(edit.before, edit.after, records_);
+
+    const auto body = std::span(records_).subspan(start + kHeaderBytes);
+    set_u32(records_, start, static_cast<std::uint32_t>(body.size()));
+    set_u32(records_, start + 4, checksum(body));
+    added.emplace_back(edit.before.selection_path,
+                       Location{0, static_cast<std::uint32_t>(start),
+                                static_cast<std::uint32_t>(records_.size() -
+                                                           start),
+                                sequence});
+  }
+  if (!write_records(records_, added)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &[key, location] : added) {
+    auto &locations = index_[key];
+    locations.push_back(location);
+    trim(locations);
+  }
+}
+
+bool EditJournal::write_records(
+    const std::vector<std::uint8_t> &records,
+    std::vector<std::pair<std::string, Location>> &added) {
+  std::size_t offset = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    offset = segments_[newest_segment_];
+    if (offset > kSegmentHeaderBytes &&
+        offset + records.size() > kSegmentBytes) {
+      ++newest_segment_;
+      offset = 0;
+    }
+  }
+
+  std::ofstream file(segment_path(newest_segment_),
+                     std::ios::binary | std::ios::app);
+  if (offset == 0) {
+    file.write(reinterpret_cast<const char *>(kSegmentHeader.data()),
+               static_cast<std::streamsize>(kSegmentHeaderBytes));
+    offset = kSegmentHeaderBytes;
+  }
+  file.write(reinterpret_cast<const char *>(records.data()),
+             static_cast<std::streamsize>(records.size()));
+  file.flush();
+  if (!file) {
+    std::cerr << "Edit journal: could not write "
+              << segment_path(newest_segment_) << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  segments_[newest_segment_] = offset + records.size();
+  for (auto &[key, location] : added) {
+    location.segment = newest_segment_;
+    location.offset += static_cast<std::uint32_t>(offset);
+  }
+  return true;
+}
+
+void EditJournal::compact() {
+  std::vector<std::pair<std::string, Location>> live;
+  std::vector<std::uint8_t> copies;
+  // Each round retires one segment, so this ends even when little is freed.
+  for (auto rounds = segments_.size(); rounds > 1; --rounds) {
+    std::uint32_t oldest = 0;
+    bool keep_live = false;
+    live.clear();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::size_t total = 0;
+      oldest = newest_segment_;
+      for (const auto &[segment, size] : segments_) {
+        total += size;
+        oldest = std::min(oldest, segment);
+      }
+      if (total <= kJournalBytes || oldest == newest_segment_) {
+        return;
+      }
+      // Copying forward only frees space while what is kept is well under
+      // the budget; past that, the patches edited longest ago lose theirs.
+      std::size_t kept = 0;
+      for (const auto &[key, locations] : index_) {
+        for (const auto &location : locations) {
+          kept += location.size;
+        }
+      }
+      keep_live = kept <= kJournalBytes / 2;
+      for (const auto &[key, locations] : index_) {
+        for (const auto &location : locations) {
+          if (keep_live && location.segment == oldest) {
+            live.emplace_back(key, location);
+          }
+        }
+      }
+    }
+
+    if (!live.empty()) {
+      const auto bytes = read_file(segment_path(oldest));
+      copies.clear();
+      for (auto &[key, location] : live) {
+        if (location.offset + location.size > bytes.size()) {
+          return;
+        }
+        const auto from = bytes.begin() + location.offset;
+        location.offset = static_cast<std::uint32_t>(copies.size());
+        copies.insert(copies.end(), from, from + location.size);
+      }
+      // Keep the old segment when the copies could not be written.
+      if (!write_records(copies, live)) {
+        return;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[key, moved] : live) {
+      for (auto &location : index_[key]) {
+        if (location.segment == oldest && location.sequence == moved.sequence) {
+          location = moved;
+        }
+      }
+    }
+    for (auto it = index_.begin(); it != index_.end();) {
+      std::erase_if(it->second, [oldest](const Location &location) {
+        return location.segment == oldest;
+      });
+      it = it->second.empty() ? index_.erase(it) : std::next(it);
+    }
+    segments_.erase(oldest);
+    std::error_code error;
+    fs::remove(segment_path(oldest), error);
+  }
+}
+
+std::filesystem::path EditJournal::segment_path(std::uint32_t segment) const {
+  char name[16];
+  std::snprintf(name, sizeof(name), "%08u", static_cast<unsigned>(segment));
+  return directory_ / (std::string(name) + kSegmentExtension);
+}
+
+} // namespace history
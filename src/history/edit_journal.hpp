@@ -0,0 +1,158 @@
+#pragma once
+
+#include "patches/patch_snapshot.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace history {
+
+/**
+ * Every edit made to every patch, kept on disk so a patch reopened in a
+ * later session comes back with its undo steps.
+ *
+ * append() only copies the two snapshots into a queue, where an edit that
+ * continues the one before it -- same patch, same merge key, as each frame
+ * of a drag is -- replaces it and keeps its `before`. A worker thread turns
+ * each into a patch_delta record and appends the batch to the newest segment
+ * file about once a second, so an edit costs the UI thread neither encoding
+ * nor a write. Nothing is ever rewritten: segments are append-only, start
+ * with a header naming the record format, and the newest rolls over at
+ * kSegmentBytes. A segment in a format this build does not know is left
+ * unread and retired like any other. Once the journal passes kJournalBytes
+ * the oldest segment goes, after the records still worth keeping -- each
+ * patch's newest kPatchBytes -- are appended again at the end.
+ *
+ * Records are found through an index of where each patch's records are,
+ * built from the segments on a worker when the journal opens. A patch's
+ * records are only read and decoded when take_steps() asks for them, and
+ * only once per session: after that, or once it has been edited, the
+ * in-memory history already has them.
+ *
+ * A record torn by a crash fails its checksum and ends its segment; the
+ * newest segment is cut back to the last whole record. The browser build
+ * has no threads to spare: it indexes inline in open() and writes the queue
+ * from poll(), on the same interval.
+ */
+class EditJournal {
+public:
+  static constexpr std::size_t kSegmentBytes = 256 * 1024;
+  static constexpr std::size_t kJournalBytes = 4 * 1024 * 1024;
+  /// The newest steps of one patch that are kept and restored.
+  static constexpr std::size_t kPatchBytes = 16 * 1024;
+
+  /// One journalled edit, as take_steps() hands it back.
+  struct Step {
+    std::string label;
+    std::string merge_key;
+    /// PackedPatch hashes of the patch either side of the edit, which tell
+    /// whether the steps still lead to the patch as it was reopened.
+    std::uint64_t before_hash = 0;
+    std::uint64_t after_hash = 0;
+    /// A patch_delta from before to after.
+    std::vector<std::uint8_t> change;
+  };
+
+  EditJournal() = default;
+  ~EditJournal();
+
+  EditJournal(const EditJournal &) = delete;
+  EditJournal &operator=(const EditJournal &) = delete;
+
+  /// Journal into `directory`, creating it if needed, and start indexing
+  /// what is already there.
+  void open(std::filesystem::path directory);
+  bool is_open() const { return !directory_.empty(); }
+
+  /// Queue one edit of the patch at `before.selection_path`.
+  void append(std::string_view label, std::string_view merge_key,
+              const patches::PatchSnapshot &before,
+              const patches::PatchSnapshot &after);
+
+  /// Whether the index is built, so take_steps() can answer.
+  bool ready() const;
+
+  /**
+   * The newest kPatchBytes of steps journalled for `key` by earlier
+   * sessions, oldest first. Empty once the key has been asked for or
+   * edited this session, and while the index is still being built -- ask
+   * again once ready().
+   */
+  std::vector<Step> take_steps(const std::string &key);
+
+  /// Write the queue once it has waited the flush interval. The browser
+  /// build's stand-in for the worker; call it every frame.
+  void poll();
+
+  /// Write what is queued and join the worker. append() then does nothing.
+  void shutdown();
+
+  /// Bytes on disk across all segments; for tests.
+  std::size_t bytes_on_disk() const;
+
+private:
+  struct Pending {
+    std::string label;
+    std::string merge_key;
+    patches::PatchSnapshot before;
+    patches::PatchSnapshot after;
+  };
+
+  struct Location {
+    std::uint32_t segment = 0;
+    std::uint32_t offset = 0;
+    std::uint32_t size = 0;
+    std::uint64_t sequence = 0;
+  };
+
+  /// Forget all but the newest kPatchBytes of one patch's records; the
+  /// newest is always kept.
+  static void trim(std::vector<Location> &locations);
+
+  void run_worker();
+  void build_index();
+  /// Write and compact one batch taken off the queue.
+  void flush(std::vector<Pending> &batch);
+  void write(std::vector<Pending> &batch);
+  /// Append whole records to the newest segment, starting a new one when it
+  /// is full, and move `added` from offsets in `records` to where they went.
+  bool write_records(const std::vector<std::uint8_t> &records,
+                     std::vector<std::pair<std::string, Location>> &added);
+  /// Retire the oldest segments while the journal is over kJournalBytes.
+  void compact();
+  std::filesystem::path segment_path(std::uint32_t segment) const;
+
+  std::filesystem::path directory_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread worker_;
+  bool stopping_ = false;
+  bool index_ready_ = false;
+  std::vector<Pending> pending_;
+  /// When the oldest queued edit was appended.
+  std::chrono::steady_clock::time_point queued_at_;
+
+  /// Per patch, where its kept records are, oldest first.
+  std::unordered_map<std::string, std::vector<Location>> index_;
+  /// Segment id to its size on disk.
+  std::unordered_map<std::uint32_t, std::size_t> segments_;
+  std::uint32_t newest_segment_ = 0;
+  std::uint64_t next_sequence_ = 0;
+  /// Keys asked for or edited this session.
+  std::unordered_set<std::string> seen_;
+  /// Scratch for encoding a batch, kept to avoid allocating per write.
+  std::vector<std::uint8_t> records_;
+};
+
+} // namespace history
@@ -7,44 +7,39 @@
 #endif
 #include <imgui.h>
 #include <utility>
+#include <vector>
 
 namespace history {
 
-HistoryManager::HistoryManager(std::size_t max_entries)
-    : max_entries_(max_entries ? max_entries : 1), undo_stack_(), redo_stack_(),
-      active_transaction_() {}
+HistoryManager::HistoryManager(std::size_t budget_bytes)
+    : steps_(budget_bytes), active_transaction_() {}
 
 void HistoryManager::clear() {
-  undo_stack_.clear();
-  redo_stack_.clear();
+  steps_.clear();
   active_transaction_.reset();
+  pending_restore_.reset();
 }
 
 void HistoryManager::reset() { clear(); }
 
-bool HistoryManager::can_undo() const { return !undo_stack_.empty(); }
+bool HistoryManager::can_undo() const { return steps_.can_undo(); }
 
-bool HistoryManager::can_redo() const { return !redo_stack_.empty(); }
+bool HistoryManager::can_redo() const { return steps_.can_redo(); }
 
 std::string_view HistoryManager::undo_label() const {
-  return can_undo() ? undo_stack_.back()->label() : std::string_view{};
+  return steps_.undo_label();
 }
 
 std::string_view HistoryManager::redo_label() const {
-  return can_redo() ? redo_stack_.back()->label() : std::string_view{};
+  return steps_.redo_label();
 }
 
 void HistoryManager::undo(AppContext &app_context) {
-  if (!can_undo()) {
+  const auto snapshot = step_back();
+  if (!snapshot) {
     return;
   }
-
-  cancel_transaction();
-
-  auto entry = std::move(undo_stack_.back());
-  undo_stack_.pop_back();
-  entry->undo(app_context);
-  redo_stack_.push_back(std::move(entry));
+  app_context.services.patch_session.restore_snapshot(*snapshot);
 #if defined(MEGATOY_PLATFORM_WEB)
   platform::web::patch_url::sync_patch_to_url_if_needed(
       app_context.services.patch_session.current_patch());
@@ -52,22 +47,30 @@ void HistoryManager::undo(AppContext &app_context) {
 }
 
 void HistoryManager::redo(AppContext &app_context) {
-  if (!can_redo()) {
+  const auto snapshot = step_forward();
+  if (!snapshot) {
     return;
   }
-
-  cancel_transaction();
-
-  auto entry = std::move(redo_stack_.back());
-  redo_stack_.pop_back();
-  entry->redo(app_context);
-  undo_stack_.push_back(std::move(entry));
+  app_context.services.patch_session.restore_snapshot(*snapshot);
 #if defined(MEGATOY_PLATFORM_WEB)
   platform::web::patch_url::sync_patch_to_url_if_needed(
       app_context.services.patch_session.current_patch());
 #endif
 }
 
+std::optional<patches::PatchSnapshot> HistoryManager::step_back() {
+  cancel_transaction();
+  // The patch a waiting restore was for is no longer the one on screen.
+  pending_restore_.reset();
+  return steps_.undo();
+}
+
+std::optional<patches::PatchSnapshot> HistoryManager::step_forward() {
+  cancel_transaction();
+  pending_restore_.reset();
+  return steps_.redo();
+}
+
 void HistoryManager::handle_shortcuts(AppContext &app_context) {
   auto &io = ImGui::GetIO();
   if (io.WantTextInput) {
@@ -97,12 +100,12 @@ void HistoryManager::handle_shortcuts(AppContext &app_context) {
 }
 
 void HistoryManager::begin_transaction(std::string label, std::string merge_key,
-                                       EntryFactory factory) {
+                                       patches::PatchSnapshot before) {
   cancel_transaction();
   active_transaction_.emplace(ActiveTransaction{
       .label = std::move(label),
       .merge_key = std::move(merge_key),
-      .factory = std::move(factory),
+      .before = std::move(before),
   });
 }
 
@@ -111,18 +114,19 @@ void HistoryManager::commit_transaction(AppContext &app_context) {
     return;
   }
 
-  auto factory = std::move(active_transaction_->factory);
+  const auto transaction = std::move(*active_transaction_);
   active_transaction_.reset();
-  if (!factory) {
+  const auto after = app_context.services.patch_session.capture_snapshot();
+  if (!steps_.record(transaction.label, transaction.merge_key,
+                     transaction.before, after)) {
     return;
   }
-
-  auto entry = factory(app_context);
-  if (!entry) {
-    return;
+  if (transaction.before.selection_path == after.selection_path) {
+    journal_.append(transaction.label, transaction.merge_key,
+                    transaction.before, after);
+  } else {
+    restore_journal(after);
   }
-
-  push_entry(std::move(entry));
 #if defined(MEGATOY_PLATFORM_WEB)
   platform::web::patch_url::sync_patch_to_url_if_needed(
       app_context.services.patch_session.current_patch());
@@ -131,24 +135,67 @@ void HistoryManager::commit_transaction(AppContext &app_context) {
 
 void HistoryManager::cancel_transaction() { active_transaction_.reset(); }
 
-void HistoryManager::push_entry(std::unique_ptr<HistoryEntry> entry) {
-  if (!undo_stack_.empty() && !entry->merge_key().empty()) {
-    if (undo_stack_.back()->merge_key() == entry->merge_key()) {
-      if (undo_stack_.back()->try_merge(*entry)) {
-        redo_stack_.clear();
-        return;
-      }
-    }
-  }
+void HistoryManager::open_journal(std::filesystem::path directory) {
+  journal_.open(std::move(directory));
+}
+
+void HistoryManager::close_journal() { journal_.shutdown(); }
 
-  undo_stack_.push_back(std::move(entry));
-  redo_stack_.clear();
-  trim_to_max();
+void HistoryManager::poll() {
+  journal_.poll();
+  if (pending_restore_ && journal_.ready()) {
+    const auto current = std::move(*pending_restore_);
+    pending_restore_.reset();
+    restore_journal(current);
+  }
 }
 
-void HistoryManager::trim_to_max() {
-  while (undo_stack_.size() > max_entries_) {
-    undo_stack_.erase(undo_stack_.begin());
+void HistoryManager::restore_journal(const patches::PatchSnapshot &current) {
+  if (!journal_.is_open()) {
+    return;
+  }
+  // Indexing reads every segment; the patch waits for it rather than the
+  // frame.
+  if (!journal_.ready()) {
+    pending_restore_ = current;
+    return;
+  }
+  pending_restore_.reset();
+  const auto journalled = journal_.take_steps(current.selection_path);
+
+  // Newest first: skip what no longer ends at the patch, then follow the
+  // chain back for as long as each step ends where the next began.
+  auto expected = current.patch.packed().hash();
+  std::vector<const EditJournal::Step *> chain;
+  for (auto it = journalled.rbegin(); it != journalled.rend(); ++it) {
+    if (it->after_hash == expected) {
+      chain.push_back(&*it);
+      expected = it->before_hash;
+    } else if (!chain.empty()) {
+      break;
+    }
+  }
+  if (chain.empty()) {
+    return;
+  }
+
+  // The deltas only go from the patch as it is now, so work out every state
+  // back to the oldest before recording forward from it.
+  std::vector<patches::PatchSnapshot> states{current};
+  for (const auto *step : chain) {
+    auto earlier = states.back();
+    // A step that does not land where it was journalled from cannot be
+    // trusted, and neither can anything before it.
+    if (!patch_delta::apply(step->change, earlier,
+                            patch_delta::Direction::Backward) ||
+        earlier.patch.packed().hash() != step->before_hash) {
+      break;
+    }
+    states.push_back(std::move(earlier));
+  }
+  for (std::size_t i = states.size() - 1; i > 0; --i) {
+    const auto *step = chain[i - 1];
+    steps_.record(step->label, step->merge_key, states[i], states[i - 1]);
   }
 }
 
@@ -1,13 +1,13 @@
 #pragma once
 
-#include "history_entry.hpp"
+#include "delta_history.hpp"
+#include "edit_journal.hpp"
+#include "patches/patch_snapshot.hpp"
 #include <cstddef>
-#include <functional>
-#include <memory>
+#include <filesystem>
 #include <optional>
 #include <string>
 #include <string_view>
-#include <vector>
 
 struct AppContext;
 
@@ -15,7 +15,8 @@ namespace history {
 
 class HistoryManager {
 public:
-  explicit HistoryManager(std::size_t max_entries = 256);
+  explicit HistoryManager(
+      std::size_t budget_bytes = DeltaHistory::kDefaultBudgetBytes);
 
   void clear();
   void reset();
@@ -28,6 +29,10 @@ public:
 
   void undo(AppContext &app_context);
   void redo(AppContext &app_context);
+  /// undo() and redo() short of restoring: the snapshot to restore, or
+  /// nothing when there is no step.
+  std::optional<patches::PatchSnapshot> step_back();
+  std::optional<patches::PatchSnapshot> step_forward();
 
   /**
    * Handle keyboard shortcuts for undo/redo
@@ -35,29 +40,47 @@ public:
    */
   void handle_shortcuts(AppContext &app_context);
 
-  using EntryFactory =
-      std::function<std::unique_ptr<HistoryEntry>(AppContext &)>;
-
+  /**
+   * Start a step from `before`; commit_transaction() ends it at the
+   * session's patch as it then stands. Steps sharing a non-empty merge key
+   * fold into one, so a drag undoes in one go.
+   */
   void begin_transaction(std::string label, std::string merge_key,
-                         EntryFactory factory);
+                         patches::PatchSnapshot before);
   void commit_transaction(AppContext &app_context);
   void cancel_transaction();
 
-private:
-  void push_entry(std::unique_ptr<HistoryEntry> entry);
-  void trim_to_max();
+  /// Keep every patch's edits in `directory` across sessions.
+  void open_journal(std::filesystem::path directory);
+  /// Write out the journal's queued edits; called on exit.
+  void close_journal();
+  /**
+   * Put back what earlier sessions journalled for the patch `current` was
+   * loaded from, as steps after the newest. Only the steps that lead to the
+   * patch as it is now are kept: edits that were never saved are not.
+   * While the journal is still indexing, poll() does it once it is done.
+   */
+  void restore_journal(const patches::PatchSnapshot &current);
+  /// Whether a restore_journal() is waiting for the journal's index.
+  bool restore_pending() const { return pending_restore_.has_value(); }
+  /// Finish a waiting restore_journal() and write the journal's queue where
+  /// there is no worker to. Call it every frame.
+  void poll();
 
-  std::size_t max_entries_;
-  std::vector<std::unique_ptr<HistoryEntry>> undo_stack_;
-  std::vector<std::unique_ptr<HistoryEntry>> redo_stack_;
+private:
+  DeltaHistory steps_;
+  EditJournal journal_;
 
   struct ActiveTransaction {
     std::string label;
     std::string merge_key;
-    EntryFactory factory;
+    patches::PatchSnapshot before;
   };
 
   std::optional<ActiveTransaction> active_transaction_;
+  /// The patch restore_journal() was last asked about before the journal
+  /// could answer.
+  std::optional<patches::PatchSnapshot> pending_restore_;
 };
 
 } // namespace history
@@ -0,0 +1,180 @@
+#include "patch_delta.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+namespace history::patch_delta {
+
+namespace {
+
+constexpr std::size_t kPatchFields = 9 + 4 * 13;
+/// Both patches' settings, then the four strings.
+constexpr std::size_t kNumberFields = 2 * kPatchFields;
+constexpr std::size_t kStringFields = 4;
+
+using Numbers = std::array<std::uint8_t, kNumberFields>;
+
+/// Calls `visit` on every setting of `patch`, in field order.
+template <typename PatchT, typename Visit>
+void visit_settings(PatchT &patch, Visit &&visit) {
+  visit(patch.global.dac_enable);
+  visit(patch.global.lfo_enable);
+  visit(patch.global.lfo_frequency);
+  visit(patch.channel.left_speaker);
+  visit(patch.channel.right_speaker);
+  visit(patch.channel.amplitude_modulation_sensitivity);
+  visit(patch.channel.frequency_modulation_sensitivity);
+  visit(patch.instrument.feedback);
+  visit(patch.instrument.algorithm);
+  for (auto &op : patch.instrument.operators) {
+    visit(op.attack_rate);
+    visit(op.decay_rate);
+    visit(op.sustain_rate);
+    visit(op.release_rate);
+    visit(op.sustain_level);
+    visit(op.total_level);
+    visit(op.key_scale);
+    visit(op.multiple);
+    visit(op.detune);
+    visit(op.ssg_type_envelope_control);
+    visit(op.ssg_enable);
+    visit(op.amplitude_modulation_enable);
+    visit(op.enable);
+  }
+}
+
+Numbers numbers(const patches::PatchSnapshot &snapshot) {
+  Numbers values{};
+  std::size_t index = 0;
+  const auto read = [&](const auto &field) {
+    values[index++] = static_cast<std::uint8_t>(field);
+  };
+  visit_settings(snapshot.patch, read);
+  visit_settings(snapshot.original_patch, read);
+  return values;
+}
+
+void set_numbers(const Numbers &values, patches::PatchSnapshot &snapshot) {
+  std::size_t index = 0;
+  const auto write = [&](auto &field) {
+    using Field = std::remove_reference_t<decltype(field)>;
+    if constexpr (std::is_same_v<Field, bool>) {
+      field = values[index++] != 0;
+    } else {
+      field = static_cast<Field>(values[index++]);
+    }
+  };
+  visit_settings(snapshot.patch, write);
+  visit_settings(snapshot.original_patch, write);
+}
+
+std::array<const std::string *, kStringFields>
+strings(const patches::PatchSnapshot &snapshot) {
+  return {&snapshot.patch.name, &snapshot.original_patch.name, &snapshot.path,
+          &snapshot.selection_path};
+}
+
+std::array<std::string *, kStringFields>
+strings(patches::PatchSnapshot &snapshot) {
+  return {&snapshot.patch.name, &snapshot.original_patch.name, &snapshot.path,
+          &snapshot.selection_path};
+}
+
+void append_string(const std::string &text, std::vector<std::uint8_t> &out) {
+  append_varint(text.size(), out);
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+bool read_string(std::span<const std::uint8_t> bytes, std::size_t &offset,
+                 std::string *text) {
+  std::uint64_t size = 0;
+  if (!read_varint(bytes, offset, size) || size > bytes.size() - offset) {
+    return false;
+  }
+  if (text != nullptr) {
+    text->assign(reinterpret_cast<const char *>(bytes.data() + offset),
+                 static_cast<std::size_t>(size));
+  }
+  offset += static_cast<std::size_t>(size);
+  return true;
+}
+
+} // namespace
+
+void append(const patches::PatchSnapshot &from,
+            const patches::PatchSnapshot &to, std::vector<std::uint8_t> &out) {
+  const auto before = numbers(from);
+  const auto after = numbers(to);
+  for (std::size_t field = 0; field < kNumberFields; ++field) {
+    if (before[field] != after[field]) {
+      out.push_back(static_cast<std::uint8_t>(field));
+      out.push_back(before[field]);
+      out.push_back(after[field]);
+    }
+  }
+  const auto old_strings = strings(from);
+  const auto new_strings = strings(to);
+  for (std::size_t s = 0; s < kStringFields; ++s) {
+    if (*old_strings[s] != *new_strings[s]) {
+      out.push_back(static_cast<std::uint8_t>(kNumberFields + s));
+      append_string(*old_strings[s], out);
+      append_string(*new_strings[s], out);
+    }
+  }
+}
+
+bool apply(std::span<const std::uint8_t> delta,
+           patches::PatchSnapshot &snapshot, Direction direction) {
+  const bool forward = direction == Direction::Forward;
+  auto values = numbers(snapshot);
+  const auto text = strings(snapshot);
+  std::size_t offset = 0;
+  bool ok = true;
+  while (ok && offset < delta.size()) {
+    const std::size_t field = delta[offset++];
+    if (field < kNumberFields) {
+      if (delta.size() - offset < 2) {
+        ok = false;
+        break;
+      }
+      values[field] = delta[offset + (forward ? 1 : 0)];
+      offset += 2;
+    } else if (field < kNumberFields + kStringFields) {
+      auto *target = text[field - kNumberFields];
+      ok = read_string(delta, offset, forward ? nullptr : target) &&
+           read_string(delta, offset, forward ? target : nullptr);
+    } else {
+      ok = false;
+    }
+  }
+  set_numbers(values, snapshot);
+  return ok;
+}
+
+void append_varint(std::uint64_t value, std::vector<std::uint8_t> &out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+bool read_varint(std::span<const std::uint8_t> bytes, std::size_t &offset,
+                 std::uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (offset >= bytes.size()) {
+      return false;
+    }
+    const auto byte = bytes[offset++];
+    value |= std::uint64_t{byte & 0x7Fu} << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace history::patch_delta
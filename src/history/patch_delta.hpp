@@ -0,0 +1,44 @@
+#pragma once
+
+#include "patches/patch_snapshot.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace history {
+
+/**
+ * The difference between two patch snapshots, as the fields that changed.
+ *
+ * Every setting of both patches is one byte-sized field, so a slider drag
+ * encodes as three bytes -- which field, its old value, its new value --
+ * and only names and paths cost more. The same bytes undo and redo: applied
+ * backward, each field takes its old value.
+ *
+ * formats::json_delta could say the same, but builds and parses JSON for
+ * every edit; this is what the undo history stores by the thousand.
+ */
+namespace patch_delta {
+
+enum class Direction { Backward, Forward };
+
+/// Append to `out` the fields where `to` differs from `from`.
+void append(const patches::PatchSnapshot &from,
+            const patches::PatchSnapshot &to, std::vector<std::uint8_t> &out);
+
+/**
+ * Set every field in `delta` to its old (Backward) or new (Forward) value.
+ * False, with `snapshot` partly changed, when `delta` is malformed.
+ */
+bool apply(std::span<const std::uint8_t> delta,
+           patches::PatchSnapshot &snapshot, Direction direction);
+
+/// Append `value` as a LEB128 varint.
+void append_varint(std::uint64_t value, std::vector<std::uint8_t> &out);
+/// Read a varint at `offset`, advancing it; false when it runs off the end.
+bool read_varint(std::span<const std::uint8_t> bytes, std::size_t &offset,
+                 std::uint64_t &value);
+
+} // namespace patch_delta
+
+} // namespace history
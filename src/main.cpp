@@ -90,6 +90,7 @@ bool run_frame(RuntimeContext &runtime) {
   runtime.midi->dispatch(*runtime.app_context);
 
   services.gui_manager.begin_frame();
+  services.history.poll();
   services.history.handle_shortcuts(*runtime.app_context);
   ui::render_all(*runtime.app_context);
   const auto &saved_prefs = services.preference_manager.ui_preferences();
@@ -112,6 +113,14 @@ bool run_frame(RuntimeContext &runtime) {
     services.audio_manager.set_performance_options(current_prefs.use_pitch_bend,
                                                    current_prefs.use_mod_wheel);
   }
+  if (current_prefs.match_loudness != saved_prefs.match_loudness) {
+    services.patch_session.set_loudness_matching(current_prefs.match_loudness);
+  }
+  // Measured ahead of browsing, so a patch's level is known before its
+  // first note.
+  if (current_prefs.match_loudness) {
+    services.patch_session.update_sound_index(true);
+  }
   services.preference_manager.set_ui_preferences(app_state.ui_state().prefs);
   services.gui_manager.end_frame();
   return true;
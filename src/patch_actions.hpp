@@ -5,7 +5,6 @@
 #include "app_state.hpp"
 #include "core/status.hpp"
 #include "history/history_manager.hpp"
-#include "history/snapshot_entry.hpp"
 #include "patches/patch_session.hpp"
 #include <filesystem>
 #include <iostream>
@@ -14,36 +13,30 @@
 namespace patch_actions {
 namespace detail {
 inline void record_change(AppContext &context, const std::string &label,
-                          const patches::PatchSession::PatchSnapshot &before,
-                          const patches::PatchSession::PatchSnapshot &after) {
-  context.services.history.begin_transaction(
-      label, {}, [label, before, after](AppContext &ctx) {
-        return history::make_snapshot_entry<
-            patches::PatchSession::PatchSnapshot>(
-            label, std::string{}, before, after,
-            [](AppContext &ctx,
-               const patches::PatchSession::PatchSnapshot &snapshot) {
-              ctx.services.patch_session.restore_snapshot(snapshot);
-              std::cout << "Patch restored" << std::endl;
-            });
-      });
+                          const patches::PatchSession::PatchSnapshot &before) {
+  context.services.history.begin_transaction(label, {}, before);
   context.services.history.commit_transaction(context);
 }
-} // namespace detail
 
-inline bool load(AppContext &context, const patches::PatchEntry &patch_info) {
+inline void apply_loaded(AppContext &context, const patches::PatchEntry &entry,
+                         const ym2612::Patch &patch) {
   auto &patch_session = context.services.patch_session;
   const auto before = patch_session.capture_snapshot();
+  patch_session.adopt_loaded_patch(entry, patch);
+  record_change(context, "Load: " + entry.name, before);
+  patch_session.mark_as_clean();
+  std::cout << "Loaded preset patch: " << entry.name << std::endl;
+}
+} // namespace detail
 
-  if (!patch_session.load_patch_from_entry(patch_info)) {
+inline bool load(AppContext &context, const patches::PatchEntry &patch_info) {
+  ym2612::Patch patch;
+  if (!context.services.patch_session.repository().load_patch(patch_info,
+                                                              patch)) {
     megatoy::status::error("Failed to load \"" + patch_info.name + "\"");
     return false;
   }
-
-  const auto after = patch_session.capture_snapshot();
-  detail::record_change(context, "Load: " + patch_info.name, before, after);
-  patch_session.mark_as_clean();
-  std::cout << "Loaded preset patch: " << patch_info.name << std::endl;
+  detail::apply_loaded(context, patch_info, patch);
   return true;
 }
 
@@ -54,8 +47,31 @@ inline void safe_load(AppContext &context,
     context.state.ui_state().confirmation_state =
         UIState::ConfirmationState::load(preset_info);
   } else {
-    load(context, preset_info);
+    // The browser never waits on the disk; poll_load() applies the patch
+    // when it arrives.
+    patch_session.request_patch_load(preset_info);
+  }
+}
+
+/// Apply the browser's finished load, if one arrived. Called every frame.
+inline void poll_load(AppContext &context) {
+  auto &patch_session = context.services.patch_session;
+  auto loaded = patch_session.take_loaded_patch();
+  if (!loaded) {
+    return;
+  }
+  const auto &entry = loaded->entry;
+  if (!loaded->patch) {
+    megatoy::status::error("Failed to load \"" + entry.name + "\"");
+    return;
+  }
+  // The current patch was edited while the file was loading.
+  if (patch_session.is_modified()) {
+    context.state.ui_state().confirmation_state =
+        UIState::ConfirmationState::load(entry);
+    return;
   }
+  detail::apply_loaded(context, entry, *loaded->patch);
 }
 
 inline void load_dropped_patch(AppContext &context, const ym2612::Patch &patch,
@@ -63,9 +79,8 @@ inline void load_dropped_patch(AppContext &context, const ym2612::Patch &patch,
   auto &patch_session = context.services.patch_session;
   const auto before = patch_session.capture_snapshot();
   patch_session.set_current_patch(patch, source_path);
-  const auto after = patch_session.capture_snapshot();
   detail::record_change(context, "Load: " + source_path.filename().string(),
-                        before, after);
+                        before);
 }
 
 } // namespace patch_actions
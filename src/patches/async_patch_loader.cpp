@@ -0,0 +1,220 @@
+#include "async_patch_loader.hpp"
+
+#include "platform/platform_config.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace patches {
+
+AsyncPatchLoader::AsyncPatchLoader(platform::VirtualFileSystem &vfs)
+    : vfs_(vfs) {}
+
+AsyncPatchLoader::~AsyncPatchLoader() { shutdown(); }
+
+void AsyncPatchLoader::request(const PatchEntry &entry, LoadFunction load) {
+  if (!load) {
+    return;
+  }
+#if defined(MEGATOY_PLATFORM_WEB)
+  Job job{entry, std::move(load), ++latest_ticket_};
+  auto patch = load_now(job);
+  done_ = Result{std::move(job.entry), std::move(patch)};
+  awaiting_ = true;
+#else
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    return;
+  }
+  job_ = Job{entry, std::move(load), ++latest_ticket_};
+  done_.reset();
+  awaiting_ = true;
+  start_worker_locked();
+  wake_.notify_one();
+#endif
+}
+
+void AsyncPatchLoader::cancel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++latest_ticket_;
+  job_.reset();
+  done_.reset();
+  awaiting_ = false;
+}
+
+bool AsyncPatchLoader::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return awaiting_;
+}
+
+std::optional<AsyncPatchLoader::Result> AsyncPatchLoader::poll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!done_) {
+    return std::nullopt;
+  }
+  auto result = std::move(done_);
+  done_.reset();
+  awaiting_ = false;
+  return result;
+}
+
+bool AsyncPatchLoader::is_neighbourhood(
+    const std::vector<const PatchEntry *> &entries) const {
+#if defined(MEGATOY_PLATFORM_WEB)
+  // Prefetching is off, so nothing would change.
+  (void)entries;
+  return true;
+#else
+  const auto wanted = prefetchable(entries);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::equal(wanted.begin(), wanted.end(), neighbourhood_.begin(),
+                    neighbourhood_.end(),
+                    [](const PatchEntry *entry, const std::string &path) {
+                      return entry->relative_path == path;
+                    });
+#endif
+}
+
+void AsyncPatchLoader::prefetch(const std::vector<const PatchEntry *> &entries,
+                                LoadFunction load) {
+#if defined(MEGATOY_PLATFORM_WEB)
+  (void)entries;
+  (void)load;
+#else
+  const auto wanted = prefetchable(entries);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_ || !load) {
+    return;
+  }
+
+  neighbourhood_.clear();
+  prefetch_queue_.clear();
+  for (const auto *entry : wanted) {
+    neighbourhood_.push_back(entry->relative_path);
+    prefetch_queue_.push_back(Job{*entry, load, 0});
+  }
+  std::erase_if(prefetched_, [this](const auto &slot) {
+    return std::find(neighbourhood_.begin(), neighbourhood_.end(),
+                     slot.first) == neighbourhood_.end();
+  });
+  if (!prefetch_queue_.empty()) {
+    start_worker_locked();
+    wake_.notify_one();
+  }
+#endif
+}
+
+std::size_t AsyncPatchLoader::prefetched_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return prefetched_.size();
+}
+
+void AsyncPatchLoader::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    job_.reset();
+    prefetch_queue_.clear();
+  }
+  wake_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+std::vector<const PatchEntry *> AsyncPatchLoader::prefetchable(
+    const std::vector<const PatchEntry *> &entries) {
+  std::vector<const PatchEntry *> wanted;
+  for (const auto *entry : entries) {
+    if (wanted.size() == kMaxPrefetched) {
+      break;
+    }
+    if (entry != nullptr && !entry->is_directory) {
+      wanted.push_back(entry);
+    }
+  }
+  return wanted;
+}
+
+AsyncPatchLoader::Stamp
+AsyncPatchLoader::stamp_of(const PatchEntry &entry) const {
+  Stamp stamp;
+  stamp.valid = vfs_.file_size(entry.full_path, stamp.file_size) &&
+                vfs_.last_write_time(entry.full_path, stamp.modified);
+  return stamp;
+}
+
+std::optional<ym2612::Patch> AsyncPatchLoader::load_now(const Job &job) {
+  const auto stamp = stamp_of(job.entry);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto prefetched = prefetched_.find(job.entry.relative_path);
+    if (prefetched != prefetched_.end() && prefetched->second.stamp == stamp) {
+      return prefetched->second.patch;
+    }
+  }
+  ym2612::Patch patch;
+  if (!job.load(job.entry, patch)) {
+    return std::nullopt;
+  }
+  return patch;
+}
+
+void AsyncPatchLoader::start_worker_locked() {
+  if (!worker_.joinable() && !stopping_) {
+    worker_ = std::thread([this] { run_worker(); });
+  }
+}
+
+void AsyncPatchLoader::run_worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] {
+      return stopping_ || job_ || !prefetch_queue_.empty();
+    });
+    if (stopping_) {
+      return;
+    }
+
+    // Requests always go before prefetching; a prefetch in progress is
+    // the most a request waits for.
+    if (job_) {
+      auto job = std::move(*job_);
+      job_.reset();
+      lock.unlock();
+      auto patch = load_now(job);
+      lock.lock();
+      if (job.ticket == latest_ticket_) {
+        done_ = Result{std::move(job.entry), std::move(patch)};
+      }
+      continue;
+    }
+
+    auto next = std::move(prefetch_queue_.front());
+    prefetch_queue_.pop_front();
+    const auto &path = next.entry.relative_path;
+    lock.unlock();
+    const auto stamp = stamp_of(next.entry);
+    lock.lock();
+    // Files that cannot be stamped cannot be revalidated, so they are only
+    // ever loaded on request.
+    if (!stamp.valid) {
+      continue;
+    }
+    if (const auto existing = prefetched_.find(path);
+        existing != prefetched_.end() && existing->second.stamp == stamp) {
+      continue;
+    }
+    lock.unlock();
+    ym2612::Patch patch;
+    const bool loaded = next.load(next.entry, patch);
+    lock.lock();
+    const bool still_wanted =
+        std::find(neighbourhood_.begin(), neighbourhood_.end(), path) !=
+        neighbourhood_.end();
+    if (loaded && still_wanted) {
+      prefetched_.insert_or_assign(path, Prefetched{stamp, std::move(patch)});
+    }
+  }
+}
+
+} // namespace patches
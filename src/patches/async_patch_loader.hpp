@@ -0,0 +1,130 @@
+#pragma once
+
+#include "patch_repository.hpp"
+#include "platform/virtual_file_system.hpp"
+#include "ym2612/patch.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace patches {
+
+/**
+ * Loads the patches the browser asks for on a worker thread, so a slow disk
+ * or a large bank no longer stalls the frame that clicked it.
+ *
+ * Only the newest request counts. A request replaces one that has not
+ * started yet, and the result of one overtaken while it was running is
+ * dropped instead of delivered, so a burst of clicks ends on the last patch
+ * clicked and nothing in between flashes into the editor.
+ *
+ * Between requests the worker prefetches the entries the browser reports as
+ * neighbours of the current one. Each is kept decoded, stamped with its
+ * file's size and modification time, until it leaves the neighbourhood; a
+ * request for one that is still current skips the load entirely. Loading
+ * also fills DecodedContainerCache, so a prefetched bank is parsed once.
+ *
+ * All members are UI-thread-only; the load functions run on the worker and
+ * must be safe there, which PatchRepository::detached_loader() is. The
+ * browser build has no threads to spare: there request() loads inline,
+ * poll() hands the result back and prefetch() does nothing.
+ */
+class AsyncPatchLoader {
+public:
+  using LoadFunction = PatchRepository::PatchLoader;
+
+  struct Result {
+    PatchEntry entry;
+    /// Empty when the load failed.
+    std::optional<ym2612::Patch> patch;
+  };
+
+  /// Upper bound on the neighbourhood kept decoded.
+  static constexpr std::size_t kMaxPrefetched = 16;
+
+  explicit AsyncPatchLoader(platform::VirtualFileSystem &vfs);
+  ~AsyncPatchLoader();
+
+  AsyncPatchLoader(const AsyncPatchLoader &) = delete;
+  AsyncPatchLoader &operator=(const AsyncPatchLoader &) = delete;
+
+  /// Load `entry`, superseding any request still pending.
+  void request(const PatchEntry &entry, LoadFunction load);
+  /// Forget the pending request, if any; its result will not be delivered.
+  void cancel();
+  /// True from request() until its result is taken or superseded.
+  bool pending() const;
+  /// The newest request's result, once, when it is ready.
+  std::optional<Result> poll();
+
+  /**
+   * Replace the neighbourhood to keep decoded, nearest first. Entries
+   * already prefetched and still listed are kept; the rest are dropped.
+   */
+  void prefetch(const std::vector<const PatchEntry *> &entries,
+                LoadFunction load);
+  /// Whether prefetch(entries) would change nothing; cheap enough to ask
+  /// every frame.
+  bool is_neighbourhood(const std::vector<const PatchEntry *> &entries) const;
+  std::size_t prefetched_count() const;
+
+  /// Stop and join the worker. Further requests are ignored.
+  void shutdown();
+
+private:
+  struct Stamp {
+    std::uintmax_t file_size = 0;
+    std::filesystem::file_time_type modified;
+    bool valid = false;
+
+    bool operator==(const Stamp &other) const {
+      return valid && other.valid && file_size == other.file_size &&
+             modified == other.modified;
+    }
+  };
+
+  struct Job {
+    PatchEntry entry;
+    LoadFunction load;
+    std::uint64_t ticket = 0;
+  };
+
+  struct Prefetched {
+    Stamp stamp;
+    ym2612::Patch patch;
+  };
+
+  static std::vector<const PatchEntry *>
+  prefetchable(const std::vector<const PatchEntry *> &entries);
+  Stamp stamp_of(const PatchEntry &entry) const;
+  std::optional<ym2612::Patch> load_now(const Job &job);
+  void start_worker_locked();
+  void run_worker();
+
+  platform::VirtualFileSystem &vfs_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread worker_;
+  bool stopping_ = false;
+
+  std::optional<Job> job_;
+  std::uint64_t latest_ticket_ = 0;
+  std::optional<Result> done_;
+  bool awaiting_ = false;
+
+  /// Relative paths of the current neighbourhood, in priority order.
+  std::vector<std::string> neighbourhood_;
+  std::deque<Job> prefetch_queue_;
+  std::unordered_map<std::string, Prefetched> prefetched_;
+};
+
+} // namespace patches
@@ -5,8 +5,15 @@
 #include "patches/filesystem_patch_storage.hpp"
 #include "patches/patch_repository.hpp"
 #include "platform/std_file_system.hpp"
+#include "platform/zip_file_system.hpp"
+#include "workspace/workspace.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -15,16 +22,115 @@ namespace patches::background_folder_scan {
 
 namespace {
 
-struct ActiveScan {
+struct Job {
   std::filesystem::path folder;
   std::string folder_name;
+  Priority priority = Priority::Normal;
   ScanProgress progress;
   std::function<void(bool cancelled)> on_complete;
-  std::thread worker;
+  PersistentParseCache *cache = nullptr;
+  /// Handed to the workers; UI thread only.
+  bool started = false;
 };
 
 PersistentParseCache *g_cache = nullptr;
-std::unique_ptr<ActiveScan> g_active_scan;
+std::size_t g_max_workers = kDefaultMaxWorkers;
+/// Queued and running folders, in the order they were queued.
+std::vector<std::unique_ptr<Job>> g_jobs;
+
+/**
+ * Workers that outlive the folders they scan: one is started per free slot
+ * the first time it is needed and then takes folder after folder, so a batch
+ * of dropped libraries does not cost a thread each. A job handed over stays
+ * owned by g_jobs; its worker lets go of it once `finished` is set.
+ */
+struct Pool {
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Job *> ready;
+  std::vector<std::thread> workers;
+  bool stopping = false;
+};
+Pool g_pool;
+
+void run_worker() {
+  std::unique_lock lock(g_pool.mutex);
+  while (true) {
+    g_pool.wake.wait(
+        lock, [] { return g_pool.stopping || !g_pool.ready.empty(); });
+    // Started folders are still run when stopping, cancelled, so each one
+    // sets `finished`.
+    if (g_pool.ready.empty()) {
+      return;
+    }
+    Job *job = g_pool.ready.front();
+    g_pool.ready.pop_front();
+    lock.unlock();
+    scan_and_warm(job->folder, job->folder_name, job->cache, job->progress);
+    lock.lock();
+  }
+}
+
+void stop_workers() {
+  {
+    std::lock_guard lock(g_pool.mutex);
+    g_pool.stopping = true;
+  }
+  g_pool.wake.notify_all();
+  for (auto &worker : g_pool.workers) {
+    worker.join();
+  }
+  g_pool.workers.clear();
+  g_pool.stopping = false;
+}
+
+/// What the folders finished in this batch contributed to Status.
+struct Batch {
+  std::size_t folders_total = 0;
+  std::size_t folders_finished = 0;
+  std::size_t files_seen = 0;
+  std::size_t containers_parsed = 0;
+};
+Batch g_batch;
+
+bool is_running(const Job &job) { return job.started; }
+
+Job *find_job(const std::filesystem::path &folder) {
+  for (auto &job : g_jobs) {
+    if (job->folder == folder) {
+      return job.get();
+    }
+  }
+  return nullptr;
+}
+
+/// The queued folder to start next: highest priority, then oldest.
+Job *next_queued() {
+  Job *next = nullptr;
+  for (auto &job : g_jobs) {
+    if (is_running(*job)) {
+      continue;
+    }
+    if (next == nullptr || job->priority > next->priority) {
+      next = job.get();
+    }
+  }
+  return next;
+}
+
+void start(Job &job, std::size_t running) {
+  job.started = true;
+  job.cache = g_cache;
+  {
+    std::lock_guard lock(g_pool.mutex);
+    g_pool.ready.push_back(&job);
+  }
+  // Every started folder has a worker of its own to run on.
+  if (g_pool.workers.size() < running) {
+    g_pool.workers.emplace_back(run_worker);
+  }
+  g_pool.wake.notify_one();
+}
 
 std::string folder_display_name(const std::filesystem::path &folder) {
   auto name = folder.filename().string();
@@ -44,9 +150,15 @@ void scan_and_warm(const std::filesystem::path &folder,
                    std::string_view root_label, PersistentParseCache *cache,
                    ScanProgress &progress) {
   platform::StdFileSystem file_system;
-  FilesystemPatchStorage storage(file_system, folder, std::string(root_label),
-                                 /*writable=*/true, /*enable_metadata=*/false,
-                                 cache);
+  std::optional<platform::ZipFileSystem> archive;
+  if (megatoy::workspace::is_archive(folder)) {
+    archive.emplace(folder);
+  }
+  FilesystemPatchStorage storage(
+      archive ? static_cast<platform::VirtualFileSystem &>(*archive)
+              : file_system,
+      folder, std::string(root_label), /*writable=*/!archive,
+      /*enable_metadata=*/false, cache);
   FilesystemPatchStorage::ScanObserver observer;
   observer.on_file = [&progress, &storage](const std::filesystem::path &) {
     progress.files_seen.fetch_add(1, std::memory_order_relaxed);
@@ -66,75 +178,131 @@ void scan_and_warm(const std::filesystem::path &folder,
   progress.finished.store(true, std::memory_order_release);
 }
 
-void configure(PersistentParseCache *cache) { g_cache = cache; }
+void configure(PersistentParseCache *cache, std::size_t max_workers) {
+  g_cache = cache;
+  g_max_workers = std::max<std::size_t>(max_workers, 1);
+}
 
 bool begin(const std::filesystem::path &folder,
-           std::function<void(bool cancelled)> on_complete) {
-  if (g_active_scan) {
+           std::function<void(bool cancelled)> on_complete,
+           Priority priority) {
+  if (find_job(folder) != nullptr) {
     return false;
   }
+  if (g_jobs.empty()) {
+    g_batch = {};
+  }
 
-  auto scan = std::make_unique<ActiveScan>();
-  scan->folder = folder;
-  scan->folder_name = folder_display_name(folder);
-  scan->on_complete = std::move(on_complete);
-
-  auto *raw = scan.get();
-  g_active_scan = std::move(scan);
-  g_active_scan->worker = std::thread([raw, cache = g_cache] {
-    scan_and_warm(raw->folder, raw->folder_name, cache, raw->progress);
-  });
+  auto job = std::make_unique<Job>();
+  job->folder = folder;
+  job->folder_name = folder_display_name(folder);
+  job->priority = priority;
+  job->on_complete = std::move(on_complete);
+  g_jobs.push_back(std::move(job));
+  ++g_batch.folders_total;
   return true;
 }
 
 Status status() {
   Status result;
-  if (!g_active_scan) {
+  if (g_jobs.empty()) {
     return result;
   }
   result.active = true;
-  result.files_seen =
-      g_active_scan->progress.files_seen.load(std::memory_order_relaxed);
-  result.containers_parsed =
-      g_active_scan->progress.containers_parsed.load(std::memory_order_relaxed);
-  result.folder_name = g_active_scan->folder_name;
+  result.files_seen = g_batch.files_seen;
+  result.containers_parsed = g_batch.containers_parsed;
+  result.folders_total = g_batch.folders_total;
+  result.folders_finished = g_batch.folders_finished;
+
+  for (const bool running : {true, false}) {
+    for (const auto &job : g_jobs) {
+      if (is_running(*job) != running) {
+        continue;
+      }
+      const auto files =
+          job->progress.files_seen.load(std::memory_order_relaxed);
+      result.files_seen += files;
+      result.containers_parsed +=
+          job->progress.containers_parsed.load(std::memory_order_relaxed);
+      result.folders.push_back(
+          FolderStatus{job->folder, job->folder_name, running, files});
+    }
+  }
+  result.folder_name = result.folders.front().folder_name;
   return result;
 }
 
 void request_cancel() {
-  if (g_active_scan) {
-    g_active_scan->progress.cancel.store(true, std::memory_order_relaxed);
+  for (auto &job : g_jobs) {
+    job->progress.cancel.store(true, std::memory_order_relaxed);
   }
 }
 
+bool cancel(const std::filesystem::path &folder) {
+  auto *job = find_job(folder);
+  if (job == nullptr) {
+    return false;
+  }
+  job->progress.cancel.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+bool prioritize(const std::filesystem::path &folder) {
+  auto *job = find_job(folder);
+  if (job == nullptr || is_running(*job)) {
+    return false;
+  }
+  job->priority = Priority::Visible;
+  return true;
+}
+
 void poll_completion() {
-  if (!g_active_scan ||
-      !g_active_scan->progress.finished.load(std::memory_order_acquire)) {
-    return;
+  // Take every finished folder out of the list before any callback runs:
+  // they are on the UI thread and may well queue the next scan. A folder
+  // cancelled before it started is finished too; it simply never ran.
+  std::vector<std::unique_ptr<Job>> finished;
+  for (auto &job : g_jobs) {
+    const bool done =
+        is_running(*job)
+            ? job->progress.finished.load(std::memory_order_acquire)
+            : job->progress.cancel.load(std::memory_order_relaxed);
+    if (done) {
+      finished.push_back(std::move(job));
+    }
   }
+  std::erase(g_jobs, nullptr);
 
-  // Clear the slot before the callback runs: it is on the UI thread and may
-  // well start the next scan.
-  auto finished = std::move(g_active_scan);
-  g_active_scan.reset();
-  if (finished->worker.joinable()) {
-    finished->worker.join();
+  for (auto &job : finished) {
+    ++g_batch.folders_finished;
+    g_batch.files_seen +=
+        job->progress.files_seen.load(std::memory_order_relaxed);
+    g_batch.containers_parsed +=
+        job->progress.containers_parsed.load(std::memory_order_relaxed);
   }
-  if (finished->on_complete) {
-    finished->on_complete(
-        finished->progress.cancel.load(std::memory_order_relaxed));
+
+  auto running = static_cast<std::size_t>(
+      std::count_if(g_jobs.begin(), g_jobs.end(),
+                    [](const auto &job) { return is_running(*job); }));
+  for (; running < g_max_workers; ++running) {
+    auto *next = next_queued();
+    if (next == nullptr) {
+      break;
+    }
+    start(*next, running + 1);
+  }
+
+  for (auto &job : finished) {
+    if (job->on_complete) {
+      job->on_complete(job->progress.cancel.load(std::memory_order_relaxed));
+    }
   }
 }
 
 void shutdown() {
-  if (!g_active_scan) {
-    return;
-  }
-  g_active_scan->progress.cancel.store(true, std::memory_order_relaxed);
-  if (g_active_scan->worker.joinable()) {
-    g_active_scan->worker.join();
-  }
-  g_active_scan.reset();
+  request_cancel();
+  stop_workers();
+  g_jobs.clear();
+  g_batch = {};
 }
 
 } // namespace patches::background_folder_scan
@@ -10,27 +10,32 @@
 #include <functional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace patches {
 
 class PersistentParseCache;
 
 /**
- * Parse a folder the user just picked on a worker thread, before it joins the
- * workspace.
+ * Parse folders the user just picked or dropped on worker threads, before
+ * they join the workspace.
  *
- * The worker shares no storage and no tree with the UI: all it does is warm
+ * A worker shares no storage and no tree with the UI: all it does is warm
  * the persistent parse cache. Once it is done the folder is added normally
  * and the ordinary synchronous sync walks it again -- every container is a
  * cache hit by then, so that walk is cheap. Without this, adding a folder of
  * a few thousand banks froze the app for the whole first parse.
  *
+ * Several folders may be queued at once -- dropping a handful of libraries is
+ * one gesture -- and run side by side on a small bounded pool rather than
+ * one after another. The workers are kept and reused from folder to folder.
+ * Each folder is cancelled on its own.
+ *
  * Desktop only: the browser has no folder to point at (it imports a copy
  * instead) and no threads to spare.
  *
- * `configure`, `begin`, `status`, `request_cancel`, `poll_completion` and
- * `shutdown` are UI-thread-only; the worker touches nothing but ScanProgress
- * and the cache's own locked interface.
+ * Everything but `scan_and_warm` is UI-thread-only; the workers touch nothing
+ * but their own ScanProgress and the cache's locked interface.
  */
 namespace background_folder_scan {
 
@@ -41,15 +46,9 @@ struct ScanProgress {
   std::atomic<bool> finished{false};
 };
 
-struct Status {
-  bool active = false;
-  std::size_t files_seen = 0;
-  std::size_t containers_parsed = 0;
-  std::string folder_name;
-};
-
 /**
- * Walk `folder` and store every container it holds in `cache`.
+ * Walk `folder` and store every container it holds in `cache`. A .zip
+ * archive is walked in place, as the workspace will mount it.
  *
  * Synchronous and self-contained -- the thread wrapper below is the only
  * reason it is not called directly.
@@ -64,25 +63,79 @@ void scan_and_warm(const std::filesystem::path &folder,
                    std::string_view root_label, PersistentParseCache *cache,
                    ScanProgress &progress);
 
-/// Cache every later scan warms. Called once at app init.
-void configure(PersistentParseCache *cache);
+/// Folders scanned at once unless configure() says otherwise.
+constexpr std::size_t kDefaultMaxWorkers = 4;
+
+/**
+ * Order in which queued folders get a worker. Within one priority, folders
+ * start in the order they were queued.
+ */
+enum class Priority {
+  Normal,
+  /// The folder the user is looking at, e.g. the one they just picked.
+  Visible,
+};
+
+/// One queued or running folder, for the progress dialog.
+struct FolderStatus {
+  std::filesystem::path folder;
+  std::string folder_name;
+  bool running = false;
+  std::size_t files_seen = 0;
+};
+
+/**
+ * Progress over the current batch: every folder queued since the scheduler
+ * was last idle. Finished folders keep counting until the batch drains, so
+ * the totals never run backwards while the dialog is up.
+ */
+struct Status {
+  bool active = false;
+  std::size_t files_seen = 0;
+  std::size_t containers_parsed = 0;
+  /// The first running folder, or the next queued one.
+  std::string folder_name;
+  std::size_t folders_total = 0;
+  std::size_t folders_finished = 0;
+  /// Queued and running folders, running ones first.
+  std::vector<FolderStatus> folders;
+};
 
 /**
- * Start warming `folder` on a worker thread.
+ * Cache every later scan warms, and how many folders run at once. Called once
+ * at app init.
+ */
+void configure(PersistentParseCache *cache,
+               std::size_t max_workers = kDefaultMaxWorkers);
+
+/**
+ * Queue `folder` for warming.
  *
- * Returns false, having done nothing, when a scan is already running.
- * `on_complete` runs on the UI thread from `poll_completion`, exactly once.
+ * Returns false, having done nothing, when that folder is already queued or
+ * running. Workers are handed folders from `poll_completion`, highest
+ * priority first, at most `max_workers` at a time. `on_complete` runs on the
+ * UI thread from `poll_completion`, exactly once, also for a folder cancelled
+ * before it started.
  */
 bool begin(const std::filesystem::path &folder,
-           std::function<void(bool cancelled)> on_complete);
+           std::function<void(bool cancelled)> on_complete,
+           Priority priority = Priority::Normal);
 
 Status status();
+/// Cancel every queued and running folder.
 void request_cancel();
+/// Cancel one folder; false when it is neither queued nor running.
+bool cancel(const std::filesystem::path &folder);
+/// Move a queued folder ahead of the Normal ones.
+bool prioritize(const std::filesystem::path &folder);
 
-/// Join a finished worker and run its callback. Called every frame.
+/**
+ * Collect finished folders, run their callbacks and hand queued folders to
+ * the free workers. Called every frame.
+ */
 void poll_completion();
 
-/// Cancel and join a running scan without running its callback.
+/// Cancel every scan and join the workers without running any callback.
 void shutdown();
 
 } // namespace background_folder_scan
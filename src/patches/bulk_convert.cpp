@@ -0,0 +1,270 @@
+#include "patches/bulk_convert.hpp"
+
+#include "core/parallel_for.hpp"
+#include "formats/patch_registry.hpp"
+#include "patches/filename_utils.hpp"
+#include "patches/patch_write.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <string_view>
+#include <system_error>
+#include <unordered_set>
+
+namespace patches::bulk_convert {
+
+namespace {
+
+std::string normalize_extension(std::string extension) {
+  std::transform(
+      extension.begin(), extension.end(), extension.begin(),
+      [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  if (!extension.empty() && extension.front() != '.') {
+    extension.insert(extension.begin(), '.');
+  }
+  return extension;
+}
+
+bool is_readable(const std::filesystem::path &path) {
+  const auto &registry = formats::PatchRegistry::instance();
+  const auto *handler =
+      registry.handler_for_extension(lowercase_extension(path));
+  return handler != nullptr && (handler->read_file || handler->read_memory);
+}
+
+/// '*' matches any run of characters, '?' any one.
+bool wildcard_match(std::string_view pattern, std::string_view name) {
+  std::size_t p = 0;
+  std::size_t n = 0;
+  std::size_t star = std::string_view::npos;
+  std::size_t resume = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      ++p;
+      ++n;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      resume = n;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      n = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+bool has_wildcard(const std::string &text) {
+  return text.find_first_of("*?") != std::string::npos;
+}
+
+/// `dir/base<extension>`, or `dir/base (2)<extension>` and so on when an
+/// earlier instrument of this run already took the name. Case-folded, for
+/// file systems that ignore case.
+std::filesystem::path claim_target(const std::filesystem::path &dir,
+                                   const std::string &base,
+                                   const std::string &extension,
+                                   std::unordered_set<std::string> &claimed) {
+  for (int attempt = 1;; ++attempt) {
+    const auto name = attempt == 1
+                          ? base + extension
+                          : base + " (" + std::to_string(attempt) + ")" +
+                                extension;
+    const auto target = dir / name;
+    auto key = target.lexically_normal().generic_string();
+    std::transform(
+        key.begin(), key.end(), key.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (claimed.insert(std::move(key)).second) {
+      return target;
+    }
+  }
+}
+
+} // namespace
+
+std::vector<Input> collect_inputs(const std::vector<std::string> &arguments,
+                                  std::vector<std::string> &errors) {
+  std::vector<Input> inputs;
+  for (const auto &argument : arguments) {
+    const std::filesystem::path path(argument);
+    std::error_code error;
+    std::vector<Input> found;
+
+    if (has_wildcard(path.filename().string())) {
+      if (has_wildcard(path.parent_path().string())) {
+        errors.push_back(argument +
+                         ": wildcards are only supported in the file name");
+        continue;
+      }
+      const auto dir =
+          path.parent_path().empty() ? std::filesystem::path(".")
+                                     : path.parent_path();
+      const auto pattern = path.filename().string();
+      for (std::filesystem::directory_iterator it(dir, error), end;
+           it != end && !error; it.increment(error)) {
+        if (it->is_regular_file(error) &&
+            wildcard_match(pattern, it->path().filename().string())) {
+          found.push_back({it->path(), {}});
+        }
+      }
+    } else if (std::filesystem::is_directory(path, error)) {
+      const auto options =
+          std::filesystem::directory_options::skip_permission_denied;
+      for (std::filesystem::recursive_directory_iterator it(path, options,
+                                                            error),
+           end;
+           it != end && !error; it.increment(error)) {
+        if (it->is_regular_file(error) && is_readable(it->path())) {
+          auto relative = it->path().parent_path().lexically_relative(path);
+          if (relative == ".") {
+            relative.clear();
+          }
+          found.push_back({it->path(), std::move(relative)});
+        }
+      }
+    } else if (std::filesystem::is_regular_file(path, error)) {
+      found.push_back({path, {}});
+    }
+
+    if (found.empty()) {
+      errors.push_back(argument + ": no patch files found");
+      continue;
+    }
+    std::sort(found.begin(), found.end(), [](const Input &a, const Input &b) {
+      return a.source < b.source;
+    });
+    inputs.insert(inputs.end(), found.begin(), found.end());
+  }
+  return inputs;
+}
+
+bool can_write(const std::string &extension) {
+  const auto normalized = normalize_extension(extension);
+  if (normalized == ".ginpkg") {
+    return true;
+  }
+  for (const auto &format :
+       formats::PatchRegistry::instance().save_formats()) {
+    if (format.extension == normalized) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Summary convert(const std::vector<Input> &inputs, const Options &options,
+                const std::function<void(const FileReport &)> &on_file) {
+  const auto extension = normalize_extension(options.target_extension);
+  const std::size_t threads = options.threads != 0
+                                  ? options.threads
+                                  : megatoy::default_thread_count();
+  auto &registry = formats::PatchRegistry::instance();
+
+  std::vector<formats::PatchLoadResult> loaded(inputs.size());
+  megatoy::parallel_for(inputs.size(), threads, [&](std::size_t i) {
+    try {
+      loaded[i] = registry.load(inputs[i].source);
+    } catch (const std::exception &e) {
+      loaded[i].status = formats::PatchLoadStatus::Failure;
+      loaded[i].message = e.what();
+    }
+  });
+
+  // Naming and deduplication go in input order, so a second run over the
+  // same library writes the same files under the same names.
+  struct Job {
+    std::size_t file;
+    const ym2612::Patch *patch;
+    std::filesystem::path target;
+  };
+  Summary summary;
+  summary.files.resize(inputs.size());
+  std::vector<Job> jobs;
+  std::unordered_set<ym2612::PackedPatch> sounds;
+  std::unordered_set<std::string> claimed;
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    auto &report = summary.files[i];
+    report.source = inputs[i].source;
+    const auto &result = loaded[i];
+    if (result.status == formats::PatchLoadStatus::Failure) {
+      report.errors.push_back(result.message.empty() ? "could not be read"
+                                                     : result.message);
+      continue;
+    }
+
+    const auto stem = sanitize_filename(inputs[i].source.stem().string());
+    const bool bank = result.patches.size() > 1;
+    auto dir = options.output_dir / inputs[i].relative_dir;
+    if (bank) {
+      // A bank's instruments keep their names, in a folder named after it.
+      dir /= stem.empty() ? "bank" : stem;
+    }
+    for (std::size_t k = 0; k < result.patches.size(); ++k) {
+      const auto &patch = result.patches[k];
+      if (options.deduplicate && !sounds.insert(patch.packed()).second) {
+        ++report.duplicates;
+        continue;
+      }
+      auto base = bank ? sanitize_filename(patch.name) : stem;
+      if (base.empty()) {
+        base = (stem.empty() ? "patch" : stem) + " " + std::to_string(k + 1);
+      }
+      jobs.push_back({i, &patch, claim_target(dir, base, extension, claimed)});
+    }
+  }
+
+  std::vector<std::string> failures(jobs.size());
+  megatoy::parallel_for(jobs.size(), threads, [&](std::size_t j) {
+    const auto &job = jobs[j];
+    std::error_code error;
+    if (std::filesystem::exists(job.target, error)) {
+      if (!options.overwrite) {
+        failures[j] = job.target.string() + " already exists";
+        return;
+      }
+      // Saving into a package adds a version to it; replacing one starts it
+      // over, as with every other format.
+      if (extension == ".ginpkg" &&
+          !std::filesystem::remove(job.target, error)) {
+        failures[j] = "cannot replace " + job.target.string() + ": " +
+                      error.message();
+        return;
+      }
+    }
+    std::filesystem::create_directories(job.target.parent_path(), error);
+    if (error) {
+      failures[j] = "cannot create " + job.target.parent_path().string() +
+                    ": " + error.message();
+      return;
+    }
+    if (!write_patch(*job.patch, job.target)) {
+      failures[j] = "failed to write " + job.target.string();
+    }
+  });
+
+  for (std::size_t j = 0; j < jobs.size(); ++j) {
+    auto &report = summary.files[jobs[j].file];
+    if (failures[j].empty()) {
+      report.written.push_back(jobs[j].target);
+    } else {
+      report.errors.push_back(std::move(failures[j]));
+    }
+  }
+  for (const auto &report : summary.files) {
+    summary.written += report.written.size();
+    summary.duplicates += report.duplicates;
+    summary.failed_files += report.errors.empty() ? 0 : 1;
+    if (on_file) {
+      on_file(report);
+    }
+  }
+  return summary;
+}
+
+} // namespace patches::bulk_convert
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Converting a whole library from one patch format to another, as
+ * megatoy_convert does from the command line.
+ *
+ * Every input goes through PatchRegistry::load and every instrument out
+ * through write_patch(), which uses PatchRegistry's writers, so the result is
+ * what the editor would produce one file at a time. Files are read on a pool
+ * of threads, deduplicated and named in input order on the calling thread,
+ * then written on the pool again: the output does not depend on which thread
+ * finished first.
+ */
+namespace patches::bulk_convert {
+
+/// One file to convert and the directory, relative to the output, its
+/// instruments go to.
+struct Input {
+  std::filesystem::path source;
+  std::filesystem::path relative_dir;
+};
+
+/**
+ * The files named by `arguments`, in a stable order. A file is taken as
+ * given. A directory is walked for every extension PatchRegistry can read,
+ * keeping its layout below the output. A '*' or '?' in the last path
+ * component makes a pattern over the directory before it. Arguments that
+ * match nothing land in `errors`.
+ */
+std::vector<Input> collect_inputs(const std::vector<std::string> &arguments,
+                                  std::vector<std::string> &errors);
+
+struct Options {
+  /// Extension to write, with or without the leading dot: ".dmp", "fui".
+  std::string target_extension;
+  std::filesystem::path output_dir;
+  /// 0 for one per hardware thread.
+  std::size_t threads = 0;
+  /// Write each distinct sound once, whatever it is called; later copies
+  /// are counted as duplicates of the first.
+  bool deduplicate = false;
+  /// Replace files already in the output instead of reporting them. A
+  /// replaced .ginpkg holds only the new sound, not its old versions.
+  bool overwrite = false;
+};
+
+struct FileReport {
+  std::filesystem::path source;
+  std::vector<std::filesystem::path> written;
+  std::size_t duplicates = 0;
+  /// Why the file, or some of its instruments, were not converted.
+  std::vector<std::string> errors;
+};
+
+struct Summary {
+  /// One per input, in input order.
+  std::vector<FileReport> files;
+  std::size_t written = 0;
+  std::size_t duplicates = 0;
+  std::size_t failed_files = 0;
+};
+
+/// Whether `extension` names a format PatchRegistry can write.
+bool can_write(const std::string &extension);
+
+/**
+ * Convert `inputs` as `options` says. `on_file`, if set, runs on the
+ * calling thread once per input, in input order, after the writes.
+ */
+Summary convert(const std::vector<Input> &inputs, const Options &options,
+                const std::function<void(const FileReport &)> &on_file = {});
+
+} // namespace patches::bulk_convert
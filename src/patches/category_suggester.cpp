@@ -0,0 +1,312 @@
+#include "category_suggester.hpp"
+
+#include "core/parallel_for.hpp"
+#include "patch_lab.hpp"
+#include "similarity_index.hpp"
+#include "ym2612/patch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string_view>
+
+namespace patches {
+
+namespace {
+
+constexpr std::size_t kSoundDimensions = 4;
+constexpr std::size_t kDimensions =
+    SimilarityVector::kDimensions + kSoundDimensions;
+/// How far a full swing of one sound feature moves a patch, on the scale of
+/// SimilarityVector's weights.
+constexpr float kSoundWeight = 1.0f;
+
+constexpr std::size_t kMaxGroups = 64;
+constexpr int kMaxIterations = 25;
+/// Samples handed to a worker at a time.
+constexpr std::size_t kChunk = 256;
+/// What one label someone chose is worth against one template guess.
+constexpr float kLabelVotes = 4.0f;
+constexpr std::uint32_t kSeed = 2612;
+
+bool same_name(std::string_view a, std::string_view b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+/// The template `category` names, by id or label, if any.
+std::optional<std::size_t>
+category_index(std::string_view category,
+               const std::vector<patch_lab::CategoryChoice> &choices) {
+  for (std::size_t c = 0; c < choices.size(); ++c) {
+    if (same_name(category, choices[c].id) ||
+        same_name(category, choices[c].label)) {
+      return c;
+    }
+  }
+  return std::nullopt;
+}
+
+/// Each descriptor mapped to 0..1 over the range patches actually span.
+std::array<float, kSoundDimensions>
+sound_features(const audio::SoundDescriptors &descriptors) {
+  const auto unit = [](double value) {
+    return static_cast<float>(std::clamp(value, 0.0, 1.0)) * kSoundWeight;
+  };
+  return {
+      // 55 Hz to 14 kHz.
+      unit(std::log2(std::max(descriptors.centroid_hz, 55.0f) / 55.0f) / 8.0),
+      // Up to a second, and up to ten.
+      unit(std::log10(1.0 + descriptors.attack_ms) / 3.0),
+      unit(std::log10(1.0 + descriptors.decay_ms) / 4.0),
+      unit(descriptors.harmonicity),
+  };
+}
+
+/**
+ * Features are stored column by column -- dimension d of sample i at
+ * [d * count + i] -- and distances are taken a chunk of samples at a time,
+ * so the inner loop runs down a column and vectorizes, as in
+ * BruteForceSimilarityIndex.
+ */
+struct Features {
+  std::size_t count = 0;
+  std::vector<float> columns;
+
+  float &at(std::size_t i, std::size_t d) { return columns[d * count + i]; }
+  float at(std::size_t i, std::size_t d) const {
+    return columns[d * count + i];
+  }
+
+  /// Squared distances from `center` to samples [begin, end), into `out`.
+  void distances(const float *center, std::size_t begin, std::size_t end,
+                 float *out) const {
+    std::fill(out, out + (end - begin), 0.0f);
+    for (std::size_t d = 0; d < kDimensions; ++d) {
+      const float *column = &columns[d * count + begin];
+      const float value = center[d];
+      for (std::size_t i = 0; i < end - begin; ++i) {
+        const float delta = column[i] - value;
+        out[i] += delta * delta;
+      }
+    }
+  }
+};
+
+/// Runs `body(begin, end)` over `count` samples in chunks.
+template <typename Body>
+void for_chunks(std::size_t count, std::size_t threads, Body body) {
+  const std::size_t chunks = (count + kChunk - 1) / kChunk;
+  megatoy::parallel_for(chunks, threads, [&](std::size_t chunk) {
+    body(chunk * kChunk, std::min(count, (chunk + 1) * kChunk));
+  });
+}
+
+/**
+ * k-means++ seeding: each next center is drawn with probability growing
+ * with its squared distance to the nearest center so far. Returns fewer
+ * than `k` centers when the samples hold fewer distinct points.
+ */
+std::vector<float> seed_centers(const Features &features, std::size_t k,
+                                std::size_t threads) {
+  const std::size_t count = features.count;
+  std::mt19937 rng(kSeed);
+  std::vector<float> centers;
+  centers.reserve(k * kDimensions);
+  std::vector<float> nearest(count, std::numeric_limits<float>::max());
+
+  std::size_t pick =
+      std::uniform_int_distribution<std::size_t>(0, count - 1)(rng);
+  while (true) {
+    for (std::size_t d = 0; d < kDimensions; ++d) {
+      centers.push_back(features.at(pick, d));
+    }
+    if (centers.size() == k * kDimensions) {
+      break;
+    }
+    const float *center = &centers[centers.size() - kDimensions];
+    for_chunks(count, threads, [&](std::size_t begin, std::size_t end) {
+      std::array<float, kChunk> distances;
+      features.distances(center, begin, end, distances.data());
+      for (std::size_t i = begin; i < end; ++i) {
+        nearest[i] = std::min(nearest[i], distances[i - begin]);
+      }
+    });
+
+    double total = 0.0;
+    for (const float distance : nearest) {
+      total += distance;
+    }
+    if (total <= 0.0) {
+      break;
+    }
+    double target = std::uniform_real_distribution<double>(0.0, total)(rng);
+    pick = count - 1;
+    for (std::size_t i = 0; i < count; ++i) {
+      target -= nearest[i];
+      if (target < 0.0) {
+        pick = i;
+        break;
+      }
+    }
+  }
+  return centers;
+}
+
+/// Lloyd's iterations from `centers`; returns each sample's group.
+std::vector<std::size_t> cluster(const Features &features,
+                                 std::vector<float> centers,
+                                 std::size_t threads) {
+  const std::size_t count = features.count;
+  const std::size_t k = centers.size() / kDimensions;
+  std::vector<std::size_t> group(count, k);
+  for (int iteration = 0; iteration < kMaxIterations; ++iteration) {
+    std::atomic<std::size_t> moved{0};
+    for_chunks(count, threads, [&](std::size_t begin, std::size_t end) {
+      std::array<float, kChunk> nearest;
+      std::array<std::size_t, kChunk> nearest_group{};
+      std::array<float, kChunk> distances;
+      nearest.fill(std::numeric_limits<float>::max());
+      for (std::size_t c = 0; c < k; ++c) {
+        features.distances(&centers[c * kDimensions], begin, end,
+                           distances.data());
+        for (std::size_t j = 0; j < end - begin; ++j) {
+          if (distances[j] < nearest[j]) {
+            nearest[j] = distances[j];
+            nearest_group[j] = c;
+          }
+        }
+      }
+      std::size_t moved_here = 0;
+      for (std::size_t i = begin; i < end; ++i) {
+        moved_here += group[i] != nearest_group[i - begin] ? 1 : 0;
+        group[i] = nearest_group[i - begin];
+      }
+      moved.fetch_add(moved_here, std::memory_order_relaxed);
+    });
+    if (moved.load() == 0) {
+      break;
+    }
+
+    // A group left empty keeps its center.
+    std::vector<double> sums(k * kDimensions, 0.0);
+    std::vector<std::size_t> sizes(k, 0);
+    for (std::size_t i = 0; i < count; ++i) {
+      ++sizes[group[i]];
+    }
+    for (std::size_t d = 0; d < kDimensions; ++d) {
+      for (std::size_t i = 0; i < count; ++i) {
+        sums[group[i] * kDimensions + d] += features.at(i, d);
+      }
+    }
+    for (std::size_t c = 0; c < k; ++c) {
+      if (sizes[c] == 0) {
+        continue;
+      }
+      for (std::size_t d = 0; d < kDimensions; ++d) {
+        centers[c * kDimensions + d] = static_cast<float>(
+            sums[c * kDimensions + d] / static_cast<double>(sizes[c]));
+      }
+    }
+  }
+  return group;
+}
+
+} // namespace
+
+std::vector<CategorySuggestion>
+suggest_categories(std::span<const CategorySample> samples,
+                   std::size_t threads) {
+  const std::size_t count = samples.size();
+  const auto choices = patch_lab::available_categories();
+  if (count == 0 || choices.empty()) {
+    return {};
+  }
+
+  // Unmeasured samples sit at the measured ones' average, where the sound
+  // features pull no group either way.
+  std::array<double, kSoundDimensions> mean{};
+  std::size_t measured = 0;
+  for (const auto &sample : samples) {
+    if (sample.descriptors) {
+      const auto values = sound_features(*sample.descriptors);
+      for (std::size_t d = 0; d < kSoundDimensions; ++d) {
+        mean[d] += values[d];
+      }
+      ++measured;
+    }
+  }
+  for (auto &value : mean) {
+    value = measured ? value / static_cast<double>(measured) : 0.0;
+  }
+
+  Features features{count, std::vector<float>(count * kDimensions)};
+  std::vector<std::size_t> best_template(count, 0);
+  for_chunks(count, threads, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const auto &sample = samples[i];
+      const auto settings = SimilarityVector::from(sample.sound);
+      for (std::size_t d = 0; d < SimilarityVector::kDimensions; ++d) {
+        features.at(i, d) = settings.values[d];
+      }
+      const auto sound =
+          sample.descriptors ? sound_features(*sample.descriptors)
+                             : std::array<float, kSoundDimensions>{};
+      for (std::size_t d = 0; d < kSoundDimensions; ++d) {
+        features.at(i, SimilarityVector::kDimensions + d) =
+            sample.descriptors ? sound[d] : static_cast<float>(mean[d]);
+      }
+
+      ym2612::Patch patch;
+      ym2612::unpack(sample.sound, patch.global, patch.channel,
+                     patch.instrument);
+      const auto fits = patch_lab::category_fit(patch);
+      best_template[i] = static_cast<std::size_t>(
+          std::max_element(fits.begin(), fits.end()) - fits.begin());
+    }
+  });
+
+  const auto k = std::clamp<std::size_t>(
+      static_cast<std::size_t>(std::lround(std::sqrt(count / 2.0))), 1,
+      std::min(kMaxGroups, count));
+  auto centers = seed_centers(features, k, threads);
+  const std::size_t groups = centers.size() / kDimensions;
+  const auto group = cluster(features, std::move(centers), threads);
+
+  const std::size_t categories = choices.size();
+  std::vector<float> votes(groups * categories, 0.0f);
+  for (std::size_t i = 0; i < count; ++i) {
+    float *row = &votes[group[i] * categories];
+    row[best_template[i]] += 1.0f;
+    if (const auto label = category_index(samples[i].category, choices)) {
+      row[*label] += kLabelVotes;
+    }
+  }
+
+  std::vector<CategorySuggestion> suggestions;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!samples[i].category.empty()) {
+      continue;
+    }
+    const float *row = &votes[group[i] * categories];
+    const auto winner = std::max_element(row, row + categories);
+    float total = 0.0f;
+    for (std::size_t c = 0; c < categories; ++c) {
+      total += row[c];
+    }
+    suggestions.push_back(
+        {i, choices[static_cast<std::size_t>(winner - row)].id,
+         *winner / total});
+  }
+  return suggestions;
+}
+
+} // namespace patches
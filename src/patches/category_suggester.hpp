@@ -0,0 +1,58 @@
+#pragma once
+
+#include "audio/sound_descriptors.hpp"
+#include "ym2612/packed_patch.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace patches {
+
+/// One patch as suggest_categories() sees it.
+struct CategorySample {
+  ym2612::PackedPatch sound;
+  /// How it sounds, when SoundDescriptorIndex has measured it.
+  std::optional<audio::SoundDescriptors> descriptors;
+  /// The patch's category as it stands; empty for none.
+  std::string category;
+};
+
+struct CategorySuggestion {
+  /// Index into the samples.
+  std::size_t sample = 0;
+  /// An id from patch_lab::available_categories().
+  std::string category;
+  /// The category's share of its group's vote, 0..1.
+  float confidence = 0.0f;
+};
+
+/**
+ * Proposes a category for every sample that has none, by grouping the whole
+ * set and letting each group vote.
+ *
+ * Each sample becomes its SimilarityVector, extended with how it sounds
+ * when that was measured: brightness, attack, decay and harmonicity.
+ * Samples not measured yet take the average there, so they group by their
+ * settings alone. k-means groups them, with k growing as the square root
+ * of the set, from a seeded k-means++ start so the same library always
+ * gets the same answer.
+ *
+ * Within a group every sample already labelled with one of
+ * patch_lab::available_categories() votes for it, and counts as several:
+ * a person chose it. Every sample also casts one vote for the template it
+ * fits best (patch_lab::category_fit), which is all a group of unlabelled
+ * imports has to go by. Every unlabelled member is offered the group's
+ * winner. Labels outside the template set still shape the groups but do
+ * not vote.
+ *
+ * The distance passes run on `threads` threads. 100,000 patches take about
+ * a second and a half on one core of a release build.
+ */
+std::vector<CategorySuggestion>
+suggest_categories(std::span<const CategorySample> samples,
+                   std::size_t threads);
+
+} // namespace patches
@@ -0,0 +1,106 @@
+#include "category_suggestion_index.hpp"
+
+#include "category_suggester.hpp"
+#include "core/parallel_for.hpp"
+#include "patch_index.hpp"
+#include "platform/platform_config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace patches {
+
+struct CategorySuggestionIndex::Job {
+  std::vector<CategorySample> samples;
+  /// Alongside `samples`.
+  std::vector<std::string> paths;
+  std::vector<Suggestion> results;
+
+  std::atomic<bool> finished{false};
+  std::thread worker;
+};
+
+CategorySuggestionIndex::CategorySuggestionIndex() = default;
+
+CategorySuggestionIndex::~CategorySuggestionIndex() { shutdown(); }
+
+void CategorySuggestionIndex::work(Job &job) {
+#if defined(MEGATOY_PLATFORM_WEB)
+  const std::size_t threads = 1;
+#else
+  const std::size_t threads = megatoy::default_thread_count();
+#endif
+  for (auto &suggestion : suggest_categories(job.samples, threads)) {
+    job.results.push_back(
+        {job.paths[suggestion.sample], std::move(suggestion.category),
+         static_cast<int>(std::lround(suggestion.confidence * 100.0f))});
+  }
+  std::stable_sort(job.results.begin(), job.results.end(),
+                   [](const Suggestion &a, const Suggestion &b) {
+                     return a.confidence > b.confidence;
+                   });
+  job.finished.store(true, std::memory_order_release);
+}
+
+void CategorySuggestionIndex::update(const PatchRepository &repository,
+                                     const DuplicateFinder &finder,
+                                     const SoundDescriptorIndex &descriptors) {
+  if (stopped_ || job_ || !finder.revision()) {
+    return;
+  }
+  const Key key{*finder.revision(), descriptors.generation()};
+  if (key_ == key) {
+    return;
+  }
+  key_ = key;
+
+  // Gathered here, where the repository may be read; the job only groups.
+  auto job = std::make_unique<Job>();
+  const auto &index = repository.index();
+  for (const auto node : index.patches()) {
+    const auto &entry = index.entry(node);
+    const auto sound = finder.sound(entry.relative_path);
+    if (!sound) {
+      continue;
+    }
+    job->samples.push_back({*sound, descriptors.find(*sound),
+                            entry.metadata ? entry.metadata->category : ""});
+    job->paths.push_back(entry.relative_path);
+  }
+
+  job_ = std::move(job);
+#if defined(MEGATOY_PLATFORM_WEB)
+  work(*job_);
+#else
+  auto *raw = job_.get();
+  job_->worker = std::thread([raw] { work(*raw); });
+#endif
+}
+
+bool CategorySuggestionIndex::poll() {
+  if (!job_ || !job_->finished.load(std::memory_order_acquire)) {
+    return false;
+  }
+  auto done = std::move(job_);
+  if (done->worker.joinable()) {
+    done->worker.join();
+  }
+  suggestions_ = std::move(done->results);
+  ++generation_;
+  return true;
+}
+
+void CategorySuggestionIndex::shutdown() {
+  stopped_ = true;
+  if (!job_) {
+    return;
+  }
+  if (job_->worker.joinable()) {
+    job_->worker.join();
+  }
+  job_.reset();
+}
+
+} // namespace patches
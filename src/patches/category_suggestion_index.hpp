@@ -0,0 +1,83 @@
+#pragma once
+
+#include "duplicate_finder.hpp"
+#include "patch_repository.hpp"
+#include "sound_descriptor_index.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace patches {
+
+/**
+ * suggest_categories() over the whole workspace, run as a job.
+ *
+ * Grouping a large library takes a second or two, far too long for a
+ * frame, so it runs on a worker and the table shows the last result that
+ * finished. A job describes one DuplicateFinder revision and one
+ * SoundDescriptorIndex generation: a fresh read of the library or new
+ * measurements start the next one. A category edit does neither, so
+ * labelling patches never groups them again; whoever shows suggestions()
+ * leaves out the patches that have a category by now.
+ *
+ * Suggestions name patches by relative path, so they stay usable while the
+ * repository rescans. UI-thread-only apart from the job. The browser build
+ * has no threads and groups inline in update().
+ */
+class CategorySuggestionIndex {
+public:
+  struct Suggestion {
+    std::string relative_path;
+    /// An id from patch_lab::available_categories().
+    std::string category;
+    /// 0..100.
+    int confidence = 0;
+  };
+
+  CategorySuggestionIndex();
+  ~CategorySuggestionIndex();
+
+  CategorySuggestionIndex(const CategorySuggestionIndex &) = delete;
+  CategorySuggestionIndex &operator=(const CategorySuggestionIndex &) = delete;
+
+  /**
+   * Start a job over the patches of `repository` the finder's last job
+   * read, unless suggestions() already describe that revision and the
+   * descriptors' generation or a job is running. Call it every frame the
+   * suggestions are on screen.
+   */
+  void update(const PatchRepository &repository, const DuplicateFinder &finder,
+              const SoundDescriptorIndex &descriptors);
+  /// Publish a finished job; true when suggestions() changed.
+  bool poll();
+
+  bool running() const { return job_ != nullptr; }
+  /// Bumped whenever suggestions() change.
+  std::uint64_t generation() const { return generation_; }
+  /// One per patch that had no category when the job started, most certain
+  /// first.
+  const std::vector<Suggestion> &suggestions() const { return suggestions_; }
+
+  /// Join the running job and drop what it finds. update() starts no more.
+  void shutdown();
+
+private:
+  struct Job;
+  /// Finder revision and descriptor generation.
+  using Key = std::pair<std::uint64_t, std::uint64_t>;
+
+  static void work(Job &job);
+
+  bool stopped_ = false;
+  std::uint64_t generation_ = 0;
+  /// What the last job was started from.
+  std::optional<Key> key_;
+  std::vector<Suggestion> suggestions_;
+  std::unique_ptr<Job> job_;
+};
+
+} // namespace patches
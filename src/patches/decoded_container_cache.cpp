@@ -0,0 +1,100 @@
+#include "decoded_container_cache.hpp"
+
+namespace patches {
+
+DecodedContainerCache::DecodedContainerCache(std::size_t max_entries,
+                                             std::size_t max_bytes)
+    : max_entries_(max_entries), max_bytes_(max_bytes) {}
+
+DecodedContainerCache &DecodedContainerCache::shared() {
+  static DecodedContainerCache cache;
+  return cache;
+}
+
+std::shared_ptr<const DecodedContainer>
+DecodedContainerCache::lookup(const std::filesystem::path &absolute_path,
+                              std::uintmax_t file_size,
+                              std::filesystem::file_time_type modified) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto slot = slots_.find(absolute_path);
+  if (slot == slots_.end()) {
+    return nullptr;
+  }
+  if (slot->second.file_size != file_size ||
+      slot->second.modified != modified) {
+    erase_locked(slot);
+    return nullptr;
+  }
+  recency_.splice(recency_.begin(), recency_, slot->second.recency);
+  return slot->second.container;
+}
+
+void DecodedContainerCache::store(
+    const std::filesystem::path &absolute_path, std::uintmax_t file_size,
+    std::filesystem::file_time_type modified,
+    std::shared_ptr<const DecodedContainer> container) {
+  if (!container) {
+    return;
+  }
+  const std::size_t bytes = estimate_bytes(*container);
+  // Something larger than the whole budget would only evict everything else
+  // and then itself.
+  if (bytes > max_bytes_ || max_entries_ == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (const auto existing = slots_.find(absolute_path);
+      existing != slots_.end()) {
+    erase_locked(existing);
+  }
+  recency_.push_front(absolute_path);
+  slots_.emplace(absolute_path, Slot{file_size, modified, std::move(container),
+                                     bytes, recency_.begin()});
+  bytes_ += bytes;
+
+  while (slots_.size() > max_entries_ || bytes_ > max_bytes_) {
+    erase_locked(slots_.find(recency_.back()));
+  }
+}
+
+void DecodedContainerCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  slots_.clear();
+  recency_.clear();
+  bytes_ = 0;
+}
+
+std::size_t DecodedContainerCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slots_.size();
+}
+
+std::size_t DecodedContainerCache::approximate_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+std::size_t
+DecodedContainerCache::estimate_bytes(const DecodedContainer &container) {
+  std::size_t bytes = sizeof(DecodedContainer);
+  for (const auto &instrument : container.instruments) {
+    bytes += sizeof(instrument) + instrument.name.size();
+  }
+  if (container.package) {
+    // Snapshots are whole patch documents, roughly the size of the current
+    // one; the package does not expose their sizes without copying them.
+    const auto &package = *container.package;
+    bytes += package.current_data().size() * (package.history().size() + 1);
+  }
+  return bytes;
+}
+
+void DecodedContainerCache::erase_locked(
+    std::unordered_map<std::filesystem::path, Slot>::iterator slot) {
+  bytes_ -= slot->second.bytes;
+  recency_.erase(slot->second.recency);
+  slots_.erase(slot);
+}
+
+} // namespace patches
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "formats/ginpkg.hpp"
+#include "ym2612/patch.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace patches {
+
+/// What one container file decodes to: a GINPKG package, or a bank's
+/// instruments as the format adapter returned them (names not yet defaulted).
+struct DecodedContainer {
+  std::optional<formats::ginpkg::GinPackage> package;
+  std::vector<ym2612::Patch> instruments;
+};
+
+/**
+ * Recently decoded container files, so that picking instrument after
+ * instrument out of one bank parses the file once rather than once per pick.
+ *
+ * Entries are keyed by absolute path and stamped with the file's size and
+ * modification time; a lookup with a different stamp is a miss, which is
+ * what invalidates an entry when the file is rewritten. The cache is bounded
+ * by entry count and by an estimate of the decoded size, evicting the least
+ * recently used entry first.
+ *
+ * One process-wide instance, shared(), is filled by the folder scan as it
+ * parses containers and read by FilesystemPatchStorage::load_patch. It is
+ * safe to use from the background scan and the UI thread at once.
+ */
+class DecodedContainerCache {
+public:
+  static constexpr std::size_t kDefaultMaxEntries = 64;
+  static constexpr std::size_t kDefaultMaxBytes = 32u << 20;
+
+  explicit DecodedContainerCache(std::size_t max_entries = kDefaultMaxEntries,
+                                 std::size_t max_bytes = kDefaultMaxBytes);
+
+  static DecodedContainerCache &shared();
+
+  std::shared_ptr<const DecodedContainer>
+  lookup(const std::filesystem::path &absolute_path, std::uintmax_t file_size,
+         std::filesystem::file_time_type modified);
+  void store(const std::filesystem::path &absolute_path,
+             std::uintmax_t file_size, std::filesystem::file_time_type modified,
+             std::shared_ptr<const DecodedContainer> container);
+  void clear();
+
+  std::size_t size() const;
+  std::size_t approximate_bytes() const;
+
+private:
+  struct Slot {
+    std::uintmax_t file_size = 0;
+    std::filesystem::file_time_type modified;
+    std::shared_ptr<const DecodedContainer> container;
+    std::size_t bytes = 0;
+    std::list<std::filesystem::path>::iterator recency;
+  };
+
+  static std::size_t estimate_bytes(const DecodedContainer &container);
+  void erase_locked(
+      std::unordered_map<std::filesystem::path, Slot>::iterator slot);
+
+  const std::size_t max_entries_;
+  const std::size_t max_bytes_;
+  mutable std::mutex mutex_;
+  /// Most recently used first.
+  std::list<std::filesystem::path> recency_;
+  std::unordered_map<std::filesystem::path, Slot> slots_;
+  std::size_t bytes_ = 0;
+};
+
+} // namespace patches
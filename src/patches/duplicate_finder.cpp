@@ -0,0 +1,402 @@
+#include "duplicate_finder.hpp"
+
+#include "core/parallel_for.hpp"
+#include "patch_index.hpp"
+#include "platform/platform_config.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <numeric>
+#include <thread>
+#include <utility>
+
+namespace patches {
+
+struct DuplicateFinder::Job {
+  std::uint64_t revision = 0;
+  const platform::VirtualFileSystem *vfs = nullptr;
+  int tolerance = 0;
+  PatchRepository::PatchLoader load;
+  /// One per patch, in PatchId order.
+  std::vector<PatchEntry> entries;
+  std::shared_ptr<const Records> previous;
+
+  std::atomic<std::size_t> done{0};
+  std::atomic<bool> cancel{false};
+  std::atomic<bool> finished{false};
+  std::thread worker;
+
+  // Written by the worker, read once `finished` is set.
+  std::shared_ptr<const Records> records;
+  std::vector<Group> groups;
+  std::vector<std::string> indexed_paths;
+  std::vector<ym2612::PackedPatch> indexed_sounds;
+  std::unique_ptr<const SimilarityIndex> similarity;
+  bool aborted = false;
+};
+
+namespace {
+
+/// The settings distance() adds up, one step per unit.
+constexpr std::size_t kFieldCount = 6 + 4 * 9;
+using Fields = std::array<int, kFieldCount>;
+
+struct Sound {
+  /// The settings that must match, packed into one word.
+  std::uint64_t structure = 0;
+  Fields fields{};
+  /// Sum of `fields`: two sounds are at least this far apart.
+  int sum = 0;
+};
+
+Sound describe(const ym2612::PackedPatch &packed) {
+  ym2612::GlobalSettings global;
+  ym2612::ChannelSettings channel;
+  ym2612::ChannelInstrument instrument;
+  ym2612::unpack(packed, global, channel, instrument);
+
+  Sound sound;
+  auto &key = sound.structure;
+  key = instrument.algorithm;
+  key = key << 2 | (channel.left_speaker ? 2u : 0u) |
+        (channel.right_speaker ? 1u : 0u);
+  std::size_t field = 0;
+  const auto add = [&](int value) { sound.fields[field++] = value; };
+  add(instrument.feedback);
+  add(global.lfo_enable);
+  add(global.lfo_frequency);
+  add(global.dac_enable);
+  add(channel.amplitude_modulation_sensitivity);
+  add(channel.frequency_modulation_sensitivity);
+  for (const auto &op : instrument.operators) {
+    key = key << 9 | (op.enable ? 1u << 8 : 0u) |
+          static_cast<unsigned>(op.multiple) << 4 |
+          (op.ssg_enable ? 1u << 3 : 0u) | op.ssg_type_envelope_control;
+    // Detune is signed: a step down from 0 is one step, not five.
+    add(ym2612::signed_detune(op.detune));
+    add(op.total_level);
+    add(op.attack_rate);
+    add(op.decay_rate);
+    add(op.sustain_rate);
+    add(op.sustain_level);
+    add(op.release_rate);
+    add(op.key_scale);
+    add(op.amplitude_modulation_enable);
+  }
+  sound.sum = std::accumulate(sound.fields.begin(), sound.fields.end(), 0);
+  return sound;
+}
+
+int field_distance(const Sound &a, const Sound &b) {
+  int total = 0;
+  for (std::size_t i = 0; i < kFieldCount; ++i) {
+    total += std::abs(a.fields[i] - b.fields[i]);
+  }
+  return total;
+}
+
+std::size_t worker_count() {
+#if defined(MEGATOY_PLATFORM_WEB)
+  return 1;
+#else
+  return megatoy::default_thread_count();
+#endif
+}
+
+std::size_t find_root(std::vector<std::size_t> &parent, std::size_t i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+} // namespace
+
+DuplicateFinder::DuplicateFinder(const platform::VirtualFileSystem &vfs,
+                                 int tolerance)
+    : vfs_(vfs), tolerance_(tolerance) {}
+
+DuplicateFinder::~DuplicateFinder() { shutdown(); }
+
+std::optional<int> DuplicateFinder::distance(const ym2612::PackedPatch &a,
+                                             const ym2612::PackedPatch &b) {
+  const auto left = describe(a);
+  const auto right = describe(b);
+  if (left.structure != right.structure) {
+    return std::nullopt;
+  }
+  return field_distance(left, right);
+}
+
+std::vector<std::vector<std::size_t>> DuplicateFinder::group(
+    std::span<const std::optional<ym2612::PackedPatch>> sounds,
+    int tolerance) {
+  // Exact duplicates first: each distinct image becomes one class.
+  std::unordered_map<ym2612::PackedPatch, std::size_t> class_of;
+  std::vector<ym2612::PackedPatch> images;
+  std::vector<std::vector<std::size_t>> members;
+  for (std::size_t i = 0; i < sounds.size(); ++i) {
+    if (!sounds[i]) {
+      continue;
+    }
+    const auto [slot, inserted] =
+        class_of.try_emplace(*sounds[i], images.size());
+    if (inserted) {
+      images.push_back(*sounds[i]);
+      members.emplace_back();
+    }
+    members[slot->second].push_back(i);
+  }
+
+  std::vector<std::size_t> parent(images.size());
+  std::iota(parent.begin(), parent.end(), std::size_t{0});
+  if (tolerance > 0) {
+    // Only classes with the same structure can be near, and a pair whose
+    // sums differ by more than the tolerance cannot be: sorted by both, each
+    // class is compared with the few that follow it inside that window.
+    std::vector<Sound> described;
+    described.reserve(images.size());
+    for (const auto &image : images) {
+      described.push_back(describe(image));
+    }
+    std::vector<std::size_t> order(images.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      return std::pair(described[a].structure, described[a].sum) <
+             std::pair(described[b].structure, described[b].sum);
+    });
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      const auto &a = described[order[i]];
+      for (std::size_t j = i + 1; j < order.size(); ++j) {
+        const auto &b = described[order[j]];
+        if (b.structure != a.structure || b.sum - a.sum > tolerance) {
+          break;
+        }
+        if (field_distance(a, b) <= tolerance) {
+          parent[find_root(parent, order[j])] = find_root(parent, order[i]);
+        }
+      }
+    }
+  }
+
+  std::unordered_map<std::size_t, std::vector<std::size_t>> by_root;
+  for (std::size_t c = 0; c < images.size(); ++c) {
+    auto &group = by_root[find_root(parent, c)];
+    group.insert(group.end(), members[c].begin(), members[c].end());
+  }
+  std::vector<std::vector<std::size_t>> groups;
+  for (auto &[root, group] : by_root) {
+    if (group.size() > 1) {
+      std::sort(group.begin(), group.end());
+      groups.push_back(std::move(group));
+    }
+  }
+  std::sort(groups.begin(), groups.end(),
+            [](const auto &a, const auto &b) { return a.front() < b.front(); });
+  return groups;
+}
+
+void DuplicateFinder::run(Job &job) {
+  // Patches grouped by the file they come from: a bank is stamped once and
+  // read by one worker, which decodes it once.
+  std::vector<std::string> container_paths;
+  std::vector<std::vector<std::size_t>> container_items;
+  {
+    std::unordered_map<std::string, std::size_t> container_of;
+    for (std::size_t i = 0; i < job.entries.size(); ++i) {
+      auto path = job.entries[i].full_path.generic_string();
+      const auto [slot, inserted] =
+          container_of.try_emplace(path, container_paths.size());
+      if (inserted) {
+        container_paths.push_back(std::move(path));
+        container_items.emplace_back();
+      }
+      container_items[slot->second].push_back(i);
+    }
+  }
+
+  std::vector<std::optional<ym2612::PackedPatch>> sounds(job.entries.size());
+  std::vector<std::optional<ContainerRecord>> records(container_paths.size());
+  megatoy::parallel_for(
+      container_paths.size(), worker_count(), [&](std::size_t c) {
+        if (job.cancel.load(std::memory_order_relaxed)) {
+          return;
+        }
+        const auto &items = container_items[c];
+        const auto &full_path = job.entries[items.front()].full_path;
+        Stamp stamp;
+        const bool stamped =
+            job.vfs->file_size(full_path, stamp.file_size) &&
+            job.vfs->last_write_time(full_path, stamp.modified);
+
+        const ContainerRecord *known = nullptr;
+        if (stamped && job.previous) {
+          const auto found = job.previous->find(container_paths[c]);
+          if (found != job.previous->end() && found->second.stamp == stamp) {
+            known = &found->second;
+          }
+        }
+
+        ContainerRecord record;
+        record.stamp = stamp;
+        for (const auto i : items) {
+          const auto &entry = job.entries[i];
+          if (known != nullptr) {
+            if (const auto found = known->sounds.find(entry.relative_path);
+                found != known->sounds.end()) {
+              sounds[i] = found->second;
+              record.sounds.emplace(entry.relative_path, sounds[i]);
+              continue;
+            }
+          }
+          ym2612::Patch patch;
+          if (job.load(entry, patch)) {
+            sounds[i] = patch.packed();
+          }
+          record.sounds.emplace(entry.relative_path, sounds[i]);
+        }
+        // A file that cannot be stamped cannot be revalidated, so it is read
+        // again every time.
+        if (stamped) {
+          records[c] = std::move(record);
+        }
+        job.done.fetch_add(items.size(), std::memory_order_relaxed);
+      });
+  if (job.cancel.load(std::memory_order_relaxed)) {
+    job.aborted = true;
+    return;
+  }
+
+  auto kept = std::make_shared<Records>();
+  for (std::size_t c = 0; c < records.size(); ++c) {
+    if (records[c]) {
+      kept->emplace(std::move(container_paths[c]), std::move(*records[c]));
+    }
+  }
+  job.records = std::move(kept);
+
+  for (const auto &members : group(sounds, job.tolerance)) {
+    Group result;
+    result.exact = true;
+    for (const auto i : members) {
+      result.paths.push_back(job.entries[i].relative_path);
+      result.sounds.push_back(*sounds[i]);
+      result.exact = result.exact && *sounds[i] == result.sounds.front();
+    }
+    job.groups.push_back(std::move(result));
+  }
+
+  std::vector<SimilarityVector> vectors;
+  for (std::size_t i = 0; i < sounds.size(); ++i) {
+    if (sounds[i]) {
+      job.indexed_paths.push_back(job.entries[i].relative_path);
+      job.indexed_sounds.push_back(*sounds[i]);
+      vectors.push_back(SimilarityVector::from(*sounds[i]));
+    }
+  }
+  job.similarity = make_similarity_index(vectors);
+}
+
+void DuplicateFinder::update(const PatchRepository &repository) {
+  if (stopped_ || job_ || revision_ == repository.revision()) {
+    return;
+  }
+
+  auto job = std::make_unique<Job>();
+  job->revision = repository.revision();
+  job->vfs = &vfs_;
+  job->tolerance = tolerance_;
+  job->load = repository.detached_loader();
+  job->previous = records_;
+  const auto &index = repository.index();
+  job->entries.reserve(index.patch_count());
+  for (const auto node : index.patches()) {
+    job->entries.push_back(index.entry(node));
+  }
+
+  job_ = std::move(job);
+#if defined(MEGATOY_PLATFORM_WEB)
+  run(*job_);
+  job_->finished.store(true, std::memory_order_release);
+#else
+  auto *raw = job_.get();
+  job_->worker = std::thread([raw] {
+    run(*raw);
+    raw->finished.store(true, std::memory_order_release);
+  });
+#endif
+}
+
+bool DuplicateFinder::poll() {
+  if (!job_ || !job_->finished.load(std::memory_order_acquire)) {
+    return false;
+  }
+  auto done = std::move(job_);
+  if (done->worker.joinable()) {
+    done->worker.join();
+  }
+  if (done->aborted) {
+    return false;
+  }
+  records_ = std::move(done->records);
+  revision_ = done->revision;
+  groups_ = std::move(done->groups);
+  indexed_paths_ = std::move(done->indexed_paths);
+  indexed_sounds_ = std::move(done->indexed_sounds);
+  similarity_ = std::move(done->similarity);
+  item_of_.clear();
+  for (std::size_t i = 0; i < indexed_paths_.size(); ++i) {
+    item_of_.emplace(indexed_paths_[i], i);
+  }
+  return true;
+}
+
+std::optional<ym2612::PackedPatch>
+DuplicateFinder::sound(const std::string &relative_path) const {
+  const auto found = item_of_.find(relative_path);
+  if (found == item_of_.end()) {
+    return std::nullopt;
+  }
+  return indexed_sounds_[found->second];
+}
+
+std::vector<DuplicateFinder::Similar>
+DuplicateFinder::similar(const ym2612::PackedPatch &sound, std::size_t k,
+                         const std::string &exclude) const {
+  std::vector<Similar> result;
+  if (!similarity_ || k == 0) {
+    return result;
+  }
+  const auto query = SimilarityVector::from(sound);
+  for (const auto &match : similarity_->nearest(query, k + 1)) {
+    const auto &path = indexed_paths_[match.item];
+    if (path != exclude && result.size() < k) {
+      result.push_back({path, match.distance});
+    }
+  }
+  return result;
+}
+
+DuplicateFinder::Progress DuplicateFinder::progress() const {
+  if (!job_) {
+    return {};
+  }
+  return {job_->done.load(std::memory_order_relaxed), job_->entries.size()};
+}
+
+void DuplicateFinder::shutdown() {
+  stopped_ = true;
+  if (!job_) {
+    return;
+  }
+  job_->cancel.store(true, std::memory_order_relaxed);
+  if (job_->worker.joinable()) {
+    job_->worker.join();
+  }
+  job_.reset();
+}
+
+} // namespace patches
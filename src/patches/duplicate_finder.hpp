@@ -0,0 +1,168 @@
+#pragma once
+
+#include "patch_repository.hpp"
+#include "platform/virtual_file_system.hpp"
+#include "similarity_index.hpp"
+#include "ym2612/packed_patch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace patches {
+
+/**
+ * Finds the patches in the workspace that sound the same, or nearly so.
+ *
+ * Libraries gathered from many trackers hold the same instrument many times
+ * over, under different names and in different formats. Every patch is
+ * loaded and reduced to its ym2612::PackedPatch, so two copies match however
+ * they were stored; that takes reading every container, which is why it
+ * runs on worker threads.
+ *
+ * A job describes one repository revision. The next job reuses every image
+ * whose file still has the same size and modification time, so after an
+ * edit or a rescan only new and changed files are read again. A metadata
+ * write leaves the revision alone and costs nothing.
+ *
+ * Groups are found among the images in two passes. Patches that pack to the
+ * same bytes are exact duplicates. Unless the tolerance is 0, patches are
+ * also near duplicates when they share an algorithm, operator layout,
+ * multiples, SSG-EG and output, and their remaining settings differ by at
+ * most `tolerance` steps in total. Near matches chain: A and C land in one
+ * group when both are near B.
+ *
+ * The same job indexes every image it read for similar(), so "find similar"
+ * costs no pass of its own over the files.
+ *
+ * Everything is UI-thread-only apart from the job itself, which reads the
+ * files through PatchRepository::detached_loader() and the file system's
+ * const interface. The browser build has no threads to spare and runs the
+ * job inline in update().
+ */
+class DuplicateFinder {
+public:
+  static constexpr int kDefaultTolerance = 3;
+
+  struct Group {
+    /// Relative paths in tree order. The first is the one bulk-hide keeps.
+    std::vector<std::string> paths;
+    /// Each member's image, alongside `paths`.
+    std::vector<ym2612::PackedPatch> sounds;
+    /// Whether every member sounds exactly like the first.
+    bool exact = false;
+  };
+
+  struct Similar {
+    std::string path;
+    float distance = 0.0f;
+  };
+
+  struct Progress {
+    std::size_t patches_done = 0;
+    std::size_t patches_total = 0;
+  };
+
+  DuplicateFinder(const platform::VirtualFileSystem &vfs,
+                  int tolerance = kDefaultTolerance);
+  ~DuplicateFinder();
+
+  DuplicateFinder(const DuplicateFinder &) = delete;
+  DuplicateFinder &operator=(const DuplicateFinder &) = delete;
+
+  /**
+   * Start a job for `repository` as it is now, unless groups() already
+   * describe its revision or a job is running. A running job is left to
+   * finish even when the revision has moved on: what it reads makes the
+   * next job cheap. Call it every frame the groups are on screen.
+   */
+  void update(const PatchRepository &repository);
+  /// Publish a finished job; true when groups() changed.
+  bool poll();
+
+  bool running() const { return job_ != nullptr; }
+  Progress progress() const;
+  /// The revision groups() describe; nullopt before any job has finished.
+  std::optional<std::uint64_t> revision() const { return revision_; }
+  /// Groups of two or more, ordered by their first member.
+  const std::vector<Group> &groups() const { return groups_; }
+
+  /// Every image the last job read, one per patch that loaded.
+  const std::vector<ym2612::PackedPatch> &sounds() const {
+    return indexed_sounds_;
+  }
+  /// The image the last job read for `relative_path`, if it could.
+  std::optional<ym2612::PackedPatch>
+  sound(const std::string &relative_path) const;
+  /**
+   * Up to `k` patches nearest `sound` by SimilarityVector distance, nearest
+   * first, among those the last job read. `exclude` names one to leave out,
+   * usually the patch asked about.
+   */
+  std::vector<Similar> similar(const ym2612::PackedPatch &sound,
+                               std::size_t k,
+                               const std::string &exclude = {}) const;
+
+  /// Cancel and join the running job. update() starts no more.
+  void shutdown();
+
+  /**
+   * The grouping itself, over one image per patch (nullopt where a patch
+   * could not be read). Each group lists indices into `sounds`, ascending;
+   * groups are ordered by their first index.
+   */
+  static std::vector<std::vector<std::size_t>>
+  group(std::span<const std::optional<ym2612::PackedPatch>> sounds,
+        int tolerance);
+  /**
+   * How many steps apart two sounds are, summed over every setting but the
+   * ones that must match (algorithm, operator enables, multiples, SSG-EG,
+   * speakers); nullopt when one of those differs.
+   */
+  static std::optional<int> distance(const ym2612::PackedPatch &a,
+                                     const ym2612::PackedPatch &b);
+
+private:
+  struct Stamp {
+    std::uintmax_t file_size = 0;
+    std::filesystem::file_time_type modified;
+
+    bool operator==(const Stamp &other) const = default;
+  };
+
+  /// What the last job learned about one container's patches.
+  struct ContainerRecord {
+    Stamp stamp;
+    /// By relative path; nullopt for patches that failed to load.
+    std::unordered_map<std::string, std::optional<ym2612::PackedPatch>>
+        sounds;
+  };
+  using Records = std::unordered_map<std::string, ContainerRecord>;
+
+  struct Job;
+
+  static void run(Job &job);
+
+  const platform::VirtualFileSystem &vfs_;
+  int tolerance_;
+  bool stopped_ = false;
+
+  std::unique_ptr<Job> job_;
+  /// Shared with the running job, which only reads it.
+  std::shared_ptr<const Records> records_;
+  std::optional<std::uint64_t> revision_;
+  std::vector<Group> groups_;
+  /// Every patch that loaded, by its item in similarity_.
+  std::vector<std::string> indexed_paths_;
+  std::vector<ym2612::PackedPatch> indexed_sounds_;
+  std::unordered_map<std::string, std::size_t> item_of_;
+  std::unique_ptr<const SimilarityIndex> similarity_;
+};
+
+} // namespace patches
@@ -5,6 +5,7 @@
 #include "formats/patch_registry.hpp"
 #include "formats/ym2612_format_adapter.hpp"
 #include "patch_repository.hpp"
+#include "patches/decoded_container_cache.hpp"
 #include "patches/filename_utils.hpp"
 #include "patches/patch_write.hpp"
 #include "patches/persistent_parse_cache.hpp"
@@ -16,6 +17,24 @@
 
 namespace patches {
 
+namespace {
+
+/// The key containers are cached under, in both the parse caches and the
+/// decoded-container cache: absolute and lexically normal.
+std::filesystem::path container_cache_key(const std::filesystem::path &path) {
+  auto key = path.lexically_normal();
+  if (!key.is_absolute()) {
+    std::error_code ec;
+    const auto absolute = std::filesystem::absolute(key, ec);
+    if (!ec) {
+      key = absolute.lexically_normal();
+    }
+  }
+  return key;
+}
+
+} // namespace
+
 FilesystemPatchStorage::FilesystemPatchStorage(
     platform::VirtualFileSystem &vfs, std::filesystem::path root,
     std::string relative_root_label, bool writable, bool enable_metadata,
@@ -34,6 +53,37 @@ FilesystemPatchStorage::FilesystemPatchStorage(
   }
 }
 
+FilesystemPatchStorage::FilesystemPatchStorage(
+    std::shared_ptr<platform::VirtualFileSystem> vfs,
+    std::filesystem::path root, std::string relative_root_label,
+    PersistentParseCache *persistent_cache)
+    : FilesystemPatchStorage(*vfs, std::move(root),
+                             std::move(relative_root_label),
+                             /*writable=*/false, /*enable_metadata=*/false,
+                             persistent_cache) {
+  owned_vfs_ = std::move(vfs);
+}
+
+std::unique_ptr<FilesystemPatchStorage>
+FilesystemPatchStorage::make_scan_copy() const {
+  auto copy = owned_vfs_
+                  ? std::make_unique<FilesystemPatchStorage>(
+                        owned_vfs_, root_, root_label_, persistent_cache_)
+                  : std::make_unique<FilesystemPatchStorage>(
+                        vfs_, root_, root_label_, writable_,
+                        /*enable_metadata=*/false, persistent_cache_);
+  copy->label_ = label_;
+  sync_scan_copy(*copy);
+  return copy;
+}
+
+void FilesystemPatchStorage::sync_scan_copy(
+    FilesystemPatchStorage &copy) const {
+  copy.metadata_ =
+      metadata_ ? std::make_unique<FolderMetadataStore>(*metadata_) : nullptr;
+  copy.scan_scope_ = scan_scope_;
+}
+
 std::string
 FilesystemPatchStorage::metadata_key(const std::string &relative_path) const {
   const std::string prefix = root_label_ + "/";
@@ -53,6 +103,25 @@ void FilesystemPatchStorage::set_scan_observer(ScanObserver observer) {
   scan_observer_ = std::move(observer);
 }
 
+void FilesystemPatchStorage::set_scan_scope(ScanScope scope) {
+  scan_scope_ = std::move(scope);
+}
+
+bool FilesystemPatchStorage::list_directory(
+    const std::string &relative_path,
+    std::vector<PatchEntry> &children) const {
+  if (!owns_relative_path(relative_path)) {
+    return false;
+  }
+  const auto path = to_absolute_path(relative_path);
+  if (!path || !vfs_.is_directory(*path)) {
+    return false;
+  }
+  scan_aborted_ = false;
+  scan_directory(*path, children, relative_path);
+  return !scan_aborted_;
+}
+
 void FilesystemPatchStorage::append_entries(
     std::vector<PatchEntry> &tree) const {
   seen_container_paths_.clear();
@@ -69,10 +138,10 @@ void FilesystemPatchStorage::append_entries(
   if (vfs_.is_directory(root_)) {
     scan_directory(root_, root_entry.children, root_label_);
   }
-  // An aborted walk never reached the rest of the tree, so its record of what
-  // is still on disk is not one to evict from.
-  for (auto it = parse_cache_.begin();
-       !scan_aborted_ && it != parse_cache_.end();) {
+  // An aborted or lazy walk never reached the rest of the tree, so its record
+  // of what is still on disk is not one to evict from.
+  const bool complete = !scan_aborted_ && !scan_scope_.lazy;
+  for (auto it = parse_cache_.begin(); complete && it != parse_cache_.end();) {
     if (!seen_container_paths_.contains(it->first)) {
       it = parse_cache_.erase(it);
     } else {
@@ -87,25 +156,55 @@ bool FilesystemPatchStorage::load_patch(const PatchEntry &entry,
   if (entry.is_directory || !owns_relative_path(entry.relative_path)) {
     return false;
   }
-  if (!entry.container_item_id.empty() &&
-      lowercase_extension(entry.full_path) == ".ginpkg") {
-    if (entry.container_item_id == "__current__") {
-      auto patches = formats::ginpkg::read_file(entry.full_path);
-      if (patches.size() == 1) {
-        out_patch = std::move(patches.front());
-        return true;
-      }
+
+  const auto extension = lowercase_extension(entry.full_path);
+  const bool is_ginpkg_item =
+      !entry.container_item_id.empty() && extension == ".ginpkg";
+  const auto format = formats::adapter::format_for_extension(extension);
+  const bool is_bank_item =
+      !is_ginpkg_item && format && formats::adapter::is_multi_patch(*format);
+  if (is_ginpkg_item || is_bank_item) {
+    const auto decoded = decoded_container(entry.full_path);
+    if (!decoded) {
       return false;
     }
-    auto patch =
-        formats::ginpkg::read_version(entry.full_path, entry.container_item_id);
-    if (!patch) {
+    if (is_ginpkg_item) {
+      if (!decoded->package) {
+        return false;
+      }
+      auto patch = entry.container_item_id == "__current__"
+                       ? formats::ginpkg::read_current(*decoded->package)
+                       : formats::ginpkg::read_version(
+                             *decoded->package, entry.container_item_id);
+      if (!patch) {
+        return false;
+      }
+      out_patch = std::move(*patch);
+      return true;
+    }
+
+    // Mirrors formats::load_patch_from_file: a lone instrument is the patch
+    // whatever the index, and unnamed instruments take the file's stem.
+    const auto &instruments = decoded->instruments;
+    const std::size_t instrument_index =
+        instruments.size() == 1 ? 0 : entry.instrument_index;
+    if (instrument_index >= instruments.size()) {
       return false;
     }
-    out_patch = std::move(*patch);
+    out_patch = instruments[instrument_index];
+    if (out_patch.name.empty()) {
+      out_patch.name = formats::get_patch_name_from_file(entry.full_path,
+                                                         extension);
+    }
     return true;
   }
-  auto result = formats::load_patch_from_file(entry.full_path);
+
+  const auto view = vfs_.view(entry.full_path);
+  if (!view) {
+    return false;
+  }
+  auto result = formats::load_patch_from_memory(entry.full_path, view->data(),
+                                                view->size());
   if (result.status == formats::PatchLoadStatus::Failure) {
     return false;
   } else if (result.status == formats::PatchLoadStatus::Success) {
@@ -120,6 +219,62 @@ bool FilesystemPatchStorage::load_patch(const PatchEntry &entry,
   return false;
 }
 
+std::filesystem::path
+FilesystemPatchStorage::cache_key(const std::filesystem::path &path) const {
+  auto key = container_cache_key(path);
+  // Entries of a mounted archive all share its modification time, so the
+  // CRC it records for each one tells their versions apart.
+  if (const auto tag = vfs_.content_tag(path); !tag.empty()) {
+    key += "#" + tag;
+  }
+  return key;
+}
+
+std::shared_ptr<DecodedContainer>
+FilesystemPatchStorage::decode_container(
+    const std::filesystem::path &path) const {
+  const auto view = vfs_.view(path);
+  if (!view) {
+    return nullptr;
+  }
+  auto decoded = std::make_shared<DecodedContainer>();
+  if (lowercase_extension(path) == ".ginpkg") {
+    decoded->package = formats::ginpkg::load_package_from_memory(
+        view->data(), view->size(), path);
+    return decoded->package ? decoded : nullptr;
+  }
+  const auto format =
+      formats::adapter::format_for_extension(lowercase_extension(path));
+  if (!format) {
+    return nullptr;
+  }
+  decoded->instruments = formats::adapter::read_memory(
+      *format, view->data(), view->size(), path.stem().string());
+  return decoded->instruments.empty() ? nullptr : decoded;
+}
+
+std::shared_ptr<const DecodedContainer>
+FilesystemPatchStorage::decoded_container(
+    const std::filesystem::path &path) const {
+  std::uintmax_t file_size = 0;
+  std::filesystem::file_time_type modified{};
+  const bool has_identity =
+      vfs_.file_size(path, file_size) && vfs_.last_write_time(path, modified);
+  const auto key = cache_key(path);
+  auto &cache = DecodedContainerCache::shared();
+  if (has_identity) {
+    if (auto cached = cache.lookup(key, file_size, modified)) {
+      return cached;
+    }
+  }
+
+  std::shared_ptr<const DecodedContainer> decoded = decode_container(path);
+  if (decoded && has_identity) {
+    cache.store(key, file_size, modified, decoded);
+  }
+  return decoded;
+}
+
 SavePatchResult
 FilesystemPatchStorage::save_patch(const ym2612::Patch &patch,
                                    const std::string &name, bool overwrite,
@@ -332,6 +487,23 @@ bool FilesystemPatchStorage::update_patch_metadata(
   return metadata_->put(std::move(stored));
 }
 
+bool FilesystemPatchStorage::merge_missing_metadata(
+    const std::vector<std::pair<std::string, PatchMetadata>> &metadata,
+    std::size_t &inserted) {
+  inserted = 0;
+  if (!metadata_) {
+    return false;
+  }
+  std::vector<PatchMetadata> mine;
+  for (const auto &[relative_path, entry] : metadata) {
+    if (owns_relative_path(relative_path)) {
+      mine.push_back(entry);
+      mine.back().path = metadata_key(relative_path);
+    }
+  }
+  return mine.empty() || metadata_->merge_missing(mine, inserted);
+}
+
 std::optional<PatchMetadata> FilesystemPatchStorage::get_patch_metadata(
     const std::string &relative_path) const {
   if (!metadata_ || !owns_relative_path(relative_path)) {
@@ -444,6 +616,13 @@ void FilesystemPatchStorage::scan_directory(
     if (entry.is_directory) {
       info.is_directory = true;
       info.format = "";
+      if (scan_scope_.lazy &&
+          !scan_scope_.expanded.contains(info.relative_path)) {
+        // Whether it holds any patches is unknown, so it is listed anyway.
+        info.children_pending = true;
+        tree.push_back(std::move(info));
+        continue;
+      }
       scan_directory(path, info.children, info.relative_path);
       if (!info.children.empty()) {
         tree.push_back(std::move(info));
@@ -466,14 +645,7 @@ void FilesystemPatchStorage::scan_directory(
       const bool is_multi_patch =
           format && formats::adapter::is_multi_patch(*format);
       if (is_ginpkg || is_multi_patch) {
-        auto cache_path = path.lexically_normal();
-        if (!cache_path.is_absolute()) {
-          std::error_code ec;
-          const auto absolute = std::filesystem::absolute(cache_path, ec);
-          if (!ec) {
-            cache_path = absolute.lexically_normal();
-          }
-        }
+        const auto cache_path = cache_key(path);
         seen_container_paths_.insert(cache_path);
 
         std::uintmax_t file_size = 0;
@@ -506,14 +678,34 @@ void FilesystemPatchStorage::scan_directory(
             continue;
           }
         }
-        if (!warmed) {
+        // A bank whose instruments were loaded since the last scan is already
+        // decoded; otherwise this parse fills the cache for load_patch().
+        auto &decoded_cache = DecodedContainerCache::shared();
+        std::shared_ptr<const DecodedContainer> decoded =
+            !warmed && has_identity
+                ? decoded_cache.lookup(cache_path, file_size, modified)
+                : nullptr;
+        const bool decoded_here = !decoded;
+        const bool use_warmed =
+            warmed && (is_ginpkg ? warmed->package.has_value()
+                                 : !warmed->instruments.empty());
+        if (decoded_here && use_warmed) {
+          auto fresh = std::make_shared<DecodedContainer>();
+          fresh->package = warmed->package;
+          fresh->instruments = warmed->instruments;
+          decoded = std::move(fresh);
+        } else if (decoded_here) {
+          decoded = decode_container(path);
+          if (!decoded) {
+            decoded = std::make_shared<DecodedContainer>();
+          }
+        }
+        if (!warmed && decoded_here) {
           ++container_parse_count_;
         }
         std::optional<PatchEntry> parsed_container;
         if (is_ginpkg) {
-          auto package = warmed && warmed->package
-                             ? warmed->package
-                             : formats::ginpkg::load_package(path);
+          const auto &package = decoded->package;
           auto current =
               package ? formats::ginpkg::read_current(*package) : std::nullopt;
           if (package && current) {
@@ -537,13 +729,14 @@ void FilesystemPatchStorage::scan_directory(
 
             for (auto it = package->history().rbegin();
                  it != package->history().rend(); ++it) {
+              // Labels come from the index alone: no version is decoded
+              // to list the package.
               PatchEntry version;
-              auto snapshot = formats::ginpkg::read_version(*package, it->uuid);
               version.name = it->comment && !it->comment->empty()
                                  ? *it->comment
                                  : it->timestamp;
-              if (snapshot && !snapshot->name.empty()) {
-                version.name += " — " + snapshot->name;
+              if (it->name && !it->name->empty()) {
+                version.name += " — " + *it->name;
               }
               version.full_path = path;
               version.relative_path =
@@ -557,10 +750,7 @@ void FilesystemPatchStorage::scan_directory(
             parsed_container = std::move(container);
           }
         } else {
-          std::vector<ym2612::Patch> instruments =
-              warmed && !warmed->instruments.empty()
-                  ? warmed->instruments
-                  : formats::adapter::read_file(*format, path);
+          const auto &instruments = decoded->instruments;
           if (!instruments.empty()) {
             const std::string format_name =
                 ym2612_format::format_to_extension(*format);
@@ -597,6 +787,9 @@ void FilesystemPatchStorage::scan_directory(
         }
 
         if (parsed_container) {
+          if (has_identity && decoded_here) {
+            decoded_cache.store(cache_path, file_size, modified, decoded);
+          }
           if (has_identity) {
             parse_cache_.insert_or_assign(
                 cache_path,
@@ -7,13 +7,16 @@
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace patches {
 
+struct DecodedContainer;
 class PersistentParseCache;
 
 /**
@@ -36,6 +39,15 @@ public:
                          std::string relative_root_label, bool writable,
                          bool enable_metadata,
                          PersistentParseCache *persistent_cache = nullptr);
+  /**
+   * A read-only storage over a file system of its own, such as a
+   * platform::ZipFileSystem mounting an archive at `root`. Scan copies share
+   * it.
+   */
+  FilesystemPatchStorage(std::shared_ptr<platform::VirtualFileSystem> vfs,
+                         std::filesystem::path root,
+                         std::string relative_root_label,
+                         PersistentParseCache *persistent_cache = nullptr);
 
   void append_entries(std::vector<PatchEntry> &tree) const override;
   bool load_patch(const PatchEntry &entry,
@@ -56,6 +68,9 @@ public:
                            const PatchMetadata &metadata) override;
   bool update_patch_metadata(const std::string &relative_path,
                              const PatchMetadata &metadata) override;
+  bool merge_missing_metadata(
+      const std::vector<std::pair<std::string, PatchMetadata>> &metadata,
+      std::size_t &inserted) override;
   std::optional<PatchMetadata>
   get_patch_metadata(const std::string &relative_path) const override;
   void cleanup_metadata(const std::vector<std::string> &paths) const override;
@@ -66,6 +81,16 @@ public:
   to_absolute_path(const std::filesystem::path &path) const override;
 
   const std::filesystem::path &root() const { return root_; }
+
+  /**
+   * A storage over the same folder for a background refresh to walk. It
+   * shares the folder, label and persistent cache but has in-memory caches
+   * of its own and a snapshot of this storage's metadata, so the walk reads
+   * nothing the UI thread may be writing. sync_scan_copy() renews the
+   * snapshot before each walk.
+   */
+  std::unique_ptr<FilesystemPatchStorage> make_scan_copy() const;
+  void sync_scan_copy(FilesystemPatchStorage &copy) const;
   std::size_t container_parse_count_for_testing() const {
     return container_parse_count_;
   }
@@ -82,6 +107,25 @@ public:
   };
   void set_scan_observer(ScanObserver observer);
 
+  /**
+   * Which folders a walk reads. By default all of them. A lazy walk reads
+   * the root and the folders in `expanded` only, and lists every other
+   * folder unread, with children_pending set.
+   */
+  struct ScanScope {
+    bool lazy = false;
+    std::unordered_set<std::string> expanded;
+  };
+  void set_scan_scope(ScanScope scope);
+
+  /**
+   * Read the folder at `relative_path` on its own, within the scan scope, for
+   * a lazy tree to fill in when it is opened. False when the folder is not
+   * this storage's or is gone.
+   */
+  bool list_directory(const std::string &relative_path,
+                      std::vector<PatchEntry> &children) const;
+
 private:
   struct ParseCacheEntry {
     std::uintmax_t file_size = 0;
@@ -89,6 +133,8 @@ private:
     PatchEntry subtree;
   };
 
+  /// Set when this storage keeps its file system alive; vfs_ is that one.
+  std::shared_ptr<platform::VirtualFileSystem> owned_vfs_;
   platform::VirtualFileSystem &vfs_;
   std::filesystem::path root_;
   std::string root_label_;
@@ -101,6 +147,7 @@ private:
   mutable std::unordered_set<std::filesystem::path> seen_container_paths_;
   mutable std::size_t container_parse_count_ = 0;
   ScanObserver scan_observer_;
+  ScanScope scan_scope_;
   mutable bool scan_aborted_ = false;
 
   void scan_directory(const std::filesystem::path &dir_path,
@@ -110,6 +157,16 @@ private:
   static bool is_supported_file(const std::filesystem::path &file_path);
   void load_metadata_for_entry(PatchEntry &entry) const;
   void load_metadata_for_subtree(PatchEntry &entry) const;
+  /// What the parse caches file `path` under: its absolute, lexically normal
+  /// path, plus the file system's content_tag() when it has one.
+  std::filesystem::path cache_key(const std::filesystem::path &path) const;
+  /// Decodes a container file, or returns null if it cannot be read.
+  std::shared_ptr<DecodedContainer>
+  decode_container(const std::filesystem::path &path) const;
+  /// The decoded form of a container file, from DecodedContainerCache when
+  /// the file is unchanged since it was last decoded.
+  std::shared_ptr<const DecodedContainer>
+  decoded_container(const std::filesystem::path &path) const;
 
   /// Strip the root label so metadata keys stay relative to the folder.
   std::string metadata_key(const std::string &relative_path) const;
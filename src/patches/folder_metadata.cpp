@@ -1,18 +1,31 @@
 #include "patches/folder_metadata.hpp"
 
+#include "platform/platform_config.hpp"
 #include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <set>
 #include <sstream>
 #include <system_error>
+#include <utility>
+#if !defined(MEGATOY_PLATFORM_WEB)
+#include <thread>
+#endif
 
 #if defined(_WIN32)
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 namespace patches {
@@ -21,6 +34,17 @@ namespace {
 
 constexpr int kSchemaVersion = 1;
 
+/// Journal lines written before they are folded into the sidecar.
+constexpr std::size_t kCompactAfter = 256;
+#if !defined(MEGATOY_PLATFORM_WEB)
+/// Edits are written once none has arrived for this long...
+constexpr auto kQuietPeriod = std::chrono::milliseconds(250);
+/// ...or once the oldest has waited this long, whichever comes first.
+constexpr auto kMaxDelay = std::chrono::seconds(2);
+#endif
+
+using Entries = std::map<std::string, PatchMetadata>;
+
 bool replace_file(const std::filesystem::path &source,
                   const std::filesystem::path &destination,
                   std::error_code &error) {
@@ -39,6 +63,34 @@ bool replace_file(const std::filesystem::path &source,
 #endif
 }
 
+/**
+ * Push `path` -- a file, or on POSIX the directory a rename happened in --
+ * out of the OS cache. The sidecar has to be on disk before the journal it
+ * replaces is deleted, or a power cut could lose both.
+ */
+bool sync_path(const std::filesystem::path &path) {
+#if defined(_WIN32)
+  const HANDLE file =
+      ::CreateFileW(path.c_str(), GENERIC_WRITE,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  const bool synced = ::FlushFileBuffers(file) != 0;
+  ::CloseHandle(file);
+  return synced;
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  const bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+#endif
+}
+
 std::string iso8601_utc_now() {
   const auto now = std::chrono::system_clock::now();
   const std::time_t time = std::chrono::system_clock::to_time_t(now);
@@ -60,6 +112,7 @@ PatchMetadata metadata_from_json(const std::string &path,
   metadata.hash = j.value("hash", std::string{});
   metadata.star_rating = std::clamp(j.value("star_rating", 0), 0, 5);
   metadata.category = j.value("category", std::string{});
+  metadata.hidden = j.value("hidden", false);
   metadata.notes = j.value("notes", std::string{});
   metadata.created_at = j.value("created_at", std::string{});
   metadata.updated_at = j.value("updated_at", std::string{});
@@ -82,6 +135,9 @@ nlohmann::json metadata_to_json(const PatchMetadata &metadata) {
   if (!metadata.category.empty()) {
     j["category"] = metadata.category;
   }
+  if (metadata.hidden) {
+    j["hidden"] = true;
+  }
   if (!metadata.tags.empty()) {
     j["tags"] = metadata.tags;
   }
@@ -97,91 +153,154 @@ nlohmann::json metadata_to_json(const PatchMetadata &metadata) {
   return j;
 }
 
-} // namespace
-
-FolderMetadataStore::FolderMetadataStore(std::filesystem::path sidecar_path)
-    : sidecar_path_(std::move(sidecar_path)) {}
-
-bool FolderMetadataStore::load() {
-  entries_.clear();
-
-  std::error_code ec;
-  if (!std::filesystem::exists(sidecar_path_, ec) || ec) {
-    return true;
+/// Move `old_path` and everything under it to `new_path`; false if nothing
+/// was there to move.
+bool move_key_prefix(Entries &entries, const std::string &old_path,
+                     const std::string &new_path) {
+  const std::string old_prefix = old_path + "/";
+  std::vector<std::pair<std::string, PatchMetadata>> moved;
+  for (const auto &[key, metadata] : entries) {
+    if (key == old_path || key.rfind(old_prefix, 0) == 0) {
+      const std::string suffix = key.substr(old_path.size());
+      auto renamed = metadata;
+      renamed.path = new_path + suffix;
+      moved.emplace_back(key, std::move(renamed));
+    }
   }
-
-  std::ifstream file(sidecar_path_);
-  if (!file) {
+  if (moved.empty()) {
     return false;
   }
+  for (const auto &[old_key, metadata] : moved) {
+    entries.erase(old_key);
+  }
+  for (auto &[old_key, metadata] : moved) {
+    entries.insert_or_assign(metadata.path, std::move(metadata));
+  }
+  return true;
+}
 
-  try {
-    nlohmann::json j;
-    file >> j;
-    // The normalization below may rewrite the sidecar; Windows refuses to
-    // replace a file that still has an open handle.
-    file.close();
-    if (!j.contains("patches") || !j["patches"].is_object()) {
-      return true;
-    }
-    for (const auto &[path, value] : j["patches"].items()) {
-      entries_.emplace(path, metadata_from_json(path, value));
+nlohmann::json put_record(const PatchMetadata &metadata) {
+  return {{"op", "put"},
+          {"path", metadata.path},
+          {"metadata", metadata_to_json(metadata)}};
+}
+
+nlohmann::json remove_record(const std::vector<std::string> &paths) {
+  return {{"op", "remove"}, {"paths", paths}};
+}
+
+nlohmann::json rename_record(const std::string &from, const std::string &to) {
+  return {{"op", "rename"}, {"from", from}, {"to", to}};
+}
+
+void apply_record(Entries &entries, const nlohmann::json &record) {
+  const auto op = record.value("op", std::string{});
+  if (op == "put") {
+    const auto path = record.at("path").get<std::string>();
+    entries.insert_or_assign(path,
+                             metadata_from_json(path, record.at("metadata")));
+  } else if (op == "remove") {
+    for (const auto &path : record.at("paths")) {
+      entries.erase(path.get<std::string>());
     }
+  } else if (op == "rename") {
+    move_key_prefix(entries, record.at("from").get<std::string>(),
+                    record.at("to").get<std::string>());
+  }
+}
 
-    std::vector<PatchMetadata> normalized;
-    for (const auto &[path, metadata] : entries_) {
-      std::string lower_path = path;
-      std::transform(
-          lower_path.begin(), lower_path.end(), lower_path.begin(),
-          [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
-      if (!lower_path.ends_with(".ginpkg")) {
-        continue;
-      }
+std::filesystem::path journal_path_for(const std::filesystem::path &sidecar) {
+  return sidecar.parent_path() / "patches.journal";
+}
 
-      const std::string latest_path = path + "/latest";
-      if (!entries_.contains(latest_path)) {
-        auto latest = metadata;
-        latest.path = latest_path;
-        normalized.push_back(std::move(latest));
+/// What the sidecar and the journal next to it add up to.
+struct DiskState {
+  Entries entries;
+  /// Sequence number of the last change either of them holds.
+  std::uint64_t sequence = 0;
+  std::size_t journal_lines = 0;
+  /// The journal ends in a line cut short, most likely by a crash mid-write.
+  bool torn = false;
+};
+
+/// False only when the sidecar itself is unreadable.
+bool read_disk_state(const std::filesystem::path &sidecar, DiskState &state) {
+  state = {};
+  std::error_code ec;
+  if (std::filesystem::exists(sidecar, ec) && !ec) {
+    std::ifstream file(sidecar);
+    if (!file) {
+      return false;
+    }
+    try {
+      nlohmann::json j;
+      file >> j;
+      // Older releases never write this key and ignore it when they read.
+      state.sequence = j.value("journal_sequence", std::uint64_t{0});
+      if (j.contains("patches") && j["patches"].is_object()) {
+        for (const auto &[path, value] : j["patches"].items()) {
+          state.entries.emplace(path, metadata_from_json(path, value));
+        }
       }
+    } catch (const std::exception &e) {
+      std::cerr << "Failed to read patch metadata at " << sidecar << ": "
+                << e.what() << "\n";
+      return false;
     }
-    for (auto &metadata : normalized) {
-      const std::string path = metadata.path;
-      entries_.emplace(path, std::move(metadata));
+  }
+
+  // Lines the sidecar already holds are skipped by sequence number, so a
+  // crash between writing a compacted sidecar and deleting the journal
+  // replays nothing twice. The first line that does not parse ends the
+  // replay: only the last one can be cut short.
+  std::ifstream journal(journal_path_for(sidecar));
+  const auto snapshot_sequence = state.sequence;
+  std::string line;
+  while (journal && std::getline(journal, line)) {
+    if (line.empty()) {
+      continue;
     }
-    if (!normalized.empty() && !save()) {
-      return false;
+    try {
+      const auto record = nlohmann::json::parse(line);
+      const auto sequence = record.at("seq").get<std::uint64_t>();
+      if (sequence > snapshot_sequence) {
+        apply_record(state.entries, record);
+      }
+      state.sequence = std::max(state.sequence, sequence);
+      ++state.journal_lines;
+    } catch (const std::exception &) {
+      state.torn = true;
+      break;
     }
-  } catch (const std::exception &e) {
-    std::cerr << "Failed to read patch metadata at " << sidecar_path_ << ": "
-              << e.what() << "\n";
-    entries_.clear();
-    return false;
   }
   return true;
 }
 
-bool FolderMetadataStore::save() const {
+bool write_sidecar(const std::filesystem::path &sidecar_path,
+                   const Entries &entries, std::uint64_t sequence) {
   std::error_code ec;
-  std::filesystem::create_directories(sidecar_path_.parent_path(), ec);
+  std::filesystem::create_directories(sidecar_path.parent_path(), ec);
   if (ec) {
-    std::cerr << "Failed to create " << sidecar_path_.parent_path() << ": "
+    std::cerr << "Failed to create " << sidecar_path.parent_path() << ": "
               << ec.message() << "\n";
     return false;
   }
 
   nlohmann::json patches = nlohmann::json::object();
-  for (const auto &[path, metadata] : entries_) {
+  for (const auto &[path, metadata] : entries) {
     patches[path] = metadata_to_json(metadata);
   }
 
   nlohmann::json root;
   root["version"] = kSchemaVersion;
   root["patches"] = std::move(patches);
+  if (sequence != 0) {
+    root["journal_sequence"] = sequence;
+  }
 
   // Write to a temporary file first so an interrupted save cannot leave a
   // truncated sidecar behind.
-  auto temporary = sidecar_path_;
+  auto temporary = sidecar_path;
   temporary += ".tmp";
   {
     std::ofstream file(temporary);
@@ -194,16 +313,447 @@ bool FolderMetadataStore::save() const {
       return false;
     }
   }
+  if (!sync_path(temporary)) {
+    std::filesystem::remove(temporary);
+    std::cerr << "Failed to sync " << temporary << "\n";
+    return false;
+  }
 
-  if (!replace_file(temporary, sidecar_path_, ec)) {
+  if (!replace_file(temporary, sidecar_path, ec)) {
     std::filesystem::remove(temporary);
-    std::cerr << "Failed to replace " << sidecar_path_ << ": " << ec.message()
+    std::cerr << "Failed to replace " << sidecar_path << ": " << ec.message()
               << "\n";
     return false;
   }
+#if !defined(_WIN32)
+  // MoveFileEx writes through; a rename is only durable once its directory
+  // is synced.
+  if (!sync_path(sidecar_path.parent_path())) {
+    std::cerr << "Failed to sync " << sidecar_path.parent_path() << "\n";
+    return false;
+  }
+#endif
   return true;
 }
 
+#if !defined(MEGATOY_PLATFORM_WEB)
+using Clock = std::chrono::steady_clock;
+#endif
+
+} // namespace
+
+#if !defined(MEGATOY_PLATFORM_WEB)
+/**
+ * The one thread that writes queued journal lines for every open sidecar,
+ * each once it is due. A user with a dozen folders open would otherwise keep
+ * a dozen threads around, nearly always asleep.
+ *
+ * Journals add themselves when they are created and remove themselves before
+ * they go; the thread runs while any journal is registered.
+ */
+class JournalWriter {
+public:
+  ~JournalWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void add() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++journals_;
+    if (!running_) {
+      // A thread that ran out of journals has already let go of the lock
+      // and is only returning.
+      if (thread_.joinable()) {
+        thread_.join();
+      }
+      running_ = true;
+      thread_ = std::thread([this] { run(); });
+    }
+  }
+
+  /// Stop writing `journal`, waiting out a write of it in progress.
+  void remove(MetadataJournal *journal) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this, journal] { return busy_ != journal; });
+    due_.erase(journal);
+    --journals_;
+    wake_.notify_all();
+  }
+
+  /// `journal` has lines queued that are due at `due`.
+  void schedule(MetadataJournal *journal, Clock::time_point due) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      due_[journal] = due;
+    }
+    wake_.notify_all();
+  }
+
+private:
+  void run();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::thread thread_;
+  bool running_ = false;
+  bool stopping_ = false;
+  std::size_t journals_ = 0;
+  std::map<MetadataJournal *, Clock::time_point> due_;
+  /// The journal being written outside the lock, kept alive by remove().
+  MetadataJournal *busy_ = nullptr;
+};
+
+namespace {
+JournalWriter &journal_writer();
+} // namespace
+#endif
+
+/**
+ * The write side of one sidecar: queued journal lines, handing them to the
+ * writer thread, and compaction. All disk access to the sidecar and its
+ * journal goes through here, under one lock.
+ */
+class MetadataJournal {
+public:
+  explicit MetadataJournal(std::filesystem::path sidecar_path)
+      : sidecar_path_(std::move(sidecar_path)),
+        journal_path_(journal_path_for(sidecar_path_)) {
+#if !defined(MEGATOY_PLATFORM_WEB)
+    journal_writer().add();
+#endif
+  }
+
+  ~MetadataJournal() {
+#if !defined(MEGATOY_PLATFORM_WEB)
+    journal_writer().remove(this);
+#endif
+    std::lock_guard<std::mutex> lock(mutex_);
+    compact_locked();
+  }
+
+  MetadataJournal(const MetadataJournal &) = delete;
+  MetadataJournal &operator=(const MetadataJournal &) = delete;
+
+  /// Everything written and queued so far. False on an unreadable sidecar.
+  bool read(Entries &entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_pending_locked();
+    DiskState state;
+    if (!read_disk_state(sidecar_path_, state)) {
+      return false;
+    }
+    adopt_locked(state);
+    // Appending after a cut-short line would bury every later line behind
+    // it, so a torn journal is folded away before anything else is written.
+    if (state.torn && write_sidecar(sidecar_path_, state.entries,
+                                    state.sequence)) {
+      remove_journal_locked();
+    }
+    entries = std::move(state.entries);
+    return true;
+  }
+
+  void append(nlohmann::json record) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!sequence_known_) {
+      DiskState state;
+      read_disk_state(sidecar_path_, state);
+      adopt_locked(state);
+    }
+    record["seq"] = ++sequence_;
+    pending_.push_back(record.dump());
+#if defined(MEGATOY_PLATFORM_WEB)
+    // No thread to hand this to; an append is still far cheaper than
+    // rewriting the sidecar.
+    if (write_pending_locked() && journal_lines_ >= kCompactAfter) {
+      compact_locked();
+    }
+#else
+    const auto now = Clock::now();
+    if (pending_.size() == 1) {
+      first_change_ = now;
+    }
+    last_change_ = now;
+    const auto due = due_locked();
+    // Not under our lock: the writer takes its own lock before ours.
+    lock.unlock();
+    journal_writer().schedule(this, due);
+#endif
+  }
+
+#if !defined(MEGATOY_PLATFORM_WEB)
+  /**
+   * Write the queued lines if they are due, from the writer thread. Returns
+   * when to come back if some are left queued.
+   */
+  std::optional<Clock::time_point> write_due() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.empty()) {
+      return std::nullopt;
+    }
+    const auto due = due_locked();
+    if (Clock::now() < due) {
+      return due;
+    }
+    if (!write_pending_locked()) {
+      // Back off instead of spinning on a disk that keeps refusing.
+      first_change_ = last_change_ = Clock::now();
+      return due_locked();
+    }
+    if (journal_lines_ >= kCompactAfter) {
+      compact_locked();
+    }
+    return std::nullopt;
+  }
+#endif
+
+  bool flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return write_pending_locked();
+  }
+
+  bool compact() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compact_locked();
+  }
+
+private:
+  void adopt_locked(const DiskState &state) {
+    sequence_ = std::max(sequence_, state.sequence);
+    journal_lines_ = state.journal_lines;
+    sequence_known_ = true;
+  }
+
+  bool write_pending_locked() {
+    if (pending_.empty()) {
+      return true;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(journal_path_.parent_path(), ec);
+    std::ofstream file(journal_path_, std::ios::app);
+    for (const auto &line : pending_) {
+      file << line << "\n";
+    }
+    file.flush();
+    if (!file) {
+      // Kept queued: the next flush tries again.
+      std::cerr << "Failed to append to " << journal_path_ << "\n";
+      return false;
+    }
+    journal_lines_ += pending_.size();
+    pending_.clear();
+    return true;
+  }
+
+  void remove_journal_locked() {
+    std::error_code ec;
+    std::filesystem::remove(journal_path_, ec);
+    journal_lines_ = 0;
+  }
+
+  bool compact_locked() {
+    if (!write_pending_locked()) {
+      return false;
+    }
+    std::error_code ec;
+    if (!std::filesystem::exists(journal_path_, ec)) {
+      journal_lines_ = 0;
+      return true;
+    }
+    // Folded from disk rather than from any one store's map: two stores on
+    // the same sidecar each hold only their own view.
+    DiskState state;
+    if (!read_disk_state(sidecar_path_, state) ||
+        !write_sidecar(sidecar_path_, state.entries, state.sequence)) {
+      return false;
+    }
+    remove_journal_locked();
+    return true;
+  }
+
+#if !defined(MEGATOY_PLATFORM_WEB)
+  Clock::time_point due_locked() const {
+    return std::min(last_change_ + kQuietPeriod, first_change_ + kMaxDelay);
+  }
+#endif
+
+  const std::filesystem::path sidecar_path_;
+  const std::filesystem::path journal_path_;
+
+  std::mutex mutex_;
+  std::vector<std::string> pending_;
+  std::uint64_t sequence_ = 0;
+  bool sequence_known_ = false;
+  std::size_t journal_lines_ = 0;
+#if !defined(MEGATOY_PLATFORM_WEB)
+  Clock::time_point first_change_;
+  Clock::time_point last_change_;
+#endif
+};
+
+#if !defined(MEGATOY_PLATFORM_WEB)
+void JournalWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_ && journals_ != 0) {
+    if (due_.empty()) {
+      wake_.wait(lock);
+      continue;
+    }
+    const auto next =
+        std::min_element(due_.begin(), due_.end(), [](const auto &a,
+                                                      const auto &b) {
+          return a.second < b.second;
+        });
+    // A copy: the entry may be erased while this waits.
+    const auto due = next->second;
+    if (Clock::now() < due) {
+      wake_.wait_until(lock, due);
+      continue;
+    }
+    auto *journal = next->first;
+    due_.erase(next);
+    busy_ = journal;
+    lock.unlock();
+    const auto again = journal->write_due();
+    lock.lock();
+    busy_ = nullptr;
+    idle_.notify_all();
+    if (again) {
+      // An append made meanwhile may already have scheduled it.
+      const auto [it, inserted] = due_.try_emplace(journal, *again);
+      if (!inserted) {
+        it->second = std::min(it->second, *again);
+      }
+    }
+  }
+  running_ = false;
+}
+#endif
+
+namespace {
+
+/**
+ * One journal per sidecar, for as long as any store has it open. A store
+ * opening a sidecar waits while the last store to close it is still
+ * compacting, so the two never touch the files at once; other sidecars open
+ * and close meanwhile.
+ */
+struct JournalRegistry {
+#if !defined(MEGATOY_PLATFORM_WEB)
+  /// First, so it outlives every journal still open at exit.
+  JournalWriter writer;
+#endif
+  std::mutex mutex;
+  std::condition_variable closed;
+  std::map<std::filesystem::path, std::shared_ptr<MetadataJournal>> open;
+  std::set<std::filesystem::path> closing;
+};
+
+JournalRegistry &journal_registry() {
+  static JournalRegistry registry;
+  return registry;
+}
+
+#if !defined(MEGATOY_PLATFORM_WEB)
+JournalWriter &journal_writer() { return journal_registry().writer; }
+#endif
+
+std::shared_ptr<MetadataJournal>
+acquire_journal(const std::filesystem::path &sidecar_path) {
+  auto &registry = journal_registry();
+  const auto key = sidecar_path.lexically_normal();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  registry.closed.wait(lock,
+                       [&] { return !registry.closing.contains(key); });
+  auto &journal = registry.open[key];
+  if (!journal) {
+    journal = std::make_shared<MetadataJournal>(sidecar_path);
+  }
+  return journal;
+}
+
+void release_journal(const std::filesystem::path &sidecar_path,
+                     std::shared_ptr<MetadataJournal> journal) {
+  auto &registry = journal_registry();
+  const auto key = sidecar_path.lexically_normal();
+  std::shared_ptr<MetadataJournal> last;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    journal.reset();
+    const auto it = registry.open.find(key);
+    // Only the registry's own reference left: this store was the last.
+    if (it != registry.open.end() && it->second.use_count() == 1) {
+      last = std::move(it->second);
+      registry.open.erase(it);
+      registry.closing.insert(key);
+    }
+  }
+  if (!last) {
+    return;
+  }
+  // Destroying the journal compacts it: disk work, so not under the lock.
+  last.reset();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.closing.erase(key);
+  }
+  registry.closed.notify_all();
+}
+
+} // namespace
+
+FolderMetadataStore::FolderMetadataStore(std::filesystem::path sidecar_path)
+    : sidecar_path_(std::move(sidecar_path)),
+      journal_(acquire_journal(sidecar_path_)) {}
+
+FolderMetadataStore::~FolderMetadataStore() {
+  release_journal(sidecar_path_, std::move(journal_));
+}
+
+bool FolderMetadataStore::load() {
+  entries_.clear();
+  if (!journal_->read(entries_)) {
+    entries_.clear();
+    return false;
+  }
+
+  std::vector<PatchMetadata> normalized;
+  for (const auto &[path, metadata] : entries_) {
+    std::string lower_path = path;
+    std::transform(
+        lower_path.begin(), lower_path.end(), lower_path.begin(),
+        [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    if (!lower_path.ends_with(".ginpkg")) {
+      continue;
+    }
+
+    const std::string latest_path = path + "/latest";
+    if (!entries_.contains(latest_path)) {
+      auto latest = metadata;
+      latest.path = latest_path;
+      normalized.push_back(std::move(latest));
+    }
+  }
+  for (auto &metadata : normalized) {
+    journal_->append(put_record(metadata));
+    const std::string path = metadata.path;
+    entries_.emplace(path, std::move(metadata));
+  }
+  return true;
+}
+
+bool FolderMetadataStore::flush() { return journal_->flush(); }
+
+bool FolderMetadataStore::compact() { return journal_->compact(); }
+
 std::optional<PatchMetadata>
 FolderMetadataStore::get(const std::string &relative_path) const {
   const auto it = entries_.find(relative_path);
@@ -227,8 +777,9 @@ bool FolderMetadataStore::put(PatchMetadata metadata) {
   }
   metadata.updated_at = now;
 
+  journal_->append(put_record(metadata));
   entries_[metadata.path] = std::move(metadata);
-  return save();
+  return true;
 }
 
 bool FolderMetadataStore::merge_missing(
@@ -239,13 +790,16 @@ bool FolderMetadataStore::merge_missing(
       continue;
     }
     if (entries_.emplace(entry.path, entry).second) {
+      journal_->append(put_record(entry));
       ++inserted;
     }
   }
   if (inserted == 0) {
     return true;
   }
-  if (save()) {
+  // A one-off import whose caller records success only once it is on disk,
+  // so it is written through rather than left to the writer thread.
+  if (journal_->compact()) {
     return true;
   }
 
@@ -260,7 +814,8 @@ bool FolderMetadataStore::remove(const std::string &relative_path) {
   if (entries_.erase(relative_path) == 0) {
     return false;
   }
-  return save();
+  journal_->append(remove_record({relative_path}));
+  return true;
 }
 
 bool FolderMetadataStore::rename_key_prefix(
@@ -272,33 +827,10 @@ bool FolderMetadataStore::rename_key_prefix(
   if (old_relative_path == new_relative_path) {
     return true;
   }
-
-  const std::string old_prefix = old_relative_path + "/";
-  std::vector<std::pair<std::string, PatchMetadata>> moved;
-  for (const auto &[key, metadata] : entries_) {
-    if (key == old_relative_path || key.rfind(old_prefix, 0) == 0) {
-      const std::string suffix = key.substr(old_relative_path.size());
-      auto renamed = metadata;
-      renamed.path = new_relative_path + suffix;
-      moved.emplace_back(key, std::move(renamed));
-    }
+  if (move_key_prefix(entries_, old_relative_path, new_relative_path)) {
+    journal_->append(rename_record(old_relative_path, new_relative_path));
   }
-  if (moved.empty()) {
-    return true;
-  }
-
-  const auto previous = entries_;
-  for (const auto &[old_key, metadata] : moved) {
-    entries_.erase(old_key);
-  }
-  for (auto &[old_key, metadata] : moved) {
-    entries_.insert_or_assign(metadata.path, std::move(metadata));
-  }
-  if (save()) {
-    return true;
-  }
-  entries_ = previous;
-  return false;
+  return true;
 }
 
 bool FolderMetadataStore::retain_only(
@@ -306,20 +838,20 @@ bool FolderMetadataStore::retain_only(
   std::vector<std::string> sorted = existing_paths;
   std::sort(sorted.begin(), sorted.end());
 
-  bool changed = false;
+  std::vector<std::string> dropped;
   for (auto it = entries_.begin(); it != entries_.end();) {
     if (std::binary_search(sorted.begin(), sorted.end(), it->first)) {
       ++it;
     } else {
+      dropped.push_back(it->first);
       it = entries_.erase(it);
-      changed = true;
     }
   }
 
-  if (!changed) {
-    return true;
+  if (!dropped.empty()) {
+    journal_->append(remove_record(dropped));
   }
-  return save();
+  return true;
 }
 
 } // namespace patches
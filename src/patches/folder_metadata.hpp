@@ -2,17 +2,21 @@
 
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 namespace patches {
 
+class MetadataJournal;
+
 struct PatchMetadata {
   std::string path;     ///< Path relative to the folder that owns the sidecar.
   std::string hash;     ///< Hash of the patch content.
   int star_rating = 0;  ///< 0-5.
   std::string category; ///< Free-form (bass, strings, ...).
+  bool hidden = false;  ///< Left out of the browser, e.g. as a duplicate.
 
   std::vector<std::string> tags;
   std::string notes;
@@ -29,12 +33,30 @@ struct PatchMetadata {
  * by absolute path, means a folder can be moved, copied, synced or shared and
  * its ratings travel with it.
  *
- * Everything is held in memory and rewritten on change; a folder holds at
- * most a few thousand patches, so there is nothing to gain from a database.
+ * Everything is held in memory; a folder holds at most a few thousand
+ * patches, so there is nothing to gain from a database. Changes are not
+ * written to the sidecar one by one, though: each is appended as one line to
+ * a journal next to it (patches.journal) once edits pause, by one
+ * background thread shared by every open folder. The journal is folded back
+ * into the sidecar every few hundred lines and when the last store for the
+ * folder closes. Rating a few hundred
+ * patches in a row used to serialize the whole sidecar once per click.
+ *
+ * Loading replays whatever journal is left over, so a crash loses at most
+ * the edits of the last fraction of a second. The sidecar itself keeps its
+ * old layout, and older releases read it unchanged once it is compacted.
+ *
+ * Every store for the same sidecar shares one journal, so a second store
+ * opened while edits are still queued sees them.
  */
 class FolderMetadataStore {
 public:
   explicit FolderMetadataStore(std::filesystem::path sidecar_path);
+  /// The last store for a sidecar to close compacts its journal.
+  ~FolderMetadataStore();
+
+  FolderMetadataStore(const FolderMetadataStore &) = default;
+  FolderMetadataStore &operator=(const FolderMetadataStore &) = delete;
 
   /// Load the sidecar. A missing file is not an error -- it just means no
   /// metadata has been recorded yet. Returns false only on a corrupt file.
@@ -42,33 +64,38 @@ public:
 
   std::optional<PatchMetadata> get(const std::string &relative_path) const;
 
-  /// Insert or replace, stamping created_at/updated_at, then persist.
+  /// Insert or replace, stamping created_at/updated_at, then queue the
+  /// write.
   bool put(PatchMetadata metadata);
 
-  /** Add entries that are not already present and persist them in one write.
-   * Existing sidecar data always wins over legacy imported data.
+  /** Add entries that are not already present and persist them before
+   * returning. Existing sidecar data always wins over legacy imported data.
    */
   bool merge_missing(const std::vector<PatchMetadata> &metadata,
                      std::size_t &inserted);
 
   bool remove(const std::string &relative_path);
 
-  /// Move one key and all descendant keys to a new path prefix, then persist
-  /// the complete migration in one sidecar write.
+  /// Move one key and all descendant keys to a new path prefix, queued as a
+  /// single journal line so a crash cannot leave half of them moved.
   bool rename_key_prefix(const std::string &old_relative_path,
                          const std::string &new_relative_path);
 
   /// Drop entries whose patch file is no longer in `existing_paths`.
   bool retain_only(const std::vector<std::string> &existing_paths);
 
+  /// Write queued changes to the journal now. False if that failed.
+  bool flush();
+  /// Fold the journal into the sidecar now. False if that failed.
+  bool compact();
+
   const std::filesystem::path &sidecar_path() const { return sidecar_path_; }
   bool empty() const { return entries_.empty(); }
 
 private:
-  bool save() const;
-
   std::filesystem::path sidecar_path_;
   std::map<std::string, PatchMetadata> entries_;
+  std::shared_ptr<MetadataJournal> journal_;
 };
 
 } // namespace patches
@@ -0,0 +1,449 @@
+#include "patch_index.hpp"
+
+#include "core/utf8_utils.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include <utility>
+
+namespace patches {
+
+namespace {
+
+/// How many of each record a tree needs, so every vector in the arena can be
+/// sized once.
+struct Counts {
+  std::size_t nodes = 0;
+  std::size_t patches = 0;
+  std::size_t metadata = 0;
+  std::size_t tags = 0;
+};
+
+void count_records(const std::vector<PatchEntry> &items, Counts &counts) {
+  counts.nodes += items.size();
+  for (const auto &item : items) {
+    if (item.metadata) {
+      ++counts.metadata;
+      counts.tags += item.metadata->tags.size();
+    }
+    if (item.is_directory) {
+      count_records(item.children, counts);
+    } else {
+      ++counts.patches;
+    }
+  }
+}
+
+} // namespace
+
+/**
+ * One pass over the nested tree. The intern table only lives for the build:
+ * its keys point into the arena, and nothing needs to look a string up by
+ * value once the nodes hold their ids.
+ */
+class PatchIndex::Builder {
+public:
+  explicit Builder(Data &data) : data_(data) {}
+
+  void add_level(const std::vector<PatchEntry> &items, NodeId parent,
+                 const std::string &parent_path) {
+    NodeId previous = kNoNode;
+    for (const auto &item : items) {
+      const NodeId id = add_node(item, parent, parent_path);
+      if (previous == kNoNode) {
+        if (parent == kNoNode) {
+          data_.first_root = id;
+        } else {
+          data_.nodes[parent].first_child = id;
+        }
+      } else {
+        data_.nodes[previous].next_sibling = id;
+      }
+      previous = id;
+
+      if (item.is_directory && !item.children.empty()) {
+        add_level(item.children, id, item.relative_path);
+      }
+    }
+  }
+
+  std::size_t string_bytes() const { return string_bytes_; }
+
+  /// Move the interned strings into the arena, now that their number is
+  /// known.
+  void finish() {
+    data_.strings.reserve(strings_.size());
+    data_.strings.assign(strings_.begin(), strings_.end());
+  }
+
+private:
+  NodeId add_node(const PatchEntry &item, NodeId parent,
+                  const std::string &parent_path) {
+    Node node{};
+    node.parent = parent;
+    node.first_child = kNoNode;
+    node.next_sibling = kNoNode;
+    node.name = intern(item.name);
+    node.folded_name = intern(megatoy::utf8::fold_case(item.name));
+    node.format = intern(item.format);
+    node.full_path = intern(item.full_path.generic_string());
+    node.source_relative_path = intern(item.source_relative_path);
+    node.container_item_id = intern(item.container_item_id);
+    node.instrument_index = static_cast<std::uint32_t>(item.instrument_index);
+    node.metadata = kNoMetadata;
+    node.patch = kNoPatch;
+    node.is_directory = item.is_directory;
+    node.children_pending = item.children_pending;
+
+    const std::string_view path = item.relative_path;
+    const bool extends_parent =
+        parent != kNoNode && path.size() > parent_path.size() + 1 &&
+        path.compare(0, parent_path.size(), parent_path) == 0 &&
+        path[parent_path.size()] == '/';
+    node.segment_is_full = !extends_parent;
+    node.segment = intern(extends_parent ? path.substr(parent_path.size() + 1)
+                                         : path);
+
+    if (item.metadata) {
+      node.metadata = static_cast<std::uint32_t>(data_.metadata.size());
+      MetadataRecord record{};
+      record.category = intern(item.metadata->category);
+      record.folded_category =
+          intern(megatoy::utf8::fold_case(item.metadata->category));
+      record.notes = intern(item.metadata->notes);
+      record.first_tag = static_cast<std::uint32_t>(data_.tags.size());
+      record.tag_count = static_cast<std::uint32_t>(item.metadata->tags.size());
+      record.star_rating =
+          static_cast<std::uint8_t>(item.metadata->star_rating);
+      record.hidden = item.metadata->hidden;
+      for (const auto &tag : item.metadata->tags) {
+        data_.tags.push_back(intern(tag));
+      }
+      data_.metadata.push_back(record);
+    }
+
+    const auto id = static_cast<NodeId>(data_.nodes.size());
+    if (!item.is_directory) {
+      node.patch = static_cast<PatchId>(data_.patches.size());
+      data_.patches.push_back(id);
+    }
+    if (parent != kNoNode) {
+      ++data_.nodes[parent].child_count;
+    }
+    data_.nodes.push_back(node);
+    return id;
+  }
+
+  StringId intern(std::string_view value) {
+    if (auto found = ids_.find(value); found != ids_.end()) {
+      return found->second;
+    }
+    char *storage = static_cast<char *>(
+        data_.arena.allocate(value.size() + 1, alignof(char)));
+    std::memcpy(storage, value.data(), value.size());
+    storage[value.size()] = '\0';
+    string_bytes_ += value.size() + 1;
+
+    const std::string_view stored(storage, value.size());
+    const auto id = static_cast<StringId>(strings_.size());
+    strings_.push_back(stored);
+    ids_.emplace(stored, id);
+    return id;
+  }
+
+  Data &data_;
+  std::unordered_map<std::string_view, StringId> ids_;
+  /// Collected on the heap, where regrowing frees what it leaves behind.
+  std::vector<std::string_view> strings_;
+  std::size_t string_bytes_ = 0;
+};
+
+PatchIndex::PatchIndex() : data_(std::make_unique<Data>()) {}
+
+PatchIndex PatchIndex::build(const std::vector<PatchEntry> &tree) {
+  PatchIndex index;
+  Data &data = *index.data_;
+
+  // The monotonic arena never reuses freed blocks, so every vector in it is
+  // sized once, from a counting pass, instead of being allowed to regrow.
+  Counts counts;
+  count_records(tree, counts);
+  data.nodes.reserve(counts.nodes);
+  data.patches.reserve(counts.patches);
+  data.metadata.reserve(counts.metadata);
+  data.tags.reserve(counts.tags);
+
+  Builder builder(data);
+  builder.add_level(tree, kNoNode, {});
+  builder.finish();
+
+  data.arena_bytes = builder.string_bytes() +
+                     data.nodes.capacity() * sizeof(Node) +
+                     data.strings.capacity() * sizeof(std::string_view) +
+                     data.metadata.capacity() * sizeof(MetadataRecord) +
+                     data.tags.capacity() * sizeof(StringId) +
+                     data.patches.capacity() * sizeof(NodeId);
+  return index;
+}
+
+PatchEntry PatchIndex::entry(NodeId node) const {
+  const Node &current = data_->nodes[node];
+  PatchEntry entry;
+  entry.name = string(current.name);
+  entry.relative_path = relative_path(node);
+  entry.full_path = std::filesystem::path(string(current.full_path));
+  entry.format = string(current.format);
+  entry.is_directory = current.is_directory;
+  entry.children_pending = current.children_pending;
+  entry.instrument_index = current.instrument_index;
+  entry.source_relative_path = string(current.source_relative_path);
+  entry.container_item_id = string(current.container_item_id);
+  if (current.metadata != kNoMetadata) {
+    const auto &record = data_->metadata[current.metadata];
+    PatchMetadata metadata;
+    metadata.path = entry.relative_path;
+    metadata.star_rating = record.star_rating;
+    metadata.category = string(record.category);
+    metadata.hidden = record.hidden;
+    metadata.notes = string(record.notes);
+    for (const auto tag : tags(node)) {
+      metadata.tags.emplace_back(string(tag));
+    }
+    entry.metadata = std::move(metadata);
+  }
+  return entry;
+}
+
+void PatchIndex::set_metadata(NodeId node,
+                              const std::optional<PatchMetadata> &metadata) {
+  Node &current = data_->nodes[node];
+  if (!metadata) {
+    current.metadata = kNoMetadata;
+    return;
+  }
+  const bool fresh = current.metadata == kNoMetadata;
+  if (fresh) {
+    current.metadata = static_cast<std::uint32_t>(data_->metadata.size());
+    data_->metadata.push_back(MetadataRecord{});
+  }
+  auto &record = data_->metadata[current.metadata];
+  record.star_rating = static_cast<std::uint8_t>(metadata->star_rating);
+  record.hidden = metadata->hidden;
+  if (fresh || string(record.category) != metadata->category) {
+    record.category = add_string(metadata->category);
+    record.folded_category =
+        add_string(megatoy::utf8::fold_case(metadata->category));
+  }
+  if (fresh || string(record.notes) != metadata->notes) {
+    record.notes = add_string(metadata->notes);
+  }
+
+  const auto &new_tags = metadata->tags;
+  bool same_tags = !fresh && record.tag_count == new_tags.size();
+  for (std::size_t i = 0; same_tags && i < new_tags.size(); ++i) {
+    same_tags = string(data_->tags[record.first_tag + i]) == new_tags[i];
+  }
+  if (same_tags) {
+    return;
+  }
+  // Fewer or as many tags fit where the old ones were.
+  if (fresh || new_tags.size() > record.tag_count) {
+    record.first_tag = static_cast<std::uint32_t>(data_->tags.size());
+    data_->tags.resize(data_->tags.size() + new_tags.size());
+  }
+  record.tag_count = static_cast<std::uint32_t>(new_tags.size());
+  for (std::size_t i = 0; i < new_tags.size(); ++i) {
+    data_->tags[record.first_tag + i] = add_string(new_tags[i]);
+  }
+}
+
+PatchIndex::StringId PatchIndex::add_string(std::string_view value) {
+  char *storage = static_cast<char *>(
+      data_->arena.allocate(value.size() + 1, alignof(char)));
+  std::memcpy(storage, value.data(), value.size());
+  storage[value.size()] = '\0';
+  data_->arena_bytes += value.size() + 1;
+  const auto id = static_cast<StringId>(data_->strings.size());
+  data_->strings.emplace_back(storage, value.size());
+  return id;
+}
+
+std::vector<PatchEntry> PatchIndex::to_tree() const {
+  std::vector<PatchEntry> tree;
+  append_level(data_->first_root, tree);
+  return tree;
+}
+
+void PatchIndex::append_level(NodeId first,
+                              std::vector<PatchEntry> &out) const {
+  for (NodeId node = first; node != kNoNode;
+       node = data_->nodes[node].next_sibling) {
+    out.push_back(entry(node));
+    if (data_->nodes[node].is_directory) {
+      append_level(data_->nodes[node].first_child, out.back().children);
+    }
+  }
+}
+
+bool PatchIndex::same_listing(const PatchIndex &other) const {
+  const auto &left = data_->nodes;
+  const auto &right = other.data_->nodes;
+  if (left.size() != right.size() ||
+      data_->first_root != other.data_->first_root) {
+    return false;
+  }
+  const auto same_string = [&](StringId a, StringId b) {
+    return string(a) == other.string(b);
+  };
+  for (std::size_t i = 0; i < left.size(); ++i) {
+    const Node &a = left[i];
+    const Node &b = right[i];
+    if (a.parent != b.parent || a.first_child != b.first_child ||
+        a.next_sibling != b.next_sibling ||
+        a.is_directory != b.is_directory ||
+        a.children_pending != b.children_pending ||
+        a.instrument_index != b.instrument_index ||
+        a.segment_is_full != b.segment_is_full ||
+        !same_string(a.name, b.name) || !same_string(a.segment, b.segment) ||
+        !same_string(a.format, b.format) ||
+        !same_string(a.full_path, b.full_path) ||
+        !same_string(a.source_relative_path, b.source_relative_path) ||
+        !same_string(a.container_item_id, b.container_item_id) ||
+        (a.metadata == kNoMetadata) != (b.metadata == kNoMetadata)) {
+      return false;
+    }
+    if (a.metadata == kNoMetadata) {
+      continue;
+    }
+    const auto &x = data_->metadata[a.metadata];
+    const auto &y = other.data_->metadata[b.metadata];
+    if (x.star_rating != y.star_rating || x.hidden != y.hidden ||
+        !same_string(x.category, y.category) ||
+        !same_string(x.notes, y.notes) || x.tag_count != y.tag_count) {
+      return false;
+    }
+    for (std::uint32_t t = 0; t < x.tag_count; ++t) {
+      if (!same_string(data_->tags[x.first_tag + t],
+                       other.data_->tags[y.first_tag + t])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+PatchIndex::ChildRange PatchIndex::roots() const {
+  return ChildRange(this, data_->first_root);
+}
+
+PatchIndex::ChildRange PatchIndex::children(NodeId node) const {
+  return ChildRange(this, data_->nodes[node].first_child);
+}
+
+std::string_view PatchIndex::name(NodeId node) const {
+  return string(data_->nodes[node].name);
+}
+
+std::string_view PatchIndex::folded_name(NodeId node) const {
+  return string(data_->nodes[node].folded_name);
+}
+
+std::string_view PatchIndex::format(NodeId node) const {
+  return string(data_->nodes[node].format);
+}
+
+std::string_view PatchIndex::full_path(NodeId node) const {
+  return string(data_->nodes[node].full_path);
+}
+
+std::string_view PatchIndex::source_relative_path(NodeId node) const {
+  return string(data_->nodes[node].source_relative_path);
+}
+
+std::string PatchIndex::relative_path(NodeId node) const {
+  std::string path;
+  append_relative_path(node, path);
+  return path;
+}
+
+void PatchIndex::append_relative_path(NodeId node, std::string &out) const {
+  const Node &current = data_->nodes[node];
+  if (!current.segment_is_full) {
+    append_relative_path(current.parent, out);
+    out.push_back('/');
+  }
+  out.append(string(current.segment));
+}
+
+bool PatchIndex::has_metadata(NodeId node) const {
+  return data_->nodes[node].metadata != kNoMetadata;
+}
+
+int PatchIndex::star_rating(NodeId node) const {
+  const auto handle = data_->nodes[node].metadata;
+  return handle == kNoMetadata ? 0 : data_->metadata[handle].star_rating;
+}
+
+bool PatchIndex::hidden(NodeId node) const {
+  const auto handle = data_->nodes[node].metadata;
+  return handle != kNoMetadata && data_->metadata[handle].hidden;
+}
+
+std::string_view PatchIndex::category(NodeId node) const {
+  const auto handle = data_->nodes[node].metadata;
+  return handle == kNoMetadata ? std::string_view{}
+                               : string(data_->metadata[handle].category);
+}
+
+std::string_view PatchIndex::folded_category(NodeId node) const {
+  const auto handle = data_->nodes[node].metadata;
+  return handle == kNoMetadata
+             ? std::string_view{}
+             : string(data_->metadata[handle].folded_category);
+}
+
+std::span<const PatchIndex::StringId> PatchIndex::tags(NodeId node) const {
+  const auto handle = data_->nodes[node].metadata;
+  if (handle == kNoMetadata) {
+    return {};
+  }
+  const auto &record = data_->metadata[handle];
+  return std::span<const StringId>(data_->tags)
+      .subspan(record.first_tag, record.tag_count);
+}
+
+std::optional<PatchIndex::NodeId>
+PatchIndex::find(std::string_view relative_path) const {
+  // `consumed` is how much of the path the ancestors matched; a full-path
+  // segment is compared from the start instead.
+  std::size_t consumed = 0;
+  NodeId first = data_->first_root;
+  while (first != kNoNode) {
+    NodeId next_level = kNoNode;
+    std::size_t next_consumed = 0;
+    for (NodeId child = first; child != kNoNode;
+         child = data_->nodes[child].next_sibling) {
+      const Node &node = data_->nodes[child];
+      const std::size_t offset = node.segment_is_full ? 0 : consumed;
+      const std::string_view segment = string(node.segment);
+      const std::string_view rest = relative_path.substr(offset);
+      if (rest.substr(0, segment.size()) != segment) {
+        continue;
+      }
+      if (rest.size() == segment.size()) {
+        return child;
+      }
+      if (rest[segment.size()] == '/' && node.first_child != kNoNode) {
+        next_level = node.first_child;
+        next_consumed = offset + segment.size() + 1;
+        break;
+      }
+    }
+    first = next_level;
+    consumed = next_consumed;
+  }
+  return std::nullopt;
+}
+
+} // namespace patches
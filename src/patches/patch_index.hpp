@@ -0,0 +1,233 @@
+#pragma once
+
+#include "patch_repository.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace patches {
+
+/**
+ * A flat view of the repository tree, rebuilt once per refresh.
+ *
+ * The nested PatchEntry tree stays the storage layer's interchange format --
+ * storages append into it and the persistent parse cache serialises it -- but
+ * walking it is expensive: every node is a separate allocation, and every
+ * bank instrument repeats its container's full path and relative-path prefix.
+ * The index lays the same nodes out in one vector, addressed by NodeId:
+ *
+ *   - Strings (names, formats, path segments, full paths, categories, tags)
+ *     are interned once into a monotonic arena, so the 128 instruments of a
+ *     bank share one copy of the container path. Each is stored with a
+ *     trailing NUL, so the views' data() can go straight to ImGui.
+ *   - A node stores only its own path segment; the relative path is the
+ *     parent's plus "/" plus the segment, rebuilt on demand.
+ *   - Metadata is reduced to what the browser filters and sorts on and is
+ *     stored out of line, behind a handle, for the nodes that have any.
+ *   - Files get dense PatchIds in tree order, so per-patch side tables can be
+ *     plain vectors.
+ *
+ * The index is the copy that is kept: the nested tree it is built from is
+ * dropped once the index exists. The load, rename and context-menu paths that
+ * still take a PatchEntry get one from entry(), put together for the call.
+ */
+class PatchIndex {
+public:
+  using NodeId = std::uint32_t;
+  using PatchId = std::uint32_t;
+  using StringId = std::uint32_t;
+
+  static constexpr NodeId kNoNode = std::numeric_limits<NodeId>::max();
+  static constexpr PatchId kNoPatch = std::numeric_limits<PatchId>::max();
+
+  /// Iterates the children of one node (or the roots) through the sibling
+  /// links, without materialising a list.
+  class ChildRange {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = NodeId;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const NodeId *;
+      using reference = NodeId;
+
+      iterator() = default;
+      iterator(const PatchIndex *index, NodeId node)
+          : index_(index), node_(node) {}
+
+      NodeId operator*() const { return node_; }
+      iterator &operator++() {
+        node_ = index_->data_->nodes[node_].next_sibling;
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator previous = *this;
+        ++*this;
+        return previous;
+      }
+      bool operator==(const iterator &other) const {
+        return node_ == other.node_;
+      }
+
+    private:
+      const PatchIndex *index_ = nullptr;
+      NodeId node_ = kNoNode;
+    };
+
+    ChildRange(const PatchIndex *index, NodeId first)
+        : index_(index), first_(first) {}
+
+    iterator begin() const { return iterator(index_, first_); }
+    iterator end() const { return iterator(index_, kNoNode); }
+    bool empty() const { return first_ == kNoNode; }
+
+  private:
+    const PatchIndex *index_;
+    NodeId first_;
+  };
+
+  PatchIndex();
+
+  static PatchIndex build(const std::vector<PatchEntry> &tree);
+
+  bool empty() const { return data_->nodes.empty(); }
+  std::size_t node_count() const { return data_->nodes.size(); }
+  std::size_t patch_count() const { return data_->patches.size(); }
+
+  ChildRange roots() const;
+  ChildRange children(NodeId node) const;
+  NodeId parent(NodeId node) const { return data_->nodes[node].parent; }
+  std::size_t child_count(NodeId node) const {
+    return data_->nodes[node].child_count;
+  }
+
+  bool is_directory(NodeId node) const {
+    return data_->nodes[node].is_directory;
+  }
+  /// A folder a lazy walk listed without reading.
+  bool children_pending(NodeId node) const {
+    return data_->nodes[node].children_pending;
+  }
+  std::string_view name(NodeId node) const;
+  /// The name, case-folded, for the browser's substring search.
+  std::string_view folded_name(NodeId node) const;
+  std::string_view format(NodeId node) const;
+  /// The containing file in generic form; bank instruments share theirs.
+  std::string_view full_path(NodeId node) const;
+  /// For an instrument pulled out of a bank, the bank's own relative path.
+  std::string_view source_relative_path(NodeId node) const;
+  std::string relative_path(NodeId node) const;
+  void append_relative_path(NodeId node, std::string &out) const;
+
+  bool has_metadata(NodeId node) const;
+  int star_rating(NodeId node) const;
+  /// Marked to be left out of the browser.
+  bool hidden(NodeId node) const;
+  std::string_view category(NodeId node) const;
+  std::string_view folded_category(NodeId node) const;
+  std::span<const StringId> tags(NodeId node) const;
+  std::string_view string(StringId id) const { return data_->strings[id]; }
+
+  /// Files only; kNoPatch for directories.
+  PatchId patch_id(NodeId node) const { return data_->nodes[node].patch; }
+  /// Every file node in tree order, indexed by PatchId.
+  std::span<const NodeId> patches() const { return data_->patches; }
+
+  /**
+   * The node as a PatchEntry, without its children. Its metadata carries
+   * what the index keeps -- stars, category, hidden, tags and notes -- so an
+   * edit that writes metadata back starts from
+   * PatchRepository::get_patch_metadata() instead.
+   */
+  PatchEntry entry(NodeId node) const;
+  /// The whole tree the index was built from, put back together.
+  std::vector<PatchEntry> to_tree() const;
+  /// Whether both list the same entries, down to what the views show.
+  bool same_listing(const PatchIndex &other) const;
+
+  /// The node at `relative_path`, found by walking segments from the roots.
+  std::optional<NodeId> find(std::string_view relative_path) const;
+
+  /**
+   * Replace one patch's metadata, keeping its NodeId and PatchId, so a star
+   * or tag edit does not rebuild the index. Strings that change are added
+   * to the arena rather than interned; the next build reclaims them. Spans
+   * from tags() do not survive the call.
+   */
+  void set_metadata(NodeId node, const std::optional<PatchMetadata> &metadata);
+
+  /// Bytes handed out by the arena; a rough measure of the index footprint.
+  std::size_t arena_bytes() const { return data_->arena_bytes; }
+
+private:
+  class Builder;
+
+  void append_level(NodeId first, std::vector<PatchEntry> &out) const;
+  /// Copy `value` into the arena as a new string.
+  StringId add_string(std::string_view value);
+
+  static constexpr std::uint32_t kNoMetadata =
+      std::numeric_limits<std::uint32_t>::max();
+
+  struct Node {
+    NodeId parent;
+    NodeId first_child;
+    NodeId next_sibling;
+    std::uint32_t child_count;
+    StringId name;
+    StringId folded_name;
+    /// Path relative to the parent's; the whole relative path for roots and
+    /// for the odd child whose path does not extend its parent's.
+    StringId segment;
+    bool segment_is_full;
+    StringId format;
+    StringId full_path;
+    StringId source_relative_path;
+    StringId container_item_id;
+    std::uint32_t instrument_index;
+    std::uint32_t metadata;
+    PatchId patch;
+    bool is_directory;
+    bool children_pending;
+  };
+
+  struct MetadataRecord {
+    StringId category;
+    StringId folded_category;
+    StringId notes;
+    std::uint32_t first_tag;
+    std::uint32_t tag_count;
+    std::uint8_t star_rating;
+    bool hidden;
+  };
+
+  /**
+   * Everything lives behind one pointer so that moving the index never moves
+   * the arena out from under the containers allocated in it. The arena is
+   * declared first and therefore destroyed last.
+   */
+  struct Data {
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::vector<Node> nodes{&arena};
+    std::pmr::vector<std::string_view> strings{&arena};
+    std::pmr::vector<MetadataRecord> metadata{&arena};
+    std::pmr::vector<StringId> tags{&arena};
+    std::pmr::vector<NodeId> patches{&arena};
+    NodeId first_root = kNoNode;
+    std::size_t arena_bytes = 0;
+  };
+
+  std::unique_ptr<Data> data_;
+};
+
+} // namespace patches
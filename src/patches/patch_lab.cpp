@@ -418,6 +418,62 @@ std::vector<CategoryChoice> available_categories() {
   return category_choices();
 }
 
+std::vector<float> category_fit(const ym2612::Patch &patch) {
+  const auto &instrument = patch.instrument;
+  const auto modulator_count =
+      ym2612::algorithm_modulator_count[instrument.algorithm & 7];
+
+  std::vector<float> fits;
+  fits.reserve(kCategories.size());
+  for (const auto &definition : kCategories) {
+    int checked = 0;
+    int matched = 0;
+    const auto check = [&](const Range &range, int value) {
+      ++checked;
+      matched += value >= range.min && value <= range.max ? 1 : 0;
+    };
+
+    ++checked;
+    matched += std::find(definition.algorithms.begin(),
+                         definition.algorithms.end(),
+                         instrument.algorithm) != definition.algorithms.end()
+                   ? 1
+                   : 0;
+    check(definition.feedback, instrument.feedback);
+    check(definition.ams, patch.channel.amplitude_modulation_sensitivity);
+    check(definition.pms, patch.channel.frequency_modulation_sensitivity);
+    for (int i = 0; i < 4; ++i) {
+      const auto &op = instrument.operators[i];
+      const bool is_modulator = i < modulator_count;
+      check(is_modulator ? definition.mod_total_level
+                         : definition.carrier_total_level,
+            op.total_level);
+      check(is_modulator ? definition.mod_attack_rate
+                         : definition.carrier_attack_rate,
+            op.attack_rate);
+      check(is_modulator ? definition.mod_decay_rate
+                         : definition.carrier_decay_rate,
+            op.decay_rate);
+      check(is_modulator ? definition.mod_sustain_rate
+                         : definition.carrier_sustain_rate,
+            op.sustain_rate);
+      check(is_modulator ? definition.mod_release_rate
+                         : definition.carrier_release_rate,
+            op.release_rate);
+      check(is_modulator ? definition.mod_sustain_level
+                         : definition.carrier_sustain_level,
+            op.sustain_level);
+      check(is_modulator ? definition.mod_multiple
+                         : definition.carrier_multiple,
+            op.multiple);
+      check(is_modulator ? definition.mod_detune : definition.carrier_detune,
+            op.detune);
+    }
+    fits.push_back(static_cast<float>(matched) / static_cast<float>(checked));
+  }
+  return fits;
+}
+
 OperationResult merge(const ym2612::Patch &a, const ym2612::Patch &b,
                       const MergeOptions &options) {
   OperationResult result;
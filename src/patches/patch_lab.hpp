@@ -51,6 +51,13 @@ struct MutateResult {
 
 std::vector<CategoryChoice> available_categories();
 
+/**
+ * How well `patch` fits each of available_categories(), in that order: the
+ * share of the category's template ranges its settings fall within, 0..1.
+ * Operators are judged as modulators or carriers by the patch's algorithm.
+ */
+std::vector<float> category_fit(const ym2612::Patch &patch);
+
 OperationResult merge(const ym2612::Patch &a, const ym2612::Patch &b,
                       const MergeOptions &options = {});
 
@@ -0,0 +1,124 @@
+#include "patch_metadata_index.hpp"
+
+#include "core/utf8_utils.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace patches {
+
+PatchMetadataIndex::Bits::Bits(std::size_t size, bool value)
+    : words_((size + 63) / 64, value ? ~std::uint64_t{0} : 0), size_(size) {
+  // Bits past the end stay clear, so count() needs no mask.
+  if (value && size % 64 != 0) {
+    words_.back() = (std::uint64_t{1} << (size % 64)) - 1;
+  }
+}
+
+void PatchMetadataIndex::Bits::set(PatchIndex::PatchId patch, bool value) {
+  const auto mask = std::uint64_t{1} << (patch % 64);
+  if (value) {
+    words_[patch / 64] |= mask;
+  } else {
+    words_[patch / 64] &= ~mask;
+  }
+}
+
+std::size_t PatchMetadataIndex::Bits::count() const {
+  std::size_t total = 0;
+  for (const auto word : words_) {
+    total += static_cast<std::size_t>(std::popcount(word));
+  }
+  return total;
+}
+
+PatchMetadataIndex::Bits &
+PatchMetadataIndex::Bits::operator&=(const Bits &other) {
+  for (std::size_t i = 0; i < words_.size(); ++i) {
+    words_[i] &= i < other.words_.size() ? other.words_[i] : 0;
+  }
+  return *this;
+}
+
+PatchMetadataIndex PatchMetadataIndex::build(const PatchIndex &index) {
+  PatchMetadataIndex result;
+  result.size_ = index.patch_count();
+  for (auto &bits : result.at_least_) {
+    bits = Bits(result.size_, false);
+  }
+  for (const auto node : index.patches()) {
+    result.assign(index, node, /*clear=*/false);
+  }
+  return result;
+}
+
+PatchMetadataIndex::Bits
+PatchMetadataIndex::select(const Filter &filter) const {
+  Bits result(size_, true);
+  if (filter.min_stars > 0) {
+    const auto level = std::min(filter.min_stars, 5);
+    result = at_least_[static_cast<std::size_t>(level - 1)];
+  }
+  const auto narrow = [&](const std::unordered_map<std::string, Bits> &values,
+                          const std::string &value) {
+    const auto it = values.find(value);
+    if (it == values.end()) {
+      result = Bits(size_, false);
+    } else {
+      result &= it->second;
+    }
+  };
+  if (!filter.category.empty()) {
+    narrow(categories_, filter.category);
+  }
+  for (const auto &tag : filter.tags) {
+    narrow(tags_, tag);
+  }
+  return result;
+}
+
+void PatchMetadataIndex::update(const PatchIndex &index,
+                                PatchIndex::NodeId node) {
+  if (index.patch_id(node) >= size_) {
+    return;
+  }
+  assign(index, node, /*clear=*/true);
+}
+
+void PatchMetadataIndex::assign(const PatchIndex &index,
+                                PatchIndex::NodeId node, bool clear) {
+  const auto patch = index.patch_id(node);
+  const int stars = index.star_rating(node);
+  for (int level = 1; level <= 5; ++level) {
+    at_least_[static_cast<std::size_t>(level - 1)].set(patch, stars >= level);
+  }
+
+  // A fresh build has nothing to clear; an update does not know the old
+  // values, and there are few enough distinct ones to clear them all.
+  if (clear) {
+    for (auto &[value, bits] : categories_) {
+      bits.set(patch, false);
+    }
+    for (auto &[value, bits] : tags_) {
+      bits.set(patch, false);
+    }
+  }
+
+  const auto mark = [&](std::unordered_map<std::string, Bits> &values,
+                        std::string value) {
+    if (value.empty()) {
+      return;
+    }
+    auto [slot, inserted] = values.try_emplace(std::move(value));
+    if (inserted) {
+      slot->second = Bits(size_, false);
+    }
+    slot->second.set(patch, true);
+  };
+  mark(categories_, std::string(index.folded_category(node)));
+  for (const auto tag : index.tags(node)) {
+    mark(tags_, megatoy::utf8::fold_case(index.string(tag)));
+  }
+}
+
+} // namespace patches
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "patch_index.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace patches {
+
+/**
+ * Star ratings, categories and tags of every patch in a PatchIndex, kept as
+ * one bitset per value over its dense PatchIds.
+ *
+ * Filtering by metadata otherwise means visiting every patch and reading its
+ * record. Here "at least 4 stars, category bass, tagged lead" is a copy and
+ * two ANDs over n/64 words, whatever the size of the workspace.
+ *
+ * Categories and tags match whole and case-folded. A star or category edit
+ * moves one patch between bitsets through update(), so the index outlives
+ * the metadata writes that do not change the tree.
+ */
+class PatchMetadataIndex {
+public:
+  /// One bit per PatchId.
+  class Bits {
+  public:
+    Bits() = default;
+    Bits(std::size_t size, bool value);
+
+    std::size_t size() const { return size_; }
+    bool test(PatchIndex::PatchId patch) const {
+      return (words_[patch / 64] >> (patch % 64)) & 1u;
+    }
+    void set(PatchIndex::PatchId patch, bool value);
+    std::size_t count() const;
+
+    Bits &operator&=(const Bits &other);
+
+  private:
+    std::vector<std::uint64_t> words_;
+    std::size_t size_ = 0;
+  };
+
+  /// All conditions must hold; empty fields do not constrain.
+  struct Filter {
+    int min_stars = 0;
+    /// Case-folded.
+    std::string category;
+    /// Case-folded; a patch needs every one of them.
+    std::vector<std::string> tags;
+
+    bool empty() const {
+      return min_stars <= 0 && category.empty() && tags.empty();
+    }
+  };
+
+  static PatchMetadataIndex build(const PatchIndex &index);
+
+  std::size_t size() const { return size_; }
+
+  /// The patches passing `filter`; every patch when it is empty.
+  Bits select(const Filter &filter) const;
+
+  /// Re-read one patch's metadata from `index`, which must have the same
+  /// PatchIds as the index this was built from.
+  void update(const PatchIndex &index, PatchIndex::NodeId node);
+
+private:
+  void assign(const PatchIndex &index, PatchIndex::NodeId node, bool clear);
+
+  std::size_t size_ = 0;
+  /// at_least_[k - 1] holds the patches with k or more stars.
+  std::array<Bits, 5> at_least_;
+  std::unordered_map<std::string, Bits> categories_;
+  std::unordered_map<std::string, Bits> tags_;
+};
+
+} // namespace patches
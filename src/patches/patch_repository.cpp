@@ -1,34 +1,96 @@
 #include "patch_repository.hpp"
 #include "formats/patch_loader.hpp"
 #include "formats/ym2612_format_adapter.hpp"
+#include "patch_index.hpp"
+#include "patch_metadata_index.hpp"
+#include "patch_search_index.hpp"
 #include "patch_storage.hpp"
 #include "patches/filesystem_patch_storage.hpp"
 #include "patches/persistent_parse_cache.hpp"
 #include "platform/import_pipeline.hpp"
 #include "platform/platform_config.hpp"
+#include "platform/zip_file_system.hpp"
 #if defined(MEGATOY_PLATFORM_WEB)
 #include "platform/web/web_storage_persistence.hpp"
 #endif
 #include "ym2612/patch.hpp"
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 
 namespace patches {
 
+struct PatchRepository::BackgroundRefresh {
+  std::vector<std::shared_ptr<FilesystemPatchStorage>> storages;
+  std::vector<std::filesystem::path> watched_directories;
+  std::uint64_t storages_generation = 0;
+  std::string storages_key;
+  std::atomic<bool> cancel{false};
+  std::atomic<bool> finished{false};
+  std::thread worker;
+
+  // Written by the worker, read once `finished` is set.
+  PatchIndex index;
+  std::vector<std::filesystem::file_time_type> watched_times;
+  bool aborted = false;
+};
+
+struct PatchRepository::DirectoryListing {
+  std::vector<std::shared_ptr<FilesystemPatchStorage>> storages;
+  std::vector<std::string> folders;
+  std::uint64_t storages_generation = 0;
+  std::atomic<bool> cancel{false};
+  std::atomic<bool> finished{false};
+  std::thread worker;
+
+  // Written by the worker, read once `finished` is set: per folder, its
+  // children, or nullopt when it could not be listed.
+  std::vector<std::optional<std::vector<PatchEntry>>> children;
+};
+
+namespace {
+
+PatchEntry *find_in_tree(std::vector<PatchEntry> &entries,
+                         const std::string &relative_path) {
+  for (auto &entry : entries) {
+    if (entry.relative_path == relative_path) {
+      return &entry;
+    }
+    if (entry.is_directory &&
+        relative_path.rfind(entry.relative_path + "/", 0) == 0) {
+      return find_in_tree(entry.children, relative_path);
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
 PatchRepository::PatchRepository(
     platform::VirtualFileSystem &vfs,
     const megatoy::workspace::Workspace &workspace,
     const std::filesystem::path &builtin_presets_dir,
-    PersistentParseCache *persistent_cache)
+    PersistentParseCache *persistent_cache, bool show_builtin_presets,
+    bool lazy_scanning)
     : workspace_(workspace), builtin_presets_directory_(builtin_presets_dir),
-      vfs_(vfs), persistent_cache_(persistent_cache) {
+      vfs_(vfs), persistent_cache_(persistent_cache),
+      index_(std::make_unique<PatchIndex>()),
+      show_builtin_presets_(show_builtin_presets),
+      lazy_scanning_(lazy_scanning) {
   rebuild_storages();
   refresh();
 }
 
+PatchRepository::~PatchRepository() {
+  stop_background_refresh();
+  stop_directory_listing();
+}
+
 void PatchRepository::set_show_builtin_presets(bool show) {
   if (show == show_builtin_presets_) {
     return;
@@ -49,7 +111,16 @@ bool PatchRepository::sync_workspace() {
 
 void PatchRepository::rebuild_storages() {
   storages_.clear();
+  scan_storages_.clear();
+  listing_storages_.clear();
+  folders_to_list_.clear();
+  ++storages_generation_;
+  if (background_) {
+    // That walk's folders are gone; the next refresh() starts over.
+    background_->cancel.store(true, std::memory_order_relaxed);
+  }
   watched_directories_.clear();
+  storages_key_.clear();
 
   // Root labels prefix every relative path in the tree, so they have to be
   // unique even when two folders share a basename.
@@ -72,61 +143,459 @@ void PatchRepository::rebuild_storages() {
   // shadow the built-in one.
   used_labels.emplace_back(kBuiltinRootName);
 
+  const auto add_to_key = [this](const std::string &label,
+                                 const std::filesystem::path &root) {
+    storages_key_ += label + '\t' + root.generic_string() + '\n';
+  };
+
   for (const auto &folder : workspace_.folders()) {
-    storages_.push_back(std::make_unique<FilesystemPatchStorage>(
-        vfs_, folder.path, unique_label(folder.name), folder.writable,
-        /*enable_metadata=*/folder.writable, persistent_cache_));
+    const auto label = unique_label(folder.name);
+    if (folder.archive) {
+      // Browsed in place, read-only, without unpacking.
+      storages_.push_back(std::make_shared<FilesystemPatchStorage>(
+          std::make_shared<platform::ZipFileSystem>(folder.path), folder.path,
+          label, persistent_cache_));
+    } else {
+      storages_.push_back(std::make_shared<FilesystemPatchStorage>(
+          vfs_, folder.path, label, folder.writable,
+          /*enable_metadata=*/folder.writable, persistent_cache_));
+    }
+    add_to_key(label, folder.path);
     if (folder.available) {
       watched_directories_.push_back(folder.path);
     }
   }
 
   if (show_builtin_presets_ && !builtin_presets_directory_.empty()) {
-    storages_.push_back(std::make_unique<FilesystemPatchStorage>(
+    storages_.push_back(std::make_shared<FilesystemPatchStorage>(
         vfs_, builtin_presets_directory_, kBuiltinRootName,
         /*writable=*/false, /*enable_metadata=*/false, persistent_cache_));
+    add_to_key(kBuiltinRootName, builtin_presets_directory_);
     watched_directories_.push_back(builtin_presets_directory_);
   }
 
+  apply_scan_scope();
   synced_revision_ = workspace_.revision();
   storages_built_ = true;
 }
 
+void PatchRepository::apply_scan_scope() {
+  for (const auto &storage : storages_) {
+    if (auto *filesystem_storage =
+            dynamic_cast<FilesystemPatchStorage *>(storage.get())) {
+      filesystem_storage->set_scan_scope(
+          {lazy_scanning_, expanded_directories_});
+    }
+  }
+}
+
 void PatchRepository::refresh() {
-  tree_cache_.clear();
+  if (tree_key_ != storages_key_ && restore_snapshot()) {
+    if (background_refresh_) {
+      start_background_refresh();
+    }
+    return;
+  }
+  if (background_refresh_) {
+    start_background_refresh();
+  } else {
+    refresh_now();
+  }
+}
 
+void PatchRepository::refresh_now() {
   watched_times_.assign(watched_directories_.size(),
                         std::filesystem::file_time_type{});
   for (std::size_t i = 0; i < watched_directories_.size(); ++i) {
     vfs_.last_write_time(watched_directories_[i], watched_times_[i]);
   }
 
+  // The tree only lives until the index is built from it.
+  std::vector<PatchEntry> tree;
   for (const auto &storage : storages_) {
-    storage->append_entries(tree_cache_);
+    storage->append_entries(tree);
   }
+  *index_ = PatchIndex::build(tree);
 
-  if (persistent_cache_ && persistent_cache_->dirty() &&
-      persistent_cache_->save()) {
+  if (persistent_cache_) {
+    persistent_cache_->store_tree(storages_key_, tree);
+    if (persistent_cache_->dirty() && persistent_cache_->save()) {
 #if defined(MEGATOY_PLATFORM_WEB)
-    platform::web::request_storage_persist();
+      platform::web::request_storage_persist();
 #endif
+    }
   }
 
+  finish_walk();
+  bump_revision();
+}
+
+void PatchRepository::finish_walk() {
   cache_initialized_ = true;
-  ++revision_;
+  tree_key_ = storages_key_;
+  revalidate_pending_ = false;
+}
+
+bool PatchRepository::restore_snapshot() {
+  if (!persistent_cache_) {
+    return false;
+  }
+  auto snapshot = persistent_cache_->lookup_tree(storages_key_);
+  if (!snapshot) {
+    return false;
+  }
+
+  // The snapshot leaves metadata out; the sidecars are already in memory.
+  const auto apply_metadata = [this](const auto &self,
+                                     std::vector<PatchEntry> &entries) -> void {
+    for (auto &entry : entries) {
+      if (entry.is_directory) {
+        self(self, entry.children);
+      } else {
+        entry.metadata = get_patch_metadata(entry.relative_path);
+      }
+    }
+  };
+  apply_metadata(apply_metadata, *snapshot);
+
+  *index_ = PatchIndex::build(*snapshot);
+  cache_initialized_ = true;
+  tree_key_ = storages_key_;
+  revalidate_pending_ = true;
+  bump_revision();
+  return true;
+}
+
+void PatchRepository::enable_background_refresh() {
+#if !defined(MEGATOY_PLATFORM_WEB)
+  background_refresh_ = true;
+  if (revalidate_pending_) {
+    start_background_refresh();
+  }
+#endif
+}
+
+void PatchRepository::start_background_refresh() {
+  if (background_) {
+    refresh_again_ = true;
+    return;
+  }
+
+  // No walk is running, so the scan copies are free to bring up to date.
+  if (scan_storages_.empty()) {
+    for (const auto &storage : storages_) {
+      const auto *filesystem_storage =
+          dynamic_cast<const FilesystemPatchStorage *>(storage.get());
+      if (filesystem_storage == nullptr) {
+        // Only folder storages know how to copy themselves.
+        scan_storages_.clear();
+        refresh_now();
+        return;
+      }
+      scan_storages_.push_back(filesystem_storage->make_scan_copy());
+    }
+  } else {
+    for (std::size_t i = 0; i < storages_.size(); ++i) {
+      static_cast<const FilesystemPatchStorage &>(*storages_[i])
+          .sync_scan_copy(*scan_storages_[i]);
+    }
+  }
+
+  auto job = std::make_unique<BackgroundRefresh>();
+  job->storages = scan_storages_;
+  job->watched_directories = watched_directories_;
+  job->storages_generation = storages_generation_;
+  job->storages_key = storages_key_;
+  auto *raw = job.get();
+  for (const auto &storage : job->storages) {
+    FilesystemPatchStorage::ScanObserver observer;
+    observer.on_file = [raw](const std::filesystem::path &) {
+      return !raw->cancel.load(std::memory_order_relaxed);
+    };
+    storage->set_scan_observer(std::move(observer));
+  }
+
+  background_ = std::move(job);
+  background_->worker = std::thread([raw, &vfs = vfs_,
+                                     cache = persistent_cache_] {
+    // The directory times are taken before the walk, so a change made
+    // while it runs still reads as a change afterwards.
+    raw->watched_times.assign(raw->watched_directories.size(),
+                              std::filesystem::file_time_type{});
+    for (std::size_t i = 0; i < raw->watched_directories.size(); ++i) {
+      vfs.last_write_time(raw->watched_directories[i], raw->watched_times[i]);
+    }
+    std::vector<PatchEntry> tree;
+    for (const auto &storage : raw->storages) {
+      storage->append_entries(tree);
+    }
+    raw->aborted = raw->cancel.load(std::memory_order_relaxed);
+    if (!raw->aborted) {
+      raw->index = PatchIndex::build(tree);
+      if (cache) {
+        cache->store_tree(raw->storages_key, tree);
+      }
+    }
+    if (cache && cache->dirty()) {
+      cache->save();
+    }
+    raw->finished.store(true, std::memory_order_release);
+  });
+}
+
+void PatchRepository::restart_refresh() {
+  if (background_) {
+    background_->cancel.store(true, std::memory_order_relaxed);
+    refresh_again_ = true;
+  } else {
+    refresh();
+  }
+}
+
+bool PatchRepository::expand_directory(const std::string &relative_path) {
+  const auto node = index_->find(relative_path);
+  if (!node || !index_->is_directory(*node) ||
+      !index_->children_pending(*node)) {
+    return false;
+  }
+
+  expanded_directories_.insert(relative_path);
+  apply_scan_scope();
+  // Later lazy walks read the expanded folders too, but only this one is
+  // listed now; a running walk is left alone. The folder shows as loading
+  // until poll_background_refresh() splices it in.
+  if (background_refresh_) {
+    if (std::find(folders_to_list_.begin(), folders_to_list_.end(),
+                  relative_path) == folders_to_list_.end()) {
+      folders_to_list_.push_back(relative_path);
+    }
+    start_directory_listing();
+    return false;
+  }
+
+  auto tree = index_->to_tree();
+  auto *entry = find_in_tree(tree, relative_path);
+  std::vector<PatchEntry> children;
+  const bool listed =
+      std::any_of(storages_.begin(), storages_.end(), [&](const auto &storage) {
+        const auto *filesystem_storage =
+            dynamic_cast<const FilesystemPatchStorage *>(storage.get());
+        return filesystem_storage &&
+               filesystem_storage->list_directory(relative_path, children);
+      });
+  if (!listed) {
+    return false;
+  }
+
+  entry->children = std::move(children);
+  entry->children_pending = false;
+  *index_ = PatchIndex::build(tree);
+  bump_revision();
+  return true;
+}
+
+bool PatchRepository::directory_loading(
+    const std::string &relative_path) const {
+  if (!expanded_directories_.contains(relative_path)) {
+    return false;
+  }
+  const auto node = index_->find(relative_path);
+  return node && index_->children_pending(*node);
+}
+
+void PatchRepository::require_full_listing() {
+  if (!lazy_scanning_) {
+    return;
+  }
+  lazy_scanning_ = false;
+  expanded_directories_.clear();
+  apply_scan_scope();
+  restart_refresh();
+}
+
+void PatchRepository::start_directory_listing() {
+  if (listing_ || folders_to_list_.empty()) {
+    return;
+  }
+
+  // As for walks, the copies are only brought up to date between listings.
+  if (listing_storages_.empty()) {
+    for (const auto &storage : storages_) {
+      if (const auto *filesystem_storage =
+              dynamic_cast<const FilesystemPatchStorage *>(storage.get())) {
+        listing_storages_.push_back(filesystem_storage->make_scan_copy());
+      }
+    }
+  } else {
+    std::size_t next = 0;
+    for (const auto &storage : storages_) {
+      if (const auto *filesystem_storage =
+              dynamic_cast<const FilesystemPatchStorage *>(storage.get())) {
+        filesystem_storage->sync_scan_copy(*listing_storages_[next++]);
+      }
+    }
+  }
+
+  auto job = std::make_unique<DirectoryListing>();
+  job->storages = listing_storages_;
+  job->folders = std::move(folders_to_list_);
+  folders_to_list_.clear();
+  job->storages_generation = storages_generation_;
+  job->children.resize(job->folders.size());
+  auto *raw = job.get();
+  for (const auto &storage : job->storages) {
+    FilesystemPatchStorage::ScanObserver observer;
+    observer.on_file = [raw](const std::filesystem::path &) {
+      return !raw->cancel.load(std::memory_order_relaxed);
+    };
+    storage->set_scan_observer(std::move(observer));
+  }
+
+  listing_ = std::move(job);
+  listing_->worker = std::thread([raw] {
+    for (std::size_t i = 0; i < raw->folders.size(); ++i) {
+      for (const auto &storage : raw->storages) {
+        std::vector<PatchEntry> children;
+        if (storage->list_directory(raw->folders[i], children)) {
+          raw->children[i] = std::move(children);
+          break;
+        }
+      }
+    }
+    raw->finished.store(true, std::memory_order_release);
+  });
+}
+
+bool PatchRepository::poll_directory_listing() {
+  if (!listing_ || !listing_->finished.load(std::memory_order_acquire)) {
+    return false;
+  }
+  auto done = std::move(listing_);
+  listing_.reset();
+  done->worker.join();
+
+  bool changed = false;
+  if (done->storages_generation == storages_generation_) {
+    auto tree = index_->to_tree();
+    for (std::size_t i = 0; i < done->folders.size(); ++i) {
+      auto *entry = find_in_tree(tree, done->folders[i]);
+      if (!entry || !entry->children_pending || !done->children[i]) {
+        continue;
+      }
+      entry->children = std::move(*done->children[i]);
+      entry->children_pending = false;
+      changed = true;
+    }
+    if (changed) {
+      *index_ = PatchIndex::build(tree);
+      bump_revision();
+    }
+  }
+
+  start_directory_listing();
+  return changed;
+}
+
+void PatchRepository::stop_directory_listing() {
+  if (!listing_) {
+    return;
+  }
+  listing_->cancel.store(true, std::memory_order_relaxed);
+  listing_->worker.join();
+  listing_.reset();
+  folders_to_list_.clear();
+}
+
+bool PatchRepository::poll_background_refresh() {
+  const bool listed = poll_directory_listing();
+  if (!background_ || !background_->finished.load(std::memory_order_acquire)) {
+    return listed;
+  }
+
+  auto done = std::move(background_);
+  background_.reset();
+  done->worker.join();
+
+  const bool complete =
+      !done->aborted && done->storages_generation == storages_generation_;
+  bool publish = false;
+  if (complete) {
+    watched_times_ = std::move(done->watched_times);
+    // A walk that only confirms the listing, as revalidating an unchanged
+    // snapshot does, leaves the views and their caches alone.
+    publish = !index_->same_listing(done->index);
+    if (publish) {
+      *index_ = std::move(done->index);
+      bump_revision();
+      // A walk started before a folder was expanded did not read it.
+      for (const auto &folder : expanded_directories_) {
+        const auto node = index_->find(folder);
+        if (node && index_->children_pending(*node) &&
+            std::find(folders_to_list_.begin(), folders_to_list_.end(),
+                      folder) == folders_to_list_.end()) {
+          folders_to_list_.push_back(folder);
+        }
+      }
+      start_directory_listing();
+    }
+    finish_walk();
+  }
+
+  if (refresh_again_) {
+    refresh_again_ = false;
+    start_background_refresh();
+  }
+  return publish || listed;
+}
+
+void PatchRepository::stop_background_refresh() {
+  if (!background_) {
+    return;
+  }
+  background_->cancel.store(true, std::memory_order_relaxed);
+  background_->worker.join();
+  background_.reset();
+  refresh_again_ = false;
 }
 
 const std::vector<PatchEntry> &PatchRepository::tree() const {
-  return tree_cache_;
+  if (!tree_ || tree_revision_ != metadata_revision_) {
+    tree_ = std::make_unique<std::vector<PatchEntry>>(index_->to_tree());
+    tree_revision_ = metadata_revision_;
+  }
+  return *tree_;
 }
 
-bool PatchRepository::load_patch(const PatchEntry &entry,
-                                 ym2612::Patch &patch) const {
+const PatchSearchIndex &PatchRepository::search_index() const {
+  // Most refreshes are never searched, so the index waits for a query. It
+  // covers categories and tags too, so metadata edits rebuild it.
+  if (!search_index_ || search_index_revision_ != metadata_revision_) {
+    search_index_ =
+        std::make_unique<PatchSearchIndex>(PatchSearchIndex::build(*index_));
+    search_index_revision_ = metadata_revision_;
+  }
+  return *search_index_;
+}
+
+const PatchMetadataIndex &PatchRepository::metadata_index() const {
+  if (!metadata_index_ || metadata_index_revision_ != metadata_revision_) {
+    metadata_index_ = std::make_unique<PatchMetadataIndex>(
+        PatchMetadataIndex::build(*index_));
+    metadata_index_revision_ = metadata_revision_;
+  }
+  return *metadata_index_;
+}
+
+namespace {
+
+template <typename Storages>
+bool load_from_storages(const Storages &storages, const PatchEntry &entry,
+                        ym2612::Patch &patch) {
   if (entry.is_directory) {
     return false;
   }
 
-  for (const auto &storage : storages_) {
+  for (const auto &storage : storages) {
     if (storage->load_patch(entry, patch)) {
       return true;
     }
@@ -155,8 +624,29 @@ bool PatchRepository::load_patch(const PatchEntry &entry,
   return false;
 }
 
+} // namespace
+
+bool PatchRepository::load_patch(const PatchEntry &entry,
+                                 ym2612::Patch &patch) const {
+  return load_from_storages(storages_, entry, patch);
+}
+
+PatchRepository::PatchLoader PatchRepository::detached_loader() const {
+  std::vector<std::shared_ptr<const PatchStorage>> storages(storages_.begin(),
+                                                            storages_.end());
+  return [storages = std::move(storages)](const PatchEntry &entry,
+                                          ym2612::Patch &patch) {
+    return load_from_storages(storages, entry, patch);
+  };
+}
+
 bool PatchRepository::has_directory_changed() const {
-  if (!cache_initialized_) {
+  // The running walk stamped the directories before it started, so anything
+  // changed since is caught once it is published.
+  if (background_) {
+    return false;
+  }
+  if (!cache_initialized_ || revalidate_pending_) {
     return true;
   }
   if (watched_times_.size() != watched_directories_.size()) {
@@ -242,8 +732,10 @@ bool PatchRepository::delete_patch(const PatchEntry &entry) {
     if (!storage->delete_patch(entry)) {
       return false;
     }
+    // The storage dropped the patch's metadata with its file. A sweep here
+    // would go by the listing before the delete, which a background walk
+    // only replaces later.
     refresh();
-    cleanup_orphaned_metadata();
 #if defined(MEGATOY_PLATFORM_WEB)
     platform::web::request_storage_persist();
 #endif
@@ -308,6 +800,7 @@ bool PatchRepository::save_patch_metadata(const std::string &relative_path,
                                           const PatchMetadata &metadata) {
   for (const auto &storage : storages_) {
     if (storage->save_patch_metadata(relative_path, patch, metadata)) {
+      apply_metadata_to_index({relative_path});
 #if defined(MEGATOY_PLATFORM_WEB)
       platform::web::request_storage_persist();
 #endif
@@ -321,6 +814,7 @@ bool PatchRepository::update_patch_metadata(const std::string &relative_path,
                                             const PatchMetadata &metadata) {
   for (const auto &storage : storages_) {
     if (storage->update_patch_metadata(relative_path, metadata)) {
+      apply_metadata_to_index({relative_path});
 #if defined(MEGATOY_PLATFORM_WEB)
       // Stars and categories write a sidecar like any other file, so they
       // need the same flush any other write does.
@@ -332,6 +826,72 @@ bool PatchRepository::update_patch_metadata(const std::string &relative_path,
   return false;
 }
 
+std::size_t PatchRepository::update_patch_metadata(
+    const std::vector<std::pair<std::string, PatchMetadata>> &updates) {
+  std::vector<std::string> written;
+  for (const auto &[relative_path, metadata] : updates) {
+    for (const auto &storage : storages_) {
+      if (storage->update_patch_metadata(relative_path, metadata)) {
+        written.push_back(relative_path);
+        break;
+      }
+    }
+  }
+  if (!written.empty()) {
+    apply_metadata_to_index(written);
+#if defined(MEGATOY_PLATFORM_WEB)
+    platform::web::request_storage_persist();
+#endif
+  }
+  return written.size();
+}
+
+std::size_t PatchRepository::add_missing_categories(
+    const std::vector<std::pair<std::string, std::string>> &categories) {
+  std::vector<std::pair<std::string, PatchMetadata>> missing;
+  std::vector<std::pair<std::string, PatchMetadata>> uncategorized;
+  for (const auto &[relative_path, category] : categories) {
+    if (auto metadata = get_patch_metadata(relative_path)) {
+      if (metadata->category.empty()) {
+        metadata->category = category;
+        uncategorized.emplace_back(relative_path, std::move(*metadata));
+      }
+      continue;
+    }
+    PatchMetadata metadata;
+    metadata.category = category;
+    missing.emplace_back(relative_path, std::move(metadata));
+  }
+
+  std::size_t written = 0;
+  std::vector<std::string> paths;
+  for (const auto &storage : storages_) {
+    std::size_t inserted = 0;
+    if (storage->merge_missing_metadata(missing, inserted)) {
+      written += inserted;
+    }
+  }
+  for (const auto &[relative_path, metadata] : missing) {
+    paths.push_back(relative_path);
+  }
+  for (const auto &[relative_path, metadata] : uncategorized) {
+    for (const auto &storage : storages_) {
+      if (storage->update_patch_metadata(relative_path, metadata)) {
+        paths.push_back(relative_path);
+        ++written;
+        break;
+      }
+    }
+  }
+  if (written > 0) {
+    apply_metadata_to_index(paths);
+#if defined(MEGATOY_PLATFORM_WEB)
+    platform::web::request_storage_persist();
+#endif
+  }
+  return written;
+}
+
 std::optional<PatchMetadata>
 PatchRepository::get_patch_metadata(const std::string &relative_path) const {
   for (const auto &storage : storages_) {
@@ -342,41 +902,66 @@ PatchRepository::get_patch_metadata(const std::string &relative_path) const {
   return std::nullopt;
 }
 
+void PatchRepository::apply_metadata_to_index(
+    const std::vector<std::string> &relative_paths) {
+  const bool metadata_index_current =
+      metadata_index_ && metadata_index_revision_ == metadata_revision_;
+  bool applied = false;
+  for (const auto &relative_path : relative_paths) {
+    if (const auto node = index_->find(relative_path);
+        node && !index_->is_directory(*node)) {
+      index_->set_metadata(*node, get_patch_metadata(relative_path));
+      // PatchIds are unchanged, so only this patch moves between bitsets.
+      if (metadata_index_current) {
+        metadata_index_->update(*index_, *node);
+      }
+      applied = true;
+    }
+  }
+  // The listing kept its shape: revision() stays, so nothing keyed on the
+  // files alone -- the duplicate finder, the measured sounds -- starts over.
+  if (applied) {
+    ++metadata_revision_;
+    if (metadata_index_current) {
+      metadata_index_revision_ = metadata_revision_;
+    }
+  }
+  // A walk already running read the metadata before this write.
+  if (background_) {
+    refresh_again_ = true;
+  }
+}
+
 std::vector<PatchEntry> PatchRepository::get_patches_by_metadata_filter(
     const std::function<bool(const PatchMetadata &)> &filter) const {
   std::vector<PatchEntry> result;
-
-  std::function<void(const std::vector<PatchEntry> &)> search_tree;
-  search_tree = [&](const std::vector<PatchEntry> &entries) {
-    for (const auto &entry : entries) {
-      if (entry.is_directory) {
-        search_tree(entry.children);
-      } else if (entry.metadata && filter(*entry.metadata)) {
-        result.push_back(entry);
-      }
+  for (const auto node : index_->patches()) {
+    if (!index_->has_metadata(node)) {
+      continue;
     }
-  };
-
-  search_tree(tree_cache_);
+    // The index keeps only part of the metadata; the filter sees all of it.
+    auto entry = index_->entry(node);
+    auto metadata = get_patch_metadata(entry.relative_path);
+    if (metadata && filter(*metadata)) {
+      entry.metadata = std::move(metadata);
+      result.push_back(std::move(entry));
+    }
+  }
   return result;
 }
 
 void PatchRepository::cleanup_orphaned_metadata() {
+  // Patches in folders a lazy walk never read are not orphans.
+  if (lazy_scanning_) {
+    return;
+  }
+
   // Collect all existing patch paths
   std::vector<std::string> existing_paths;
-
-  std::function<void(const std::vector<PatchEntry> &)> collect_paths;
-  collect_paths = [&](const std::vector<PatchEntry> &entries) {
-    for (const auto &entry : entries) {
-      if (entry.is_directory) {
-        collect_paths(entry.children);
-      } else {
-        existing_paths.push_back(entry.relative_path);
-      }
-    }
-  };
-
-  collect_paths(tree_cache_);
+  existing_paths.reserve(index_->patch_count());
+  for (const auto node : index_->patches()) {
+    existing_paths.push_back(index_->relative_path(node));
+  }
 
   // Cleanup orphaned entries
   for (const auto &storage : storages_) {
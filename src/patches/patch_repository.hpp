@@ -12,10 +12,16 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace patches {
 
+class FilesystemPatchStorage;
+class PatchIndex;
+class PatchMetadataIndex;
+class PatchSearchIndex;
 class PersistentParseCache;
 
 struct PatchEntry {
@@ -25,6 +31,9 @@ struct PatchEntry {
   std::string format;
   bool is_directory;
   std::vector<PatchEntry> children;
+  /// A folder a lazy walk listed without reading: `children` is empty and
+  /// says nothing about the disk until PatchRepository::expand_directory().
+  bool children_pending = false;
 
   // Metadata (only valid for files, not directories)
   std::optional<PatchMetadata> metadata;
@@ -46,23 +55,96 @@ struct PatchEntry {
  * The repository owns no directories of its own: it mirrors whatever folders
  * the user has added. When the workspace changes, sync_workspace() rebuilds
  * the storage list.
+ *
+ * With background refresh enabled, refresh() walks the folders on a worker
+ * instead, against scan copies of the storages, and tree(), index() and
+ * revision() keep describing the previous walk until
+ * poll_background_refresh() swaps the finished one in. A refresh requested
+ * while a walk is running is folded into one more walk after it.
+ *
+ * Given a persistent cache, every complete walk is also saved there as the
+ * tree snapshot of its folder set. Whenever tree() does not yet describe the
+ * current folder set -- at launch, above all -- and a snapshot of that set
+ * exists, refresh() shows the snapshot at once and treats the walk as owed:
+ * has_directory_changed() stays true until a walk has revalidated it, and a
+ * walk that finds the same listing replaces nothing.
+ *
+ * With lazy scanning, a walk reads each folder's top level and the folders
+ * opened through expand_directory(), and lists every other folder unread
+ * (PatchEntry::children_pending). Anything that needs every patch calls
+ * require_full_listing(), after which walks read everything again.
  */
 class PatchRepository {
 public:
   PatchRepository(platform::VirtualFileSystem &vfs,
                   const megatoy::workspace::Workspace &workspace,
                   const std::filesystem::path &builtin_presets_dir = {},
-                  PersistentParseCache *persistent_cache = nullptr);
+                  PersistentParseCache *persistent_cache = nullptr,
+                  bool show_builtin_presets = true, bool lazy_scanning = false);
+  ~PatchRepository();
 
   /// Rebuild the storage list if the workspace has changed since last call.
   /// Returns true when something changed.
   bool sync_workspace();
 
   void refresh();
+  /**
+   * Move refresh() onto a worker thread from now on. Desktop turns this on
+   * once startup no longer needs tree() to be current; the browser has no
+   * threads and never does.
+   */
+  void enable_background_refresh();
+  /// Publish a finished background walk or folder listing. UI thread, once
+  /// per frame; returns true when tree() was replaced.
+  bool poll_background_refresh();
+  bool background_refresh_running() const { return background_ != nullptr; }
+  /// Whether expanded folders are being listed on a worker.
+  bool directory_listing_running() const { return listing_ != nullptr; }
+
+  /**
+   * Read a folder a lazy walk left unread. True when index() changed; with
+   * background refresh the folder is listed on a worker instead, on its own
+   * and beside any walk, and false is returned until
+   * poll_background_refresh() splices it in.
+   */
+  bool expand_directory(const std::string &relative_path);
+  /// Opened through expand_directory() and not read yet.
+  bool directory_loading(const std::string &relative_path) const;
+  /// Stop listing lazily and walk everything, once; later calls do nothing.
+  void require_full_listing();
+  bool lazy_scanning() const { return lazy_scanning_; }
+  /**
+   * index() as a nested tree, put back together on the first call after
+   * each change, for tools and tests. The index is what is kept; the views
+   * read that instead.
+   */
   const std::vector<PatchEntry> &tree() const;
+  /// The workspace listing, rebuilt on every refresh().
+  const PatchIndex &index() const { return *index_; }
+  /// Search index over index(), built on first use after each change.
+  const PatchSearchIndex &search_index() const;
+  /// Star, category and tag bitsets over index(), built on first use after
+  /// each refresh() and kept current through metadata edits.
+  const PatchMetadataIndex &metadata_index() const;
+  /// Changes when the listing does: files added, removed or renamed.
   std::uint64_t revision() const { return revision_; }
+  /**
+   * Changes with revision() and also on every metadata edit, which updates
+   * index() in place. Views that filter or sort on stars, categories, tags
+   * or hidden watch this one.
+   */
+  std::uint64_t metadata_revision() const { return metadata_revision_; }
 
   bool load_patch(const PatchEntry &entry, ym2612::Patch &patch) const;
+
+  using PatchLoader = std::function<bool(const PatchEntry &, ym2612::Patch &)>;
+  /**
+   * load_patch() for another thread. It keeps the current storages alive, so
+   * it stays usable however the workspace changes in the meantime; storages
+   * load through const paths that touch no scan state, and the files they
+   * read are the only thing shared.
+   */
+  PatchLoader detached_loader() const;
   bool has_directory_changed() const;
 
   static std::vector<std::string> supported_extensions();
@@ -78,8 +160,20 @@ public:
                            const PatchMetadata &metadata);
   bool update_patch_metadata(const std::string &relative_path,
                              const PatchMetadata &metadata);
+  /// update_patch_metadata() for many patches, bumping metadata_revision()
+  /// once rather than once per patch. Returns how many were written.
+  std::size_t update_patch_metadata(
+      const std::vector<std::pair<std::string, PatchMetadata>> &updates);
   std::optional<PatchMetadata>
   get_patch_metadata(const std::string &relative_path) const;
+  /**
+   * Give each listed patch its category, pairs of relative path and
+   * category, unless it already has one. Patches without any metadata get
+   * it through the storages' merge_missing_metadata(), in one write per
+   * sidecar; the rest are updated in place. Returns how many were written.
+   */
+  std::size_t add_missing_categories(
+      const std::vector<std::pair<std::string, std::string>> &categories);
 
   SavePatchResult save_patch(const ym2612::Patch &patch,
                              const std::string &name, bool overwrite,
@@ -111,24 +205,80 @@ public:
 
 private:
   static constexpr const char *kBuiltinRootName = "presets";
+  struct BackgroundRefresh;
+  struct DirectoryListing;
 
   void rebuild_storages();
+  void refresh_now();
+  /// Show the persisted snapshot of the current folder set, if there is one.
+  bool restore_snapshot();
+  /// Mark tree() as a complete walk of the current folder set.
+  void finish_walk();
+  /// Hand the lazy-walk settings to every storage.
+  void apply_scan_scope();
+  /// Drop a running walk that no longer matches and start one that does.
+  void restart_refresh();
+  void start_background_refresh();
+  void stop_background_refresh();
+  /// List the queued folders on a worker, unless a listing is running.
+  void start_directory_listing();
+  /// Splice a finished listing into index(); true when it changed.
+  bool poll_directory_listing();
+  void stop_directory_listing();
+  /// Mirror metadata writes into index() so they show without a rescan.
+  void apply_metadata_to_index(const std::vector<std::string> &relative_paths);
+  void bump_revision() {
+    ++revision_;
+    ++metadata_revision_;
+  }
 
   const megatoy::workspace::Workspace &workspace_;
   std::filesystem::path builtin_presets_directory_;
   platform::VirtualFileSystem &vfs_;
   PersistentParseCache *persistent_cache_;
 
-  std::vector<PatchEntry> tree_cache_;
+  std::unique_ptr<PatchIndex> index_;
+  mutable std::unique_ptr<std::vector<PatchEntry>> tree_;
+  mutable std::uint64_t tree_revision_ = 0;
+  mutable std::unique_ptr<PatchSearchIndex> search_index_;
+  mutable std::uint64_t search_index_revision_ = 0;
+  mutable std::unique_ptr<PatchMetadataIndex> metadata_index_;
+  mutable std::uint64_t metadata_index_revision_ = 0;
   std::vector<std::filesystem::path> watched_directories_;
   std::vector<std::filesystem::file_time_type> watched_times_;
   bool cache_initialized_ = false;
   bool show_builtin_presets_ = true;
+  /// Identifies the folder set: every storage's label and root, in order.
+  std::string storages_key_;
+  /// storages_key_ as it was when index_ was last built.
+  std::string tree_key_;
+  /// index_ came from a snapshot and no walk has confirmed it yet.
+  bool revalidate_pending_ = false;
+  bool lazy_scanning_ = false;
+  /// Folders read on demand, which later lazy walks read as well.
+  std::unordered_set<std::string> expanded_directories_;
   std::uint64_t synced_revision_ = 0;
   bool storages_built_ = false;
   std::uint64_t revision_ = 0;
+  std::uint64_t metadata_revision_ = 0;
+
+  std::vector<std::shared_ptr<PatchStorage>> storages_;
 
-  std::vector<std::unique_ptr<PatchStorage>> storages_;
+  bool background_refresh_ = false;
+  /// Bumped by rebuild_storages(), so a walk over a folder list that has
+  /// since changed is dropped instead of published.
+  std::uint64_t storages_generation_ = 0;
+  /// Walked only by the background worker, one walk at a time; built on
+  /// demand for the current storages.
+  std::vector<std::shared_ptr<FilesystemPatchStorage>> scan_storages_;
+  std::unique_ptr<BackgroundRefresh> background_;
+  bool refresh_again_ = false;
+  /// Scan copies for folder listings, apart from scan_storages_ so a listing
+  /// runs beside a walk; built on demand like them.
+  std::vector<std::shared_ptr<FilesystemPatchStorage>> listing_storages_;
+  std::unique_ptr<DirectoryListing> listing_;
+  /// Expanded folders waiting for the running listing to finish.
+  std::vector<std::string> folders_to_list_;
 };
 
 } // namespace patches
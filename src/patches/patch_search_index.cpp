@@ -0,0 +1,222 @@
+#include "patch_search_index.hpp"
+
+#include "core/utf8_utils.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+namespace patches {
+
+namespace {
+
+constexpr std::size_t kFieldCount = 4;
+
+std::uint32_t trigram_at(std::string_view text, std::size_t offset) {
+  return static_cast<std::uint32_t>(static_cast<unsigned char>(text[offset]))
+             << 16 |
+         static_cast<std::uint32_t>(
+             static_cast<unsigned char>(text[offset + 1]))
+             << 8 |
+         static_cast<std::uint32_t>(
+             static_cast<unsigned char>(text[offset + 2]));
+}
+
+/// Whether a match at `offset` starts a word: the start of the text, or
+/// right after an ASCII separator. Bytes of multi-byte characters count as
+/// letters, so a match never "starts" in the middle of one.
+bool at_word_start(std::string_view text, std::size_t offset) {
+  if (offset == 0) {
+    return true;
+  }
+  const auto before = static_cast<unsigned char>(text[offset - 1]);
+  if (before >= 0x80u) {
+    return false;
+  }
+  const bool alnum = (before >= 'a' && before <= 'z') ||
+                     (before >= 'A' && before <= 'Z') ||
+                     (before >= '0' && before <= '9');
+  return !alnum;
+}
+
+} // namespace
+
+PatchSearchIndex PatchSearchIndex::build(const PatchIndex &index) {
+  PatchSearchIndex search;
+  const auto patches = index.patches();
+  search.documents_.reserve(patches.size());
+
+  std::unordered_map<std::uint32_t, std::vector<PatchIndex::PatchId>> lists;
+  std::string path;
+  for (std::size_t id = 0; id < patches.size(); ++id) {
+    const auto node = patches[id];
+    Document document{};
+    std::string &text = search.text_;
+
+    document.bounds[0] = static_cast<std::uint32_t>(text.size());
+    text.append(index.folded_name(node));
+    document.bounds[1] = static_cast<std::uint32_t>(text.size());
+    text.append(index.folded_category(node));
+    document.bounds[2] = static_cast<std::uint32_t>(text.size());
+    bool first_tag = true;
+    for (const auto tag : index.tags(node)) {
+      if (!first_tag) {
+        text.push_back('\n');
+      }
+      text.append(megatoy::utf8::fold_case(index.string(tag)));
+      first_tag = false;
+    }
+    document.bounds[3] = static_cast<std::uint32_t>(text.size());
+    path.clear();
+    index.append_relative_path(node, path);
+    text.append(megatoy::utf8::fold_case(path));
+    document.bounds[4] = static_cast<std::uint32_t>(text.size());
+
+    // Trigrams are taken per field, so none spans two of them. Patches are
+    // visited in id order, so checking the back keeps each list unique and
+    // sorted without a second pass.
+    const auto patch = static_cast<PatchIndex::PatchId>(id);
+    for (std::size_t field = 0; field < kFieldCount; ++field) {
+      const std::string_view value(text.data() + document.bounds[field],
+                                   document.bounds[field + 1] -
+                                       document.bounds[field]);
+      for (std::size_t i = 0; i + 3 <= value.size(); ++i) {
+        auto &list = lists[trigram_at(value, i)];
+        if (list.empty() || list.back() != patch) {
+          list.push_back(patch);
+        }
+      }
+    }
+    search.documents_.push_back(document);
+  }
+
+  search.keys_.reserve(lists.size());
+  for (const auto &[key, list] : lists) {
+    search.keys_.push_back(key);
+  }
+  std::sort(search.keys_.begin(), search.keys_.end());
+
+  auto &postings = search.postings_;
+  search.starts_.reserve(search.keys_.size() + 1);
+  for (const auto key : search.keys_) {
+    const auto &list = lists[key];
+    search.starts_.push_back(static_cast<std::uint32_t>(postings.size()));
+    postings.insert(postings.end(), list.begin(), list.end());
+  }
+  search.starts_.push_back(static_cast<std::uint32_t>(postings.size()));
+  return search;
+}
+
+std::vector<PatchIndex::PatchId>
+PatchSearchIndex::candidates(std::string_view folded) const {
+  std::vector<PatchIndex::PatchId> result;
+  if (folded.size() < 3) {
+    result.resize(documents_.size());
+    for (std::size_t id = 0; id < result.size(); ++id) {
+      result[id] = static_cast<PatchIndex::PatchId>(id);
+    }
+    return result;
+  }
+
+  struct List {
+    const PatchIndex::PatchId *begin;
+    const PatchIndex::PatchId *end;
+  };
+  std::vector<std::uint32_t> trigrams;
+  for (std::size_t i = 0; i + 3 <= folded.size(); ++i) {
+    trigrams.push_back(trigram_at(folded, i));
+  }
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                 trigrams.end());
+
+  std::vector<List> lists;
+  lists.reserve(trigrams.size());
+  for (const auto trigram : trigrams) {
+    const auto found = std::lower_bound(keys_.begin(), keys_.end(), trigram);
+    if (found == keys_.end() || *found != trigram) {
+      return {};
+    }
+    const auto slot = static_cast<std::size_t>(found - keys_.begin());
+    lists.push_back(List{postings_.data() + starts_[slot],
+                         postings_.data() + starts_[slot + 1]});
+  }
+  std::sort(lists.begin(), lists.end(), [](const List &a, const List &b) {
+    return (a.end - a.begin) < (b.end - b.begin);
+  });
+
+  result.assign(lists.front().begin, lists.front().end);
+  std::vector<PatchIndex::PatchId> narrowed;
+  for (std::size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+    narrowed.clear();
+    std::set_intersection(result.begin(), result.end(), lists[i].begin,
+                          lists[i].end, std::back_inserter(narrowed));
+    result.swap(narrowed);
+  }
+  return result;
+}
+
+bool PatchSearchIndex::rank_of(const Document &document,
+                               std::string_view folded, unsigned fields,
+                               Rank &rank) const {
+  const auto field_text = [&](std::size_t field) {
+    return std::string_view(text_).substr(
+        document.bounds[field],
+        document.bounds[field + 1] - document.bounds[field]);
+  };
+
+  if (fields & kName) {
+    const std::string_view name = field_text(0);
+    std::size_t offset = name.find(folded);
+    if (offset == 0) {
+      rank = Rank::NamePrefix;
+      return true;
+    }
+    if (offset != std::string_view::npos) {
+      rank = Rank::NameInfix;
+      for (; offset != std::string_view::npos;
+           offset = name.find(folded, offset + 1)) {
+        if (at_word_start(name, offset)) {
+          rank = Rank::NameWord;
+          break;
+        }
+      }
+      return true;
+    }
+  }
+  if (((fields & kCategory) &&
+       field_text(1).find(folded) != std::string_view::npos) ||
+      ((fields & kTags) &&
+       field_text(2).find(folded) != std::string_view::npos)) {
+    rank = Rank::Metadata;
+    return true;
+  }
+  if ((fields & kPath) &&
+      field_text(3).find(folded) != std::string_view::npos) {
+    rank = Rank::Path;
+    return true;
+  }
+  return false;
+}
+
+std::vector<PatchSearchIndex::Hit>
+PatchSearchIndex::search(std::string_view query, unsigned fields) const {
+  std::vector<Hit> hits;
+  const std::string folded = megatoy::utf8::fold_case(query);
+  if (folded.empty()) {
+    return hits;
+  }
+
+  for (const auto patch : candidates(folded)) {
+    Rank rank;
+    if (rank_of(documents_[patch], folded, fields, rank)) {
+      hits.push_back(Hit{patch, rank});
+    }
+  }
+  std::stable_sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+    return a.rank < b.rank;
+  });
+  return hits;
+}
+
+} // namespace patches
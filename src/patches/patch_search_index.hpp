@@ -0,0 +1,86 @@
+#pragma once
+
+#include "patch_index.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace patches {
+
+/**
+ * Trigram index over each patch's name, category, tags and relative path.
+ *
+ * Every searchable field is case-folded with megatoy::utf8::fold_case() once,
+ * when the index is built, and the byte trigrams of the folded text are kept
+ * as sorted posting lists of PatchIds. A query intersects the lists of its
+ * own trigrams, shortest first, and only the few surviving candidates are
+ * checked with a substring search -- so typing into the search box costs a
+ * handful of list merges rather than a lowercase-and-scan of every entry.
+ * Queries shorter than a trigram fall back to scanning the pre-folded text.
+ *
+ * Built from a PatchIndex and addressed by its PatchIds; rebuild it whenever
+ * the index is rebuilt.
+ */
+class PatchSearchIndex {
+public:
+  enum Field : unsigned {
+    kName = 1u << 0,
+    kCategory = 1u << 1,
+    kTags = 1u << 2,
+    kPath = 1u << 3,
+  };
+  /// What the tree view filters on: its hierarchy already shows the path.
+  static constexpr unsigned kBrowserFields = kName | kCategory | kTags;
+  static constexpr unsigned kAllFields = kBrowserFields | kPath;
+
+  /// How well a patch matched; lower ranks sort first.
+  enum class Rank : std::uint8_t {
+    NamePrefix,   ///< The name starts with the query.
+    NameWord,     ///< A word inside the name starts with the query.
+    NameInfix,    ///< The query is elsewhere in the name.
+    Metadata,     ///< Category or a tag contains the query.
+    Path,         ///< Only the relative path contains the query.
+  };
+  static constexpr std::size_t kRankCount = 5;
+
+  struct Hit {
+    PatchIndex::PatchId patch;
+    Rank rank;
+  };
+
+  static PatchSearchIndex build(const PatchIndex &index);
+
+  std::size_t size() const { return documents_.size(); }
+  std::size_t trigram_count() const { return keys_.size(); }
+
+  /**
+   * Patches whose selected fields contain `query`, case-insensitively, best
+   * rank first and in PatchId (tree) order within a rank. An empty query
+   * matches nothing; callers treat that as "no filter".
+   */
+  std::vector<Hit> search(std::string_view query,
+                          unsigned fields = kAllFields) const;
+
+private:
+  /// Offsets into text_: name, category, tags ('\n'-joined), path, end.
+  struct Document {
+    std::uint32_t bounds[5];
+  };
+
+  std::vector<PatchIndex::PatchId> candidates(std::string_view folded) const;
+  bool rank_of(const Document &document, std::string_view folded,
+               unsigned fields, Rank &rank) const;
+
+  std::string text_;
+  std::vector<Document> documents_;
+  /// Sorted trigram keys; postings for keys_[i] are
+  /// postings_[starts_[i] .. starts_[i + 1]).
+  std::vector<std::uint32_t> keys_;
+  std::vector<std::uint32_t> starts_;
+  std::vector<PatchIndex::PatchId> postings_;
+};
+
+} // namespace patches
@@ -2,9 +2,11 @@
 
 #include "audio/audio_command.hpp"
 #include "audio/audio_manager.hpp"
+#include "audio/sound_descriptors.hpp"
 #include "formats/patch_loader.hpp"
 #include "formats/patch_registry.hpp"
 #include "formats/ym2612_format_adapter.hpp"
+#include "patches/patch_index.hpp"
 #include "patches/patch_write.hpp"
 #include "platform/file_dialog.hpp"
 #include "platform/platform_config.hpp"
@@ -27,9 +29,10 @@ PatchSession::PatchSession(megatoy::system::PathService &directories,
     : directories_(directories), preferences_(preferences), audio_(audio),
       repository_(std::make_unique<PatchRepository>(
           directories_.file_system(), preferences_.workspace(),
-          directories_.paths().builtin_presets_root, persistent_cache)) {
-  repository_->set_show_builtin_presets(preferences_.show_builtin_presets());
-}
+          directories_.paths().builtin_presets_root, persistent_cache,
+          preferences_.show_builtin_presets(), /*lazy_scanning=*/true)),
+      loader_(directories_.file_system()),
+      duplicates_(directories_.file_system()) {}
 
 ym2612::Patch &PatchSession::current_patch() { return current_patch_; }
 
@@ -166,12 +169,35 @@ bool PatchSession::load_patch_from_entry(const PatchEntry &entry) {
   if (!repository_->load_patch(entry, patch)) {
     return false;
   }
+  adopt_loaded_patch(entry, patch);
+  return true;
+}
+
+void PatchSession::adopt_loaded_patch(const PatchEntry &entry,
+                                      const ym2612::Patch &patch) {
   set_current_patch(patch, entry.source_relative_path.empty()
                                ? entry.relative_path
                                : entry.source_relative_path);
   set_current_patch_selection_path(entry.relative_path);
   mark_as_clean();
-  return true;
+}
+
+void PatchSession::request_patch_load(const PatchEntry &entry) {
+  loader_.request(entry, repository_->detached_loader());
+}
+
+std::optional<AsyncPatchLoader::Result> PatchSession::take_loaded_patch() {
+  return loader_.poll();
+}
+
+bool PatchSession::patch_load_pending() const { return loader_.pending(); }
+
+void PatchSession::prefetch_patches(
+    const std::vector<const PatchEntry *> &entries) {
+  // Asked every frame; the loader only needs the storages when it changed.
+  if (!loader_.is_neighbourhood(entries)) {
+    loader_.prefetch(entries, repository_->detached_loader());
+  }
 }
 
 bool PatchSession::restore_patch(const std::filesystem::path &relative_path) {
@@ -186,28 +212,26 @@ bool PatchSession::restore_patch(const std::filesystem::path &relative_path) {
     return false;
   }
 
-  const auto find_entry =
-      [&](const auto &self,
-          const std::vector<PatchEntry> &entries) -> const PatchEntry * {
-    for (const auto &entry : entries) {
-      if (!entry.is_directory &&
-          (entry.relative_path == relative_string ||
-           entry.source_relative_path == relative_string)) {
-        return &entry;
-      }
-      if (const auto *found = self(self, entry.children)) {
-        return found;
+  const auto &index = repository_->index();
+  auto node = index.find(relative_string);
+  if (!node || index.is_directory(*node)) {
+    // A bank remembered by its own path opens at its first instrument.
+    node.reset();
+    for (const auto patch : index.patches()) {
+      if (index.source_relative_path(patch) == relative_string) {
+        node = patch;
+        break;
       }
     }
-    return nullptr;
-  };
-  const auto *entry = find_entry(find_entry, repository_->tree());
-  return entry != nullptr && load_patch_from_entry(*entry);
+  }
+  return node && load_patch_from_entry(index.entry(*node));
 }
 
 void PatchSession::set_current_patch(const ym2612::Patch &patch,
                                      const std::filesystem::path &source_path,
                                      RememberPatchPath remember) {
+  // Whatever replaced the patch is newer than a browser load still running.
+  loader_.cancel();
   current_patch_ = patch;
   set_current_patch_path(source_path, remember);
   if (!source_path.empty()) {
@@ -227,27 +251,69 @@ void PatchSession::set_current_patch(const ym2612::Patch &patch,
 void PatchSession::apply_patch_to_audio() {
   // Patch edits take the same route as notes so that a slider drag cannot
   // rewrite registers underneath the renderer.
-  if (audio_.submit(audio::AudioCommand::apply_patch(
-          current_patch_.global, current_patch_.channel,
-          current_patch_.instrument))) {
-    last_applied_ = current_patch_;
+  auto command = audio::AudioCommand::apply_patch(
+      current_patch_.global, current_patch_.channel, current_patch_.instrument);
+  command.gain = audition_gain(command.patch);
+  if (audio_.submit(command)) {
+    last_applied_ = command.patch;
     has_applied_patch_ = true;
+    applied_gain_ = command.gain;
   }
 }
 
+void PatchSession::set_loudness_matching(bool enabled) {
+  match_loudness_ = enabled;
+  refresh_audition_gain();
+}
+
+float PatchSession::audition_gain(const ym2612::PackedPatch &sound) const {
+  if (!match_loudness_) {
+    return 1.0f;
+  }
+  if (const auto descriptors = sound_descriptors_.find(sound)) {
+    return audio::loudness_matching_gain(descriptors->loudness_lufs);
+  }
+  return applied_gain_;
+}
+
+void PatchSession::refresh_audition_gain() {
+  if (!has_applied_patch_) {
+    return;
+  }
+  const float gain = audition_gain(last_applied_);
+  if (gain != applied_gain_ &&
+      audio_.submit(audio::AudioCommand::set_gain(gain))) {
+    applied_gain_ = gain;
+  }
+}
+
+void PatchSession::update_sound_index(bool measure) {
+  duplicates_.update(*repository_);
+  duplicates_.poll();
+  if (!measure) {
+    return;
+  }
+  sound_descriptors_.update(duplicates_);
+  // Saved as each job lands, so a crash only costs the one running.
+  if (sound_descriptors_.poll()) {
+    sound_descriptors_.save();
+    refresh_audition_gain();
+  }
+}
+
+void PatchSession::update_category_suggestions() {
+  category_suggestions_.update(*repository_, duplicates_, sound_descriptors_);
+  category_suggestions_.poll();
+}
+
 bool PatchSession::apply_patch_to_audio_if_changed() {
-  const bool audio_settings_changed =
-      !has_applied_patch_ || current_patch_.global != last_applied_.global ||
-      current_patch_.channel != last_applied_.channel ||
-      current_patch_.instrument != last_applied_.instrument;
-  if (!audio_settings_changed) {
+  const auto packed = current_patch_.packed();
+  if (has_applied_patch_ && packed == last_applied_) {
     return false;
   }
 
   apply_patch_to_audio();
-  return has_applied_patch_ && current_patch_.global == last_applied_.global &&
-         current_patch_.channel == last_applied_.channel &&
-         current_patch_.instrument == last_applied_.instrument;
+  return has_applied_patch_ && packed == last_applied_;
 }
 
 std::optional<std::filesystem::path>
@@ -451,6 +517,7 @@ PatchSession::PatchSnapshot PatchSession::capture_snapshot() const {
 }
 
 void PatchSession::restore_snapshot(const PatchSnapshot &snapshot) {
+  loader_.cancel();
   current_patch_ = snapshot.patch;
   original_patch_ = snapshot.original_patch;
   if (snapshot.path.empty()) {
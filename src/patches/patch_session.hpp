@@ -1,9 +1,14 @@
 #pragma once
 
+#include "async_patch_loader.hpp"
+#include "category_suggestion_index.hpp"
+#include "duplicate_finder.hpp"
 #include "formats/patch_registry.hpp"
 #include "patch_repository.hpp"
+#include "patch_snapshot.hpp"
 #include "patches/filename_utils.hpp"
 #include "preferences/preference_manager.hpp"
+#include "sound_descriptor_index.hpp"
 #include "system/path_service.hpp"
 #include "ym2612/note.hpp"
 #include "ym2612/patch.hpp"
@@ -78,6 +83,24 @@ public:
   // Repository access
   PatchRepository &repository();
   const PatchRepository &repository() const;
+  /// Duplicate detection over repository(), run on demand.
+  DuplicateFinder &duplicate_finder() { return duplicates_; }
+  /// Loudness, brightness and envelope of the sounds duplicate_finder()
+  /// read, measured on demand.
+  SoundDescriptorIndex &sound_descriptors() { return sound_descriptors_; }
+  /**
+   * Keep duplicate_finder() current with the repository and, when `measure`
+   * is set, have sound_descriptors() measure what it found. Call it every
+   * frame either is wanted; calling it twice in a frame is harmless.
+   */
+  void update_sound_index(bool measure);
+  /// Categories proposed for the patches without one, grouped on demand.
+  CategorySuggestionIndex &category_suggestions() {
+    return category_suggestions_;
+  }
+  /// Keep category_suggestions() current with what update_sound_index()
+  /// found. Call it every frame the suggestions are wanted, after that.
+  void update_category_suggestions();
 
   // Initialization and workspace management
   void initialize_patch_defaults();
@@ -86,6 +109,20 @@ public:
 
   // Patch loading
   bool load_patch_from_entry(const PatchEntry &entry);
+  /// Make an already loaded patch the current one, as load_patch_from_entry
+  /// does once it has read the file.
+  void adopt_loaded_patch(const PatchEntry &entry, const ym2612::Patch &patch);
+
+  /**
+   * Load `entry` off the UI thread. take_loaded_patch() returns the result
+   * once it is ready; only the newest request's result ever arrives, and any
+   * other change of the current patch cancels a request still in flight.
+   */
+  void request_patch_load(const PatchEntry &entry);
+  std::optional<AsyncPatchLoader::Result> take_loaded_patch();
+  bool patch_load_pending() const;
+  /// Keep these entries (nearest first) decoded for an instant switch.
+  void prefetch_patches(const std::vector<const PatchEntry *> &entries);
   bool restore_patch(const std::filesystem::path &relative_path);
   void set_current_patch(const ym2612::Patch &patch,
                          const std::filesystem::path &source_path,
@@ -94,6 +131,13 @@ public:
   // Audio integration
   void apply_patch_to_audio();
   bool apply_patch_to_audio_if_changed();
+  /**
+   * Play every patch at the same loudness, from its measurement in
+   * sound_descriptors(); the gain travels with the patch, so it is right
+   * from the first note. A sound not measured yet -- an edit in progress,
+   * typically -- keeps the level it had, and takes its own once measured.
+   */
+  void set_loudness_matching(bool enabled);
 
   // File operations
   /**
@@ -126,16 +170,7 @@ public:
   const std::vector<ym2612::Note> active_notes() const;
 
   // Snapshot functionality for undo/redo
-  struct PatchSnapshot {
-    ym2612::Patch original_patch;
-    ym2612::Patch patch;
-    std::string path;
-    std::string selection_path;
-    bool operator==(const PatchSnapshot &other) const {
-      return patch == other.patch && path == other.path &&
-             selection_path == other.selection_path;
-    }
-  };
+  using PatchSnapshot = patches::PatchSnapshot;
 
   PatchSnapshot capture_snapshot() const;
   void restore_snapshot(const PatchSnapshot &snapshot);
@@ -156,14 +191,22 @@ private:
                                         bool overwrite);
   void set_file_identity(const std::filesystem::path &path);
   std::optional<std::filesystem::path> writable_source_folder() const;
+  float audition_gain(const ym2612::PackedPatch &sound) const;
+  void refresh_audition_gain();
 
   megatoy::system::PathService &directories_;
   PreferenceManager &preferences_;
   AudioManager &audio_;
   std::unique_ptr<PatchRepository> repository_;
+  AsyncPatchLoader loader_;
+  DuplicateFinder duplicates_;
+  SoundDescriptorIndex sound_descriptors_;
+  CategorySuggestionIndex category_suggestions_;
   ym2612::Patch current_patch_;
-  ym2612::Patch last_applied_;
+  ym2612::PackedPatch last_applied_;
   bool has_applied_patch_ = false;
+  bool match_loudness_ = false;
+  float applied_gain_ = 1.0f;
   std::string current_patch_path_;
   std::string current_patch_selection_path_;
   ym2612::Patch original_patch_; // For tracking modifications
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ym2612/patch.hpp"
+#include <string>
+
+namespace patches {
+
+/// What undo and redo put back: the patch being edited and where it is from.
+struct PatchSnapshot {
+  /// The patch as last loaded or saved, for is_modified().
+  ym2612::Patch original_patch;
+  ym2612::Patch patch;
+  std::string path;
+  std::string selection_path;
+
+  /// Equal when the user would see no change; original_patch only follows.
+  bool operator==(const PatchSnapshot &other) const {
+    return patch == other.patch && path == other.path &&
+           selection_path == other.selection_path;
+  }
+};
+
+} // namespace patches
@@ -0,0 +1,87 @@
+#include "patch_sort_index.hpp"
+
+#include "core/utf8_utils.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace patches {
+
+void PatchSortIndex::reset(const PatchIndex &index) {
+  index_ = &index;
+  for (auto &order : orders_) {
+    order.clear();
+  }
+  built_.fill(false);
+}
+
+void PatchSortIndex::invalidate(Key key) {
+  const auto slot = static_cast<std::size_t>(key);
+  orders_[slot].clear();
+  built_[slot] = false;
+}
+
+std::span<const PatchIndex::PatchId> PatchSortIndex::ascending(Key key) {
+  const auto slot = static_cast<std::size_t>(key);
+  if (!built_[slot] && index_ != nullptr) {
+    compute(key, orders_[slot]);
+    built_[slot] = true;
+  }
+  return orders_[slot];
+}
+
+void PatchSortIndex::compute(Key key,
+                             std::vector<PatchIndex::PatchId> &order) const {
+  const auto &index = *index_;
+  const auto patches = index.patches();
+  order.resize(patches.size());
+  for (std::size_t id = 0; id < order.size(); ++id) {
+    order[id] = static_cast<PatchIndex::PatchId>(id);
+  }
+
+  // Comparators read interned views straight from the index; only paths,
+  // which the index does not store whole, are materialised -- once.
+  const auto sort_by = [&](auto less) {
+    std::stable_sort(order.begin(), order.end(), less);
+  };
+  switch (key) {
+  case Key::Name:
+    sort_by([&](PatchIndex::PatchId a, PatchIndex::PatchId b) {
+      const auto folded_a = index.folded_name(patches[a]);
+      const auto folded_b = index.folded_name(patches[b]);
+      if (folded_a != folded_b) {
+        return folded_a < folded_b;
+      }
+      return index.name(patches[a]) < index.name(patches[b]);
+    });
+    break;
+  case Key::Category:
+    sort_by([&](PatchIndex::PatchId a, PatchIndex::PatchId b) {
+      return index.folded_category(patches[a]) <
+             index.folded_category(patches[b]);
+    });
+    break;
+  case Key::StarRating:
+    sort_by([&](PatchIndex::PatchId a, PatchIndex::PatchId b) {
+      return index.star_rating(patches[a]) < index.star_rating(patches[b]);
+    });
+    break;
+  case Key::Format:
+    sort_by([&](PatchIndex::PatchId a, PatchIndex::PatchId b) {
+      return index.format(patches[a]) < index.format(patches[b]);
+    });
+    break;
+  case Key::Path: {
+    std::vector<std::string> paths(patches.size());
+    for (std::size_t id = 0; id < paths.size(); ++id) {
+      paths[id] = megatoy::utf8::fold_case(index.relative_path(patches[id]));
+    }
+    sort_by([&](PatchIndex::PatchId a, PatchIndex::PatchId b) {
+      return paths[a] < paths[b];
+    });
+    break;
+  }
+  }
+}
+
+} // namespace patches
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "patch_index.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace patches {
+
+/**
+ * Every patch of a PatchIndex pre-sorted by each sortable column.
+ *
+ * A table that sorts on every rebuild pays O(n log n) string comparisons each
+ * time the query or a filter changes. Here each column is sorted at most once
+ * per index, on first use, and a filtered view is then a single walk over the
+ * stored order that skips rejected patches.
+ *
+ * Keys are normalised before sorting: names, categories and paths compare
+ * case-folded, with the raw name as the tie-breaker for names. Equal keys
+ * keep tree order.
+ */
+class PatchSortIndex {
+public:
+  enum class Key : std::uint8_t { Name, Category, StarRating, Format, Path };
+  static constexpr std::size_t kKeyCount = 5;
+
+  /// Drops every order; they are recomputed against `index` when next asked.
+  void reset(const PatchIndex &index);
+  /// Drops one order, for an index whose `key` column was edited in place
+  /// (PatchIndex::set_metadata()).
+  void invalidate(Key key);
+
+  /// All PatchIds in ascending `key` order. Walk it backwards for descending.
+  std::span<const PatchIndex::PatchId> ascending(Key key);
+
+  /// Whether the order for `key` has been computed since the last reset().
+  bool has_order(Key key) const {
+    return built_[static_cast<std::size_t>(key)];
+  }
+
+private:
+  void compute(Key key, std::vector<PatchIndex::PatchId> &order) const;
+
+  const PatchIndex *index_ = nullptr;
+  std::array<std::vector<PatchIndex::PatchId>, kKeyCount> orders_;
+  std::array<bool, kKeyCount> built_{};
+};
+
+} // namespace patches
@@ -5,6 +5,7 @@
 #include <filesystem>
 #include <optional>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace patches {
@@ -80,6 +81,15 @@ public:
     return false;
   }
 
+  // Add entries for the patches this storage owns that have none yet, and
+  // persist them before returning; existing entries are left alone.
+  virtual bool merge_missing_metadata(
+      const std::vector<std::pair<std::string, PatchMetadata>> &,
+      std::size_t &inserted) {
+    inserted = 0;
+    return false;
+  }
+
   virtual std::optional<PatchMetadata>
   get_patch_metadata(const std::string &) const {
     return std::nullopt;
@@ -1,9 +1,10 @@
 #include "patches/persistent_parse_cache.hpp"
 
+#include "platform/file_view.hpp"
+
 #include <algorithm>
 #include <chrono>
 #include <fstream>
-#include <iterator>
 #include <nlohmann/json.hpp>
 #include <system_error>
 #include <vector>
@@ -30,9 +31,34 @@ nlohmann::json subtree_to_json(const PatchEntry &entry) {
       {"source_relative_path", entry.source_relative_path},
       {"container_item_id", entry.container_item_id},
       {"children", std::move(children)},
+      {"children_pending", entry.children_pending},
   };
 }
 
+/// Whether two trees would be written out the same: everything
+/// subtree_to_json() stores, and nothing it leaves out, such as metadata.
+bool same_stored_tree(const std::vector<PatchEntry> &left,
+                      const std::vector<PatchEntry> &right) {
+  if (left.size() != right.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < left.size(); ++i) {
+    const auto &a = left[i];
+    const auto &b = right[i];
+    if (a.name != b.name || a.relative_path != b.relative_path ||
+        a.full_path != b.full_path || a.format != b.format ||
+        a.is_directory != b.is_directory ||
+        a.instrument_index != b.instrument_index ||
+        a.source_relative_path != b.source_relative_path ||
+        a.container_item_id != b.container_item_id ||
+        a.children_pending != b.children_pending ||
+        !same_stored_tree(a.children, b.children)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 std::optional<PatchEntry> subtree_from_json(const nlohmann::json &json) {
   if (!json.is_object() || !json.contains("name") ||
       !json.at("name").is_string() || !json.contains("relative_path") ||
@@ -60,6 +86,11 @@ std::optional<PatchEntry> subtree_from_json(const nlohmann::json &json) {
   entry.source_relative_path =
       json.at("source_relative_path").get<std::string>();
   entry.container_item_id = json.at("container_item_id").get<std::string>();
+  // Absent from entries written before lazy walks existed.
+  if (json.contains("children_pending") &&
+      json.at("children_pending").is_boolean()) {
+    entry.children_pending = json.at("children_pending").get<bool>();
+  }
   for (const auto &child_json : json.at("children")) {
     auto child = subtree_from_json(child_json);
     if (!child) {
@@ -70,6 +101,23 @@ std::optional<PatchEntry> subtree_from_json(const nlohmann::json &json) {
   return entry;
 }
 
+std::optional<std::vector<PatchEntry>>
+tree_from_json(const nlohmann::json &json) {
+  if (!json.is_array()) {
+    return std::nullopt;
+  }
+  std::vector<PatchEntry> tree;
+  tree.reserve(json.size());
+  for (const auto &root_json : json) {
+    auto root = subtree_from_json(root_json);
+    if (!root) {
+      return std::nullopt;
+    }
+    tree.push_back(std::move(*root));
+  }
+  return tree;
+}
+
 bool is_signed_integer(const nlohmann::json &json) {
   return json.is_number_integer() || json.is_number_unsigned();
 }
@@ -81,6 +129,8 @@ void PersistentParseCache::load(std::filesystem::path file_path) {
   file_path_ = std::move(file_path);
   entries_.clear();
   next_access_order_ = 0;
+  tree_key_.reset();
+  tree_.clear();
   dirty_ = false;
 
   try {
@@ -89,13 +139,12 @@ void PersistentParseCache::load(std::filesystem::path file_path) {
       return;
     }
 
-    std::ifstream input(file_path_, std::ios::binary);
-    if (!input) {
+    const auto view = platform::FileView::open(file_path_);
+    if (!view) {
       return;
     }
-    const std::string text((std::istreambuf_iterator<char>(input)),
-                           std::istreambuf_iterator<char>());
-    const auto json = nlohmann::json::parse(text, nullptr, false);
+    const auto json = nlohmann::json::parse(
+        view->data(), view->data() + view->size(), nullptr, false);
     if (json.is_discarded() || !json.is_object() ||
         json.value("version", 0) != kSchemaVersion ||
         !json.contains("entries") || !json.at("entries").is_array()) {
@@ -134,9 +183,24 @@ void PersistentParseCache::load(std::filesystem::path file_path) {
         continue;
       }
     }
+
+    // Optional: a file written before the snapshot existed, or one whose
+    // snapshot does not parse, still loads its entries.
+    if (json.contains("tree") && json.at("tree").is_object()) {
+      const auto &snapshot = json.at("tree");
+      if (snapshot.contains("key") && snapshot.at("key").is_string() &&
+          snapshot.contains("roots")) {
+        if (auto tree = tree_from_json(snapshot.at("roots"))) {
+          tree_key_ = snapshot.at("key").get<std::string>();
+          tree_ = std::move(*tree);
+        }
+      }
+    }
   } catch (...) {
     entries_.clear();
     next_access_order_ = 0;
+    tree_key_.reset();
+    tree_.clear();
     dirty_ = false;
   }
 }
@@ -175,8 +239,15 @@ bool PersistentParseCache::save() {
          {"last_used", entry->last_used},
          {"subtree", subtree_to_json(entry->subtree)}});
   }
-  const nlohmann::json root = {{"version", kSchemaVersion},
-                               {"entries", std::move(serialized_entries)}};
+  nlohmann::json root = {{"version", kSchemaVersion},
+                         {"entries", std::move(serialized_entries)}};
+  if (tree_key_) {
+    nlohmann::json roots = nlohmann::json::array();
+    for (const auto &entry : tree_) {
+      roots.push_back(subtree_to_json(entry));
+    }
+    root["tree"] = {{"key", *tree_key_}, {"roots", std::move(roots)}};
+  }
 
   std::error_code error;
   if (file_path_.has_parent_path()) {
@@ -249,6 +320,28 @@ bool PersistentParseCache::dirty() const {
   return dirty_;
 }
 
+std::optional<std::vector<PatchEntry>>
+PersistentParseCache::lookup_tree(std::string_view folder_key) const {
+  std::lock_guard lock(mutex_);
+  if (!tree_key_ || *tree_key_ != folder_key) {
+    return std::nullopt;
+  }
+  return tree_;
+}
+
+void PersistentParseCache::store_tree(std::string folder_key,
+                                      std::vector<PatchEntry> tree) {
+  std::lock_guard lock(mutex_);
+  // Every walk stores its tree, and most find what the last one did; only a
+  // change is worth rewriting the cache file for.
+  if (tree_key_ && *tree_key_ == folder_key && same_stored_tree(tree_, tree)) {
+    return;
+  }
+  tree_key_ = std::move(folder_key);
+  tree_ = std::move(tree);
+  dirty_ = true;
+}
+
 std::int64_t PersistentParseCache::modified_milliseconds(
     std::filesystem::file_time_type modified) {
   return std::chrono::floor<std::chrono::milliseconds>(
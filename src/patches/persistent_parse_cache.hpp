@@ -8,6 +8,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace patches {
 
@@ -28,6 +29,16 @@ public:
 
   bool dirty() const;
 
+  /**
+   * The last complete tree the repository listed, keyed by the folder set it
+   * listed, so the next launch can show it before touching the disk. Only
+   * one is kept. Metadata is not stored; the repository reapplies it from
+   * the sidecars.
+   */
+  std::optional<std::vector<PatchEntry>>
+  lookup_tree(std::string_view folder_key) const;
+  void store_tree(std::string folder_key, std::vector<PatchEntry> tree);
+
 private:
   struct Entry {
     std::uintmax_t file_size = 0;
@@ -47,6 +58,8 @@ private:
   std::filesystem::path file_path_;
   std::unordered_map<std::string, Entry> entries_;
   std::uint64_t next_access_order_ = 0;
+  std::optional<std::string> tree_key_;
+  std::vector<PatchEntry> tree_;
   bool dirty_ = false;
 };
 
@@ -0,0 +1,150 @@
+#include "similarity_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace patches {
+
+namespace {
+
+/// Items scanned together: their running distances stay in L1.
+constexpr std::size_t kBlock = 256;
+
+constexpr std::size_t kAlgorithms = 8;
+constexpr std::size_t kOperatorFields = 13;
+static_assert(kAlgorithms + 1 + 4 * kOperatorFields <=
+              SimilarityVector::kDimensions);
+
+constexpr float kAlgorithmWeight = 1.0f;
+constexpr float kFeedbackWeight = 1.0f;
+
+struct Field {
+  float range;
+  float weight;
+};
+
+// In the order SimilarityVector::from() writes them.
+constexpr std::array<Field, kOperatorFields> kOperatorLayout = {{
+    {31.0f, 1.0f},  // attack rate
+    {31.0f, 0.8f},  // decay rate
+    {31.0f, 0.6f},  // sustain rate
+    {15.0f, 0.8f},  // release rate
+    {15.0f, 0.8f},  // sustain level
+    {127.0f, 1.5f}, // total level
+    {3.0f, 0.3f},   // key scale
+    {15.0f, 1.5f},  // multiple
+    {6.0f, 0.4f},   // detune, -3..3
+    {7.0f, 0.3f},   // SSG-EG shape
+    {1.0f, 0.5f},   // SSG-EG on
+    {1.0f, 0.3f},   // amplitude modulation
+    {1.0f, 1.5f},   // operator on
+}};
+
+} // namespace
+
+SimilarityVector SimilarityVector::from(const ym2612::PackedPatch &sound) {
+  ym2612::GlobalSettings global;
+  ym2612::ChannelSettings channel;
+  ym2612::ChannelInstrument instrument;
+  ym2612::unpack(sound, global, channel, instrument);
+
+  SimilarityVector vector;
+  auto *out = vector.values.data();
+  out[instrument.algorithm % kAlgorithms] = kAlgorithmWeight;
+  out += kAlgorithms;
+  *out++ = instrument.feedback / 7.0f * kFeedbackWeight;
+  for (const auto &op : instrument.operators) {
+    const std::array<int, kOperatorFields> raw = {
+        op.attack_rate,
+        op.decay_rate,
+        op.sustain_rate,
+        op.release_rate,
+        op.sustain_level,
+        op.total_level,
+        op.key_scale,
+        op.multiple,
+        ym2612::signed_detune(op.detune) + 3,
+        op.ssg_type_envelope_control,
+        op.ssg_enable,
+        op.amplitude_modulation_enable,
+        op.enable};
+    for (std::size_t f = 0; f < kOperatorFields; ++f) {
+      const auto &field = kOperatorLayout[f];
+      *out++ = static_cast<float>(raw[f]) / field.range * field.weight;
+    }
+  }
+  return vector;
+}
+
+float similarity_distance(const SimilarityVector &a,
+                          const SimilarityVector &b) {
+  float sum = 0.0f;
+  for (std::size_t d = 0; d < SimilarityVector::kDimensions; ++d) {
+    const float diff = a.values[d] - b.values[d];
+    sum += diff * diff;
+  }
+  return std::sqrt(sum);
+}
+
+float max_similarity_distance() {
+  // Two algorithms apart, and every other setting at opposite ends.
+  float sum = 2.0f * kAlgorithmWeight * kAlgorithmWeight +
+              kFeedbackWeight * kFeedbackWeight;
+  for (const auto &field : kOperatorLayout) {
+    sum += 4.0f * field.weight * field.weight;
+  }
+  return std::sqrt(sum);
+}
+
+BruteForceSimilarityIndex::BruteForceSimilarityIndex(
+    std::span<const SimilarityVector> items)
+    : count_(items.size()),
+      stride_((items.size() + kBlock - 1) / kBlock * kBlock),
+      columns_(SimilarityVector::kDimensions * stride_, 0.0f) {
+  for (std::size_t i = 0; i < count_; ++i) {
+    for (std::size_t d = 0; d < SimilarityVector::kDimensions; ++d) {
+      columns_[d * stride_ + i] = items[i].values[d];
+    }
+  }
+}
+
+std::vector<SimilarityIndex::Match>
+BruteForceSimilarityIndex::nearest(const SimilarityVector &query,
+                                   std::size_t k) const {
+  std::vector<float> squared(stride_, 0.0f);
+  for (std::size_t block = 0; block < stride_; block += kBlock) {
+    float *sums = squared.data() + block;
+    for (std::size_t d = 0; d < SimilarityVector::kDimensions; ++d) {
+      const float q = query.values[d];
+      const float *column = columns_.data() + d * stride_ + block;
+      for (std::size_t i = 0; i < kBlock; ++i) {
+        const float diff = column[i] - q;
+        sums[i] += diff * diff;
+      }
+    }
+  }
+
+  std::vector<std::size_t> order(count_);
+  std::iota(order.begin(), order.end(), std::size_t{0});
+  k = std::min(k, count_);
+  const auto closer = [&](std::size_t a, std::size_t b) {
+    return squared[a] != squared[b] ? squared[a] < squared[b] : a < b;
+  };
+  std::partial_sort(order.begin(), order.begin() + static_cast<long>(k),
+                    order.end(), closer);
+
+  std::vector<Match> matches;
+  matches.reserve(k);
+  for (std::size_t i = 0; i < k; ++i) {
+    matches.push_back({order[i], std::sqrt(squared[order[i]])});
+  }
+  return matches;
+}
+
+std::unique_ptr<SimilarityIndex>
+make_similarity_index(std::span<const SimilarityVector> items) {
+  return std::make_unique<BruteForceSimilarityIndex>(items);
+}
+
+} // namespace patches
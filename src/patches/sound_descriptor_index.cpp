@@ -0,0 +1,318 @@
+#include "sound_descriptor_index.hpp"
+
+#include "core/parallel_for.hpp"
+#include "platform/file_view.hpp"
+#include "platform/platform_config.hpp"
+#include "ym2612/channel.hpp"
+#include "ym2612/note.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace patches {
+
+namespace {
+
+/// Bump when the render or the measurements change: older entries are then
+/// measured again.
+constexpr int kSchemaVersion = 1;
+
+/// A3, in the middle of the range most patches are played in.
+const ym2612::Note kNote{4, Key::A};
+constexpr std::uint32_t kHeldFrames = SoundDescriptorIndex::kSampleRate;
+constexpr std::uint32_t kReleaseFrames = SoundDescriptorIndex::kSampleRate / 2;
+
+#if defined(MEGATOY_PLATFORM_WEB)
+/// Sounds rendered per update() on the UI thread.
+constexpr std::size_t kWebBatch = 4;
+#endif
+
+float note_frequency(const ym2612::Note &note) {
+  const auto frequency = ym2612::frequency_with_bend(note, 0.0f);
+  // fnum * 2^(block - 1) * (clock / 144) / 2^20
+  return static_cast<float>(frequency.fnum) *
+         static_cast<float>(1u << frequency.block) *
+         (static_cast<float>(ym2612::Device::kClock) / 144.0f) /
+         static_cast<float>(1u << 21);
+}
+
+std::string hash_key(std::uint64_t hash) {
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx",
+                static_cast<unsigned long long>(hash));
+  return text;
+}
+
+nlohmann::json to_json(const audio::SoundDescriptors &descriptors) {
+  return nlohmann::json::array(
+      {descriptors.peak_db, descriptors.rms_db, descriptors.loudness_lufs,
+       descriptors.centroid_hz, descriptors.attack_ms, descriptors.decay_ms,
+       descriptors.harmonicity});
+}
+
+std::optional<audio::SoundDescriptors> from_json(const nlohmann::json &json) {
+  if (!json.is_array() || json.size() != 7) {
+    return std::nullopt;
+  }
+  for (const auto &value : json) {
+    if (!value.is_number()) {
+      return std::nullopt;
+    }
+  }
+  audio::SoundDescriptors descriptors;
+  descriptors.peak_db = json[0].get<float>();
+  descriptors.rms_db = json[1].get<float>();
+  descriptors.loudness_lufs = json[2].get<float>();
+  descriptors.centroid_hz = json[3].get<float>();
+  descriptors.attack_ms = json[4].get<float>();
+  descriptors.decay_ms = json[5].get<float>();
+  descriptors.harmonicity = json[6].get<float>();
+  return descriptors;
+}
+
+} // namespace
+
+struct SoundDescriptorIndex::Job {
+  std::vector<ym2612::PackedPatch> sounds;
+  /// Alongside `sounds`; each is written by the one worker that claimed it.
+  std::vector<std::optional<audio::SoundDescriptors>> results;
+
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> done{0};
+  std::atomic<bool> cancel{false};
+  std::atomic<bool> finished{false};
+  std::thread worker;
+};
+
+SoundDescriptorIndex::SoundDescriptorIndex() = default;
+
+SoundDescriptorIndex::~SoundDescriptorIndex() { shutdown(); }
+
+void SoundDescriptorIndex::load(std::filesystem::path file_path) {
+  file_path_ = std::move(file_path);
+  known_.clear();
+  dirty_ = false;
+  ++generation_;
+
+  std::error_code error;
+  if (!std::filesystem::exists(file_path_, error) || error) {
+    return;
+  }
+  const auto view = platform::FileView::open(file_path_);
+  if (!view) {
+    return;
+  }
+  const auto json = nlohmann::json::parse(
+      view->data(), view->data() + view->size(), nullptr, false);
+  if (json.is_discarded() || !json.is_object() ||
+      json.value("version", 0) != kSchemaVersion ||
+      !json.contains("entries") || !json.at("entries").is_object()) {
+    return;
+  }
+  for (const auto &[key, value] : json.at("entries").items()) {
+    char *end = nullptr;
+    const auto hash = std::strtoull(key.c_str(), &end, 16);
+    if (key.size() != 16 || end != key.c_str() + key.size()) {
+      continue;
+    }
+    if (auto descriptors = from_json(value)) {
+      known_.insert_or_assign(hash, *descriptors);
+    }
+  }
+}
+
+bool SoundDescriptorIndex::save() {
+  if (!dirty_) {
+    return true;
+  }
+  if (file_path_.empty()) {
+    return false;
+  }
+
+  nlohmann::json entries = nlohmann::json::object();
+  for (const auto &[hash, descriptors] : known_) {
+    entries[hash_key(hash)] = to_json(descriptors);
+  }
+  const nlohmann::json root = {{"version", kSchemaVersion},
+                               {"entries", std::move(entries)}};
+
+  std::error_code error;
+  if (file_path_.has_parent_path()) {
+    std::filesystem::create_directories(file_path_.parent_path(), error);
+    if (error) {
+      return false;
+    }
+  }
+  auto temporary = file_path_;
+  temporary += ".tmp";
+  {
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      return false;
+    }
+    output << root.dump() << '\n';
+    if (!output) {
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, file_path_, error);
+  if (error) {
+    std::error_code remove_error;
+    std::filesystem::remove(temporary, remove_error);
+    return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+audio::SoundDescriptors
+SoundDescriptorIndex::analyze(const ym2612::PackedPatch &sound,
+                              ym2612::Device &device) {
+  ym2612::GlobalSettings global;
+  ym2612::ChannelSettings channel_settings;
+  ym2612::ChannelInstrument instrument;
+  ym2612::unpack(sound, global, channel_settings, instrument);
+
+  // A fresh chip, so nothing of the previous sound rings on.
+  device.init(kSampleRate);
+  device.write_settings(global);
+  auto channel = device.channel(ym2612::ChannelIndex::Fm1);
+  channel.write_settings(channel_settings);
+  channel.write_instrument(instrument);
+  channel.write_frequency(kNote);
+  const auto &ops = instrument.operators;
+  channel.write_key_on(ops[0].enable, ops[1].enable, ops[2].enable,
+                       ops[3].enable);
+
+  std::vector<float> rendered(
+      static_cast<std::size_t>(kHeldFrames + kReleaseFrames) * 2);
+  device.render(kHeldFrames, rendered.data());
+  channel.write_key_off();
+  device.render(kReleaseFrames, rendered.data() + kHeldFrames * 2);
+  device.stop();
+
+  return audio::measure_sound(
+      rendered, {kSampleRate, kHeldFrames, note_frequency(kNote)});
+}
+
+void SoundDescriptorIndex::work(Job &job, std::size_t limit) {
+  ym2612::Device device;
+  for (std::size_t n = 0; n < limit; ++n) {
+    if (job.cancel.load(std::memory_order_relaxed)) {
+      return;
+    }
+    const auto i = job.next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= job.sounds.size()) {
+      return;
+    }
+    job.results[i] = analyze(job.sounds[i], device);
+    job.done.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void SoundDescriptorIndex::update(const DuplicateFinder &finder) {
+  if (stopped_) {
+    return;
+  }
+#if defined(MEGATOY_PLATFORM_WEB)
+  if (job_) {
+    work(*job_, kWebBatch);
+    if (job_->done.load(std::memory_order_relaxed) == job_->sounds.size()) {
+      job_->finished.store(true, std::memory_order_release);
+    }
+    return;
+  }
+#endif
+  if (job_ || !finder.revision() || finder_revision_ == finder.revision()) {
+    return;
+  }
+  finder_revision_ = finder.revision();
+
+  auto job = std::make_unique<Job>();
+  std::unordered_set<std::uint64_t> queued;
+  for (const auto &sound : finder.sounds()) {
+    const auto hash = sound.hash();
+    if (!known_.contains(hash) && queued.insert(hash).second) {
+      job->sounds.push_back(sound);
+    }
+  }
+  if (job->sounds.empty()) {
+    return;
+  }
+  job->results.resize(job->sounds.size());
+
+  job_ = std::move(job);
+#if !defined(MEGATOY_PLATFORM_WEB)
+  auto *raw = job_.get();
+  job_->worker = std::thread([raw] {
+    // One Device per worker, each pulling sounds until none are left.
+    const auto threads = megatoy::default_thread_count();
+    megatoy::parallel_for(threads, threads, [raw](std::size_t) {
+      work(*raw, raw->sounds.size());
+    });
+    raw->finished.store(true, std::memory_order_release);
+  });
+#endif
+}
+
+void SoundDescriptorIndex::merge(Job &job) {
+  for (std::size_t i = 0; i < job.sounds.size(); ++i) {
+    if (job.results[i]) {
+      known_.insert_or_assign(job.sounds[i].hash(), *job.results[i]);
+      dirty_ = true;
+    }
+  }
+  ++generation_;
+}
+
+bool SoundDescriptorIndex::poll() {
+  if (!job_ || !job_->finished.load(std::memory_order_acquire)) {
+    return false;
+  }
+  auto done = std::move(job_);
+  if (done->worker.joinable()) {
+    done->worker.join();
+  }
+  merge(*done);
+  return true;
+}
+
+SoundDescriptorIndex::Progress SoundDescriptorIndex::progress() const {
+  if (!job_) {
+    return {};
+  }
+  return {job_->done.load(std::memory_order_relaxed), job_->sounds.size()};
+}
+
+std::optional<audio::SoundDescriptors>
+SoundDescriptorIndex::find(const ym2612::PackedPatch &sound) const {
+  const auto found = known_.find(sound.hash());
+  if (found == known_.end()) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+void SoundDescriptorIndex::shutdown() {
+  stopped_ = true;
+  if (!job_) {
+    return;
+  }
+  job_->cancel.store(true, std::memory_order_relaxed);
+  if (job_->worker.joinable()) {
+    job_->worker.join();
+  }
+  merge(*job_);
+  job_.reset();
+}
+
+} // namespace patches
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "audio/sound_descriptors.hpp"
+#include "duplicate_finder.hpp"
+#include "ym2612/device.hpp"
+#include "ym2612/packed_patch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace patches {
+
+/**
+ * How every patch in the workspace sounds, measured by playing it.
+ *
+ * Each distinct sound is rendered once -- one note, held for a second and
+ * then released -- on a ym2612::Device owned by the worker doing it, and
+ * reduced to audio::SoundDescriptors. The sounds come from the
+ * DuplicateFinder's last job, which has already read every patch.
+ *
+ * Results are kept by PackedPatch hash, so copies share one render, a
+ * renamed or moved patch needs none, and the cache saved with save() lets
+ * the next launch pick up where this one stopped. A library of thousands
+ * takes minutes to render, which is why it runs on every core and why a
+ * job that is stopped keeps what it finished.
+ *
+ * UI-thread-only apart from the job. The browser build has no threads to
+ * spare and renders a few sounds per update() instead.
+ */
+class SoundDescriptorIndex {
+public:
+  static constexpr std::uint32_t kSampleRate = 44100;
+
+  struct Progress {
+    std::size_t sounds_done = 0;
+    std::size_t sounds_total = 0;
+  };
+
+  SoundDescriptorIndex();
+  ~SoundDescriptorIndex();
+
+  SoundDescriptorIndex(const SoundDescriptorIndex &) = delete;
+  SoundDescriptorIndex &operator=(const SoundDescriptorIndex &) = delete;
+
+  /// Read the cache at `file_path`, which save() writes back.
+  void load(std::filesystem::path file_path);
+  bool save();
+  bool dirty() const { return dirty_; }
+
+  /**
+   * Start measuring the sounds of the finder's last job that have no
+   * descriptors yet, unless that job was already looked at or a job is
+   * running. Call it every frame descriptors are wanted.
+   */
+  void update(const DuplicateFinder &finder);
+  /// Publish a finished job; true when find() has more to say.
+  bool poll();
+
+  bool running() const { return job_ != nullptr; }
+  Progress progress() const;
+  /// Bumped whenever find() may answer differently.
+  std::uint64_t generation() const { return generation_; }
+
+  std::optional<audio::SoundDescriptors>
+  find(const ym2612::PackedPatch &sound) const;
+
+  /// Cancel and join the running job, keeping what it finished. update()
+  /// starts no more.
+  void shutdown();
+
+  /// Render `sound` on `device` and measure it. `device` is reset first.
+  static audio::SoundDescriptors analyze(const ym2612::PackedPatch &sound,
+                                         ym2612::Device &device);
+
+private:
+  struct Job;
+
+  static void work(Job &job, std::size_t limit);
+  void merge(Job &job);
+
+  std::filesystem::path file_path_;
+  std::unordered_map<std::uint64_t, audio::SoundDescriptors> known_;
+  bool dirty_ = false;
+  bool stopped_ = false;
+  std::uint64_t generation_ = 0;
+  /// The finder revision the last job was started from.
+  std::optional<std::uint64_t> finder_revision_;
+  std::unique_ptr<Job> job_;
+};
+
+} // namespace patches
@@ -0,0 +1,146 @@
+#include "platform/file_view.hpp"
+
+#include "platform/platform_config.hpp"
+
+#include <utility>
+
+#if defined(MEGATOY_PLATFORM_DESKTOP) && !defined(_WIN32)
+#define MEGATOY_FILE_VIEW_MMAP 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace platform {
+
+namespace {
+
+#if defined(MEGATOY_FILE_VIEW_MMAP)
+
+/// Closes the descriptor on every way out of open(); a mapping outlives it.
+struct Descriptor {
+  int fd;
+  ~Descriptor() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+};
+
+bool read_all(int fd, std::vector<std::uint8_t> &buffer) {
+  std::size_t done = 0;
+  while (done < buffer.size()) {
+    const auto count = ::read(fd, buffer.data() + done, buffer.size() - done);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    done += static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+#endif
+
+} // namespace
+
+std::optional<FileView> FileView::open(const std::filesystem::path &path) {
+#if defined(MEGATOY_FILE_VIEW_MMAP)
+  const Descriptor file{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (file.fd < 0) {
+    return std::nullopt;
+  }
+  struct stat info;
+  if (::fstat(file.fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    return std::nullopt;
+  }
+  const auto size = static_cast<std::size_t>(info.st_size);
+  if (size >= kMapThreshold) {
+    void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (mapping != MAP_FAILED) {
+      FileView view;
+      view.mapping_ = mapping;
+      view.data_ = static_cast<const std::uint8_t *>(mapping);
+      view.size_ = size;
+      return view;
+    }
+  }
+  std::vector<std::uint8_t> buffer(size);
+  if (!read_all(file.fd, buffer)) {
+    return std::nullopt;
+  }
+  return adopt(std::move(buffer));
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return std::nullopt;
+  }
+  const auto end = file.tellg();
+  if (end < 0) {
+    return std::nullopt;
+  }
+  std::vector<std::uint8_t> buffer(static_cast<std::size_t>(end));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char *>(buffer.data()),
+                 static_cast<std::streamsize>(buffer.size()))) {
+    return std::nullopt;
+  }
+  return adopt(std::move(buffer));
+#endif
+}
+
+std::optional<FileView> FileView::read(std::istream &stream) {
+  std::vector<std::uint8_t> bytes;
+  char block[16 * 1024];
+  while (stream.read(block, sizeof(block)) || stream.gcount() > 0) {
+    bytes.insert(bytes.end(), block, block + stream.gcount());
+  }
+  if (stream.bad()) {
+    return std::nullopt;
+  }
+  return adopt(std::move(bytes));
+}
+
+FileView FileView::adopt(std::vector<std::uint8_t> bytes) {
+  FileView view;
+  view.buffer_ = std::move(bytes);
+  view.data_ = view.buffer_.data();
+  view.size_ = view.buffer_.size();
+  return view;
+}
+
+FileView::FileView(FileView &&other) noexcept { *this = std::move(other); }
+
+FileView &FileView::operator=(FileView &&other) noexcept {
+  if (this != &other) {
+    release();
+    // Moving the vector keeps its allocation, so data_ stays valid.
+    buffer_ = std::move(other.buffer_);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapping_ = std::exchange(other.mapping_, nullptr);
+  }
+  return *this;
+}
+
+FileView::~FileView() { release(); }
+
+void FileView::release() {
+#if defined(MEGATOY_FILE_VIEW_MMAP)
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, size_);
+  }
+#endif
+  mapping_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+  buffer_.clear();
+}
+
+} // namespace platform
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace platform {
+
+/**
+ * The whole contents of a file, for a parser to read in place.
+ *
+ * On desktop POSIX builds a file of kMapThreshold bytes or more is mapped
+ * read-only, so nothing is copied and pages come in as the parser touches
+ * them. Smaller files, other platforms, and files that will not map are read
+ * with one bulk read into a buffer the view owns: for a 100-byte patch the
+ * map and unmap calls cost more than the copy they save. Either way bytes()
+ * stays valid, and unchanged, for as long as the view lives.
+ *
+ * A mapped file that another program truncates can fault on access, as with
+ * any mapping; keep a view only as long as the parse that needs it.
+ */
+class FileView {
+public:
+  static constexpr std::size_t kMapThreshold = 64 * 1024;
+
+  /// Nothing if the file cannot be opened or read to the end.
+  static std::optional<FileView> open(const std::filesystem::path &path);
+  /// Whatever is left in `stream`, copied in blocks; nothing on a read error.
+  static std::optional<FileView> read(std::istream &stream);
+  /// A view that owns bytes already in memory, such as an inflated archive
+  /// entry, so callers take one type whatever the source.
+  static FileView adopt(std::vector<std::uint8_t> bytes);
+
+  FileView() = default;
+  FileView(FileView &&other) noexcept;
+  FileView &operator=(FileView &&other) noexcept;
+  FileView(const FileView &) = delete;
+  FileView &operator=(const FileView &) = delete;
+  ~FileView();
+
+  std::span<const std::uint8_t> bytes() const { return {data_, size_}; }
+  const std::uint8_t *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  /// Whether the bytes are the file's own pages rather than a copy.
+  bool mapped() const { return mapping_ != nullptr; }
+
+private:
+  void release();
+
+  const std::uint8_t *data_ = nullptr;
+  std::size_t size_ = 0;
+  void *mapping_ = nullptr;
+  std::vector<std::uint8_t> buffer_;
+};
+
+} // namespace platform
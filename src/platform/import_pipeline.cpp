@@ -2,13 +2,13 @@
 
 #include "formats/ginpkg.hpp"
 #include "formats/ym2612_format_adapter.hpp"
+#include "platform/file_view.hpp"
 
 #include <algorithm>
 #include <array>
 #include <cctype>
-#include <fstream>
-#include <iterator>
 #include <mutex>
+#include <span>
 #include <system_error>
 #include <unordered_map>
 #include <unordered_set>
@@ -49,24 +49,14 @@ ValidationResult invalid(const std::string &extension,
   return result;
 }
 
-std::vector<std::uint8_t> read_bytes(const std::filesystem::path &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file) {
-    return {};
-  }
-  return {std::istreambuf_iterator<char>(file),
-          std::istreambuf_iterator<char>()};
-}
-
-bool has_prefix(const std::vector<std::uint8_t> &bytes,
+bool has_prefix(std::span<const std::uint8_t> bytes,
                 std::initializer_list<std::uint8_t> prefix) {
   return bytes.size() >= prefix.size() &&
          std::equal(prefix.begin(), prefix.end(), bytes.begin());
 }
 
-ValidationResult validate_mml(const std::filesystem::path &path,
+ValidationResult validate_mml(std::span<const std::uint8_t> bytes,
                               const std::string &extension) {
-  const auto bytes = read_bytes(path);
   if (bytes.empty()) {
     return invalid(extension, "empty text");
   }
@@ -147,18 +137,23 @@ ValidationResult validate_file(const std::filesystem::path &path) {
     return {.reason = "unsupported file type"};
   }
 
+  // Read once: the header checks and the parse share these bytes.
+  const auto view = platform::FileView::open(path);
+  const auto bytes =
+      view ? view->bytes() : std::span<const std::uint8_t>();
+
   if (extension == ".mml") {
-    return validate_mml(path, extension);
+    return validate_mml(bytes, extension);
   }
 
   if (extension == ".ginpkg") {
-    const auto bytes = read_bytes(path);
     if (!has_prefix(bytes, {'P', 'K', 0x03, 0x04}) &&
         !has_prefix(bytes, {'P', 'K', 0x05, 0x06}) &&
         !has_prefix(bytes, {'P', 'K', 0x07, 0x08})) {
       return invalid(extension, "missing ZIP header");
     }
-    auto package = formats::ginpkg::load_package(path);
+    auto package = formats::ginpkg::load_package_from_memory(
+        bytes.data(), bytes.size(), path);
     if (!package || !formats::ginpkg::read_current(*package)) {
       return invalid(extension);
     }
@@ -173,7 +168,6 @@ ValidationResult validate_file(const std::filesystem::path &path) {
   }
 
   if (extension == ".vgm" || extension == ".vgz") {
-    const auto bytes = read_bytes(path);
     const bool magic_ok = extension == ".vgm"
                               ? has_prefix(bytes, {'V', 'g', 'm', ' '})
                               : has_prefix(bytes, {0x1f, 0x8b});
@@ -187,7 +181,8 @@ ValidationResult validate_file(const std::filesystem::path &path) {
   if (!format) {
     return invalid(extension);
   }
-  auto patches = formats::adapter::read_file(*format, path);
+  auto patches = formats::adapter::read_memory(
+      *format, bytes.data(), bytes.size(), path.stem().string());
   if (patches.empty()) {
     return invalid(extension);
   }
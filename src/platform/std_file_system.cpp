@@ -79,6 +79,11 @@ StdFileSystem::open_read(const std::filesystem::path &path) const {
   return stream;
 }
 
+std::optional<FileView>
+StdFileSystem::view(const std::filesystem::path &path) const {
+  return FileView::open(path);
+}
+
 std::unique_ptr<std::ostream>
 StdFileSystem::open_write(const std::filesystem::path &path,
                           std::ios::openmode mode) {
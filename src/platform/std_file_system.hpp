@@ -25,6 +25,9 @@ public:
   open_read(const std::filesystem::path &path) const override;
   std::unique_ptr<std::ostream> open_write(const std::filesystem::path &path,
                                            std::ios::openmode mode) override;
+  /// Maps the file where the platform allows; see FileView.
+  std::optional<FileView>
+  view(const std::filesystem::path &path) const override;
 };
 
 } // namespace platform
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "platform/file_view.hpp"
+
 #include <filesystem>
 #include <ios>
 #include <istream>
 #include <memory>
+#include <optional>
 #include <ostream>
+#include <string>
 #include <system_error>
 #include <vector>
 
@@ -37,6 +41,31 @@ public:
   virtual std::unique_ptr<std::ostream>
   open_write(const std::filesystem::path &path,
              std::ios::openmode mode = std::ios::binary) = 0;
+
+  /**
+   * The whole of `path` as one block for a parser, or nothing if it cannot
+   * be read. This default copies open_read() into a buffer; file systems
+   * that can hand over the bytes more cheaply override it.
+   */
+  virtual std::optional<FileView>
+  view(const std::filesystem::path &path) const {
+    auto stream = open_read(path);
+    if (!stream) {
+      return std::nullopt;
+    }
+    return FileView::read(*stream);
+  }
+
+  /**
+   * Whatever identifies the contents of `path` beyond its size and
+   * modification time, for caches to add to their keys; empty when there is
+   * nothing more. An archive records a CRC for every entry, so it answers
+   * with that.
+   */
+  virtual std::string content_tag(const std::filesystem::path &path) const {
+    (void)path;
+    return {};
+  }
 };
 
 } // namespace platform
@@ -0,0 +1,344 @@
+#include "platform/zip_file_system.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <miniz.h>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace platform {
+
+struct ZipFileSystem::Reader {
+  mz_zip_archive zip;
+
+  Reader() { std::memset(&zip, 0, sizeof(zip)); }
+  ~Reader() { mz_zip_reader_end(&zip); }
+};
+
+namespace {
+
+/// Deflate cannot grow data by much more than this.
+constexpr std::uint64_t kMaxInflateRatio = 1032;
+/// Far past any patch bank; a bigger entry is not worth inflating into
+/// memory.
+constexpr std::uint64_t kMaxEntryBytes = 256 * 1024 * 1024;
+
+std::string to_native_string(const std::filesystem::path &path) {
+#if defined(_WIN32)
+  auto u8 = path.u8string();
+  return std::string(u8.begin(), u8.end());
+#else
+  return path.string();
+#endif
+}
+
+/**
+ * An entry name as the tree uses it: '/'-separated, no leading or repeated
+ * separators, no "." segments. Names that climb out with ".." are dropped,
+ * as is the archive's own root.
+ */
+std::optional<std::string> normalize_entry_name(std::string_view raw) {
+  std::string name;
+  std::size_t start = 0;
+  while (start <= raw.size()) {
+    auto end = raw.find_first_of("/\\", start);
+    if (end == std::string_view::npos) {
+      end = raw.size();
+    }
+    const auto segment = raw.substr(start, end - start);
+    start = end + 1;
+    if (segment.empty() || segment == ".") {
+      continue;
+    }
+    if (segment == "..") {
+      return std::nullopt;
+    }
+    if (!name.empty()) {
+      name += '/';
+    }
+    name += segment;
+  }
+  if (name.empty()) {
+    return std::nullopt;
+  }
+  return name;
+}
+
+} // namespace
+
+ZipFileSystem::ZipFileSystem(std::filesystem::path archive)
+    : archive_(std::move(archive)) {}
+
+ZipFileSystem::~ZipFileSystem() = default;
+
+std::optional<std::string>
+ZipFileSystem::entry_name(const std::filesystem::path &path) const {
+  const auto relative = path.lexically_normal().lexically_relative(
+      archive_.lexically_normal());
+  if (relative.empty()) {
+    return std::nullopt;
+  }
+  auto name = relative.generic_string();
+  while (name.ends_with("/.") || name.ends_with("/")) {
+    name.resize(name.ends_with("/") ? name.size() - 1 : name.size() - 2);
+  }
+  if (name == ".") {
+    return std::string();
+  }
+  if (name == ".." || name.starts_with("../")) {
+    return std::nullopt;
+  }
+  return name;
+}
+
+void ZipFileSystem::close_locked() const {
+  reader_.reset();
+  nodes_.clear();
+  archive_size_ = 0;
+  archive_modified_ = {};
+}
+
+ZipFileSystem::Node &
+ZipFileSystem::directory_locked(const std::string &name) const {
+  if (const auto found = nodes_.find(name); found != nodes_.end()) {
+    return found->second;
+  }
+  if (!name.empty()) {
+    const auto slash = name.rfind('/');
+    auto &parent = directory_locked(
+        slash == std::string::npos ? "" : name.substr(0, slash));
+    parent.children.push_back(
+        slash == std::string::npos ? name : name.substr(slash + 1));
+  }
+  Node directory;
+  directory.is_directory = true;
+  return nodes_.emplace(name, std::move(directory)).first->second;
+}
+
+bool ZipFileSystem::open_locked() const {
+  close_locked();
+
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(archive_, ec);
+  if (ec) {
+    return false;
+  }
+  const auto modified = std::filesystem::last_write_time(archive_, ec);
+  if (ec) {
+    return false;
+  }
+
+  auto reader = std::make_unique<Reader>();
+  const std::string native_path = to_native_string(archive_);
+  if (!mz_zip_reader_init_file(&reader->zip, native_path.c_str(), 0)) {
+    std::cerr << "Failed to open archive: " << archive_ << std::endl;
+    return false;
+  }
+
+  directory_locked("");
+  const mz_uint count = mz_zip_reader_get_num_files(&reader->zip);
+  for (mz_uint index = 0; index < count; ++index) {
+    mz_zip_archive_file_stat stat;
+    if (!mz_zip_reader_file_stat(&reader->zip, index, &stat)) {
+      continue;
+    }
+    const auto name = normalize_entry_name(stat.m_filename);
+    if (!name) {
+      continue;
+    }
+    if (stat.m_is_directory) {
+      directory_locked(*name);
+      continue;
+    }
+    // A name stored twice keeps its first entry, as unzip tools do.
+    if (nodes_.contains(*name)) {
+      continue;
+    }
+    const auto slash = name->rfind('/');
+    auto &parent = directory_locked(
+        slash == std::string::npos ? "" : name->substr(0, slash));
+    parent.children.push_back(
+        slash == std::string::npos ? *name : name->substr(slash + 1));
+
+    Node file;
+    file.index = index;
+    file.size = stat.m_uncomp_size;
+    file.crc = stat.m_crc32;
+    nodes_.emplace(*name, std::move(file));
+  }
+
+  reader_ = std::move(reader);
+  archive_size_ = size;
+  archive_modified_ = modified;
+  return true;
+}
+
+const ZipFileSystem::Node *
+ZipFileSystem::find_locked(const std::filesystem::path &path) const {
+  const auto name = entry_name(path);
+  if (!name) {
+    return nullptr;
+  }
+  if (name->empty() && reader_) {
+    std::error_code size_error;
+    std::error_code time_error;
+    const auto size = std::filesystem::file_size(archive_, size_error);
+    const auto modified =
+        std::filesystem::last_write_time(archive_, time_error);
+    if (size_error || time_error) {
+      close_locked();
+      return nullptr;
+    }
+    if (size != archive_size_ || modified != archive_modified_) {
+      close_locked();
+    }
+  }
+  if (!reader_ && !open_locked()) {
+    return nullptr;
+  }
+  const auto found = nodes_.find(*name);
+  return found == nodes_.end() ? nullptr : &found->second;
+}
+
+bool ZipFileSystem::exists(const std::filesystem::path &path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return find_locked(path) != nullptr;
+}
+
+bool ZipFileSystem::is_directory(const std::filesystem::path &path) const {
+  std::error_code error;
+  return is_directory(path, error);
+}
+
+bool ZipFileSystem::is_directory(const std::filesystem::path &path,
+                                 std::error_code &error) const {
+  error.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto *node = find_locked(path);
+  return node != nullptr && node->is_directory;
+}
+
+bool ZipFileSystem::create_directories(const std::filesystem::path &path) {
+  (void)path;
+  return false;
+}
+
+std::vector<DirectoryEntry>
+ZipFileSystem::read_directory(const std::filesystem::path &path) const {
+  std::vector<DirectoryEntry> entries;
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto *node = find_locked(path);
+  if (node == nullptr || !node->is_directory) {
+    return entries;
+  }
+  const auto name = *entry_name(path);
+  entries.reserve(node->children.size());
+  for (const auto &child : node->children) {
+    const auto &child_node =
+        nodes_.at(name.empty() ? child : name + "/" + child);
+    DirectoryEntry info;
+    info.path = path / child;
+    info.is_directory = child_node.is_directory;
+    info.is_regular_file = !child_node.is_directory;
+    entries.push_back(std::move(info));
+  }
+  return entries;
+}
+
+bool ZipFileSystem::last_write_time(
+    const std::filesystem::path &path,
+    std::filesystem::file_time_type &result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (find_locked(path) == nullptr) {
+    return false;
+  }
+  result = archive_modified_;
+  return true;
+}
+
+bool ZipFileSystem::file_size(const std::filesystem::path &path,
+                              std::uintmax_t &result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto *node = find_locked(path);
+  if (node == nullptr || node->is_directory) {
+    return false;
+  }
+  result = node->size;
+  return true;
+}
+
+bool ZipFileSystem::plausible_size_locked(
+    const Node &node, const std::filesystem::path &path) const {
+  // The size is the central directory's claim, allocated before a byte is
+  // inflated: a corrupt or hostile archive must not get to pick it.
+  if (node.size <= kMaxEntryBytes &&
+      node.size <= std::uint64_t{archive_size_} * kMaxInflateRatio) {
+    return true;
+  }
+  std::cerr << "Skipping " << path << ": the archive claims " << node.size
+            << " bytes for it" << std::endl;
+  return false;
+}
+
+std::unique_ptr<std::istream>
+ZipFileSystem::open_read(const std::filesystem::path &path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto *node = find_locked(path);
+  if (node == nullptr || node->is_directory ||
+      !plausible_size_locked(*node, path)) {
+    return nullptr;
+  }
+  std::size_t size = 0;
+  auto *data = static_cast<char *>(
+      mz_zip_reader_extract_to_heap(&reader_->zip, node->index, &size, 0));
+  if (data == nullptr) {
+    std::cerr << "Failed to read " << path << " from archive" << std::endl;
+    return nullptr;
+  }
+  std::string contents(data, size);
+  mz_free(data);
+  return std::make_unique<std::istringstream>(
+      std::move(contents), std::ios::in | std::ios::binary);
+}
+
+std::unique_ptr<std::ostream>
+ZipFileSystem::open_write(const std::filesystem::path &path,
+                          std::ios::openmode mode) {
+  (void)path;
+  (void)mode;
+  return nullptr;
+}
+
+std::optional<FileView>
+ZipFileSystem::view(const std::filesystem::path &path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto *node = find_locked(path);
+  if (node == nullptr || node->is_directory ||
+      !plausible_size_locked(*node, path)) {
+    return std::nullopt;
+  }
+  std::vector<std::uint8_t> bytes(static_cast<std::size_t>(node->size));
+  if (!mz_zip_reader_extract_to_mem(&reader_->zip, node->index, bytes.data(),
+                                    bytes.size(), 0)) {
+    std::cerr << "Failed to read " << path << " from archive" << std::endl;
+    return std::nullopt;
+  }
+  return FileView::adopt(std::move(bytes));
+}
+
+std::string
+ZipFileSystem::content_tag(const std::filesystem::path &path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto *node = find_locked(path);
+  if (node == nullptr || node->is_directory) {
+    return {};
+  }
+  char crc[9];
+  std::snprintf(crc, sizeof(crc), "%08x", static_cast<unsigned>(node->crc));
+  return std::string(crc) + "@" + std::to_string(archive_size_);
+}
+
+} // namespace platform
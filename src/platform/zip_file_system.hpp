@@ -0,0 +1,101 @@
+#pragma once
+
+#include "platform/virtual_file_system.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace platform {
+
+/**
+ * A .zip archive presented, read-only, as a directory tree rooted at the
+ * archive's own path: "/downloads/pack.zip/bass/a.dmp" is its entry
+ * "bass/a.dmp". Paths outside the archive do not exist.
+ *
+ * The central directory is read once, when the archive is first touched, and
+ * kept as a path table. Asking about the root again -- which every walk
+ * starts with -- re-reads it only if the archive's size or modification time
+ * changed. Opening an entry inflates that entry alone, so browsing a
+ * collection of thousands of patches never unpacks it to disk.
+ *
+ * Every entry reports the archive's modification time, and content_tag()
+ * adds the archive's size and the entry's CRC-32: together, what the parse
+ * caches key an entry on. Safe to share across threads; miniz reads through
+ * one file handle, so calls are serialized.
+ */
+class ZipFileSystem final : public VirtualFileSystem {
+public:
+  explicit ZipFileSystem(std::filesystem::path archive);
+  ~ZipFileSystem() override;
+
+  ZipFileSystem(const ZipFileSystem &) = delete;
+  ZipFileSystem &operator=(const ZipFileSystem &) = delete;
+
+  const std::filesystem::path &archive() const { return archive_; }
+
+  bool exists(const std::filesystem::path &path) const override;
+  bool is_directory(const std::filesystem::path &path) const override;
+  bool is_directory(const std::filesystem::path &path,
+                    std::error_code &error) const override;
+  /// Always false: the archive is never written.
+  bool create_directories(const std::filesystem::path &path) override;
+  std::vector<DirectoryEntry>
+  read_directory(const std::filesystem::path &path) const override;
+  bool last_write_time(const std::filesystem::path &path,
+                       std::filesystem::file_time_type &result) const override;
+  bool file_size(const std::filesystem::path &path,
+                 std::uintmax_t &result) const override;
+  std::unique_ptr<std::istream>
+  open_read(const std::filesystem::path &path) const override;
+  /// Always null: the archive is never written.
+  std::unique_ptr<std::ostream> open_write(const std::filesystem::path &path,
+                                           std::ios::openmode mode) override;
+  /// Inflates the entry straight into the view's buffer.
+  std::optional<FileView>
+  view(const std::filesystem::path &path) const override;
+  std::string content_tag(const std::filesystem::path &path) const override;
+
+private:
+  struct Reader;
+
+  struct Node {
+    bool is_directory = false;
+    /// Index in the central directory; files only.
+    std::uint32_t index = 0;
+    /// Uncompressed, as the central directory claims.
+    std::uint64_t size = 0;
+    std::uint32_t crc = 0;
+    /// Names, not paths, in central directory order; directories only.
+    std::vector<std::string> children;
+  };
+
+  /// The entry name `path` refers to: "" for the archive itself, nothing
+  /// for a path outside it.
+  std::optional<std::string>
+  entry_name(const std::filesystem::path &path) const;
+  /// The node for `path`, opening the archive on first use. Asking for the
+  /// root re-reads a changed archive first.
+  const Node *find_locked(const std::filesystem::path &path) const;
+  bool open_locked() const;
+  void close_locked() const;
+  /// False, with a message, for an entry too large to inflate into memory.
+  bool plausible_size_locked(const Node &node,
+                             const std::filesystem::path &path) const;
+  Node &directory_locked(const std::string &name) const;
+
+  std::filesystem::path archive_;
+
+  mutable std::mutex mutex_;
+  mutable std::unique_ptr<Reader> reader_;
+  mutable std::unordered_map<std::string, Node> nodes_;
+  mutable std::uintmax_t archive_size_ = 0;
+  mutable std::filesystem::file_time_type archive_modified_{};
+};
+
+} // namespace platform
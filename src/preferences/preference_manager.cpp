@@ -140,16 +140,36 @@ void PreferenceManager::request_add_workspace_folder(
     return;
   }
 
+  add_workspace_folder_after_scan(chosen, on_changed, /*visible=*/true);
+#endif
+}
+
+void PreferenceManager::add_workspace_folder_after_scan(
+    const std::filesystem::path &path, std::function<void()> on_changed,
+    bool visible) {
+#if defined(MEGATOY_PLATFORM_WEB)
+  (void)visible;
+  if (add_workspace_folder(path)) {
+    if (on_changed) {
+      on_changed();
+    }
+  } else {
+    megatoy::status::warning("\"" + path.filename().string() +
+                             "\" is already in the workspace.");
+  }
+#else
   // Warm the parse cache on a worker before the folder joins the workspace:
   // the sync that follows re-walks it on the UI thread, and for a folder of
   // thousands of banks that first parse is a freeze measured in seconds.
   // Warm the same path the workspace will store, or the cache keys miss.
-  const auto folder = megatoy::workspace::normalize_path(chosen);
+  namespace scan = patches::background_folder_scan;
+  const auto folder = megatoy::workspace::normalize_path(path);
   const std::string folder_name = folder.filename().string();
-  const bool started = patches::background_folder_scan::begin(
-      folder, [this, folder, folder_name, on_changed](bool cancelled) {
+  const bool queued = scan::begin(
+      folder,
+      [this, folder, folder_name, on_changed](bool cancelled) {
         if (cancelled) {
-          megatoy::status::info("Folder scan cancelled.");
+          megatoy::status::info("Scan of \"" + folder_name + "\" cancelled.");
           return;
         }
         if (add_workspace_folder(folder)) {
@@ -160,9 +180,11 @@ void PreferenceManager::request_add_workspace_folder(
           megatoy::status::warning("\"" + folder_name +
                                    "\" is already in the workspace.");
         }
-      });
-  if (!started) {
-    megatoy::status::warning("Another folder scan is in progress.");
+      },
+      visible ? scan::Priority::Visible : scan::Priority::Normal);
+  if (!queued) {
+    megatoy::status::warning("\"" + folder_name +
+                             "\" is already being scanned.");
   }
 #endif
 }
@@ -293,6 +315,7 @@ void PreferenceManager::reset_ui_preferences() {
       current.velocity_sensitivity_depth;
   ui_preferences_.steal_oldest_note_when_full =
       current.steal_oldest_note_when_full;
+  ui_preferences_.match_loudness = current.match_loudness;
   ui_preferences_.midi_keyboard_layout = current.midi_keyboard_layout;
   ui_preferences_.custom_typing_layout_keys = current.custom_typing_layout_keys;
   ui_preferences_.custom_typing_octave_down_key =
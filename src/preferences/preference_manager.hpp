@@ -50,6 +50,15 @@ public:
    */
   void request_add_workspace_folder(std::function<void()> on_changed);
 
+  /**
+   * Add a folder already chosen, e.g. one dropped on the window. On desktop
+   * it is scanned in the background first and joins once that is done;
+   * `visible` folders are scanned ahead of the rest of the queue.
+   */
+  void add_workspace_folder_after_scan(const std::filesystem::path &path,
+                                       std::function<void()> on_changed,
+                                       bool visible = false);
+
   /// True when adding a folder copies it rather than referencing it.
   static bool folder_add_is_import();
 
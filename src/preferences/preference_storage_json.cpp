@@ -184,6 +184,9 @@ public:
           data.ui_preferences.steal_oldest_note_when_full =
               ui["steal_oldest_note_when_full"].get<bool>();
         }
+        if (ui.contains("match_loudness")) {
+          data.ui_preferences.match_loudness = ui["match_loudness"].get<bool>();
+        }
         if (ui.contains("multi_operator_edit_absolute")) {
           data.ui_preferences.multi_operator_edit_absolute =
               ui["multi_operator_edit_absolute"].get<bool>();
@@ -273,6 +276,7 @@ public:
           data.ui_preferences.velocity_sensitivity_depth;
       ui["steal_oldest_note_when_full"] =
           data.ui_preferences.steal_oldest_note_when_full;
+      ui["match_loudness"] = data.ui_preferences.match_loudness;
       ui["multi_operator_edit_absolute"] =
           data.ui_preferences.multi_operator_edit_absolute;
       ui["patch_sort_column"] = data.ui_preferences.patch_sort_column;
@@ -28,6 +28,11 @@ struct UIPreferences {
   bool use_pitch_bend = true;
   bool use_mod_wheel = false;
   bool steal_oldest_note_when_full = true;
+  /**
+   * Play every patch at a common loudness, measured by rendering the whole
+   * workspace in the background; see PatchSession::set_loudness_matching.
+   */
+  bool match_loudness = false;
   /**
    * How an edit spreads across selected operators. Relative keeps the
    * distance between them; absolute lands them on the same value. Booleans
@@ -71,6 +76,7 @@ struct UIPreferences {
            lhs.use_velocity == rhs.use_velocity &&
            lhs.velocity_sensitivity_depth == rhs.velocity_sensitivity_depth &&
            lhs.steal_oldest_note_when_full == rhs.steal_oldest_note_when_full &&
+           lhs.match_loudness == rhs.match_loudness &&
            lhs.multi_operator_edit_absolute ==
                rhs.multi_operator_edit_absolute &&
            lhs.use_pitch_bend == rhs.use_pitch_bend &&
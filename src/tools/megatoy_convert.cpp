@@ -0,0 +1,132 @@
+// megatoy_convert: convert patch libraries between formats without the GUI.
+//
+//   megatoy_convert --to dmp --out converted [--jobs N] [--dedup]
+//                   [--overwrite] [--quiet] INPUT...
+//
+// INPUT is a patch file, a directory (walked recursively, layout kept) or a
+// pattern such as "banks/*.tfi". Exit status: 0 when everything converted,
+// 1 when some files failed, 2 on a usage error.
+
+#include "formats/patch_registry.hpp"
+#include "patches/bulk_convert.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+namespace bulk_convert = patches::bulk_convert;
+
+void print_usage(std::ostream &out) {
+  out << "usage: megatoy_convert --to EXT --out DIR [options] INPUT...\n"
+         "\n"
+         "  --to EXT       format to write (";
+  bool first = true;
+  for (const auto &format :
+       formats::PatchRegistry::instance().save_formats()) {
+    out << (first ? "" : ", ") << format.extension.substr(1);
+    first = false;
+  }
+  out << (first ? "" : ", ") << "ginpkg)\n"
+      << "  --out DIR      where to write; directory inputs keep their layout\n"
+         "  --jobs N       worker threads (default: one per core)\n"
+         "  --dedup        write each distinct sound once\n"
+         "  --overwrite    replace files that already exist\n"
+         "  --quiet        report failures only\n"
+         "\n"
+         "INPUT is a file, a directory, or a pattern like \"banks/*.tfi\".\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bulk_convert::Options options;
+  std::vector<std::string> arguments;
+  bool quiet = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view argument = argv[i];
+    const auto value = [&]() -> const char * {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+    if (argument == "--help" || argument == "-h") {
+      print_usage(std::cout);
+      return 0;
+    } else if (argument == "--to") {
+      const char *extension = value();
+      if (extension == nullptr) {
+        print_usage(std::cerr);
+        return 2;
+      }
+      options.target_extension = extension;
+    } else if (argument == "--out") {
+      const char *dir = value();
+      if (dir == nullptr) {
+        print_usage(std::cerr);
+        return 2;
+      }
+      options.output_dir = dir;
+    } else if (argument == "--jobs") {
+      const char *jobs = value();
+      if (jobs == nullptr || std::atoi(jobs) <= 0) {
+        print_usage(std::cerr);
+        return 2;
+      }
+      options.threads = static_cast<std::size_t>(std::atoi(jobs));
+    } else if (argument == "--dedup") {
+      options.deduplicate = true;
+    } else if (argument == "--overwrite") {
+      options.overwrite = true;
+    } else if (argument == "--quiet") {
+      quiet = true;
+    } else if (argument.starts_with("--")) {
+      std::cerr << "megatoy_convert: unknown option " << argument << "\n";
+      print_usage(std::cerr);
+      return 2;
+    } else {
+      arguments.emplace_back(argument);
+    }
+  }
+
+  if (options.target_extension.empty() || options.output_dir.empty() ||
+      arguments.empty()) {
+    print_usage(std::cerr);
+    return 2;
+  }
+  if (!bulk_convert::can_write(options.target_extension)) {
+    std::cerr << "megatoy_convert: cannot write " << options.target_extension
+              << "\n";
+    return 2;
+  }
+
+  std::vector<std::string> errors;
+  const auto inputs = bulk_convert::collect_inputs(arguments, errors);
+  for (const auto &error : errors) {
+    std::cerr << "megatoy_convert: " << error << "\n";
+  }
+
+  const auto summary = bulk_convert::convert(
+      inputs, options, [quiet](const bulk_convert::FileReport &report) {
+        for (const auto &error : report.errors) {
+          std::cerr << report.source.string() << ": " << error << "\n";
+        }
+        if (!quiet && report.errors.empty()) {
+          std::cout << report.source.string() << ": "
+                    << report.written.size() << " written";
+          if (report.duplicates > 0) {
+            std::cout << ", " << report.duplicates << " duplicate"
+                      << (report.duplicates == 1 ? "" : "s");
+          }
+          std::cout << "\n";
+        }
+      });
+
+  std::cout << inputs.size() << " files, " << summary.written
+            << " instruments written, " << summary.duplicates
+            << " duplicates skipped, " << summary.failed_files
+            << " files with errors\n";
+  return summary.failed_files == 0 && errors.empty() ? 0 : 1;
+}
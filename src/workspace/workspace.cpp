@@ -3,6 +3,7 @@
 #include "workspace/path_policy.hpp"
 
 #include <algorithm>
+#include <cctype>
 #include <system_error>
 
 namespace megatoy::workspace {
@@ -14,6 +15,14 @@ constexpr const char *kSidecarDirectory = ".megatoy";
 constexpr const char *kSidecarFile = "patches.json";
 } // namespace
 
+bool is_archive(const fs::path &path) {
+  auto extension = path.extension().string();
+  std::transform(
+      extension.begin(), extension.end(), extension.begin(),
+      [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return extension == ".zip";
+}
+
 fs::path Folder::metadata_path() const {
   return path / kSidecarDirectory / kSidecarFile;
 }
@@ -27,11 +36,19 @@ bool Workspace::probe_writable(const fs::path &path) {
   return (status.permissions() & fs::perms::owner_write) != fs::perms::none;
 }
 
+bool Workspace::probe_available(const Folder &folder) {
+  std::error_code ec;
+  const bool present = folder.archive ? fs::is_regular_file(folder.path, ec)
+                                      : fs::is_directory(folder.path, ec);
+  return present && !ec;
+}
+
 namespace {
 
 Folder make_folder(const fs::path &resolved) {
   Folder folder;
   folder.path = resolved;
+  folder.archive = is_archive(resolved);
   folder.name = resolved.filename().string();
   if (folder.name.empty()) {
     // A root path such as "/" has no filename component.
@@ -44,18 +61,16 @@ Folder make_folder(const fs::path &resolved) {
 
 bool Workspace::add(const fs::path &path) {
   const auto resolved = normalize_path(path);
-
-  std::error_code ec;
-  if (!fs::is_directory(resolved, ec) || ec) {
-    return false;
-  }
   if (contains(resolved)) {
     return false;
   }
 
   Folder folder = make_folder(resolved);
+  if (!probe_available(folder)) {
+    return false;
+  }
   folder.available = true;
-  folder.writable = probe_writable(resolved);
+  folder.writable = !folder.archive && probe_writable(resolved);
 
   folders_.push_back(std::move(folder));
   ++revision_;
@@ -166,9 +181,9 @@ void Workspace::set_paths(const std::vector<fs::path> &paths) {
       continue;
     }
     Folder folder = make_folder(resolved);
-    std::error_code ec;
-    folder.available = fs::is_directory(resolved, ec) && !ec;
-    folder.writable = folder.available && probe_writable(resolved);
+    folder.available = probe_available(folder);
+    folder.writable =
+        folder.available && !folder.archive && probe_writable(resolved);
     folders_.push_back(std::move(folder));
   }
   ++revision_;
@@ -186,9 +201,9 @@ std::vector<fs::path> Workspace::paths() const {
 bool Workspace::refresh() {
   bool changed = false;
   for (auto &folder : folders_) {
-    std::error_code ec;
-    const bool available = fs::is_directory(folder.path, ec) && !ec;
-    const bool writable = available && probe_writable(folder.path);
+    const bool available = probe_available(folder);
+    const bool writable =
+        available && !folder.archive && probe_writable(folder.path);
     if (available != folder.available || writable != folder.writable) {
       folder.available = available;
       folder.writable = writable;
@@ -9,6 +9,9 @@
 
 namespace megatoy::workspace {
 
+/// True for files the workspace mounts as folders: .zip archives.
+bool is_archive(const std::filesystem::path &path);
+
 /// A folder the user has added to the workspace.
 struct Folder {
   std::filesystem::path path;
@@ -18,6 +21,8 @@ struct Folder {
   /// workspace over a temporary absence.
   bool available = false;
   bool writable = false;
+  /// A .zip archive listed like a folder. Archives are never writable.
+  bool archive = false;
 
   /// Where this folder's sidecar metadata lives.
   std::filesystem::path metadata_path() const;
@@ -41,9 +46,9 @@ public:
   bool empty() const { return folders_.empty(); }
 
   /**
-   * Add a folder. Returns false if the path is not a directory or is already
-   * present -- comparison is on the resolved path, so the same folder reached
-   * by different routes is not added twice.
+   * Add a folder, or an archive to browse as one. Returns false if the path
+   * is neither or is already present -- comparison is on the resolved path,
+   * so the same folder reached by different routes is not added twice.
    */
   bool add(const std::filesystem::path &path);
 
@@ -91,6 +96,8 @@ public:
 
 private:
   static bool probe_writable(const std::filesystem::path &path);
+  /// Whether the folder's directory, or its archive, is there.
+  static bool probe_available(const Folder &folder);
 
   std::vector<Folder> folders_;
   std::uint64_t revision_ = 0;
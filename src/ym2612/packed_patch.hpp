@@ -0,0 +1,148 @@
+#pragma once
+#include "ym2612/types.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+namespace ym2612 {
+
+/**
+ * A patch's sound as the registers it writes, in 33 bytes.
+ *
+ * Fields sit in their YM2612 register positions (DT/MUL, TL, KS/AR, AM/DR,
+ * SR, SL/RR and SSG-EG per operator, FB/ALG and L/R/AMS/PMS per channel),
+ * masked to their register widths, so two patches pack to the same bytes
+ * exactly when the chip cannot tell them apart. The name is not part of it.
+ *
+ * That makes it the identity to use for sounds: compare with ==, key maps
+ * with it, or use hash() where a number or string is needed. hash() depends
+ * only on these bytes, so it is the same on every platform and build. The
+ * layout is part of that promise: changing it changes every stored hash.
+ */
+struct PackedPatch {
+  static constexpr std::size_t kOperatorBytes = 7;
+  static constexpr std::size_t kSize = 5 + 4 * kOperatorBytes;
+
+  std::array<std::uint8_t, kSize> bytes{};
+
+  friend constexpr bool operator==(const PackedPatch &lhs,
+                                   const PackedPatch &rhs) {
+    if (std::is_constant_evaluated()) {
+      return lhs.bytes == rhs.bytes;
+    }
+    return std::memcmp(lhs.bytes.data(), rhs.bytes.data(), kSize) == 0;
+  }
+
+  /// 64 bits, mixed eight bytes at a time.
+  constexpr std::uint64_t hash() const {
+    std::uint64_t hash = 0x9e3779b97f4a7c15ULL ^ kSize;
+    for (std::size_t i = 0; i < kSize; i += 8) {
+      std::uint64_t word = 0;
+      for (std::size_t b = 0; b < 8 && i + b < kSize; ++b) {
+        word |= std::uint64_t{bytes[i + b]} << (8 * b);
+      }
+      hash = std::rotl(hash ^ mix(word), 27) * 0x9e3779b97f4a7c15ULL;
+    }
+    return mix(hash);
+  }
+
+  /// hash() as 16 lowercase hex digits.
+  std::string hex() const {
+    constexpr char kDigits[] = "0123456789abcdef";
+    std::string text(16, '0');
+    auto value = hash();
+    for (std::size_t i = text.size(); i-- > 0; value >>= 4) {
+      text[i] = kDigits[value & 0xF];
+    }
+    return text;
+  }
+
+private:
+  /// MurmurHash3's finalizer.
+  static constexpr std::uint64_t mix(std::uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+  }
+};
+
+constexpr PackedPatch pack(const GlobalSettings &global,
+                           const ChannelSettings &channel,
+                           const ChannelInstrument &instrument) {
+  const auto bits = [](auto value, unsigned width, unsigned shift) {
+    return static_cast<std::uint8_t>(
+        (static_cast<unsigned>(value) & ((1u << width) - 1)) << shift);
+  };
+  PackedPatch packed;
+  auto &b = packed.bytes;
+  b[0] = bits(global.lfo_enable, 1, 3) | bits(global.lfo_frequency, 3, 0);
+  b[1] = bits(global.dac_enable, 1, 7);
+  b[2] = bits(instrument.feedback, 3, 3) | bits(instrument.algorithm, 3, 0);
+  b[3] = bits(channel.left_speaker, 1, 7) | bits(channel.right_speaker, 1, 6) |
+         bits(channel.amplitude_modulation_sensitivity, 2, 4) |
+         bits(channel.frequency_modulation_sensitivity, 3, 0);
+  for (std::size_t i = 0; i < 4; ++i) {
+    const auto &op = instrument.operators[i];
+    b[4] |= bits(op.enable, 1, static_cast<unsigned>(i));
+    auto *o = &b[5 + i * PackedPatch::kOperatorBytes];
+    o[0] = bits(op.detune, 3, 4) | bits(op.multiple, 4, 0);
+    o[1] = bits(op.total_level, 7, 0);
+    o[2] = bits(op.key_scale, 2, 6) | bits(op.attack_rate, 5, 0);
+    o[3] = bits(op.amplitude_modulation_enable, 1, 7) |
+           bits(op.decay_rate, 5, 0);
+    o[4] = bits(op.sustain_rate, 5, 0);
+    o[5] = bits(op.sustain_level, 4, 4) | bits(op.release_rate, 4, 0);
+    o[6] = bits(op.ssg_enable, 1, 3) | bits(op.ssg_type_envelope_control, 3, 0);
+  }
+  return packed;
+}
+
+constexpr void unpack(const PackedPatch &packed, GlobalSettings &global,
+                      ChannelSettings &channel, ChannelInstrument &instrument) {
+  const auto field = [](std::uint8_t byte, unsigned width, unsigned shift) {
+    return static_cast<std::uint8_t>((byte >> shift) & ((1u << width) - 1));
+  };
+  const auto &b = packed.bytes;
+  global.lfo_enable = field(b[0], 1, 3) != 0;
+  global.lfo_frequency = field(b[0], 3, 0);
+  global.dac_enable = field(b[1], 1, 7) != 0;
+  instrument.feedback = field(b[2], 3, 3);
+  instrument.algorithm = field(b[2], 3, 0);
+  channel.left_speaker = field(b[3], 1, 7) != 0;
+  channel.right_speaker = field(b[3], 1, 6) != 0;
+  channel.amplitude_modulation_sensitivity = field(b[3], 2, 4);
+  channel.frequency_modulation_sensitivity = field(b[3], 3, 0);
+  for (std::size_t i = 0; i < 4; ++i) {
+    auto &op = instrument.operators[i];
+    op.enable = field(b[4], 1, static_cast<unsigned>(i)) != 0;
+    const auto *o = &b[5 + i * PackedPatch::kOperatorBytes];
+    op.detune = field(o[0], 3, 4);
+    op.multiple = field(o[0], 4, 0);
+    op.total_level = field(o[1], 7, 0);
+    op.key_scale = field(o[2], 2, 6);
+    op.attack_rate = field(o[2], 5, 0);
+    op.amplitude_modulation_enable = field(o[3], 1, 7) != 0;
+    op.decay_rate = field(o[3], 5, 0);
+    op.sustain_rate = field(o[4], 5, 0);
+    op.sustain_level = field(o[5], 4, 4);
+    op.release_rate = field(o[5], 4, 0);
+    op.ssg_enable = field(o[6], 1, 3) != 0;
+    op.ssg_type_envelope_control = field(o[6], 3, 0);
+  }
+}
+
+} // namespace ym2612
+
+template <> struct std::hash<ym2612::PackedPatch> {
+  std::size_t operator()(const ym2612::PackedPatch &packed) const noexcept {
+    return static_cast<std::size_t>(packed.hash());
+  }
+};
@@ -1,10 +1,10 @@
 #pragma once
+#include "ym2612/packed_patch.hpp"
 #include "ym2612/types.hpp"
 #include <algorithm>
 #include <functional>
 #include <iterator>
 #include <nlohmann/json.hpp>
-#include <sstream>
 #include <string>
 
 namespace ym2612 {
@@ -16,7 +16,11 @@ struct Patch {
   ChannelSettings channel;
   ChannelInstrument instrument;
 
-  std::string hash() const;
+  /// The sound without the name; see PackedPatch.
+  PackedPatch packed() const { return pack(global, channel, instrument); }
+  /// packed().hex(): equal for patches that sound the same, whatever their
+  /// names, and stable across runs and platforms.
+  std::string hash() const { return packed().hex(); }
 };
 
 inline bool operator==(const GlobalSettings &lhs, const GlobalSettings &rhs) {
@@ -180,18 +184,4 @@ inline void from_json(const nlohmann::json &j, Patch &patch) {
   j.at("instrument").get_to(patch.instrument);
 }
 
-inline std::string Patch::hash() const {
-  nlohmann::json patch_data;
-  patch_data["global"] = global;
-  patch_data["channel"] = channel;
-  patch_data["instrument"] = instrument;
-
-  std::string patch_str = patch_data.dump();
-
-  std::hash<std::string> hasher;
-  std::ostringstream ss;
-  ss << std::hex << hasher(patch_str);
-  return ss.str();
-}
-
 } // namespace ym2612
@@ -80,6 +80,11 @@ struct OperatorSettings {
   bool enable = true; // global register
 };
 
+/// DT1 stores -3..3 as sign and magnitude: 0..3 up, 4..7 down.
+inline int signed_detune(uint8_t detune) {
+  return detune & 4 ? -(detune & 3) : detune & 3;
+}
+
 struct ChannelSettings {
   bool left_speaker = true;
   bool right_speaker = true;
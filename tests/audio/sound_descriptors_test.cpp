@@ -0,0 +1,168 @@
+// Checks the numbers the patch table sorts by against signals whose answer
+// is known: BS.1770's own calibration tone for loudness, and synthetic
+// envelopes and spectra for the rest.
+
+#include "audio/sound_descriptors.hpp"
+
+#include "../test_check.hpp"
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr std::uint32_t kSampleRate = 44100;
+constexpr double kPi = 3.14159265358979323846;
+
+/// Interleaved stereo of `level(t)` times a sine, on the chosen channels.
+template <typename Level>
+std::vector<float> make_tone(float hz, double seconds, Level level,
+                             bool left = true, bool right = true) {
+  const auto frames = static_cast<std::size_t>(seconds * kSampleRate);
+  std::vector<float> stereo(frames * 2, 0.0f);
+  for (std::size_t i = 0; i < frames; ++i) {
+    const double t = static_cast<double>(i) / kSampleRate;
+    const auto sample =
+        static_cast<float>(level(t) * std::sin(2.0 * kPi * hz * t));
+    stereo[i * 2] = left ? sample : 0.0f;
+    stereo[i * 2 + 1] = right ? sample : 0.0f;
+  }
+  return stereo;
+}
+
+double full_scale(double) { return 1.0; }
+
+audio::NoteRender held_for(const std::vector<float> &stereo, float hz) {
+  return {kSampleRate, stereo.size() / 2, hz};
+}
+
+// The standard's reference: a full-scale 997 Hz sine reads -3.01 LUFS on
+// one channel and 0 LUFS on both. Half amplitude is 6 dB quieter.
+void test_loudness_calibration() {
+  const auto both = make_tone(997.0f, 3.0, full_scale);
+  CHECK(std::abs(audio::integrated_loudness(both, kSampleRate)) < 0.2f);
+
+  const auto left = make_tone(997.0f, 3.0, full_scale, true, false);
+  CHECK(std::abs(audio::integrated_loudness(left, kSampleRate) + 3.01f) <
+        0.2f);
+
+  const auto half = make_tone(997.0f, 3.0, [](double) { return 0.5; });
+  CHECK(std::abs(audio::integrated_loudness(half, kSampleRate) + 6.02f) <
+        0.2f);
+
+  // Shorter than a block still measures.
+  const auto short_tone = make_tone(997.0f, 0.1, full_scale);
+  CHECK(std::abs(audio::integrated_loudness(short_tone, kSampleRate)) < 0.5f);
+}
+
+// A long quiet tail does not pull the reading down: that is what the
+// relative gate is for. Ungated, this would read about -6 LUFS; only the
+// blocks straddling the cut cost a little.
+void test_loudness_gates_the_tail() {
+  auto stereo = make_tone(997.0f, 2.0, full_scale);
+  const auto tail = make_tone(997.0f, 6.0, [](double) { return 0.001; });
+  stereo.insert(stereo.end(), tail.begin(), tail.end());
+  CHECK(std::abs(audio::integrated_loudness(stereo, kSampleRate)) < 0.5f);
+}
+
+void test_silence() {
+  const std::vector<float> silence(kSampleRate * 2, 0.0f);
+  const auto descriptors =
+      audio::measure_sound(silence, held_for(silence, 440.0f));
+  CHECK(descriptors.peak_db == audio::SoundDescriptors::kSilenceDb);
+  CHECK(descriptors.loudness_lufs == audio::SoundDescriptors::kSilenceDb);
+  CHECK(descriptors.centroid_hz == 0.0f);
+
+  // A DC offset, like the chip's idle DAC, is silence too.
+  const std::vector<float> offset(kSampleRate * 2, 0.01f);
+  CHECK(audio::measure_sound(offset, held_for(offset, 440.0f)).peak_db ==
+        audio::SoundDescriptors::kSilenceDb);
+}
+
+// A 100 ms linear ramp reaches 90% at 90 ms; an exponential decay with a
+// 100 ms time constant falls 20 dB in 100 ms * ln(10).
+void test_envelope_times() {
+  const auto ramp = make_tone(440.0f, 1.0, [](double t) {
+    return std::min(1.0, t / 0.1);
+  });
+  const auto attack = audio::measure_sound(ramp, held_for(ramp, 440.0f));
+  CHECK(std::abs(attack.attack_ms - 90.0f) <= 10.0f);
+  CHECK(std::abs(attack.peak_db) < 0.1f);
+  CHECK(std::abs(attack.rms_db + 3.0f) < 0.5f);
+
+  const auto decaying =
+      make_tone(440.0f, 1.0, [](double t) { return std::exp(-t / 0.1); });
+  const auto decay = audio::measure_sound(decaying, held_for(decaying, 440.0f));
+  CHECK(decay.attack_ms <= 5.0f);
+  CHECK(std::abs(decay.decay_ms - 230.0f) <= 10.0f);
+
+  // A sound that never falls that far decays for the whole render.
+  const auto steady = make_tone(440.0f, 1.0, full_scale);
+  CHECK(audio::measure_sound(steady, held_for(steady, 440.0f)).decay_ms >=
+        990.0f);
+}
+
+void test_spectrum() {
+  const auto sine = make_tone(1000.0f, 1.0, full_scale);
+  const auto pure = audio::measure_sound(sine, held_for(sine, 1000.0f));
+  CHECK(std::abs(pure.centroid_hz - 1000.0f) < 30.0f);
+  CHECK(pure.harmonicity > 0.95f);
+
+  // The same tone is no harmonic of a pitch it does not belong to.
+  CHECK(audio::measure_sound(sine, held_for(sine, 440.0f)).harmonicity <
+        0.1f);
+
+  // Adding overtones moves the centroid up.
+  const auto frames = sine.size() / 2;
+  std::vector<float> rich(sine.size());
+  for (std::size_t i = 0; i < frames; ++i) {
+    const double t = static_cast<double>(i) / kSampleRate;
+    double sample = 0.0;
+    for (int k = 1; k <= 8; ++k) {
+      sample += std::sin(2.0 * kPi * 1000.0 * k * t) / k;
+    }
+    rich[i * 2] = rich[i * 2 + 1] = static_cast<float>(sample * 0.3);
+  }
+  const auto bright = audio::measure_sound(rich, held_for(rich, 1000.0f));
+  CHECK(bright.centroid_hz > 1500.0f);
+  CHECK(bright.harmonicity > 0.95f);
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+  std::vector<float> noise(sine.size());
+  for (auto &sample : noise) {
+    sample = uniform(rng);
+  }
+  const auto hiss = audio::measure_sound(noise, held_for(noise, 440.0f));
+  CHECK(hiss.harmonicity < 0.35f);
+  CHECK(hiss.centroid_hz > 8000.0f);
+}
+
+// Every patch lands on one level, within limits: boost is capped, and
+// silence is left alone.
+void test_loudness_matching_gain() {
+  const float matched = audio::loudness_matching_gain(-20.0f);
+  CHECK(std::abs(matched - 1.0f) < 0.001f);
+  CHECK(std::abs(audio::loudness_matching_gain(-14.0f) - 0.5012f) < 0.001f);
+  CHECK(std::abs(audio::loudness_matching_gain(-26.0f) - 1.9953f) < 0.001f);
+  CHECK(audio::loudness_matching_gain(-60.0f) ==
+        audio::loudness_matching_gain(-40.0f));
+  CHECK(audio::loudness_matching_gain(20.0f) > 0.0f);
+  CHECK(audio::loudness_matching_gain(
+            audio::SoundDescriptors::kSilenceDb) == 1.0f);
+}
+
+} // namespace
+
+int main() {
+  test_loudness_calibration();
+  test_loudness_gates_the_tail();
+  test_silence();
+  test_envelope_times();
+  test_spectrum();
+  test_loudness_matching_gain();
+  std::cout << "sound_descriptors_test passed\n";
+  return 0;
+}
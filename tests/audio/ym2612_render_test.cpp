@@ -305,6 +305,40 @@ void test_switching_chip_type_releases_notes_and_keeps_audio_working() {
   CHECK(std::abs(idle[idle.size() - 1]) < 0.000001f);
 }
 
+// Loudness matching: the gain a patch arrives with scales what is heard, and
+// survives the chip-type switch that re-applies the patch.
+void test_patch_gain_scales_output() {
+  AudioEngine engine;
+  CHECK(engine.initialize(kSampleRate));
+
+  const auto patch = make_all_carrier_patch(40);
+  submit_patch(engine, patch);
+  CHECK(engine.submit(
+      audio::AudioCommand::note_on(ym2612::Note::from_midi_note(60), 127)));
+  render_ac_peak(engine, kSampleRate / 10);
+  const float unity = render_ac_peak(engine, kSampleRate / 10);
+
+  CHECK(engine.submit(audio::AudioCommand::apply_patch(
+      patch.global, patch.channel, patch.instrument, 0.25f)));
+  render_ac_peak(engine, kSampleRate / 10);
+  const float quarter = render_ac_peak(engine, kSampleRate / 10);
+
+  CHECK(unity > 0.01f);
+  CHECK(quarter > unity * 0.2f);
+  CHECK(quarter < unity * 0.3f);
+
+  CHECK(engine.submit(
+      audio::AudioCommand::set_chip_type(ym2612::ChipType::Ym3438)));
+  CHECK(engine.submit(
+      audio::AudioCommand::note_on(ym2612::Note::from_midi_note(60), 127)));
+  render_ac_peak(engine, kSampleRate / 10);
+  CHECK(render_ac_peak(engine, kSampleRate / 10) < unity * 0.3f);
+
+  CHECK(engine.submit(audio::AudioCommand::set_gain(1.0f)));
+  render_ac_peak(engine, kSampleRate / 10);
+  CHECK(render_ac_peak(engine, kSampleRate / 10) > unity * 0.8f);
+}
+
 } // namespace
 
 int main() {
@@ -316,6 +350,7 @@ int main() {
   test_apply_patch_updates_instrument_for_future_notes();
   test_apply_patch_preserves_sustaining_note_velocity();
   test_switching_chip_type_releases_notes_and_keeps_audio_working();
+  test_patch_gain_scales_output();
 
   AudioEngine engine;
   CHECK(engine.initialize(kSampleRate));
@@ -5,6 +5,7 @@
 #include <string>
 
 int main() {
+  using megatoy::utf8::fold_case;
   using megatoy::utf8::trim_incomplete_suffix;
   using megatoy::utf8::truncate;
 
@@ -26,6 +27,14 @@ int main() {
   corrupted.push_back(static_cast<char>(0xe5));
   CHECK(trim_incomplete_suffix(corrupted) == "有効");
 
+  CHECK(fold_case("Bright LEAD 01") == "bright lead 01");
+  CHECK(fold_case("ÉCLAIR Ÿ") == "éclair ÿ");
+  CHECK(fold_case("×") == "×");
+  CHECK(fold_case("ŁÓDŹ") == "łódź");
+  CHECK(fold_case("ΣΥΝΘ Бас") == "συνθ бас");
+  CHECK(fold_case("ＦＭ音源") == "ｆｍ音源");
+  CHECK(fold_case(corrupted) == corrupted);
+
   std::cout << "All UTF-8 utility tests passed\n";
   return 0;
 }
@@ -1,16 +1,28 @@
 // The version history inside a .ginpkg: saving over a package archives the
 // previous current patch, versions can be read back and deleted. This is the
 // mechanism behind Save Version and the package entries in the patch tree.
+// Saves append keyframes and deltas to the package rather than rewriting
+// it, and packages from before that layout still load and migrate.
 
 #include "formats/ginpkg.hpp"
 #include "ym2612/patch.hpp"
 
 #include "../test_check.hpp"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <miniz.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
 
 namespace {
 
+namespace fs = std::filesystem;
+
 ym2612::Patch make_patch(const char *name, uint8_t algorithm) {
   ym2612::Patch patch;
   patch.name = name;
@@ -18,6 +30,221 @@ ym2612::Patch make_patch(const char *name, uint8_t algorithm) {
   return patch;
 }
 
+/// One parameter moves per step, as when tweaking a sound between saves.
+ym2612::Patch step_patch(int step) {
+  auto patch = make_patch("tweak", 4);
+  patch.instrument.operators[step % 4].total_level =
+      static_cast<uint8_t>(step);
+  return patch;
+}
+
+std::string read_bytes(const fs::path &path) {
+  std::ifstream input(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(input),
+                     std::istreambuf_iterator<char>());
+}
+
+/// A package as written before keyframes: current.gin first, then each
+/// version whole at the top level, and a history.json with no format.
+void write_legacy_package(const fs::path &path) {
+  mz_zip_archive archive;
+  std::memset(&archive, 0, sizeof(archive));
+  CHECK(mz_zip_writer_init_file(&archive, path.string().c_str(), 0));
+  const auto add = [&](const std::string &name, const std::string &data) {
+    CHECK(mz_zip_writer_add_mem(&archive, name.c_str(), data.data(),
+                                data.size(), MZ_NO_COMPRESSION));
+  };
+  add("current.gin", nlohmann::json(make_patch("now", 7)).dump(2));
+  nlohmann::json history = {
+      {"versions",
+       {{{"uuid", "aaaa"}, {"timestamp", "2024-01-01T00:00:00Z"}},
+        {{"uuid", "bbbb"},
+         {"timestamp", "2024-01-02T00:00:00Z"},
+         {"comment", "brighter"}}}},
+      {"current", {{"timestamp", "2024-01-03T00:00:00Z"}}}};
+  add("history.json", history.dump(2));
+  add("aaaa.gin", nlohmann::json(make_patch("older", 5)).dump(2));
+  add("bbbb.gin", nlohmann::json(make_patch("old", 6)).dump(2));
+  CHECK(mz_zip_writer_finalize_archive(&archive));
+  CHECK(mz_zip_writer_end(&archive));
+}
+
+void test_saves_append(const fs::path &dir) {
+  const auto path = dir / "long.ginpkg";
+  CHECK(formats::ginpkg::save_patch(dir, step_patch(0), "long"));
+  constexpr int kSaves = 80;
+  for (int step = 1; step <= kSaves; ++step) {
+    const auto before = read_bytes(path);
+    CHECK(formats::ginpkg::save_patch(dir, step_patch(step), "long"));
+    const auto after = read_bytes(path);
+
+    // Everything up to the old current.gin entry is untouched.
+    const auto tail = before.find("current.gin");
+    CHECK(tail != std::string::npos);
+    const auto unchanged = static_cast<std::size_t>(
+        std::mismatch(before.begin(), before.end(), after.begin(),
+                      after.end())
+            .first -
+        before.begin());
+    CHECK(unchanged >= tail - 30);
+  }
+
+  auto package = formats::ginpkg::load_package(path);
+  CHECK(package.has_value());
+  CHECK(!package->legacy_layout());
+  CHECK(package->history().size() == kSaves);
+  for (int step = 0; step < kSaves; ++step) {
+    const auto version =
+        formats::ginpkg::read_version(*package, package->history()[step].uuid);
+    CHECK(version.has_value());
+    CHECK(*version == step_patch(step));
+  }
+  CHECK(*formats::ginpkg::read_current(*package) == step_patch(kSaves));
+
+  // Deltas keep the package well under one whole snapshot per version.
+  const auto snapshot_size = nlohmann::json(step_patch(0)).dump(2).size();
+  CHECK(fs::file_size(path) < kSaves * snapshot_size / 2);
+
+  // Deleting a keyframe rewrites the package; its deltas survive it.
+  const auto keyframe = package->history()[0].uuid;
+  CHECK(formats::ginpkg::delete_version(path, keyframe));
+  package = formats::ginpkg::load_package(path);
+  CHECK(package->history().size() == kSaves - 1);
+  for (int step = 1; step < kSaves; ++step) {
+    CHECK(*formats::ginpkg::read_version(
+              *package, package->history()[step - 1].uuid) ==
+          step_patch(step));
+  }
+}
+
+void test_index_only_load(const fs::path &dir) {
+  const auto path = dir / "long.ginpkg";
+  formats::ginpkg::GinPackage package;
+  CHECK(package.Load(path, formats::ginpkg::LoadScope::Index));
+  CHECK(package.history().size() == 79);
+  CHECK(!package.snapshot(package.history()[0].uuid).has_value());
+  CHECK(formats::ginpkg::read_current(package).has_value());
+
+  // An index-only package still saves: the keyframe is read on demand.
+  package.AddVersion(package.current_data());
+  package.SetCurrentData(nlohmann::json(step_patch(500)).dump(2));
+  CHECK(package.Save(path));
+  const auto reloaded = formats::ginpkg::load_package(path);
+  CHECK(reloaded->history().size() == 80);
+  CHECK(*formats::ginpkg::read_version(*reloaded,
+                                       reloaded->history().back().uuid) ==
+        step_patch(80));
+}
+
+void test_legacy_packages(const fs::path &dir) {
+  const auto path = dir / "legacy.ginpkg";
+  write_legacy_package(path);
+  {
+    auto package = formats::ginpkg::load_package(path);
+    CHECK(package.has_value());
+    CHECK(package->legacy_layout());
+    CHECK(package->history().size() == 2);
+    CHECK(package->history()[1].comment == "brighter");
+    CHECK(formats::ginpkg::read_version(*package, "aaaa")->name == "older");
+  }
+
+  // The next save rewrites it in the new layout, history intact.
+  CHECK(formats::ginpkg::save_patch(dir, make_patch("newer", 1), "legacy"));
+  {
+    auto package = formats::ginpkg::load_package(path);
+    CHECK(!package->legacy_layout());
+    CHECK(package->history().size() == 3);
+    CHECK(package->history()[0].uuid == "aaaa");
+    CHECK(formats::ginpkg::read_version(*package, "aaaa")->name == "older");
+    CHECK(formats::ginpkg::read_version(*package, "bbbb")->name == "old");
+    CHECK(formats::ginpkg::read_version(*package,
+                                        package->history()[2].uuid)
+              ->name == "now");
+  }
+
+  // Or migrate_package() does, without saving anything new.
+  const auto other = dir / "other.ginpkg";
+  write_legacy_package(other);
+  CHECK(formats::ginpkg::migrate_package(other));
+  auto package = formats::ginpkg::load_package(other);
+  CHECK(!package->legacy_layout());
+  CHECK(package->history().size() == 2);
+  CHECK(formats::ginpkg::read_version(*package, "bbbb")->name == "old");
+  CHECK(formats::ginpkg::read_current(*package)->name == "now");
+  CHECK(formats::ginpkg::migrate_package(other));
+}
+
+void test_index_names_and_hashes(const fs::path &dir) {
+  // New versions carry their name and hash in the index.
+  const auto path = dir / "named.ginpkg";
+  CHECK(formats::ginpkg::save_patch(dir, make_patch("pluck", 1), "named"));
+  CHECK(formats::ginpkg::save_patch(dir, make_patch("pluck 2", 2), "named"));
+  {
+    formats::ginpkg::GinPackage package;
+    CHECK(package.Load(path, formats::ginpkg::LoadScope::Index));
+    CHECK(package.history().size() == 1);
+    const auto &entry = package.history()[0];
+    CHECK(entry.name == "pluck");
+    CHECK(entry.hash ==
+          formats::ginpkg::content_hash(
+              nlohmann::json(make_patch("pluck", 1)).dump()));
+  }
+  // The hash ignores formatting, and tells sounds apart.
+  const auto json = nlohmann::json(make_patch("pluck", 1));
+  CHECK(formats::ginpkg::content_hash(json.dump()) ==
+        formats::ginpkg::content_hash(json.dump(4)));
+  CHECK(formats::ginpkg::content_hash(json.dump()) !=
+        formats::ginpkg::content_hash(
+            nlohmann::json(make_patch("pluck", 2)).dump()));
+
+  // An index without them is filled in by the next save, appending or not.
+  const auto legacy = dir / "unnamed.ginpkg";
+  write_legacy_package(legacy);
+  CHECK(!formats::ginpkg::load_package(legacy)->history()[0].name);
+  CHECK(formats::ginpkg::save_patch(dir, make_patch("latest", 3), "unnamed"));
+  CHECK(formats::ginpkg::save_patch(dir, make_patch("later", 4), "unnamed"));
+  formats::ginpkg::GinPackage package;
+  CHECK(package.Load(legacy, formats::ginpkg::LoadScope::Index));
+  std::vector<std::string> names;
+  for (const auto &entry : package.history()) {
+    CHECK(entry.hash.has_value());
+    names.push_back(entry.name.value_or("?"));
+  }
+  CHECK((names == std::vector<std::string>{"older", "old", "now", "latest"}));
+
+  // Likewise a keyframed package from before the index had names: the
+  // save appends, reading the old version once to describe it.
+  const auto keyframed = dir / "keyframed.ginpkg";
+  {
+    mz_zip_archive archive;
+    std::memset(&archive, 0, sizeof(archive));
+    CHECK(mz_zip_writer_init_file(&archive, keyframed.string().c_str(), 0));
+    const auto add = [&](const std::string &name, const std::string &data) {
+      CHECK(mz_zip_writer_add_mem(&archive, name.c_str(), data.data(),
+                                  data.size(), MZ_NO_COMPRESSION));
+    };
+    add("versions/cccc.gin", nlohmann::json(make_patch("first", 1)).dump(2));
+    add("current.gin", nlohmann::json(make_patch("second", 2)).dump(2));
+    nlohmann::json history = {
+        {"format", 2},
+        {"versions",
+         {{{"uuid", "cccc"},
+           {"timestamp", "2024-02-01T00:00:00Z"},
+           {"entry", "versions/cccc.gin"}}}}};
+    add("history.json", history.dump());
+    CHECK(mz_zip_writer_finalize_archive(&archive));
+    CHECK(mz_zip_writer_end(&archive));
+  }
+  const auto before = read_bytes(keyframed);
+  CHECK(formats::ginpkg::save_patch(dir, make_patch("third", 3), "keyframed"));
+  CHECK(read_bytes(keyframed).starts_with(
+      before.substr(0, before.find("current.gin") - 30)));
+  CHECK(package.Load(keyframed, formats::ginpkg::LoadScope::Index));
+  CHECK(package.history().size() == 2);
+  CHECK(package.history()[0].name == "first");
+  CHECK(package.history()[1].name == "second");
+}
+
 } // namespace
 
 int main() {
@@ -78,6 +305,11 @@ int main() {
     CHECK(!formats::ginpkg::read_version(*path, first_uuid).has_value());
   }
 
+  test_saves_append(dir);
+  test_index_only_load(dir);
+  test_legacy_packages(dir);
+  test_index_names_and_hashes(dir);
+
   std::filesystem::remove_all(dir);
   std::cout << "All ginpkg history tests passed\n";
   return 0;
@@ -0,0 +1,62 @@
+// The deltas .ginpkg versions are stored as: applying one to its base must
+// give back exactly the patch it was taken from.
+
+#include "formats/json_delta.hpp"
+#include "ym2612/patch.hpp"
+
+#include "../test_check.hpp"
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+using nlohmann::json;
+namespace json_delta = formats::json_delta;
+
+void check_round_trip(const json &base, const json &target) {
+  const auto delta = json_delta::diff(base, target);
+  CHECK(delta.has_value());
+  CHECK(json_delta::apply(base, *delta) == target);
+}
+
+} // namespace
+
+int main() {
+  ym2612::Patch patch;
+  patch.name = "lead";
+  patch.instrument.algorithm = 4;
+  const json base = patch;
+
+  // No change is an empty delta.
+  CHECK(json_delta::diff(base, base) == json::object());
+
+  // One operator parameter: only that path is stored.
+  patch.instrument.operators[2].attack_rate = 12;
+  json target = patch;
+  const auto delta = json_delta::diff(base, target);
+  CHECK(delta.has_value());
+  const auto expected =
+      R"({"instrument":{"operators":{"2":{"attack_rate":12}}}})";
+  CHECK(*delta == json::parse(expected));
+  CHECK(json_delta::apply(base, *delta) == target);
+
+  // Several scattered changes, a rename included.
+  patch.name = "lead 2";
+  patch.channel.left_speaker = !patch.channel.left_speaker;
+  patch.instrument.operators[0].multiple = 3;
+  check_round_trip(base, patch);
+
+  // Added and removed keys, arrays that change length, type changes.
+  check_round_trip(json{{"a", 1}, {"b", 2}}, json{{"a", 1}, {"c", 3}});
+  check_round_trip(json{{"list", {1, 2, 3}}}, json{{"list", {1, 2}}});
+  check_round_trip(json{{"value", 1}}, json{{"value", {{"nested", true}}}});
+  check_round_trip(json{{"value", {{"nested", true}}}}, json{{"value", 1}});
+
+  // What a delta cannot say.
+  CHECK(!json_delta::diff(json{{"a", 1}}, json{{"a", nullptr}}).has_value());
+  CHECK(!json_delta::diff(json{{"a", {1, 2}}}, json{{"a", {{"0", 1}}}})
+             .has_value());
+
+  std::cout << "json_delta_test passed\n";
+  return 0;
+}
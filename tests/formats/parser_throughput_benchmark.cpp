@@ -0,0 +1,236 @@
+// Parser throughput, old input path against FileView.
+//
+//   parser_throughput_benchmark [corpus-dir] [rounds]
+//
+// Without a directory it writes a corpus of its own: every format the
+// library can write, plus .ginpkg packages with and without a long history
+// (the latter large enough to be mapped). Each file is then read and parsed
+// `rounds` times both ways -- through std::istreambuf_iterator into a vector,
+// as the parsers used to, and through FileView -- and the two must agree.
+// Reports per-extension throughput for reading alone and for reading plus
+// parsing. A mapped view's read time is the mapping alone -- its pages are
+// paid for during the parse -- so the read + parse columns are the ones to
+// compare. Not run by ctest: the numbers only mean something on a quiet
+// machine, and they are for a warm page cache.
+
+#include "formats/ginpkg.hpp"
+#include "formats/patch_loader.hpp"
+#include "formats/ym2612_format_adapter.hpp"
+#include "platform/file_view.hpp"
+#include "ym2612/patch.hpp"
+
+#include "../test_check.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+ym2612::Patch make_patch(int seed) {
+  ym2612::Patch patch;
+  patch.name = "bench" + std::to_string(seed);
+  patch.instrument.algorithm = static_cast<std::uint8_t>(seed % 8);
+  patch.instrument.feedback = static_cast<std::uint8_t>(seed % 7);
+  for (int op = 0; op < 4; ++op) {
+    auto &target = patch.instrument.operators[op];
+    target.attack_rate = static_cast<std::uint8_t>((seed + op) % 32);
+    target.total_level = static_cast<std::uint8_t>((seed * 3 + op) % 128);
+    target.multiple = static_cast<std::uint8_t>((seed + op) % 16);
+  }
+  return patch;
+}
+
+void write_corpus(const fs::path &dir, int copies) {
+  fs::create_directories(dir);
+  for (const auto &info : formats::adapter::known_formats()) {
+    if (!info.can_write || info.format == ym2612_format::Format::Ginpkg) {
+      continue;
+    }
+    const auto extension = formats::adapter::extension_for(info.format);
+    for (int i = 0; i < copies; ++i) {
+      formats::adapter::write_file(
+          info.format, make_patch(i),
+          dir / ("patch" + std::to_string(i) + extension));
+    }
+  }
+  for (int i = 0; i < copies; ++i) {
+    formats::ginpkg::save_patch(dir, make_patch(i),
+                                "package" + std::to_string(i));
+  }
+  // A patch saved a few hundred times: the package that gets mapped.
+  for (int i = 0; i < 4; ++i) {
+    formats::ginpkg::GinPackage package;
+    for (int version = 0; version < 400; ++version) {
+      nlohmann::json snapshot = make_patch(version);
+      package.AddVersion(snapshot.dump(2));
+    }
+    nlohmann::json current = make_patch(i);
+    package.SetCurrentData(current.dump(2));
+    CHECK(package.Save(dir / ("history" + std::to_string(i) + ".ginpkg")));
+  }
+}
+
+std::vector<std::uint8_t> stream_read(const fs::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file),
+                                   std::istreambuf_iterator<char>());
+}
+
+struct Totals {
+  std::size_t files = 0;
+  std::size_t mapped = 0;
+  std::uintmax_t bytes = 0;
+  double stream_read = 0.0;
+  double view_read = 0.0;
+  double stream_parse = 0.0;
+  double view_parse = 0.0;
+
+  void add(const Totals &other) {
+    files += other.files;
+    mapped += other.mapped;
+    bytes += other.bytes;
+    stream_read += other.stream_read;
+    view_read += other.view_read;
+    stream_parse += other.stream_parse;
+    view_parse += other.view_parse;
+  }
+};
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string lowercase_extension(const fs::path &path) {
+  auto extension = path.extension().string();
+  std::transform(
+      extension.begin(), extension.end(), extension.begin(),
+      [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return extension;
+}
+
+/// One row: MB/s both ways and the speedup, for reading and for parsing.
+void report(const std::string &label, const Totals &totals, int rounds) {
+  const double megabytes =
+      static_cast<double>(totals.bytes) * rounds / (1024.0 * 1024.0);
+  const auto rate = [&](double seconds) {
+    return megabytes / std::max(seconds, 1e-9);
+  };
+  std::printf("%-9s %5zu %6zu | %8.1f %8.1f %6.2fx | %8.1f %8.1f %6.2fx\n",
+              label.c_str(), totals.files, totals.mapped,
+              rate(totals.stream_read), rate(totals.view_read),
+              totals.stream_read / std::max(totals.view_read, 1e-9),
+              rate(totals.stream_parse), rate(totals.view_parse),
+              totals.stream_parse / std::max(totals.view_parse, 1e-9));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int rounds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+  fs::path corpus;
+  bool own_corpus = false;
+  if (argc > 1) {
+    corpus = argv[1];
+  } else {
+    corpus = fs::temp_directory_path() / "megatoy_parser_throughput";
+    std::error_code error;
+    fs::remove_all(corpus, error);
+    write_corpus(corpus, 64);
+    own_corpus = true;
+  }
+
+  std::vector<fs::path> files;
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(corpus, error), end;
+       it != end && !error; it.increment(error)) {
+    if (it->is_regular_file(error)) {
+      files.push_back(it->path());
+    }
+  }
+  std::sort(files.begin(), files.end());
+
+  std::map<std::string, Totals> by_extension;
+  for (const auto &path : files) {
+    const auto extension = lowercase_extension(path);
+    auto &totals = by_extension[extension];
+
+    // Both paths must parse to the same patches before either is timed.
+    const auto bytes = stream_read(path);
+    const auto view = platform::FileView::open(path);
+    CHECK(view.has_value());
+    CHECK(std::equal(bytes.begin(), bytes.end(), view->data(),
+                     view->data() + view->size()));
+    const auto expected =
+        formats::load_patch_from_memory(path, bytes.data(), bytes.size());
+    if (expected.status == formats::PatchLoadStatus::Failure) {
+      continue;
+    }
+    CHECK(formats::load_patch_from_memory(path, view->data(), view->size())
+              .patches.size() == expected.patches.size());
+
+    ++totals.files;
+    totals.mapped += view->mapped() ? 1 : 0;
+    totals.bytes += bytes.size();
+
+    auto start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+      CHECK(stream_read(path).size() == bytes.size());
+    }
+    totals.stream_read += seconds_since(start);
+
+    start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+      CHECK(platform::FileView::open(path)->size() == bytes.size());
+    }
+    totals.view_read += seconds_since(start);
+
+    start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+      const auto data = stream_read(path);
+      formats::load_patch_from_memory(path, data.data(), data.size());
+    }
+    totals.stream_parse += seconds_since(start);
+
+    start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+      const auto data = platform::FileView::open(path);
+      formats::load_patch_from_memory(path, data->data(), data->size());
+    }
+    totals.view_parse += seconds_since(start);
+  }
+
+  std::printf("%-9s %5s %6s | %26s | %26s\n", "", "", "", "read (MB/s)",
+              "read + parse (MB/s)");
+  std::printf("%-9s %5s %6s | %8s %8s %7s | %8s %8s %7s\n", "extension",
+              "files", "mapped", "stream", "view", "speedup", "stream", "view",
+              "speedup");
+  Totals all;
+  for (const auto &[extension, totals] : by_extension) {
+    if (totals.files == 0) {
+      continue;
+    }
+    report(extension, totals, rounds);
+    all.add(totals);
+  }
+  report("all", all, rounds);
+
+  if (own_corpus) {
+    fs::remove_all(corpus, error);
+  }
+  return 0;
+}
@@ -1,15 +1,19 @@
 #include "../test_check.hpp"
+#include "gui/components/patch_filter.hpp"
 #include "gui/components/patch_tree_flatten.hpp"
 
 #include <iostream>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace {
 
 using ui::selector_detail::flatten_visible_rows;
+using ui::selector_detail::parse_query;
 using ui::selector_detail::TreeRow;
+using ui::selector_detail::TreeRowCache;
 
 patches::PatchEntry make_file(const std::string &name,
                               const std::string &relative_path, int stars,
@@ -61,22 +65,26 @@ std::vector<patches::PatchEntry> make_tree() {
   return tree;
 }
 
-std::vector<std::string> paths_of(const std::vector<TreeRow> &rows) {
+std::vector<std::string> paths_of(const patches::PatchIndex &index,
+                                  const std::vector<TreeRow> &rows) {
   std::vector<std::string> paths;
   paths.reserve(rows.size());
   for (const auto &row : rows) {
-    paths.push_back(row.entry->relative_path);
+    paths.push_back(index.relative_path(row.node));
   }
   return paths;
 }
 
 void test_closed_tree_lists_visible_top_level_only() {
   const auto tree = make_tree();
-  const auto rows = flatten_visible_rows(tree, "", 0, {});
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+  const auto rows = flatten_visible_rows(index, search, "", 0, {});
 
   // `empty` holds no file at any depth, and a directory may stand on its own
   // name only while a query is active -- so it is dropped here.
-  CHECK(paths_of(rows) == std::vector<std::string>({"banks", "solo.dmp"}));
+  CHECK(paths_of(index, rows) ==
+        std::vector<std::string>({"banks", "solo.dmp"}));
   CHECK(rows[0].is_directory);
   CHECK(!rows[0].is_open);
   CHECK(rows[0].depth == 0);
@@ -87,27 +95,32 @@ void test_closed_tree_lists_visible_top_level_only() {
 
 void test_closed_ancestors_of_a_deep_match_are_listed() {
   const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
 
   // Nothing is open, so the only trace of the match two levels down is the
   // top-level row it keeps alive.
-  const auto by_query = flatten_visible_rows(tree, "zap", 0, {});
-  CHECK(paths_of(by_query) == std::vector<std::string>({"banks"}));
+  const auto by_query = flatten_visible_rows(index, search, "zap", 0, {});
+  CHECK(paths_of(index, by_query) == std::vector<std::string>({"banks"}));
   CHECK(by_query[0].is_directory);
   CHECK(!by_query[0].is_open);
   CHECK(by_query[0].depth == 0);
 
   // The star filter reaches through a closed directory the same way.
-  const auto by_stars = flatten_visible_rows(tree, "", 5, {});
-  CHECK(paths_of(by_stars) == std::vector<std::string>({"banks"}));
+  const auto by_stars = flatten_visible_rows(index, search, "", 5, {});
+  CHECK(paths_of(index, by_stars) == std::vector<std::string>({"banks"}));
 }
 
 void test_open_directory_exposes_direct_children() {
   const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
   const std::unordered_set<std::string> open{"banks"};
-  const auto rows = flatten_visible_rows(tree, "", 0, open);
+  const auto rows = flatten_visible_rows(index, search, "", 0, open);
 
-  CHECK(paths_of(rows) == std::vector<std::string>({"banks", "banks/lead.dmp",
-                                                    "banks/fx", "solo.dmp"}));
+  CHECK(paths_of(index, rows) ==
+        std::vector<std::string>(
+            {"banks", "banks/lead.dmp", "banks/fx", "solo.dmp"}));
   CHECK(rows[0].is_open);
   CHECK(rows[1].depth == 1);
   CHECK(rows[2].is_directory);
@@ -116,8 +129,8 @@ void test_open_directory_exposes_direct_children() {
   CHECK(rows[3].depth == 0);
 
   const std::unordered_set<std::string> open_nested{"banks", "banks/fx"};
-  const auto nested = flatten_visible_rows(tree, "", 0, open_nested);
-  CHECK(paths_of(nested) ==
+  const auto nested = flatten_visible_rows(index, search, "", 0, open_nested);
+  CHECK(paths_of(index, nested) ==
         std::vector<std::string>({"banks", "banks/lead.dmp", "banks/fx",
                                   "banks/fx/zap.opm", "solo.dmp"}));
   CHECK(nested[3].depth == 2);
@@ -126,63 +139,233 @@ void test_open_directory_exposes_direct_children() {
 
 void test_star_filter_prunes_emptied_directories() {
   const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
   const std::unordered_set<std::string> open{"banks", "banks/fx"};
-  const auto rows = flatten_visible_rows(tree, "", 3, open);
+  const auto rows = flatten_visible_rows(index, search, "", 3, open);
 
   // fx is open but its only patch is below the threshold, so both the
   // directory row and its children go away.
-  CHECK(paths_of(rows) ==
+  CHECK(paths_of(index, rows) ==
         std::vector<std::string>({"banks", "banks/lead.dmp"}));
 }
 
 void test_query_keeps_the_ancestors_of_a_match() {
   const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
   const std::unordered_set<std::string> open{"banks"};
-  const auto rows = flatten_visible_rows(tree, "zap", 0, open);
-  CHECK(paths_of(rows) == std::vector<std::string>({"banks", "banks/fx"}));
+  const auto rows = flatten_visible_rows(index, search, "zap", 0, open);
+  CHECK(paths_of(index, rows) ==
+        std::vector<std::string>({"banks", "banks/fx"}));
 
   const std::unordered_set<std::string> open_nested{"banks", "banks/fx"};
-  const auto nested = flatten_visible_rows(tree, "zap", 0, open_nested);
-  CHECK(paths_of(nested) ==
+  const auto nested =
+      flatten_visible_rows(index, search, "zap", 0, open_nested);
+  CHECK(paths_of(index, nested) ==
         std::vector<std::string>({"banks", "banks/fx", "banks/fx/zap.opm"}));
 
   // Categories are searched alongside names.
   const auto by_category =
-      flatten_visible_rows(tree, "percussion", 0, open_nested);
-  CHECK(paths_of(by_category) ==
+      flatten_visible_rows(index, search, "percussion", 0, open_nested);
+  CHECK(paths_of(index, by_category) ==
         std::vector<std::string>({"banks", "banks/fx", "banks/fx/zap.opm"}));
 }
 
 void test_directory_name_match_needs_no_visible_files() {
   const auto tree = make_tree();
-  const auto rows = flatten_visible_rows(tree, "empty", 0, {});
-  CHECK(paths_of(rows) == std::vector<std::string>({"empty"}));
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+  const auto rows = flatten_visible_rows(index, search, "empty", 0, {});
+  CHECK(paths_of(index, rows) == std::vector<std::string>({"empty"}));
   CHECK(rows[0].is_directory);
   CHECK(!rows[0].is_open);
 
   // Opening such a directory reports the open state and still yields no
   // children.
-  const auto opened = flatten_visible_rows(tree, "empty", 0, {"empty"});
-  CHECK(paths_of(opened) == std::vector<std::string>({"empty"}));
+  const auto opened =
+      flatten_visible_rows(index, search, "empty", 0, {"empty"});
+  CHECK(paths_of(index, opened) == std::vector<std::string>({"empty"}));
   CHECK(opened[0].is_open);
 
   // ...but a match on a nested directory does not pull in its parent: the
   // parent is listed only for files below it or a match of its own.
   const std::unordered_set<std::string> open{"banks"};
-  const auto nested = flatten_visible_rows(tree, "fx", 0, open);
+  const auto nested = flatten_visible_rows(index, search, "fx", 0, open);
   CHECK(nested.empty());
 
   // Opening the matching directory changes nothing: a name-only match never
   // counts as a visible descendant for the ancestors above it.
   const auto nested_open =
-      flatten_visible_rows(tree, "fx", 0, {"banks", "banks/fx"});
+      flatten_visible_rows(index, search, "fx", 0, {"banks", "banks/fx"});
   CHECK(nested_open.empty());
 }
 
+void test_unread_directory_is_listed_only_unfiltered() {
+  auto tree = make_tree();
+  auto unread = make_directory("packs", "packs", {});
+  unread.children_pending = true;
+  tree.push_back(std::move(unread));
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+
+  // "empty" is known to hold nothing; "packs" has simply not been read.
+  // Open, it shows a loading row until it has been.
+  const auto rows = flatten_visible_rows(index, search, "", 0, {"packs"});
+  CHECK(paths_of(index, rows) ==
+        std::vector<std::string>({"banks", "solo.dmp", "packs", "packs"}));
+  CHECK(rows[2].is_open);
+  CHECK(rows[3].is_loading);
+  CHECK(!rows[3].is_directory);
+  CHECK(rows[3].depth == 1);
+  const auto closed = flatten_visible_rows(index, search, "", 0, {});
+  CHECK(!closed.back().is_open);
+  CHECK(!closed.back().is_loading);
+
+  CHECK(paths_of(index, flatten_visible_rows(index, search, "", 1, {})) ==
+        std::vector<std::string>({"banks"}));
+  CHECK(paths_of(index, flatten_visible_rows(index, search, "lead", 0, {})) ==
+        std::vector<std::string>({"banks"}));
+}
+
 void test_empty_tree_is_handled() {
   const std::vector<patches::PatchEntry> tree;
-  CHECK(flatten_visible_rows(tree, "", 0, {}).empty());
-  CHECK(flatten_visible_rows(tree, "lead", 5, {"banks"}).empty());
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+  CHECK(flatten_visible_rows(index, search, "", 0, {}).empty());
+  CHECK(flatten_visible_rows(index, search, "lead", 5, {"banks"}).empty());
+}
+
+bool same_rows(const std::vector<TreeRow> &a, const std::vector<TreeRow> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (a[i].node != b[i].node || a[i].depth != b[i].depth ||
+        a[i].is_directory != b[i].is_directory ||
+        a[i].is_open != b[i].is_open) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void test_metadata_terms_filter_by_category() {
+  const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+  const auto metadata = patches::PatchMetadataIndex::build(index);
+  const std::unordered_set<std::string> open{"banks", "banks/fx"};
+
+  // A category: term is matched whole against the metadata, not searched,
+  // and works the same with or without a prebuilt index.
+  const auto by_category = flatten_visible_rows(
+      index, search, "category:Percussion", 0, open, &metadata);
+  CHECK(paths_of(index, by_category) ==
+        std::vector<std::string>({"banks", "banks/fx", "banks/fx/zap.opm"}));
+  CHECK(same_rows(by_category,
+                  flatten_visible_rows(index, search, "category:percussion",
+                                       0, open)));
+  CHECK(flatten_visible_rows(index, search, "category:perc", 0, open,
+                             &metadata)
+            .empty());
+
+  // The rest of the query still searches, and every condition must hold.
+  CHECK(paths_of(index, flatten_visible_rows(index, search,
+                                             "category:lead lead", 0, open,
+                                             &metadata)) ==
+        std::vector<std::string>({"banks", "banks/lead.dmp"}));
+  CHECK(flatten_visible_rows(index, search, "category:lead zap", 0, open,
+                             &metadata)
+            .empty());
+  CHECK(flatten_visible_rows(index, search, "category:percussion", 3, open,
+                             &metadata)
+            .empty());
+  CHECK(flatten_visible_rows(index, search, "tag:bright", 0, open, &metadata)
+            .empty());
+}
+
+void test_query_text_is_kept_as_typed() {
+  CHECK(parse_query("  Lead  2 ", 0).text == "  Lead  2 ");
+
+  // Only the metadata terms are taken out.
+  const auto parsed = parse_query("Bass  Category:Lead  tag:Soft deep", 4);
+  CHECK(parsed.text == "Bass  deep");
+  CHECK(parsed.metadata.category == "lead");
+  CHECK(parsed.metadata.tags == std::vector<std::string>({"soft"}));
+  CHECK(parsed.metadata.min_stars == 4);
+  CHECK(parse_query("category:lead  bass", 0).text == "bass");
+  CHECK(parse_query("bass  tag:soft", 0).text == "bass");
+  CHECK(parse_query("tag:soft", 0).text.empty());
+}
+
+void test_cache_splices_toggles_without_rebuilding() {
+  const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+
+  TreeRowCache cache;
+  const auto &rows = cache.get(index, search, 1, "", 0);
+  CHECK(paths_of(index, rows) ==
+        std::vector<std::string>({"banks", "solo.dmp"}));
+  CHECK(cache.rebuild_count() == 1);
+
+  // Open, open nested, close the parent, reopen: each step must agree with
+  // a full flatten of the same open set, without a rebuild.
+  const std::vector<std::pair<std::string, bool>> steps = {
+      {"banks", true}, {"banks/fx", true}, {"banks", false}, {"banks", true}};
+  std::unordered_set<std::string> open;
+  for (const auto &[path, is_open] : steps) {
+    cache.set_open(path, is_open);
+    if (is_open) {
+      open.insert(path);
+    } else {
+      open.erase(path);
+    }
+    const auto &spliced = cache.get(index, search, 1, "", 0);
+    CHECK(same_rows(spliced, flatten_visible_rows(index, search, "", 0, open)));
+  }
+  CHECK(cache.rebuild_count() == 1);
+  CHECK(cache.open_generation() == 4);
+  CHECK(paths_of(index, rows) ==
+        std::vector<std::string>({"banks", "banks/lead.dmp", "banks/fx",
+                                  "banks/fx/zap.opm", "solo.dmp"}));
+
+  // Re-asserting the current state is not a change.
+  cache.set_open("banks", true);
+  CHECK(cache.open_generation() == 4);
+}
+
+void test_cache_rebuilds_on_filter_or_revision_change() {
+  const auto tree = make_tree();
+  const auto index = patches::PatchIndex::build(tree);
+  const auto search = patches::PatchSearchIndex::build(index);
+
+  TreeRowCache cache;
+  cache.set_open("banks", true);
+  cache.get(index, search, 1, "", 0);
+  cache.get(index, search, 1, "", 0);
+  CHECK(cache.rebuild_count() == 1);
+
+  const auto &filtered = cache.get(index, search, 1, "", 3);
+  CHECK(cache.rebuild_count() == 2);
+  CHECK(paths_of(index, filtered) ==
+        std::vector<std::string>({"banks", "banks/lead.dmp"}));
+
+  // With fx filtered out, opening it only records the state; the row
+  // appears, open, once the filter that hid it is lifted.
+  cache.set_open("banks/fx", true);
+  CHECK(paths_of(index, cache.get(index, search, 1, "", 3)) ==
+        std::vector<std::string>({"banks", "banks/lead.dmp"}));
+  CHECK(cache.rebuild_count() == 2);
+
+  const auto &searched = cache.get(index, search, 1, "zap", 0);
+  CHECK(cache.rebuild_count() == 3);
+  CHECK(paths_of(index, searched) ==
+        std::vector<std::string>({"banks", "banks/fx", "banks/fx/zap.opm"}));
+
+  cache.get(index, search, 2, "zap", 0);
+  CHECK(cache.rebuild_count() == 4);
 }
 
 } // namespace
@@ -194,7 +377,12 @@ int main() {
   test_star_filter_prunes_emptied_directories();
   test_query_keeps_the_ancestors_of_a_match();
   test_directory_name_match_needs_no_visible_files();
+  test_unread_directory_is_listed_only_unfiltered();
   test_empty_tree_is_handled();
+  test_metadata_terms_filter_by_category();
+  test_query_text_is_kept_as_typed();
+  test_cache_splices_toggles_without_rebuilding();
+  test_cache_rebuilds_on_filter_or_revision_change();
 
   std::cout << "All patch tree flatten tests passed\n";
   return 0;
@@ -0,0 +1,177 @@
+#include "../test_check.hpp"
+#include "history/delta_history.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Undo steps are stored as the fields they changed. Each test checks that
+// what comes back out is exactly the snapshot that went in, whichever way
+// the history is walked.
+
+namespace {
+
+using patches::PatchSnapshot;
+
+PatchSnapshot snapshot_with(int total_level, int attack_rate = 31) {
+  PatchSnapshot snapshot;
+  snapshot.patch.name = "lead";
+  snapshot.patch.instrument.operators[0].total_level =
+      static_cast<uint8_t>(total_level);
+  snapshot.patch.instrument.operators[2].attack_rate =
+      static_cast<uint8_t>(attack_rate);
+  snapshot.original_patch = snapshot.patch;
+  snapshot.path = "user/lead.gin";
+  snapshot.selection_path = snapshot.path;
+  return snapshot;
+}
+
+bool same(const PatchSnapshot &a, const PatchSnapshot &b) {
+  return a == b && a.original_patch == b.original_patch;
+}
+
+void test_an_unchanged_value_records_nothing() {
+  history::DeltaHistory steps;
+  CHECK(!steps.record("Total Level", "op0.tl", snapshot_with(7),
+                      snapshot_with(7)));
+  CHECK(!steps.can_undo());
+  CHECK(steps.bytes_used() == 0);
+}
+
+void test_undo_and_redo_restore_each_side() {
+  history::DeltaHistory steps;
+  const auto a = snapshot_with(7);
+  const auto b = snapshot_with(9);
+  auto c = snapshot_with(9, 12);
+  c.patch.name = "brighter lead";
+  c.path = "user/brighter lead.gin";
+
+  CHECK(steps.record("Total Level", "op0.tl", a, b));
+  CHECK(steps.record("Rename", "", b, c));
+  CHECK(steps.undo_label() == "Rename");
+
+  auto restored = steps.undo();
+  CHECK(restored && same(*restored, b));
+  CHECK(steps.undo_label() == "Total Level");
+  CHECK(steps.redo_label() == "Rename");
+  restored = steps.undo();
+  CHECK(restored && same(*restored, a));
+  CHECK(!steps.can_undo());
+  CHECK(!steps.undo());
+
+  restored = steps.redo();
+  CHECK(restored && same(*restored, b));
+  restored = steps.redo();
+  CHECK(restored && same(*restored, c));
+  CHECK(!steps.can_redo());
+}
+
+// A drag reports many edits; they collapse into the one the user made.
+void test_steps_sharing_a_merge_key_collapse() {
+  history::DeltaHistory steps;
+  CHECK(steps.record("Total Level", "op0.tl", snapshot_with(7),
+                     snapshot_with(9)));
+  CHECK(steps.record("Total Level", "op0.tl", snapshot_with(9),
+                     snapshot_with(20)));
+  CHECK(steps.steps() == 1);
+  const auto restored = steps.undo();
+  CHECK(restored && same(*restored, snapshot_with(7)));
+  CHECK(same(*steps.redo(), snapshot_with(20)));
+}
+
+void test_steps_with_different_merge_keys_stay_apart() {
+  history::DeltaHistory steps;
+  CHECK(steps.record("Total Level", "op0.tl", snapshot_with(7),
+                     snapshot_with(9)));
+  CHECK(steps.record("Attack Rate", "op2.ar", snapshot_with(9),
+                     snapshot_with(9, 4)));
+  CHECK(steps.steps() == 2);
+}
+
+// Instant edits carry no merge key: toggling on then off must not collapse
+// into one step that undoes to nothing.
+void test_steps_without_a_merge_key_never_collapse() {
+  history::DeltaHistory steps;
+  auto on = snapshot_with(7);
+  auto off = on;
+  off.patch.instrument.operators[0].enable = false;
+  CHECK(steps.record("OP1 Enable", "", on, off));
+  CHECK(steps.record("OP1 Enable", "", off, on));
+  CHECK(steps.steps() == 2);
+  CHECK(same(*steps.undo(), off));
+}
+
+// Something changed the patch without a step in between: undo still lands
+// on each step's own before-state, as whole snapshots did.
+void test_unrecorded_changes_between_steps() {
+  history::DeltaHistory steps;
+  CHECK(steps.record("Total Level", "", snapshot_with(1), snapshot_with(2)));
+  CHECK(steps.record("Total Level", "", snapshot_with(50), snapshot_with(51)));
+  CHECK(same(*steps.undo(), snapshot_with(50)));
+  CHECK(same(*steps.undo(), snapshot_with(1)));
+  CHECK(same(*steps.redo(), snapshot_with(2)));
+  CHECK(same(*steps.redo(), snapshot_with(51)));
+
+  // Recording after an undo drops the redo and the gap that went with it.
+  CHECK(same(*steps.undo(), snapshot_with(50)));
+  CHECK(steps.record("Total Level", "", snapshot_with(60), snapshot_with(61)));
+  CHECK(!steps.can_redo());
+  CHECK(same(*steps.undo(), snapshot_with(60)));
+  CHECK(same(*steps.undo(), snapshot_with(1)));
+}
+
+// The budget bounds the bytes, not the count: thousands of edits fit where
+// 256 whole snapshots used to, and the oldest go first.
+void test_budget_drops_the_oldest_steps() {
+  constexpr std::size_t kBudget = 64 * 1024;
+  history::DeltaHistory steps(kBudget);
+  for (int i = 0; i < 20000; ++i) {
+    CHECK(steps.record("Total Level", "", snapshot_with(i % 128),
+                       snapshot_with((i + 1) % 128)));
+    CHECK(steps.bytes_used() <= kBudget);
+  }
+  CHECK(steps.steps() > 2000);
+  CHECK(steps.steps() < 20000);
+
+  std::size_t undone = 0;
+  std::optional<PatchSnapshot> last;
+  while (auto restored = steps.undo()) {
+    last = restored;
+    ++undone;
+  }
+  CHECK(undone == steps.steps());
+  const int oldest = static_cast<int>(20000 - undone);
+  CHECK(last && same(*last, snapshot_with(oldest % 128)));
+  for (std::size_t i = 0; i < undone; ++i) {
+    CHECK(steps.redo().has_value());
+  }
+  CHECK(same(*steps.undo(), snapshot_with(19999 % 128)));
+}
+
+void test_malformed_delta_is_refused() {
+  PatchSnapshot snapshot;
+  const std::vector<std::uint8_t> truncated = {3, 1};
+  CHECK(!history::patch_delta::apply(truncated, snapshot,
+                                     history::patch_delta::Direction::Forward));
+  const std::vector<std::uint8_t> unknown = {200, 0, 0};
+  CHECK(!history::patch_delta::apply(unknown, snapshot,
+                                     history::patch_delta::Direction::Forward));
+}
+
+} // namespace
+
+int main() {
+  test_an_unchanged_value_records_nothing();
+  test_undo_and_redo_restore_each_side();
+  test_steps_sharing_a_merge_key_collapse();
+  test_steps_with_different_merge_keys_stay_apart();
+  test_steps_without_a_merge_key_never_collapse();
+  test_unrecorded_changes_between_steps();
+  test_budget_drops_the_oldest_steps();
+  test_malformed_delta_is_refused();
+
+  std::cout << "All delta history tests passed\n";
+  return 0;
+}
@@ -0,0 +1,287 @@
+#include "../test_check.hpp"
+#include "history/edit_journal.hpp"
+#include "history/patch_delta.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The journal is only useful if what one session appends, the next can
+// take back: each test writes with one journal and reads with a fresh one
+// over the same directory.
+
+namespace {
+
+namespace fs = std::filesystem;
+using history::EditJournal;
+using patches::PatchSnapshot;
+
+PatchSnapshot snapshot_of(const std::string &path, int total_level) {
+  PatchSnapshot snapshot;
+  snapshot.patch.name = "lead";
+  snapshot.patch.instrument.operators[0].total_level =
+      static_cast<uint8_t>(total_level);
+  snapshot.original_patch = snapshot.patch;
+  snapshot.path = path;
+  snapshot.selection_path = path;
+  return snapshot;
+}
+
+fs::path fresh_directory(const fs::path &root, const std::string &name) {
+  const auto directory = root / name;
+  fs::remove_all(directory);
+  return directory;
+}
+
+/// take_steps() answers nothing until the index is built.
+void open_indexed(EditJournal &journal, const fs::path &directory) {
+  journal.open(directory);
+  for (int i = 0; i < 2000 && !journal.ready(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(journal.ready());
+}
+
+std::vector<fs::path> segments_in(const fs::path &directory) {
+  std::vector<fs::path> segments;
+  for (const auto &entry : fs::directory_iterator(directory)) {
+    segments.push_back(entry.path());
+  }
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+
+void test_steps_come_back_in_order(const fs::path &root) {
+  const auto directory = fresh_directory(root, "round_trip");
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    journal.append("Total Level", "op0.tl", snapshot_of("lead.gin", 1),
+                   snapshot_of("lead.gin", 2));
+    journal.append("Total Level", "op1.tl", snapshot_of("lead.gin", 2),
+                   snapshot_of("lead.gin", 3));
+    journal.append("Bass", "", snapshot_of("bass.gin", 1),
+                   snapshot_of("bass.gin", 9));
+    journal.append("Total Level", "", snapshot_of("lead.gin", 3),
+                   snapshot_of("lead.gin", 7));
+  }
+
+  EditJournal journal;
+  open_indexed(journal, directory);
+  const auto steps = journal.take_steps("lead.gin");
+  CHECK(steps.size() == 3);
+  CHECK(steps[0].merge_key == "op0.tl");
+  CHECK(steps[2].merge_key.empty());
+  for (std::size_t i = 0; i + 1 < steps.size(); ++i) {
+    CHECK(steps[i].after_hash == steps[i + 1].before_hash);
+  }
+  CHECK(steps[2].after_hash ==
+        snapshot_of("lead.gin", 7).patch.packed().hash());
+
+  // The deltas walk back from the newest state to the oldest.
+  auto state = snapshot_of("lead.gin", 7);
+  for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+    CHECK(history::patch_delta::apply(
+        it->change, state, history::patch_delta::Direction::Backward));
+  }
+  CHECK(state == snapshot_of("lead.gin", 1));
+
+  // Once taken, the in-memory history has them.
+  CHECK(journal.take_steps("lead.gin").empty());
+  CHECK(journal.take_steps("missing.gin").empty());
+
+  // A patch edited this session already has its history in memory.
+  journal.append("Bass", "", snapshot_of("bass.gin", 9),
+                 snapshot_of("bass.gin", 10));
+  CHECK(journal.take_steps("bass.gin").empty());
+}
+
+// A drag commits every frame under one merge key; it is journalled as the
+// one step the history folds it into.
+void test_merged_edits_are_one_step(const fs::path &root) {
+  const auto directory = fresh_directory(root, "merged");
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    for (int level = 1; level < 6; ++level) {
+      journal.append("Total Level " + std::to_string(level), "op0.tl",
+                     snapshot_of("lead.gin", level),
+                     snapshot_of("lead.gin", level + 1));
+    }
+    journal.append("Total Level", "", snapshot_of("lead.gin", 6),
+                   snapshot_of("lead.gin", 8));
+    journal.append("Total Level", "op0.tl", snapshot_of("lead.gin", 8),
+                   snapshot_of("lead.gin", 9));
+  }
+
+  EditJournal journal;
+  open_indexed(journal, directory);
+  const auto steps = journal.take_steps("lead.gin");
+  CHECK(steps.size() == 3);
+  CHECK(steps[0].label == "Total Level 5");
+  CHECK(steps[0].before_hash ==
+        snapshot_of("lead.gin", 1).patch.packed().hash());
+  CHECK(steps[0].after_hash ==
+        snapshot_of("lead.gin", 6).patch.packed().hash());
+  CHECK(steps[1].merge_key.empty());
+  CHECK(steps[2].before_hash == steps[1].after_hash);
+
+  auto state = snapshot_of("lead.gin", 6);
+  CHECK(history::patch_delta::apply(
+      steps[0].change, state, history::patch_delta::Direction::Backward));
+  CHECK(state == snapshot_of("lead.gin", 1));
+}
+
+void test_each_patch_keeps_its_newest_steps(const fs::path &root) {
+  const auto directory = fresh_directory(root, "per_patch");
+  const std::string label(100, 'x');
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    for (int i = 0; i < 2000; ++i) {
+      journal.append(label + std::to_string(i), "",
+                     snapshot_of("lead.gin", i % 128),
+                     snapshot_of("lead.gin", (i + 1) % 128));
+    }
+  }
+
+  EditJournal journal;
+  open_indexed(journal, directory);
+  const auto steps = journal.take_steps("lead.gin");
+  CHECK(steps.size() > 50);
+  CHECK(steps.size() < 2000);
+  CHECK(steps.back().label == label + "1999");
+  std::size_t bytes = 0;
+  for (const auto &step : steps) {
+    bytes += step.label.size() + step.change.size();
+  }
+  CHECK(bytes <= EditJournal::kPatchBytes);
+}
+
+// Past the journal's budget, old segments go but each patch's newest steps
+// are carried forward.
+void test_compaction_keeps_the_newest_steps(const fs::path &root) {
+  const auto directory = fresh_directory(root, "compaction");
+  const std::vector<std::string> keys = {"a.gin", "b.gin", "c.gin", "d.gin"};
+  constexpr int kEdits = 120000;
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    for (int i = 0; i < kEdits; ++i) {
+      const auto &key = keys[static_cast<std::size_t>(i) % keys.size()];
+      const int edit = i / static_cast<int>(keys.size());
+      journal.append("Edit " + std::to_string(i), "",
+                     snapshot_of(key, edit % 128),
+                     snapshot_of(key, (edit + 1) % 128));
+    }
+    journal.shutdown();
+    CHECK(journal.bytes_on_disk() <=
+          EditJournal::kJournalBytes + EditJournal::kSegmentBytes);
+  }
+
+  std::size_t on_disk = 0;
+  for (const auto &segment : segments_in(directory)) {
+    on_disk += static_cast<std::size_t>(fs::file_size(segment));
+  }
+  CHECK(on_disk <= EditJournal::kJournalBytes + EditJournal::kSegmentBytes);
+
+  EditJournal journal;
+  open_indexed(journal, directory);
+  for (std::size_t k = 0; k < keys.size(); ++k) {
+    const auto steps = journal.take_steps(keys[k]);
+    CHECK(steps.size() > 100);
+    CHECK(steps.back().label ==
+          "Edit " + std::to_string(kEdits - keys.size() + k));
+    for (std::size_t i = 0; i + 1 < steps.size(); ++i) {
+      CHECK(steps[i].after_hash == steps[i + 1].before_hash);
+    }
+  }
+}
+
+// A crash mid-write leaves half a record; it is dropped and appending
+// carries on after the last whole one.
+void test_a_torn_record_is_dropped(const fs::path &root) {
+  const auto directory = fresh_directory(root, "torn");
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    journal.append("Total Level", "", snapshot_of("lead.gin", 1),
+                   snapshot_of("lead.gin", 2));
+  }
+  const auto segments = segments_in(directory);
+  CHECK(segments.size() == 1);
+  {
+    std::ofstream file(segments[0], std::ios::binary | std::ios::app);
+    file.write("\x40\x00\x00\x00\x12\x34", 6);
+  }
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    journal.append("Total Level", "", snapshot_of("bass.gin", 1),
+                   snapshot_of("bass.gin", 2));
+  }
+
+  EditJournal journal;
+  open_indexed(journal, directory);
+  CHECK(journal.take_steps("lead.gin").size() == 1);
+  CHECK(journal.take_steps("bass.gin").size() == 1);
+}
+
+// Segments name their format; one written in another is left as it is and
+// new edits go to a segment of their own.
+void test_a_segment_in_another_format_is_skipped(const fs::path &root) {
+  const auto directory = fresh_directory(root, "format");
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    journal.append("Total Level", "", snapshot_of("lead.gin", 1),
+                   snapshot_of("lead.gin", 2));
+  }
+  auto segments = segments_in(directory);
+  CHECK(segments.size() == 1);
+  const auto foreign_size = fs::file_size(segments[0]);
+  {
+    std::fstream file(segments[0],
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(3);
+    file.put('\x7f');
+  }
+  {
+    EditJournal journal;
+    open_indexed(journal, directory);
+    journal.append("Total Level", "", snapshot_of("bass.gin", 1),
+                   snapshot_of("bass.gin", 2));
+  }
+  segments = segments_in(directory);
+  CHECK(segments.size() == 2);
+  CHECK(fs::file_size(segments[0]) == foreign_size);
+
+  EditJournal journal;
+  open_indexed(journal, directory);
+  CHECK(journal.take_steps("lead.gin").empty());
+  CHECK(journal.take_steps("bass.gin").size() == 1);
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() / "megatoy_edit_journal_test";
+  fs::remove_all(root);
+
+  test_steps_come_back_in_order(root);
+  test_merged_edits_are_one_step(root);
+  test_each_patch_keeps_its_newest_steps(root);
+  test_compaction_keeps_the_newest_steps(root);
+  test_a_torn_record_is_dropped(root);
+  test_a_segment_in_another_format_is_skipped(root);
+
+  fs::remove_all(root);
+  std::cout << "All edit journal tests passed\n";
+  return 0;
+}
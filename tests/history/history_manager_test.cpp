@@ -0,0 +1,197 @@
+#include "../test_check.hpp"
+#include "history/edit_journal.hpp"
+#include "history/history_manager.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What one session journals, the next one's HistoryManager puts back as
+// undo steps: each test writes with an EditJournal and restores with a
+// fresh HistoryManager over the same directory.
+
+namespace {
+
+namespace fs = std::filesystem;
+using history::EditJournal;
+using history::HistoryManager;
+using patches::PatchSnapshot;
+
+PatchSnapshot snapshot_of(const std::string &path, int total_level) {
+  PatchSnapshot snapshot;
+  snapshot.patch.name = "lead";
+  snapshot.patch.instrument.operators[0].total_level =
+      static_cast<uint8_t>(total_level);
+  snapshot.original_patch = snapshot.patch;
+  snapshot.path = path;
+  snapshot.selection_path = path;
+  return snapshot;
+}
+
+int level_of(const std::optional<PatchSnapshot> &snapshot) {
+  CHECK(snapshot.has_value());
+  return snapshot ? snapshot->patch.instrument.operators[0].total_level : -1;
+}
+
+struct Edit {
+  int from = 0;
+  int to = 0;
+  std::string label;
+};
+
+fs::path journal_of(const fs::path &root, const std::string &name,
+                    const std::vector<Edit> &edits) {
+  const auto directory = root / name;
+  fs::remove_all(directory);
+  EditJournal journal;
+  journal.open(directory);
+  for (const auto &edit : edits) {
+    journal.append(edit.label, "", snapshot_of("lead.gin", edit.from),
+                   snapshot_of("lead.gin", edit.to));
+  }
+  return directory;
+}
+
+/// restore_journal() as initialize_app() does it, then poll() until the
+/// journal has answered.
+void restore(HistoryManager &history, const fs::path &directory,
+             int current_level) {
+  history.open_journal(directory);
+  history.restore_journal(snapshot_of("lead.gin", current_level));
+  for (int i = 0; i < 2000 && history.restore_pending(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    history.poll();
+  }
+  CHECK(!history.restore_pending());
+}
+
+void test_steps_replay_in_order(const fs::path &root) {
+  const auto directory = journal_of(
+      root, "order", {{1, 2, "First"}, {2, 3, "Second"}, {3, 7, "Third"}});
+  HistoryManager history;
+  restore(history, directory, 7);
+
+  CHECK(history.can_undo());
+  CHECK(!history.can_redo());
+  CHECK(history.undo_label() == "Third");
+  CHECK(level_of(history.step_back()) == 3);
+  CHECK(history.undo_label() == "Second");
+  CHECK(level_of(history.step_back()) == 2);
+  CHECK(history.undo_label() == "First");
+  CHECK(level_of(history.step_back()) == 1);
+  CHECK(!history.can_undo());
+
+  CHECK(history.redo_label() == "First");
+  CHECK(level_of(history.step_forward()) == 2);
+  CHECK(level_of(history.step_forward()) == 3);
+  CHECK(level_of(history.step_forward()) == 7);
+  CHECK(!history.can_redo());
+}
+
+// The file was saved at 3; the edits after that were never saved, and the
+// chain back from 3 ends where a step does not lead to the next.
+void test_unsaved_edits_are_skipped(const fs::path &root) {
+  const auto directory =
+      journal_of(root, "unsaved",
+                 {{1, 2, "Lost"},
+                  {5, 6, "Kept"},
+                  {6, 3, "Saved"},
+                  {3, 4, "Unsaved"},
+                  {4, 9, "Unsaved too"}});
+  HistoryManager history;
+  restore(history, directory, 3);
+
+  CHECK(history.undo_label() == "Saved");
+  CHECK(level_of(history.step_back()) == 6);
+  CHECK(history.undo_label() == "Kept");
+  CHECK(level_of(history.step_back()) == 5);
+  CHECK(!history.can_undo());
+  CHECK(level_of(history.step_forward()) == 6);
+  CHECK(level_of(history.step_forward()) == 3);
+  CHECK(!history.can_redo());
+}
+
+// Nothing journalled leads to the patch as it was reopened.
+void test_a_different_patch_restores_nothing(const fs::path &root) {
+  const auto directory =
+      journal_of(root, "different", {{1, 2, "First"}, {2, 3, "Second"}});
+  HistoryManager history;
+  restore(history, directory, 10);
+  CHECK(!history.can_undo());
+}
+
+/// Overwrite the before-hash of the newest record in `segment`, fixing up
+/// its checksum, so its delta no longer lands where it says it started.
+void mislabel_newest_step(const fs::path &segment) {
+  std::vector<std::uint8_t> bytes;
+  {
+    std::ifstream file(segment, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(file), {});
+  }
+  auto le = [&](std::size_t at, int width) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < width; ++i) {
+      value |= std::uint64_t{bytes[at + i]} << (8 * i);
+    }
+    return value;
+  };
+  // Segment header, then per record: body size, checksum, and a body of
+  // sequence, key (one length byte here), before-hash, ...
+  std::size_t last = 4;
+  for (std::size_t at = 4; at < bytes.size(); at += 8 + le(at, 4)) {
+    last = at;
+  }
+  const auto body = last + 8;
+  const auto before_hash = body + 8 + 1 + bytes[body + 8];
+  bytes[before_hash] ^= 0xff;
+  std::uint32_t checksum = 2166136261u;
+  for (std::size_t i = body; i < body + le(last, 4); ++i) {
+    checksum = (checksum ^ bytes[i]) * 16777619u;
+  }
+  for (int i = 0; i < 4; ++i) {
+    bytes[last + 4 + i] = static_cast<std::uint8_t>(checksum >> (8 * i));
+  }
+  std::ofstream file(segment, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+}
+
+// A step is only put back when undoing it lands on the patch it says it
+// started from; the chain stops at the first that does not.
+void test_a_step_that_misses_its_hash_stops_the_chain(const fs::path &root) {
+  const auto directory =
+      journal_of(root, "mismatch", {{1, 2, "First"}, {2, 3, "Second"}});
+  std::vector<fs::path> segments;
+  for (const auto &entry : fs::directory_iterator(directory)) {
+    segments.push_back(entry.path());
+  }
+  CHECK(segments.size() == 1);
+  mislabel_newest_step(segments[0]);
+
+  HistoryManager history;
+  restore(history, directory, 3);
+  CHECK(!history.can_undo());
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() / "megatoy_history_manager_test";
+  fs::remove_all(root);
+
+  test_steps_replay_in_order(root);
+  test_unsaved_edits_are_skipped(root);
+  test_a_different_patch_restores_nothing(root);
+  test_a_step_that_misses_its_hash_stops_the_chain(root);
+
+  fs::remove_all(root);
+  std::cout << "All history manager tests passed\n";
+  return 0;
+}
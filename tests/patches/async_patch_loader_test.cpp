@@ -0,0 +1,227 @@
+#include "patches/async_patch_loader.hpp"
+#include "platform/std_file_system.hpp"
+
+#include "../test_check.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using patches::AsyncPatchLoader;
+
+/// The worker gets this long to deliver before a test gives up on it.
+constexpr auto kPatience = std::chrono::seconds(5);
+
+template <typename Predicate> bool eventually(Predicate done) {
+  const auto deadline = std::chrono::steady_clock::now() + kPatience;
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+std::optional<AsyncPatchLoader::Result> wait_result(AsyncPatchLoader &loader) {
+  std::optional<AsyncPatchLoader::Result> result;
+  eventually([&] {
+    result = loader.poll();
+    return result.has_value();
+  });
+  return result;
+}
+
+patches::PatchEntry make_entry(const fs::path &root, const std::string &stem,
+                               const std::string &contents = "patch") {
+  const auto path = root / (stem + ".gin");
+  std::ofstream(path) << contents;
+  patches::PatchEntry entry;
+  entry.name = stem;
+  entry.relative_path = "folder/" + stem + ".gin";
+  entry.full_path = path;
+  entry.format = "gin";
+  entry.is_directory = false;
+  return entry;
+}
+
+/// Names the patch after the file it was asked for, and counts calls.
+struct CountingLoad {
+  std::atomic<int> *calls;
+
+  bool operator()(const patches::PatchEntry &entry,
+                  ym2612::Patch &patch) const {
+    calls->fetch_add(1);
+    patch.name = entry.name;
+    return true;
+  }
+};
+
+void test_request_delivers_once(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  AsyncPatchLoader loader(file_system);
+  std::atomic<int> calls{0};
+  const auto entry = make_entry(root, "lead");
+
+  loader.request(entry, CountingLoad{&calls});
+  CHECK(loader.pending());
+  const auto result = wait_result(loader);
+  CHECK(result.has_value());
+  CHECK(result->entry.relative_path == entry.relative_path);
+  CHECK(result->patch.has_value());
+  CHECK(result->patch->name == "lead");
+  CHECK(!loader.pending());
+  CHECK(!loader.poll().has_value());
+  CHECK(calls.load() == 1);
+}
+
+void test_failed_load_reports_no_patch(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  AsyncPatchLoader loader(file_system);
+  loader.request(make_entry(root, "broken"),
+                 [](const patches::PatchEntry &, ym2612::Patch &) {
+                   return false;
+                 });
+  const auto result = wait_result(loader);
+  CHECK(result.has_value());
+  CHECK(!result->patch.has_value());
+}
+
+void test_newest_request_wins(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  AsyncPatchLoader loader(file_system);
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  const auto slow = [&](const patches::PatchEntry &entry,
+                        ym2612::Patch &patch) {
+    started = true;
+    while (!release.load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    patch.name = entry.name;
+    return true;
+  };
+  std::atomic<int> calls{0};
+
+  // "first" is already loading when "second" and then "third" arrive;
+  // "second" never starts and "first" finishes only to be dropped.
+  loader.request(make_entry(root, "first"), slow);
+  CHECK(eventually([&] { return started.load(); }));
+  loader.request(make_entry(root, "second"), CountingLoad{&calls});
+  loader.request(make_entry(root, "third"), CountingLoad{&calls});
+  release = true;
+
+  const auto result = wait_result(loader);
+  CHECK(result.has_value());
+  CHECK(result->patch->name == "third");
+  CHECK(calls.load() == 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!loader.poll().has_value());
+}
+
+void test_cancel_drops_the_result(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  AsyncPatchLoader loader(file_system);
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  loader.request(make_entry(root, "cancelled"),
+                 [&](const patches::PatchEntry &, ym2612::Patch &) {
+                   started = true;
+                   while (!release.load()) {
+                     std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                   }
+                   return true;
+                 });
+  CHECK(eventually([&] { return started.load(); }));
+  loader.cancel();
+  CHECK(!loader.pending());
+  release = true;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!loader.poll().has_value());
+}
+
+void test_prefetched_neighbours_skip_the_load(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  AsyncPatchLoader loader(file_system);
+  std::atomic<int> calls{0};
+  const auto next = make_entry(root, "next");
+  const auto previous = make_entry(root, "previous");
+  patches::PatchEntry folder;
+  folder.name = "folder";
+  folder.relative_path = "folder";
+  folder.is_directory = true;
+
+  const std::vector<const patches::PatchEntry *> neighbours = {
+      &next, &folder, &previous};
+  CHECK(!loader.is_neighbourhood(neighbours));
+  loader.prefetch(neighbours, CountingLoad{&calls});
+  CHECK(loader.is_neighbourhood(neighbours));
+  CHECK(eventually([&] { return loader.prefetched_count() == 2; }));
+  CHECK(calls.load() == 2);
+
+  // Asking again changes nothing and loads nothing.
+  loader.prefetch(neighbours, CountingLoad{&calls});
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(calls.load() == 2);
+
+  loader.request(next, CountingLoad{&calls});
+  const auto result = wait_result(loader);
+  CHECK(result.has_value());
+  CHECK(result->patch->name == "next");
+  CHECK(calls.load() == 2);
+
+  // A file rewritten since it was prefetched is loaded again.
+  std::ofstream(previous.full_path) << "rewritten, and longer";
+  loader.request(previous, CountingLoad{&calls});
+  CHECK(wait_result(loader).has_value());
+  CHECK(calls.load() == 3);
+
+  // Moving on drops what left the neighbourhood.
+  const std::vector<const patches::PatchEntry *> moved = {&previous};
+  loader.prefetch(moved, CountingLoad{&calls});
+  CHECK(loader.prefetched_count() <= 1);
+}
+
+void test_shutdown_ignores_later_requests(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  AsyncPatchLoader loader(file_system);
+  std::atomic<int> calls{0};
+  loader.shutdown();
+  loader.request(make_entry(root, "late"), CountingLoad{&calls});
+  CHECK(!loader.pending());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!loader.poll().has_value());
+  CHECK(calls.load() == 0);
+}
+
+} // namespace
+
+int main() {
+  const auto root =
+      fs::temp_directory_path() / "megatoy_async_patch_loader_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  error.clear();
+  fs::create_directories(root, error);
+  CHECK(!error);
+
+  test_request_delivers_once(root);
+  test_failed_load_reports_no_patch(root);
+  test_newest_request_wins(root);
+  test_cancel_drops_the_result(root);
+  test_prefetched_neighbours_skip_the_load(root);
+  test_shutdown_ignores_later_requests(root);
+
+  fs::remove_all(root, error);
+  CHECK(!error);
+  std::cout << "async_patch_loader_test passed\n";
+  return 0;
+}
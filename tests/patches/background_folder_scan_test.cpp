@@ -7,11 +7,13 @@
 #include "ym2612/patch.hpp"
 
 #include "../test_check.hpp"
+#include <chrono>
 #include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <vector>
 
 namespace {
@@ -19,6 +21,9 @@ namespace {
 namespace fs = std::filesystem;
 namespace scan = patches::background_folder_scan;
 
+/// The scheduler gets this long to go idle before a test gives up on it.
+constexpr auto kPatience = std::chrono::seconds(5);
+
 ym2612::Patch sample_patch(std::string name) {
   ym2612::Patch patch;
   patch.name = std::move(name);
@@ -131,6 +136,105 @@ void test_cancel_stops_the_walk(const fs::path &root) {
   CHECK(!cache.dirty());
 }
 
+/// Poll the scheduler the way the UI does, once a frame, until it is idle;
+/// false if it never gets there.
+bool drain() {
+  const auto deadline = std::chrono::steady_clock::now() + kPatience;
+  while (scan::status().active) {
+    scan::poll_completion();
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+/// A folder of loose patches: quick to walk, and nothing to parse.
+fs::path make_loose_folder(const fs::path &root, const std::string &name) {
+  const auto folder = root / name;
+  std::error_code error;
+  fs::create_directories(folder, error);
+  CHECK(!error);
+  CHECK(patches::write_patch(sample_patch(name), folder / (name + ".gin")));
+  return folder;
+}
+
+void test_scheduler_runs_every_folder(const fs::path &root) {
+  patches::PersistentParseCache cache;
+  cache.load(root / "batch-cache.json");
+  scan::configure(&cache, 2);
+
+  std::vector<std::string> completed;
+  for (const auto *name : {"batch-a", "batch-b", "batch-c"}) {
+    const auto folder = make_loose_folder(root, name);
+    CHECK(scan::begin(folder, [&completed, name](bool cancelled) {
+      CHECK(!cancelled);
+      completed.push_back(name);
+    }));
+  }
+  // Queueing is never refused, except for a folder already in the queue.
+  CHECK(!scan::begin(root / "batch-b", [](bool) { CHECK(false); }));
+
+  const auto queued = scan::status();
+  CHECK(queued.active);
+  CHECK(queued.folders_total == 3);
+  CHECK(queued.folders_finished == 0);
+  CHECK(queued.folders.size() == 3);
+  CHECK(queued.folder_name == "batch-a");
+
+  CHECK(drain());
+  CHECK(completed.size() == 3);
+  CHECK(!scan::status().active);
+  scan::shutdown();
+}
+
+void test_priority_orders_the_queue(const fs::path &root) {
+  scan::configure(nullptr, 1);
+  std::vector<std::string> completed;
+  const auto queue = [&](const std::string &name, scan::Priority priority) {
+    CHECK(scan::begin(
+        make_loose_folder(root, name),
+        [&completed, name](bool) { completed.push_back(name); }, priority));
+  };
+  queue("order-first", scan::Priority::Normal);
+  queue("order-second", scan::Priority::Normal);
+  queue("order-visible", scan::Priority::Visible);
+  queue("order-raised", scan::Priority::Normal);
+  CHECK(scan::prioritize(root / "order-raised"));
+  CHECK(!scan::prioritize(root / "order-missing"));
+
+  // One worker, so folders finish in the order they start.
+  CHECK(drain());
+  const std::vector<std::string> expected = {"order-visible", "order-raised",
+                                             "order-first", "order-second"};
+  CHECK(completed == expected);
+  scan::shutdown();
+}
+
+void test_cancel_one_folder(const fs::path &root) {
+  scan::configure(nullptr, 1);
+  const auto kept = make_loose_folder(root, "cancel-kept");
+  const auto dropped = make_loose_folder(root, "cancel-dropped");
+  int kept_calls = 0;
+  int dropped_calls = 0;
+  CHECK(scan::begin(kept, [&](bool cancelled) {
+    CHECK(!cancelled);
+    ++kept_calls;
+  }));
+  CHECK(scan::begin(dropped, [&](bool cancelled) {
+    CHECK(cancelled);
+    ++dropped_calls;
+  }));
+  CHECK(scan::cancel(dropped));
+  CHECK(!scan::cancel(root / "cancel-missing"));
+
+  CHECK(drain());
+  CHECK(kept_calls == 1);
+  CHECK(dropped_calls == 1);
+  scan::shutdown();
+}
+
 } // namespace
 
 int main() {
@@ -145,6 +249,9 @@ int main() {
   test_warm_fills_cache(root);
   test_warm_then_scan_is_parse_free(root);
   test_cancel_stops_the_walk(root);
+  test_scheduler_runs_every_folder(root);
+  test_priority_orders_the_queue(root);
+  test_cancel_one_folder(root);
 
   fs::remove_all(root, error);
   CHECK(!error);
@@ -0,0 +1,189 @@
+// megatoy_convert's engine: which files a command line picks up, and what a
+// conversion run writes, skips and reports.
+
+#include "formats/ginpkg.hpp"
+#include "formats/patch_loader.hpp"
+#include "patches/bulk_convert.hpp"
+#include "patches/patch_write.hpp"
+#include "ym2612/patch.hpp"
+
+#include "../test_check.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+namespace bulk_convert = patches::bulk_convert;
+
+ym2612::Patch make_patch(const std::string &name, int algorithm) {
+  ym2612::Patch patch;
+  patch.name = name;
+  patch.instrument.algorithm = static_cast<std::uint8_t>(algorithm);
+  patch.instrument.operators[0].attack_rate = 20;
+  return patch;
+}
+
+void write_text(const fs::path &path, const std::string &text) {
+  std::ofstream output(path);
+  output << text;
+  CHECK(static_cast<bool>(output));
+}
+
+bool wrote(const bulk_convert::FileReport &report, const fs::path &target) {
+  return std::find(report.written.begin(), report.written.end(), target) !=
+         report.written.end();
+}
+
+void test_collect_inputs(const fs::path &in) {
+  std::vector<std::string> errors;
+  const auto walked = bulk_convert::collect_inputs({in.string()}, errors);
+  CHECK(errors.empty());
+  // notes.txt is not a patch format and is left out of directory walks.
+  CHECK(walked.size() == 4);
+  for (const auto &input : walked) {
+    const bool nested = input.source.parent_path().filename() == "sub";
+    CHECK(input.relative_dir == (nested ? fs::path("sub") : fs::path()));
+  }
+
+  const auto globbed =
+      bulk_convert::collect_inputs({(in / "*.gin").string()}, errors);
+  CHECK(errors.empty());
+  CHECK(globbed.size() == 2);
+  CHECK(globbed[0].source.filename() == "a.gin");
+  CHECK(globbed[1].source.filename() == "broken.gin");
+
+  const auto missing = bulk_convert::collect_inputs(
+      {(in / "missing.gin").string(), (in / "*.dmp").string()}, errors);
+  CHECK(missing.empty());
+  CHECK(errors.size() == 2);
+}
+
+void test_convert_with_dedup(const fs::path &in, const fs::path &out) {
+  std::vector<std::string> errors;
+  const auto inputs = bulk_convert::collect_inputs({in.string()}, errors);
+
+  bulk_convert::Options options;
+  options.target_extension = "GIN";
+  options.output_dir = out;
+  options.threads = 3;
+  options.deduplicate = true;
+
+  std::vector<fs::path> reported;
+  const auto summary = bulk_convert::convert(
+      inputs, options, [&](const bulk_convert::FileReport &report) {
+        reported.push_back(report.source);
+      });
+  CHECK(summary.files.size() == inputs.size());
+  CHECK(reported.size() == inputs.size());
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    CHECK(reported[i] == inputs[i].source);
+  }
+
+  // a.gin and sub/b.gin are one sound under two names: written once.
+  CHECK(summary.written == 2);
+  CHECK(summary.duplicates == 1);
+  CHECK(summary.failed_files == 1);
+  CHECK(fs::exists(out / "a.gin"));
+  CHECK(!fs::exists(out / "sub" / "b.gin"));
+  CHECK(fs::exists(out / "sub" / "c.gin"));
+  for (const auto &report : summary.files) {
+    CHECK(report.errors.empty() == (report.source.filename() != "broken.gin"));
+  }
+
+  const auto loaded = formats::load_patch_from_file(out / "sub" / "c.gin");
+  CHECK(loaded.status == formats::PatchLoadStatus::Success);
+  CHECK(loaded.patches.size() == 1);
+  CHECK(loaded.patches[0].instrument.algorithm == 4);
+
+  // A second run refuses to replace what the first wrote...
+  auto again = bulk_convert::convert(inputs, options);
+  CHECK(again.written == 0);
+  CHECK(again.failed_files == 3);
+
+  // ...unless asked to.
+  options.overwrite = true;
+  again = bulk_convert::convert(inputs, options);
+  CHECK(again.written == 2);
+  CHECK(again.failed_files == 1);
+}
+
+// Saving into an existing package would add a version; an overwrite
+// replaces the package instead.
+void test_overwrite_replaces_packages(const fs::path &root) {
+  fs::create_directories(root / "pkg_in");
+  const auto source = root / "pkg_in" / "pad.gin";
+  CHECK(patches::write_patch(make_patch("pad", 2), source));
+  std::vector<std::string> errors;
+  const auto inputs =
+      bulk_convert::collect_inputs({source.string()}, errors);
+  CHECK(inputs.size() == 1);
+
+  bulk_convert::Options options;
+  options.target_extension = "ginpkg";
+  options.output_dir = root / "pkg_out";
+  options.overwrite = true;
+  const auto target = root / "pkg_out" / "pad.ginpkg";
+  for (int run = 0; run < 2; ++run) {
+    CHECK(bulk_convert::convert(inputs, options).written == 1);
+    formats::ginpkg::GinPackage package;
+    CHECK(package.Load(target));
+    CHECK(package.history().empty());
+  }
+}
+
+void test_name_collisions(const fs::path &root) {
+  fs::create_directories(root / "x");
+  fs::create_directories(root / "y");
+  CHECK(patches::write_patch(make_patch("one", 1), root / "x" / "same.gin"));
+  CHECK(patches::write_patch(make_patch("two", 2), root / "y" / "same.gin"));
+
+  std::vector<std::string> errors;
+  const auto inputs = bulk_convert::collect_inputs(
+      {(root / "x" / "same.gin").string(), (root / "y" / "same.gin").string()},
+      errors);
+  CHECK(inputs.size() == 2);
+
+  bulk_convert::Options options;
+  options.target_extension = ".gin";
+  options.output_dir = root / "flat";
+  const auto summary = bulk_convert::convert(inputs, options);
+  CHECK(summary.written == 2);
+  CHECK(wrote(summary.files[0], root / "flat" / "same.gin"));
+  CHECK(wrote(summary.files[1], root / "flat" / "same (2).gin"));
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() / "megatoy_bulk_convert_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  const auto in = root / "in";
+  fs::create_directories(in / "sub");
+
+  CHECK(patches::write_patch(make_patch("lead", 3), in / "a.gin"));
+  CHECK(patches::write_patch(make_patch("lead copy", 3), in / "sub" / "b.gin"));
+  CHECK(patches::write_patch(make_patch("bass", 4), in / "sub" / "c.gin"));
+  write_text(in / "broken.gin", "not a patch");
+  write_text(in / "notes.txt", "not a patch either");
+
+  CHECK(bulk_convert::can_write("gin"));
+  CHECK(bulk_convert::can_write(".DMP"));
+  CHECK(bulk_convert::can_write("ginpkg"));
+  CHECK(!bulk_convert::can_write("vgm"));
+
+  test_collect_inputs(in);
+  test_convert_with_dedup(in, root / "out");
+  test_name_collisions(root);
+  test_overwrite_replaces_packages(root);
+
+  fs::remove_all(root, error);
+  std::cout << "bulk_convert_test passed\n";
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "../test_check.hpp"
+#include "patches/category_suggester.hpp"
+#include "patches/patch_lab.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using patches::CategorySample;
+
+/// `per_category` template patches of every category; every fifth keeps
+/// its category as a label, by display name when `by_label` is set.
+std::vector<CategorySample> library(int per_category, bool by_label,
+                                    std::vector<std::string> &truth) {
+  std::vector<CategorySample> samples;
+  int seed = 1;
+  for (const auto &choice : patch_lab::available_categories()) {
+    for (int i = 0; i < per_category; ++i) {
+      patch_lab::RandomOptions options;
+      options.mode = patch_lab::RandomOptions::Mode::Category;
+      options.category = choice.id;
+      options.seed = seed++;
+      const auto result = patch_lab::random_patch(options);
+      CategorySample sample;
+      sample.sound = result.patch.packed();
+      if (i % 5 == 0) {
+        sample.category = by_label ? choice.label : choice.id;
+      }
+      samples.push_back(sample);
+      truth.push_back(choice.id);
+    }
+  }
+  return samples;
+}
+
+void test_suggests_the_category_of_the_group() {
+  std::vector<std::string> truth;
+  const auto samples = library(100, false, truth);
+  const auto suggestions = patches::suggest_categories(samples, 4);
+
+  // Exactly the unlabelled ones, in order.
+  std::size_t unlabelled = 0;
+  for (const auto &sample : samples) {
+    unlabelled += sample.category.empty() ? 1 : 0;
+  }
+  CHECK(suggestions.size() == unlabelled);
+  std::size_t right = 0;
+  for (std::size_t s = 0; s < suggestions.size(); ++s) {
+    const auto &suggestion = suggestions[s];
+    CHECK(samples[suggestion.sample].category.empty());
+    CHECK(s == 0 || suggestion.sample > suggestions[s - 1].sample);
+    CHECK(suggestion.confidence > 0.0f && suggestion.confidence <= 1.0f);
+    right += suggestion.category == truth[suggestion.sample] ? 1 : 0;
+  }
+  CHECK(right * 10 >= suggestions.size() * 8);
+
+  // Workers change nothing about the answer.
+  const auto alone = patches::suggest_categories(samples, 1);
+  CHECK(alone.size() == suggestions.size());
+  for (std::size_t s = 0; s < alone.size(); ++s) {
+    CHECK(alone[s].sample == suggestions[s].sample);
+    CHECK(alone[s].category == suggestions[s].category);
+    CHECK(alone[s].confidence == suggestions[s].confidence);
+  }
+}
+
+void test_labels_by_display_name_vote_too() {
+  std::vector<std::string> truth;
+  const auto samples = library(60, true, truth);
+  std::size_t right = 0;
+  const auto suggestions = patches::suggest_categories(samples, 2);
+  for (const auto &suggestion : suggestions) {
+    right += suggestion.category == truth[suggestion.sample] ? 1 : 0;
+  }
+  CHECK(right * 10 >= suggestions.size() * 8);
+}
+
+void test_small_sets() {
+  CHECK(patches::suggest_categories({}, 4).empty());
+
+  // One patch, no labels: the template it fits best.
+  std::vector<std::string> truth;
+  auto samples = library(1, false, truth);
+  for (auto &sample : samples) {
+    sample.category.clear();
+  }
+  const auto one = patches::suggest_categories(
+      std::span<const CategorySample>(samples.data(), 1), 4);
+  CHECK(one.size() == 1);
+  CHECK(one[0].category == truth[0]);
+  CHECK(one[0].confidence == 1.0f);
+
+  // Identical patches, fewer distinct points than groups.
+  std::vector<CategorySample> copies(10, samples[0]);
+  copies[0].category = "something else";
+  const auto same = patches::suggest_categories(copies, 4);
+  CHECK(same.size() == 9);
+  for (const auto &suggestion : same) {
+    CHECK(suggestion.category == truth[0]);
+  }
+}
+
+} // namespace
+
+int main() {
+  test_suggests_the_category_of_the_group();
+  test_labels_by_display_name_vote_too();
+  test_small_sets();
+  std::cout << "category_suggester_test passed\n";
+  return 0;
+}
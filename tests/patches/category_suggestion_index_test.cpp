@@ -0,0 +1,134 @@
+#include "../test_check.hpp"
+#include "patches/category_suggestion_index.hpp"
+#include "patches/duplicate_finder.hpp"
+#include "patches/patch_lab.hpp"
+#include "patches/patch_repository.hpp"
+#include "patches/patch_write.hpp"
+#include "patches/sound_descriptor_index.hpp"
+#include "platform/std_file_system.hpp"
+#include "workspace/workspace.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using patches::CategorySuggestionIndex;
+
+/// Three template patches of each of the first two categories; the first
+/// of each keeps its category.
+void write_library(const fs::path &library, patches::PatchRepository &repo) {
+  fs::create_directories(library);
+  const auto &choices = patch_lab::available_categories();
+  int seed = 1;
+  for (std::size_t c = 0; c < 2; ++c) {
+    for (int i = 0; i < 3; ++i) {
+      patch_lab::RandomOptions options;
+      options.mode = patch_lab::RandomOptions::Mode::Category;
+      options.category = choices[c].id;
+      options.seed = seed++;
+      auto patch = patch_lab::random_patch(options).patch;
+      patch.name = choices[c].id + std::to_string(i);
+      CHECK(patches::write_patch(patch, library / (patch.name + ".gin")));
+    }
+  }
+  repo.refresh();
+  for (std::size_t c = 0; c < 2; ++c) {
+    patches::PatchMetadata metadata;
+    metadata.path = "library/" + choices[c].id + "0.gin";
+    metadata.category = choices[c].id;
+    CHECK(repo.update_patch_metadata(metadata.path, metadata));
+  }
+}
+
+template <typename Poll> void wait(Poll poll) {
+  for (int i = 0; i < 2000 && !poll(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+void test_job(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  megatoy::workspace::Workspace workspace;
+  fs::create_directories(root / "library");
+  CHECK(workspace.add(root / "library"));
+  patches::PatchRepository repository(file_system, workspace, {}, nullptr,
+                                      /*show_builtin_presets=*/false);
+  write_library(root / "library", repository);
+
+  patches::DuplicateFinder finder(file_system);
+  patches::SoundDescriptorIndex descriptors;
+  CategorySuggestionIndex suggestions;
+
+  // Nothing to group before the finder has read the library.
+  suggestions.update(repository, finder, descriptors);
+  CHECK(!suggestions.running());
+
+  finder.update(repository);
+  wait([&] { return finder.poll(); });
+  suggestions.update(repository, finder, descriptors);
+  wait([&] { return suggestions.poll(); });
+  CHECK(!suggestions.running());
+  CHECK(suggestions.generation() == 1);
+
+  // Only the patches without a category, most certain first.
+  const auto &published = suggestions.suggestions();
+  CHECK(published.size() == 4);
+  for (std::size_t i = 0; i < published.size(); ++i) {
+    CHECK(!published[i].relative_path.ends_with("0.gin"));
+    CHECK(!published[i].category.empty());
+    CHECK(published[i].confidence >= 0 && published[i].confidence <= 100);
+    if (i > 0) {
+      CHECK(published[i - 1].confidence >= published[i].confidence);
+    }
+  }
+
+  // Labelling a patch changes no file: the finder keeps its revision and
+  // nothing is grouped again.
+  patches::PatchMetadata metadata;
+  metadata.path = published.front().relative_path;
+  metadata.category = published.front().category;
+  const auto revision = repository.metadata_revision();
+  CHECK(repository.update_patch_metadata(metadata.path, metadata));
+  CHECK(repository.metadata_revision() != revision);
+  finder.update(repository);
+  finder.poll();
+  suggestions.update(repository, finder, descriptors);
+  CHECK(!suggestions.running());
+  CHECK(suggestions.generation() == 1);
+
+  // A new file does start a job; after shutdown, none starts.
+  suggestions.shutdown();
+  auto extra = patch_lab::random_patch().patch;
+  extra.name = "extra";
+  CHECK(patches::write_patch(extra, root / "library" / "extra.gin"));
+  repository.refresh();
+  const auto finder_revision = finder.revision();
+  finder.update(repository);
+  wait([&] { return finder.poll(); });
+  CHECK(finder.revision() != finder_revision);
+  suggestions.update(repository, finder, descriptors);
+  CHECK(!suggestions.running());
+  CHECK(suggestions.generation() == 1);
+}
+
+} // namespace
+
+int main() {
+  const auto root =
+      fs::temp_directory_path() / "megatoy_category_suggestion_index_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  fs::create_directories(root);
+
+  test_job(root);
+
+  fs::remove_all(root, error);
+  std::cout << "category_suggestion_index_test passed\n";
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "patches/decoded_container_cache.hpp"
+
+#include "../test_check.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace {
+
+using patches::DecodedContainer;
+using patches::DecodedContainerCache;
+
+const std::filesystem::file_time_type kModified{std::chrono::seconds(100)};
+
+std::shared_ptr<const DecodedContainer> make_bank(std::size_t instruments) {
+  auto bank = std::make_shared<DecodedContainer>();
+  for (std::size_t i = 0; i < instruments; ++i) {
+    ym2612::Patch patch;
+    patch.name = "inst " + std::to_string(i);
+    bank->instruments.push_back(patch);
+  }
+  return bank;
+}
+
+void test_hit_requires_matching_stamp() {
+  DecodedContainerCache cache;
+  const std::filesystem::path path = "/banks/a.opm";
+  const auto bank = make_bank(3);
+  cache.store(path, 10, kModified, bank);
+
+  CHECK(cache.lookup(path, 10, kModified) == bank);
+  CHECK(cache.lookup("/banks/b.opm", 10, kModified) == nullptr);
+
+  // A rewritten file misses, and the stale entry is dropped.
+  CHECK(cache.lookup(path, 11, kModified) == nullptr);
+  CHECK(cache.size() == 0);
+  cache.store(path, 10, kModified, bank);
+  CHECK(cache.lookup(path, 10, kModified + std::chrono::seconds(1)) ==
+        nullptr);
+  CHECK(cache.size() == 0);
+  CHECK(cache.approximate_bytes() == 0);
+}
+
+void test_evicts_least_recently_used() {
+  DecodedContainerCache cache(2, DecodedContainerCache::kDefaultMaxBytes);
+  cache.store("/a", 1, kModified, make_bank(1));
+  cache.store("/b", 1, kModified, make_bank(1));
+  // Touching /a leaves /b as the eviction candidate.
+  CHECK(cache.lookup("/a", 1, kModified) != nullptr);
+  cache.store("/c", 1, kModified, make_bank(1));
+
+  CHECK(cache.size() == 2);
+  CHECK(cache.lookup("/a", 1, kModified) != nullptr);
+  CHECK(cache.lookup("/b", 1, kModified) == nullptr);
+  CHECK(cache.lookup("/c", 1, kModified) != nullptr);
+}
+
+void test_byte_budget() {
+  const auto small = make_bank(1);
+  DecodedContainerCache probe;
+  probe.store("/probe", 1, kModified, small);
+  const std::size_t one = probe.approximate_bytes();
+  CHECK(one > 0);
+
+  // Room for two small banks but not three.
+  DecodedContainerCache cache(16, one * 2 + one / 2);
+  cache.store("/a", 1, kModified, make_bank(1));
+  cache.store("/b", 1, kModified, make_bank(1));
+  cache.store("/c", 1, kModified, make_bank(1));
+  CHECK(cache.size() == 2);
+  CHECK(cache.approximate_bytes() <= one * 2 + one / 2);
+  CHECK(cache.lookup("/a", 1, kModified) == nullptr);
+
+  // A container larger than the whole budget is not cached at all.
+  cache.store("/huge", 1, kModified, make_bank(64));
+  CHECK(cache.lookup("/huge", 1, kModified) == nullptr);
+  CHECK(cache.size() == 2);
+}
+
+void test_restore_replaces_and_clear_empties() {
+  DecodedContainerCache cache;
+  const auto first = make_bank(1);
+  const auto second = make_bank(2);
+  cache.store("/a", 1, kModified, first);
+  cache.store("/a", 2, kModified, second);
+  CHECK(cache.size() == 1);
+  CHECK(cache.lookup("/a", 2, kModified) == second);
+
+  cache.clear();
+  CHECK(cache.size() == 0);
+  CHECK(cache.approximate_bytes() == 0);
+  CHECK(cache.lookup("/a", 2, kModified) == nullptr);
+}
+
+} // namespace
+
+int main() {
+  test_hit_requires_matching_stamp();
+  test_evicts_least_recently_used();
+  test_byte_budget();
+  test_restore_replaces_and_clear_empties();
+
+  std::cout << "All decoded container cache tests passed\n";
+  return 0;
+}
@@ -0,0 +1,228 @@
+#include "../test_check.hpp"
+#include "patches/duplicate_finder.hpp"
+#include "patches/patch_index.hpp"
+#include "patches/patch_repository.hpp"
+#include "patches/patch_write.hpp"
+#include "platform/std_file_system.hpp"
+#include "workspace/workspace.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using patches::DuplicateFinder;
+
+ym2612::Patch make_patch(int seed) {
+  ym2612::Patch patch;
+  patch.instrument.algorithm = static_cast<std::uint8_t>(seed % 8);
+  patch.instrument.feedback = static_cast<std::uint8_t>(seed % 7);
+  for (int i = 0; i < 4; ++i) {
+    auto &op = patch.instrument.operators[i];
+    op.total_level = static_cast<std::uint8_t>((seed * 17 + i * 5) % 100);
+    op.attack_rate = static_cast<std::uint8_t>((seed + i) % 32);
+    op.multiple = static_cast<std::uint8_t>((seed * 3 + i) % 16);
+  }
+  return patch;
+}
+
+std::optional<ym2612::PackedPatch> sound(const ym2612::Patch &patch) {
+  return patch.packed();
+}
+
+void test_distance() {
+  const auto base = make_patch(1);
+  CHECK(DuplicateFinder::distance(base.packed(), base.packed()) == 0);
+
+  auto quieter = base;
+  quieter.instrument.operators[3].total_level += 2;
+  quieter.instrument.operators[0].attack_rate -= 1;
+  CHECK(DuplicateFinder::distance(base.packed(), quieter.packed()) == 3);
+
+  // DT1 is sign and magnitude: one step down from 0 is register value 5,
+  // and still one step.
+  auto detuned = base;
+  detuned.instrument.operators[0].detune = 0;
+  auto down = detuned;
+  down.instrument.operators[0].detune = 5;
+  CHECK(DuplicateFinder::distance(detuned.packed(), down.packed()) == 1);
+  auto up = detuned;
+  up.instrument.operators[0].detune = 1;
+  CHECK(DuplicateFinder::distance(up.packed(), down.packed()) == 2);
+  const std::vector<std::optional<ym2612::PackedPatch>> detunes = {
+      sound(detuned), sound(down)};
+  CHECK(DuplicateFinder::group(detunes, DuplicateFinder::kDefaultTolerance)
+            .size() == 1);
+
+  // Settings that change the character of the sound are never "near".
+  auto other_algorithm = base;
+  other_algorithm.instrument.algorithm ^= 1;
+  CHECK(!DuplicateFinder::distance(base.packed(), other_algorithm.packed()));
+  auto other_multiple = base;
+  other_multiple.instrument.operators[2].multiple ^= 1;
+  CHECK(!DuplicateFinder::distance(base.packed(), other_multiple.packed()));
+  auto muted = base;
+  muted.instrument.operators[1].enable = false;
+  CHECK(!DuplicateFinder::distance(base.packed(), muted.packed()));
+}
+
+void test_grouping() {
+  const auto a = make_patch(1);
+  auto a_renamed = a;
+  a_renamed.name = "another name";
+  auto a_near = a;
+  a_near.instrument.operators[1].total_level += 2;
+  auto a_nearer_still = a_near;
+  a_nearer_still.instrument.operators[2].total_level += 3;
+  const auto b = make_patch(2);
+  const auto c = make_patch(3);
+
+  const std::vector<std::optional<ym2612::PackedPatch>> sounds = {
+      sound(a),         sound(b),         std::nullopt, sound(a_renamed),
+      sound(a_near),    sound(c),         sound(b),     std::nullopt,
+      sound(a_nearer_still)};
+
+  // Exact only: the two copies of a and the two of b.
+  auto groups = DuplicateFinder::group(sounds, 0);
+  CHECK(groups.size() == 2);
+  CHECK((groups[0] == std::vector<std::size_t>{0, 3}));
+  CHECK((groups[1] == std::vector<std::size_t>{1, 6}));
+
+  // With a tolerance, a_near joins a, and a_nearer_still joins through it
+  // although it is 5 steps from a itself.
+  groups = DuplicateFinder::group(sounds, 3);
+  CHECK(groups.size() == 2);
+  CHECK((groups[0] == std::vector<std::size_t>{0, 3, 4, 8}));
+  CHECK((groups[1] == std::vector<std::size_t>{1, 6}));
+
+  CHECK(DuplicateFinder::group(sounds, 1).front().size() == 2);
+  CHECK(DuplicateFinder::group({}, 3).empty());
+}
+
+/// Runs the finder's job to completion.
+void find(DuplicateFinder &finder, const patches::PatchRepository &repository) {
+  finder.update(repository);
+  for (int i = 0; i < 2000 && !finder.poll(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  CHECK(!finder.running());
+  CHECK(finder.revision() == repository.revision());
+}
+
+void write(const fs::path &path, ym2612::Patch patch) {
+  patch.name = path.stem().string();
+  CHECK(patches::write_patch(patch, path));
+}
+
+void test_repository_job(const fs::path &root) {
+  const auto library = root / "library";
+  fs::create_directories(library / "more");
+  write(library / "lead.gin", make_patch(4));
+  write(library / "more" / "lead copy.gin", make_patch(4));
+  auto near = make_patch(4);
+  near.instrument.operators[0].release_rate ^= 1;
+  write(library / "more" / "lead take 2.gin", near);
+  write(library / "bass.gin", make_patch(5));
+
+  platform::StdFileSystem file_system;
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(library));
+  patches::PatchRepository repository(file_system, workspace, {}, nullptr,
+                                      /*show_builtin_presets=*/false);
+  DuplicateFinder finder(file_system);
+  CHECK(!finder.revision());
+  find(finder, repository);
+
+  CHECK(finder.groups().size() == 1);
+  const auto &group = finder.groups().front();
+  CHECK((group.paths == std::vector<std::string>{
+                            "library/lead.gin", "library/more/lead copy.gin",
+                            "library/more/lead take 2.gin"}));
+  CHECK(!group.exact);
+  CHECK(group.sounds[1] == group.sounds[0]);
+
+  // The same job indexed every patch for similar searches.
+  const auto lead = finder.sound("library/lead.gin");
+  CHECK(lead.has_value());
+  CHECK(!finder.sound("library/missing.gin"));
+  const auto similar = finder.similar(*lead, 10, "library/lead.gin");
+  CHECK(similar.size() == 3);
+  CHECK(similar[0].path == "library/more/lead copy.gin");
+  CHECK(similar[0].distance == 0.0f);
+  CHECK(similar[1].path == "library/more/lead take 2.gin");
+  CHECK(similar[2].path == "library/bass.gin");
+  CHECK(finder.similar(*lead, 1).size() == 1);
+
+  // Nothing new, nothing to do.
+  finder.update(repository);
+  CHECK(!finder.running());
+
+  // Hiding the copies touches no patch file and leaves revision() alone, so
+  // the finder has nothing to do. To show that nothing is read, the copy is
+  // first rewritten as another sound of the same size, and its time put
+  // back.
+  const auto copy = library / "more" / "lead copy.gin";
+  const auto modified = fs::last_write_time(copy);
+  const auto size = fs::file_size(copy);
+  auto replacement = make_patch(4);
+  replacement.instrument.operators[3].multiple ^= 1;
+  write(copy, replacement);
+  CHECK(fs::file_size(copy) == size);
+  fs::last_write_time(copy, modified);
+
+  std::vector<std::pair<std::string, patches::PatchMetadata>> updates;
+  for (std::size_t k = 1; k < group.paths.size(); ++k) {
+    patches::PatchMetadata metadata;
+    metadata.path = group.paths[k];
+    metadata.hidden = true;
+    updates.emplace_back(group.paths[k], metadata);
+  }
+  const auto revision = repository.revision();
+  const auto metadata_revision = repository.metadata_revision();
+  CHECK(repository.update_patch_metadata(updates) == 2);
+  CHECK(repository.revision() == revision);
+  CHECK(repository.metadata_revision() > metadata_revision);
+  const auto &index = repository.index();
+  CHECK(index.hidden(*index.find("library/more/lead copy.gin")));
+  CHECK(!index.hidden(*index.find("library/lead.gin")));
+
+  finder.update(repository);
+  CHECK(!finder.running());
+  CHECK(finder.revision() == repository.revision());
+  CHECK(finder.groups().size() == 1);
+  CHECK(finder.groups().front().paths.size() == 3);
+
+  // Once the time moves, the file is read again and the copy is no longer
+  // one.
+  fs::last_write_time(copy, modified + std::chrono::seconds(5));
+  repository.refresh();
+  find(finder, repository);
+  CHECK(finder.groups().size() == 1);
+  CHECK((finder.groups().front().paths ==
+         std::vector<std::string>{"library/lead.gin",
+                                  "library/more/lead take 2.gin"}));
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() / "megatoy_duplicate_finder_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  fs::create_directories(root);
+
+  test_distance();
+  test_grouping();
+  test_repository_job(root);
+
+  fs::remove_all(root, error);
+  std::cout << "duplicate_finder_test passed\n";
+  return 0;
+}
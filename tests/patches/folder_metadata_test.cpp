@@ -4,6 +4,8 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
 
 namespace fs = std::filesystem;
 
@@ -39,6 +41,152 @@ void test_bare_ginpkg_metadata_gains_latest_twin(const fs::path &root) {
   CHECK(reloaded.get("banks/Favorites.GINPKG/latest").has_value());
 }
 
+std::size_t line_count(const fs::path &path) {
+  std::ifstream file(path);
+  std::size_t lines = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    ++lines;
+  }
+  return lines;
+}
+
+nlohmann::json read_json(const fs::path &path) {
+  std::ifstream file(path);
+  return nlohmann::json::parse(file);
+}
+
+patches::PatchMetadata rated(const std::string &path, int stars) {
+  patches::PatchMetadata metadata;
+  metadata.path = path;
+  metadata.star_rating = stars;
+  return metadata;
+}
+
+void test_edits_go_to_the_journal(const fs::path &root) {
+  const auto folder = root / "journal";
+  const auto sidecar = folder / ".megatoy" / "patches.json";
+  const auto journal = folder / ".megatoy" / "patches.journal";
+  {
+    patches::FolderMetadataStore store(sidecar);
+    CHECK(store.load());
+    for (int i = 0; i < 3; ++i) {
+      CHECK(store.put(rated("lead" + std::to_string(i) + ".gin", i + 1)));
+    }
+    CHECK(store.remove("lead0.gin"));
+    CHECK(store.flush());
+    // Four edits, four appended lines, and no sidecar rewrite.
+    CHECK(line_count(journal) == 4);
+    CHECK(!fs::exists(sidecar));
+
+    // A second store on the same folder sees the edits before they are
+    // compacted, including ones still queued.
+    CHECK(store.put(rated("queued.gin", 5)));
+    patches::FolderMetadataStore other(sidecar);
+    CHECK(other.load());
+    CHECK(!other.get("lead0.gin").has_value());
+    CHECK(other.get("lead2.gin")->star_rating == 3);
+    CHECK(other.get("queued.gin")->star_rating == 5);
+  }
+
+  // Closing the last store folds the journal into a sidecar that releases
+  // without journal support read as before.
+  CHECK(!fs::exists(journal));
+  const auto json = read_json(sidecar);
+  CHECK(json.at("version").get<int>() == 1);
+  CHECK(json.at("patches").size() == 3);
+  CHECK(json.at("patches").at("lead1.gin").at("star_rating").get<int>() == 2);
+}
+
+void test_replay_after_a_crash(const fs::path &root) {
+  const auto folder = root / "crash";
+  const auto sidecar = folder / ".megatoy" / "patches.json";
+  const auto journal = folder / ".megatoy" / "patches.journal";
+  fs::create_directories(sidecar.parent_path());
+  {
+    std::ofstream file(sidecar);
+    file << R"({
+  "version": 1,
+  "journal_sequence": 2,
+  "patches": {
+    "bass.gin": { "star_rating": 2 },
+    "old/pad.gin": { "star_rating": 4 }
+  }
+})";
+  }
+  {
+    // The app died after compacting up to line 2 but before deleting the
+    // journal, then wrote two more lines and part of a third.
+    std::ofstream file(journal);
+    file << R"({"seq":1,"op":"remove","paths":["bass.gin"]})" << "\n"
+         << R"({"seq":2,"op":"rename","from":"pad","to":"old"})" << "\n"
+         << R"({"seq":3,"op":"rename","from":"old","to":"new"})" << "\n"
+         << R"({"seq":4,"op":"put","path":"lead.gin","metadata":)"
+         << R"({"star_rating":5}})" << "\n"
+         << R"({"seq":5,"op":"put","path":"lost.gin","meta)";
+  }
+
+  {
+    patches::FolderMetadataStore store(sidecar);
+    CHECK(store.load());
+    CHECK(store.get("bass.gin")->star_rating == 2);
+    CHECK(!store.get("old/pad.gin").has_value());
+    CHECK(store.get("new/pad.gin")->star_rating == 4);
+    CHECK(store.get("lead.gin")->star_rating == 5);
+    CHECK(!store.get("lost.gin").has_value());
+    // The torn line is gone, so nothing written later hides behind it.
+    CHECK(!fs::exists(journal));
+
+    CHECK(store.put(rated("after.gin", 1)));
+  }
+
+  patches::FolderMetadataStore reopened(sidecar);
+  CHECK(reopened.load());
+  CHECK(reopened.get("after.gin")->star_rating == 1);
+  CHECK(reopened.get("new/pad.gin")->star_rating == 4);
+  CHECK(read_json(sidecar).at("journal_sequence").get<int>() == 5);
+}
+
+void test_compaction_keeps_later_edits(const fs::path &root) {
+  const auto sidecar = root / "compact" / ".megatoy" / "patches.json";
+  const auto journal = sidecar.parent_path() / "patches.journal";
+  patches::FolderMetadataStore store(sidecar);
+  CHECK(store.load());
+  CHECK(store.put(rated("a.gin", 1)));
+  CHECK(store.compact());
+  CHECK(!fs::exists(journal));
+  CHECK(read_json(sidecar).at("patches").contains("a.gin"));
+
+  CHECK(store.rename_key_prefix("a.gin", "b.gin"));
+  CHECK(store.flush());
+  CHECK(line_count(journal) == 1);
+
+  patches::FolderMetadataStore other(sidecar);
+  CHECK(other.load());
+  CHECK(!other.get("a.gin").has_value());
+  CHECK(other.get("b.gin")->star_rating == 1);
+}
+
+void test_hidden_is_kept_only_when_set(const fs::path &root) {
+  const auto sidecar = root / "hidden" / ".megatoy" / "patches.json";
+  {
+    patches::FolderMetadataStore store(sidecar);
+    CHECK(store.load());
+    auto copy = rated("copy.gin", 0);
+    copy.hidden = true;
+    CHECK(store.put(copy));
+    CHECK(store.put(rated("original.gin", 3)));
+  }
+
+  const auto json = read_json(sidecar);
+  CHECK(json.at("patches").at("copy.gin").at("hidden").get<bool>());
+  CHECK(!json.at("patches").at("original.gin").contains("hidden"));
+  patches::FolderMetadataStore reopened(sidecar);
+  CHECK(reopened.load());
+  CHECK(reopened.get("copy.gin")->hidden);
+  CHECK(!reopened.get("original.gin")->hidden);
+}
+
 } // namespace
 
 int main() {
@@ -47,6 +195,10 @@ int main() {
   fs::create_directories(root);
 
   test_bare_ginpkg_metadata_gains_latest_twin(root);
+  test_edits_go_to_the_journal(root);
+  test_replay_after_a_crash(root);
+  test_compaction_keeps_later_edits(root);
+  test_hidden_is_kept_only_when_set(root);
 
   fs::remove_all(root);
   std::cout << "All folder metadata tests passed\n";
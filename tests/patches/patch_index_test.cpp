@@ -0,0 +1,282 @@
+#include "patches/patch_index.hpp"
+
+#include "../test_check.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using patches::PatchIndex;
+
+patches::PatchEntry make_file(const std::string &name,
+                              const std::string &relative_path) {
+  patches::PatchEntry entry;
+  entry.name = name;
+  entry.relative_path = relative_path;
+  entry.full_path = "/workspace/" + relative_path;
+  entry.format = "dmp";
+  entry.is_directory = false;
+  return entry;
+}
+
+patches::PatchEntry make_directory(const std::string &name,
+                                   const std::string &relative_path,
+                                   std::vector<patches::PatchEntry> children) {
+  patches::PatchEntry entry;
+  entry.name = name;
+  entry.relative_path = relative_path;
+  entry.full_path = "/workspace/" + relative_path;
+  entry.is_directory = true;
+  entry.children = std::move(children);
+  return entry;
+}
+
+/**
+ * root/
+ *   Lead.dmp            4 stars, "Lead", tags {bright, mono}
+ *   bank.opm/           two instruments sharing the container path
+ */
+std::vector<patches::PatchEntry> make_tree() {
+  auto lead = make_file("Lead.dmp", "root/Lead.dmp");
+  patches::PatchMetadata metadata;
+  metadata.star_rating = 4;
+  metadata.category = "Lead";
+  metadata.tags = {"bright", "mono"};
+  lead.metadata = metadata;
+
+  std::vector<patches::PatchEntry> instruments;
+  for (int i = 0; i < 2; ++i) {
+    auto instrument = make_file("Inst " + std::to_string(i),
+                                "root/bank.opm/" + std::to_string(i) + "_i");
+    instrument.full_path = "/workspace/root/bank.opm";
+    instrument.format = "opm";
+    instrument.instrument_index = static_cast<std::size_t>(i);
+    instruments.push_back(std::move(instrument));
+  }
+
+  std::vector<patches::PatchEntry> children;
+  children.push_back(std::move(lead));
+  children.push_back(
+      make_directory("bank.opm", "root/bank.opm", std::move(instruments)));
+
+  std::vector<patches::PatchEntry> tree;
+  tree.push_back(make_directory("root", "root", std::move(children)));
+  return tree;
+}
+
+std::vector<PatchIndex::NodeId> collect(PatchIndex::ChildRange range) {
+  std::vector<PatchIndex::NodeId> nodes;
+  for (const auto node : range) {
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+void test_structure_mirrors_the_tree() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+
+  CHECK(index.node_count() == 5);
+  CHECK(index.patch_count() == 3);
+
+  const auto roots = collect(index.roots());
+  CHECK(roots.size() == 1);
+  CHECK(index.name(roots[0]) == "root");
+  CHECK(index.is_directory(roots[0]));
+  CHECK(index.parent(roots[0]) == PatchIndex::kNoNode);
+  CHECK(index.patch_id(roots[0]) == PatchIndex::kNoPatch);
+  CHECK(index.child_count(roots[0]) == 2);
+
+  const auto children = collect(index.children(roots[0]));
+  CHECK(children.size() == 2);
+  CHECK(index.name(children[0]) == "Lead.dmp");
+  CHECK(index.parent(children[0]) == roots[0]);
+  CHECK(index.entry(children[0]).relative_path ==
+        tree[0].children[0].relative_path);
+
+  const auto instruments = collect(index.children(children[1]));
+  CHECK(instruments.size() == 2);
+  CHECK(index.format(instruments[1]) == "opm");
+  CHECK(index.entry(instruments[1]).instrument_index == 1);
+  CHECK(collect(index.children(instruments[0])).empty());
+}
+
+void test_patches_are_dense_and_in_tree_order() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+
+  const auto patches = index.patches();
+  CHECK(patches.size() == 3);
+  for (std::size_t i = 0; i < patches.size(); ++i) {
+    CHECK(index.patch_id(patches[i]) == i);
+    CHECK(!index.is_directory(patches[i]));
+  }
+  CHECK(index.name(patches[0]) == "Lead.dmp");
+  CHECK(index.name(patches[2]) == "Inst 1");
+}
+
+void test_paths_are_rebuilt_from_shared_prefixes() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+
+  const auto &bank = tree[0].children[1].children;
+  const std::vector<std::string> expected = {
+      tree[0].children[0].relative_path, bank[0].relative_path,
+      bank[1].relative_path};
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    CHECK(index.relative_path(index.patches()[i]) == expected[i]);
+  }
+
+  // Both instruments point at one interned copy of the container path.
+  const auto instruments = index.patches().subspan(1);
+  CHECK(index.full_path(instruments[0]) == "/workspace/root/bank.opm");
+  CHECK(index.full_path(instruments[0]).data() ==
+        index.full_path(instruments[1]).data());
+}
+
+void test_find_resolves_relative_paths() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+
+  const auto bank = index.find("root/bank.opm");
+  CHECK(bank.has_value());
+  CHECK(index.name(*bank) == "bank.opm");
+
+  const auto instrument = index.find("root/bank.opm/1_i");
+  CHECK(instrument.has_value());
+  CHECK(index.name(*instrument) == "Inst 1");
+
+  CHECK(!index.find("root/bank").has_value());
+  CHECK(!index.find("root/missing.dmp").has_value());
+  CHECK(!index.find("").has_value());
+}
+
+void test_metadata_is_reachable_by_handle() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+
+  const auto lead = index.patches()[0];
+  CHECK(index.has_metadata(lead));
+  CHECK(index.star_rating(lead) == 4);
+  CHECK(index.category(lead) == "Lead");
+  CHECK(index.folded_category(lead) == "lead");
+  CHECK(index.folded_name(lead) == "lead.dmp");
+  const auto tags = index.tags(lead);
+  CHECK(tags.size() == 2);
+  CHECK(index.string(tags[0]) == "bright");
+  CHECK(index.string(tags[1]) == "mono");
+
+  const auto bare = index.patches()[1];
+  CHECK(!index.has_metadata(bare));
+  CHECK(index.star_rating(bare) == 0);
+  CHECK(index.category(bare).empty());
+  CHECK(index.tags(bare).empty());
+}
+
+// The tree is dropped once indexed, so what the load and edit paths need
+// must come back out of the index intact.
+void test_entries_come_back_out_of_the_index() {
+  auto tree = make_tree();
+  tree[0].children[0].metadata->notes = "warm";
+  tree[0].children[1].children[1].source_relative_path = "root/bank.opm";
+  tree[0].children[1].children[1].container_item_id = "i1";
+  const auto index = PatchIndex::build(tree);
+
+  const auto lead = index.entry(index.patches()[0]);
+  CHECK(lead.name == "Lead.dmp");
+  CHECK(lead.full_path == "/workspace/root/Lead.dmp");
+  CHECK(lead.format == "dmp");
+  CHECK(lead.children.empty());
+  CHECK(lead.metadata.has_value());
+  CHECK(lead.metadata->path == "root/Lead.dmp");
+  CHECK(lead.metadata->star_rating == 4);
+  CHECK(lead.metadata->category == "Lead");
+  CHECK(lead.metadata->notes == "warm");
+  CHECK((lead.metadata->tags == std::vector<std::string>{"bright", "mono"}));
+
+  const auto instrument = index.entry(index.patches()[2]);
+  CHECK(instrument.source_relative_path == "root/bank.opm");
+  CHECK(instrument.container_item_id == "i1");
+  CHECK(instrument.instrument_index == 1);
+  CHECK(!instrument.metadata.has_value());
+
+  const auto rebuilt = index.to_tree();
+  CHECK(rebuilt.size() == 1);
+  CHECK(rebuilt[0].children.size() == 2);
+  CHECK(rebuilt[0].children[1].children.size() == 2);
+  CHECK(rebuilt[0].children[1].children[1].relative_path ==
+        "root/bank.opm/1_i");
+  CHECK(PatchIndex::build(rebuilt).same_listing(index));
+
+  auto retagged = tree;
+  retagged[0].children[0].metadata->tags.pop_back();
+  CHECK(!PatchIndex::build(retagged).same_listing(index));
+  auto renamed = tree;
+  renamed[0].children[1].children[0].name = "Inst 9";
+  CHECK(!PatchIndex::build(renamed).same_listing(index));
+}
+
+void test_metadata_is_replaced_in_place() {
+  const auto tree = make_tree();
+  auto index = PatchIndex::build(tree);
+  const auto lead = index.patches()[0];
+  const auto bare = index.patches()[1];
+
+  patches::PatchMetadata metadata;
+  metadata.star_rating = 2;
+  metadata.category = "Bass";
+  metadata.tags = {"mono"};
+  index.set_metadata(lead, metadata);
+  CHECK(index.star_rating(lead) == 2);
+  CHECK(index.folded_category(lead) == "bass");
+  CHECK(index.tags(lead).size() == 1);
+  CHECK(index.string(index.tags(lead)[0]) == "mono");
+
+  metadata.tags = {"dark", "wide", "soft"};
+  index.set_metadata(bare, metadata);
+  CHECK(index.has_metadata(bare));
+  CHECK(index.category(bare) == "Bass");
+  CHECK(index.tags(bare).size() == 3);
+  CHECK(index.string(index.tags(bare)[2]) == "soft");
+  // The other patches keep their records and ids.
+  CHECK(index.tags(lead).size() == 1);
+  CHECK(index.patch_id(bare) == 1);
+  CHECK(index.name(bare) == "Inst 0");
+
+  index.set_metadata(lead, std::nullopt);
+  CHECK(!index.has_metadata(lead));
+  CHECK(index.star_rating(lead) == 0);
+}
+
+void test_moved_index_keeps_its_strings() {
+  const auto tree = make_tree();
+  PatchIndex index;
+  CHECK(index.empty());
+  index = PatchIndex::build(tree);
+  CHECK(!index.empty());
+  CHECK(index.name(index.patches()[0]) == "Lead.dmp");
+  CHECK(index.arena_bytes() > 0);
+
+  const std::vector<patches::PatchEntry> nothing;
+  index = PatchIndex::build(nothing);
+  CHECK(index.empty());
+  CHECK(index.roots().empty());
+  CHECK(index.patches().empty());
+}
+
+} // namespace
+
+int main() {
+  test_structure_mirrors_the_tree();
+  test_patches_are_dense_and_in_tree_order();
+  test_paths_are_rebuilt_from_shared_prefixes();
+  test_find_resolves_relative_paths();
+  test_metadata_is_reachable_by_handle();
+  test_entries_come_back_out_of_the_index();
+  test_metadata_is_replaced_in_place();
+  test_moved_index_keeps_its_strings();
+
+  std::cout << "All patch index tests passed\n";
+  return 0;
+}
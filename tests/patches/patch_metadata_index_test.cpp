@@ -0,0 +1,149 @@
+#include "patches/patch_metadata_index.hpp"
+
+#include "../test_check.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using patches::PatchIndex;
+using patches::PatchMetadataIndex;
+
+patches::PatchEntry make_file(const std::string &relative_path, int stars,
+                              const std::string &category,
+                              std::vector<std::string> tags = {}) {
+  patches::PatchEntry entry;
+  entry.name = relative_path;
+  entry.relative_path = relative_path;
+  entry.format = "dmp";
+  entry.is_directory = false;
+  patches::PatchMetadata metadata;
+  metadata.path = relative_path;
+  metadata.star_rating = stars;
+  metadata.category = category;
+  metadata.tags = std::move(tags);
+  entry.metadata = metadata;
+  return entry;
+}
+
+/**
+ * 0 a.dmp  5 stars "Bass"  lead, warm
+ * 1 b.dmp  3 stars "bass"  lead
+ * 2 c.dmp  4 stars "pad"   warm
+ * 3 d.dmp  no metadata
+ */
+std::vector<patches::PatchEntry> make_tree() {
+  std::vector<patches::PatchEntry> tree;
+  tree.push_back(make_file("a.dmp", 5, "Bass", {"lead", "Warm"}));
+  tree.push_back(make_file("b.dmp", 3, "bass", {"lead"}));
+  tree.push_back(make_file("c.dmp", 4, "pad", {"warm"}));
+  patches::PatchEntry plain;
+  plain.name = "d.dmp";
+  plain.relative_path = "d.dmp";
+  plain.format = "dmp";
+  plain.is_directory = false;
+  tree.push_back(plain);
+  return tree;
+}
+
+std::vector<PatchIndex::PatchId> members(const PatchMetadataIndex::Bits &bits) {
+  std::vector<PatchIndex::PatchId> patches;
+  for (PatchIndex::PatchId patch = 0; patch < bits.size(); ++patch) {
+    if (bits.test(patch)) {
+      patches.push_back(patch);
+    }
+  }
+  return patches;
+}
+
+using Ids = std::vector<PatchIndex::PatchId>;
+
+void test_filters_combine() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  const auto metadata = PatchMetadataIndex::build(index);
+  CHECK(metadata.size() == 4);
+
+  PatchMetadataIndex::Filter filter;
+  CHECK(filter.empty());
+  CHECK(members(metadata.select(filter)) == Ids({0, 1, 2, 3}));
+
+  filter.min_stars = 4;
+  CHECK(members(metadata.select(filter)) == Ids({0, 2}));
+
+  // Categories and tags match case-folded.
+  filter.category = "bass";
+  CHECK(members(metadata.select(filter)) == Ids({0}));
+  filter.min_stars = 0;
+  CHECK(members(metadata.select(filter)) == Ids({0, 1}));
+
+  filter.category.clear();
+  filter.tags = {"warm"};
+  CHECK(members(metadata.select(filter)) == Ids({0, 2}));
+  filter.tags = {"warm", "lead"};
+  CHECK(members(metadata.select(filter)) == Ids({0}));
+
+  // A value nobody uses matches nothing.
+  filter.tags = {"bright"};
+  CHECK(metadata.select(filter).count() == 0);
+  filter.tags.clear();
+  filter.category = "strings";
+  CHECK(metadata.select(filter).count() == 0);
+}
+
+void test_bits_past_64_patches() {
+  std::vector<patches::PatchEntry> tree;
+  for (int i = 0; i < 130; ++i) {
+    tree.push_back(make_file("p" + std::to_string(i) + ".dmp", i % 2 ? 5 : 0,
+                             ""));
+  }
+  const auto index = PatchIndex::build(tree);
+  const auto metadata = PatchMetadataIndex::build(index);
+  CHECK(metadata.select({}).count() == 130);
+  PatchMetadataIndex::Filter filter;
+  filter.min_stars = 1;
+  CHECK(metadata.select(filter).count() == 65);
+}
+
+void test_update_moves_one_patch() {
+  auto tree = make_tree();
+  auto index = PatchIndex::build(tree);
+  auto metadata = PatchMetadataIndex::build(index);
+
+  // b.dmp loses its category and tag and gains stars.
+  tree[1].metadata->star_rating = 5;
+  tree[1].metadata->category = "pad";
+  tree[1].metadata->tags.clear();
+  index = PatchIndex::build(tree);
+  const auto node = index.find("b.dmp");
+  CHECK(node.has_value());
+  metadata.update(index, *node);
+
+  PatchMetadataIndex::Filter filter;
+  filter.min_stars = 5;
+  CHECK(members(metadata.select(filter)) == Ids({0, 1}));
+  filter.min_stars = 0;
+  filter.category = "pad";
+  CHECK(members(metadata.select(filter)) == Ids({1, 2}));
+  filter.category = "bass";
+  CHECK(members(metadata.select(filter)) == Ids({0}));
+  filter.category.clear();
+  filter.tags = {"lead"};
+  CHECK(members(metadata.select(filter)) == Ids({0}));
+
+  // The result is what a fresh build gives.
+  const auto rebuilt = PatchMetadataIndex::build(index);
+  CHECK(members(rebuilt.select(filter)) == members(metadata.select(filter)));
+}
+
+} // namespace
+
+int main() {
+  test_filters_combine();
+  test_bits_past_64_patches();
+  test_update_moves_one_patch();
+
+  std::cout << "patch_metadata_index_test passed\n";
+  return 0;
+}
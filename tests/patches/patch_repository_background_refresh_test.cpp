@@ -0,0 +1,298 @@
+#include "../test_check.hpp"
+#include "patches/patch_index.hpp"
+#include "patches/patch_metadata_index.hpp"
+#include "patches/patch_repository.hpp"
+#include "patches/persistent_parse_cache.hpp"
+#include "patches/patch_write.hpp"
+#include "platform/std_file_system.hpp"
+#include "workspace/workspace.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// The worker gets this long to finish a walk before a test gives up on it.
+constexpr auto kPatience = std::chrono::seconds(5);
+
+/// Poll until no walk is left running, noting whether any replaced the
+/// tree; false if they never finish.
+bool wait_for_walk(patches::PatchRepository &repository, bool &published) {
+  const auto deadline = std::chrono::steady_clock::now() + kPatience;
+  while (repository.background_refresh_running()) {
+    published = repository.poll_background_refresh() || published;
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+bool wait_for_publish(patches::PatchRepository &repository) {
+  bool published = false;
+  return wait_for_walk(repository, published) && published;
+}
+
+void write_named_patch(const fs::path &path) {
+  ym2612::Patch patch;
+  patch.name = path.stem().string();
+  CHECK(patches::write_patch(patch, path));
+}
+
+void test_tree_swaps_in_on_poll(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "swap";
+  fs::create_directories(folder);
+  write_named_patch(folder / "first.gin");
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  patches::PatchRepository repository(file_system, workspace);
+  CHECK(repository.index().patch_count() == 1);
+
+  repository.enable_background_refresh();
+  write_named_patch(folder / "second.gin");
+  const auto revision = repository.revision();
+  repository.refresh();
+  CHECK(repository.background_refresh_running());
+
+  // Nothing changes until the UI thread asks for the finished walk.
+  CHECK(repository.index().patch_count() == 1);
+  CHECK(repository.revision() == revision);
+  CHECK(!repository.has_directory_changed());
+
+  CHECK(wait_for_publish(repository));
+  CHECK(!repository.background_refresh_running());
+  CHECK(repository.index().patch_count() == 2);
+  CHECK(repository.revision() == revision + 1);
+  CHECK(!repository.has_directory_changed());
+}
+
+void test_refreshes_during_a_walk_coalesce(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "coalesce";
+  fs::create_directories(folder);
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  patches::PatchRepository repository(file_system, workspace);
+  repository.enable_background_refresh();
+
+  repository.refresh();
+  write_named_patch(folder / "late.gin");
+  repository.refresh();
+  repository.refresh();
+
+  // The first walk may or may not have seen the file; the one queued behind
+  // it always does, and nothing runs after that.
+  CHECK(wait_for_publish(repository));
+  CHECK(!repository.background_refresh_running());
+  CHECK(repository.index().patch_count() == 1);
+}
+
+void test_metadata_edit_shows_without_a_walk(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "metadata";
+  fs::create_directories(folder);
+  write_named_patch(folder / "starred.gin");
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  patches::PatchRepository repository(file_system, workspace);
+  repository.enable_background_refresh();
+
+  const auto &index = repository.index();
+  CHECK(index.patch_count() == 1);
+  const auto node = index.patches()[0];
+  const auto relative = index.relative_path(node);
+  const auto revision = repository.revision();
+  const auto metadata_revision = repository.metadata_revision();
+
+  patches::PatchMetadata metadata;
+  metadata.star_rating = 4;
+  CHECK(repository.update_patch_metadata(relative, metadata));
+  CHECK(!repository.background_refresh_running());
+  // Only the metadata changed, so the listing keeps its revision.
+  CHECK(repository.revision() == revision);
+  CHECK(repository.metadata_revision() == metadata_revision + 1);
+  // index() is updated in place, so the reference taken above still holds.
+  const auto &entry = index.entry(index.patches()[0]);
+  CHECK(entry.metadata.has_value());
+  CHECK(entry.metadata->star_rating == 4);
+  CHECK(index.star_rating(index.patches()[0]) == 4);
+}
+
+// A tag edit moves one patch between the metadata bitsets; the listing and
+// the bitsets already built are kept.
+void test_tag_edit_keeps_the_listing_revision(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "tags";
+  fs::create_directories(folder);
+  write_named_patch(folder / "tagged.gin");
+  write_named_patch(folder / "plain.gin");
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  patches::PatchRepository repository(file_system, workspace);
+  repository.enable_background_refresh();
+
+  const auto &index = repository.index();
+  CHECK(index.patch_count() == 2);
+  const auto relative = index.relative_path(index.patches()[0]);
+  const auto revision = repository.revision();
+  const auto *bitsets = &repository.metadata_index();
+  patches::PatchMetadataIndex::Filter filter;
+  filter.tags = {"warm"};
+  CHECK(bitsets->select(filter).count() == 0);
+
+  patches::PatchMetadata metadata;
+  metadata.tags = {"Warm"};
+  CHECK(repository.update_patch_metadata(relative, metadata));
+  CHECK(repository.revision() == revision);
+  CHECK(&repository.metadata_index() == bitsets);
+  const auto tagged = repository.metadata_index().select(filter);
+  CHECK(tagged.count() == 1);
+  CHECK(tagged.test(index.patch_id(index.patches()[0])));
+}
+
+// A delete only starts a walk; the patch's metadata goes with its file, not
+// with whatever the walk later publishes.
+void test_delete_drops_metadata_before_the_walk(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "delete";
+  fs::create_directories(folder);
+  write_named_patch(folder / "doomed.gin");
+  write_named_patch(folder / "kept.gin");
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  patches::PatchRepository repository(file_system, workspace);
+  const auto &index = repository.index();
+  const auto doomed = index.entry(index.patches()[0]).relative_path;
+  const auto kept = index.entry(index.patches()[1]).relative_path;
+  patches::PatchMetadata metadata;
+  metadata.star_rating = 3;
+  CHECK(repository.update_patch_metadata(doomed, metadata));
+  CHECK(repository.update_patch_metadata(kept, metadata));
+
+  repository.enable_background_refresh();
+  const auto node = repository.index().find(doomed);
+  CHECK(node.has_value());
+  CHECK(repository.delete_patch(repository.index().entry(*node)));
+  CHECK(repository.background_refresh_running());
+  CHECK(!repository.get_patch_metadata(doomed).has_value());
+  CHECK(repository.get_patch_metadata(kept).has_value());
+
+  CHECK(wait_for_publish(repository));
+  CHECK(repository.index().patch_count() == 1);
+  CHECK(!repository.get_patch_metadata(doomed).has_value());
+  CHECK(repository.get_patch_metadata(kept).has_value());
+}
+
+void test_destruction_stops_a_running_walk(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "destroy";
+  fs::create_directories(folder);
+  for (int i = 0; i < 32; ++i) {
+    write_named_patch(folder / ("patch" + std::to_string(i) + ".gin"));
+  }
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  patches::PatchRepository repository(file_system, workspace);
+  repository.enable_background_refresh();
+  repository.refresh();
+  // Leaving scope with the walk unpolled must join it, not leak it.
+}
+
+void test_snapshot_shows_before_the_walk(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  const auto folder = root / "snapshot";
+  const auto cache_path = root / "snapshot-cache.json";
+  fs::create_directories(folder);
+  write_named_patch(folder / "first.gin");
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(folder));
+  {
+    patches::PersistentParseCache cache;
+    cache.load(cache_path);
+    patches::PatchRepository repository(file_system, workspace, {}, &cache);
+    CHECK(repository.index().patch_count() == 1);
+    CHECK(!repository.has_directory_changed());
+  }
+
+  // The next launch lists the snapshot, not the disk, and owes a walk.
+  write_named_patch(folder / "second.gin");
+  {
+    patches::PersistentParseCache cache;
+    cache.load(cache_path);
+    patches::PatchRepository repository(file_system, workspace, {}, &cache);
+    CHECK(repository.index().patch_count() == 1);
+    CHECK(repository.has_directory_changed());
+
+    repository.enable_background_refresh();
+    CHECK(repository.background_refresh_running());
+    CHECK(wait_for_publish(repository));
+    CHECK(repository.index().patch_count() == 2);
+    CHECK(!repository.has_directory_changed());
+  }
+
+  // Revalidating a snapshot that still matches replaces nothing.
+  {
+    patches::PersistentParseCache cache;
+    cache.load(cache_path);
+    patches::PatchRepository repository(file_system, workspace, {}, &cache);
+    CHECK(repository.index().patch_count() == 2);
+    const auto revision = repository.revision();
+    repository.enable_background_refresh();
+    bool published = false;
+    CHECK(wait_for_walk(repository, published));
+    CHECK(!published);
+    CHECK(repository.revision() == revision);
+    CHECK(!repository.has_directory_changed());
+  }
+
+  // A different folder set does not use it.
+  megatoy::workspace::Workspace other;
+  const auto other_folder = root / "snapshot-other";
+  fs::create_directories(other_folder);
+  CHECK(other.add(other_folder));
+  patches::PersistentParseCache cache;
+  cache.load(cache_path);
+  patches::PatchRepository repository(file_system, other, {}, &cache);
+  CHECK(repository.index().patch_count() == 0);
+  CHECK(!repository.has_directory_changed());
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() /
+                    "megatoy_patch_repository_background_refresh_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  error.clear();
+  fs::create_directories(root, error);
+  CHECK(!error);
+
+  test_tree_swaps_in_on_poll(root);
+  test_refreshes_during_a_walk_coalesce(root);
+  test_metadata_edit_shows_without_a_walk(root);
+  test_tag_edit_keeps_the_listing_revision(root);
+  test_delete_drops_metadata_before_the_walk(root);
+  test_destruction_stops_a_running_walk(root);
+  test_snapshot_shows_before_the_walk(root);
+
+  fs::remove_all(root, error);
+  CHECK(!error);
+  std::cout << "patch_repository_background_refresh_test passed\n";
+  return 0;
+}
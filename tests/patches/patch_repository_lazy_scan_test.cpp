@@ -0,0 +1,189 @@
+#include "../test_check.hpp"
+#include "patches/patch_index.hpp"
+#include "patches/patch_repository.hpp"
+#include "patches/patch_write.hpp"
+#include "platform/std_file_system.hpp"
+#include "workspace/workspace.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// The worker gets this long to finish a walk before a test gives up on it.
+constexpr auto kPatience = std::chrono::seconds(5);
+
+void write_named_patch(const fs::path &path) {
+  ym2612::Patch patch;
+  patch.name = path.stem().string();
+  CHECK(patches::write_patch(patch, path));
+}
+
+const patches::PatchEntry *
+find_entry(const std::vector<patches::PatchEntry> &entries,
+           const std::string &relative_path) {
+  for (const auto &entry : entries) {
+    if (entry.relative_path == relative_path) {
+      return &entry;
+    }
+    if (const auto *found = find_entry(entry.children, relative_path)) {
+      return found;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * library/top.gin
+ * library/packs/a/deep.gin
+ * library/packs/b/            (no patches)
+ */
+fs::path make_library(const fs::path &root) {
+  const auto folder = root / "library";
+  fs::create_directories(folder / "packs" / "a");
+  fs::create_directories(folder / "packs" / "b");
+  write_named_patch(folder / "top.gin");
+  write_named_patch(folder / "packs" / "a" / "deep.gin");
+  return folder;
+}
+
+void test_lazy_walk_reads_only_the_top_level(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(make_library(root / "top-level")));
+  patches::PatchRepository repository(file_system, workspace, {}, nullptr,
+                                      /*show_builtin_presets=*/true,
+                                      /*lazy_scanning=*/true);
+
+  CHECK(repository.lazy_scanning());
+  CHECK(repository.index().patch_count() == 1);
+  const auto *packs = find_entry(repository.tree(), "library/packs");
+  CHECK(packs != nullptr);
+  CHECK(packs->is_directory);
+  CHECK(packs->children_pending);
+  CHECK(packs->children.empty());
+}
+
+void test_expand_reads_one_level(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(make_library(root / "expand")));
+  patches::PatchRepository repository(file_system, workspace, {}, nullptr,
+                                      /*show_builtin_presets=*/true,
+                                      /*lazy_scanning=*/true);
+  const auto revision = repository.revision();
+
+  CHECK(!repository.expand_directory("library/top.gin"));
+  CHECK(repository.expand_directory("library/packs"));
+  CHECK(repository.revision() == revision + 1);
+  const auto *packs = find_entry(repository.tree(), "library/packs");
+  CHECK(packs != nullptr);
+  CHECK(!packs->children_pending);
+  CHECK(packs->children.size() == 2);
+  CHECK(packs->children[0].children_pending);
+  // Already read: nothing to do.
+  CHECK(!repository.expand_directory("library/packs"));
+
+  CHECK(repository.expand_directory("library/packs/a"));
+  CHECK(repository.index().patch_count() == 2);
+
+  // A rescan keeps reading what was opened.
+  write_named_patch(root / "expand" / "library" / "packs" / "a" / "new.gin");
+  repository.refresh();
+  CHECK(repository.index().patch_count() == 3);
+  const auto *b = find_entry(repository.tree(), "library/packs/b");
+  CHECK(b != nullptr);
+  CHECK(b->children_pending);
+}
+
+// With background refresh, the click only queues the folder; a worker lists
+// that one folder, without walking the workspace again, and it shows as
+// loading until the listing is spliced in.
+void test_expand_in_the_background(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(make_library(root / "background")));
+  patches::PatchRepository repository(file_system, workspace, {}, nullptr,
+                                      /*show_builtin_presets=*/true,
+                                      /*lazy_scanning=*/true);
+  repository.enable_background_refresh();
+
+  CHECK(!repository.directory_loading("library/packs"));
+  CHECK(!repository.expand_directory("library/packs"));
+  CHECK(repository.directory_loading("library/packs"));
+  CHECK(repository.directory_listing_running());
+  CHECK(!repository.background_refresh_running());
+
+  const auto deadline = std::chrono::steady_clock::now() + kPatience;
+  bool published = false;
+  while (repository.directory_listing_running() &&
+         std::chrono::steady_clock::now() < deadline) {
+    published = repository.poll_background_refresh() || published;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  CHECK(published);
+  CHECK(!repository.background_refresh_running());
+  CHECK(!repository.directory_loading("library/packs"));
+  const auto *packs = find_entry(repository.tree(), "library/packs");
+  CHECK(packs != nullptr);
+  CHECK(!packs->children_pending);
+  CHECK(packs->children.size() == 2);
+
+  CHECK(!repository.expand_directory("library/packs/a"));
+  CHECK(repository.directory_listing_running());
+  while (repository.directory_listing_running() &&
+         std::chrono::steady_clock::now() < deadline) {
+    repository.poll_background_refresh();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  CHECK(!repository.background_refresh_running());
+  CHECK(find_entry(repository.tree(), "library/packs/a/deep.gin") != nullptr);
+}
+
+void test_full_listing_reads_everything(const fs::path &root) {
+  platform::StdFileSystem file_system;
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(make_library(root / "full")));
+  patches::PatchRepository repository(file_system, workspace, {}, nullptr,
+                                      /*show_builtin_presets=*/true,
+                                      /*lazy_scanning=*/true);
+
+  repository.require_full_listing();
+  CHECK(!repository.lazy_scanning());
+  CHECK(repository.index().patch_count() == 2);
+  CHECK(find_entry(repository.tree(), "library/packs/a/deep.gin") != nullptr);
+  // Folders without patches are dropped again, as in any complete walk.
+  CHECK(find_entry(repository.tree(), "library/packs/b") == nullptr);
+
+  const auto revision = repository.revision();
+  repository.require_full_listing();
+  CHECK(repository.revision() == revision);
+}
+
+} // namespace
+
+int main() {
+  const auto root =
+      fs::temp_directory_path() / "megatoy_patch_repository_lazy_scan_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  error.clear();
+  fs::create_directories(root, error);
+  CHECK(!error);
+
+  test_lazy_walk_reads_only_the_top_level(root);
+  test_expand_reads_one_level(root);
+  test_expand_in_the_background(root);
+  test_full_listing_reads_everything(root);
+
+  fs::remove_all(root, error);
+  CHECK(!error);
+  std::cout << "patch_repository_lazy_scan_test passed\n";
+  return 0;
+}
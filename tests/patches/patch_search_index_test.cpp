@@ -0,0 +1,139 @@
+#include "patches/patch_search_index.hpp"
+
+#include "../test_check.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using patches::PatchIndex;
+using patches::PatchSearchIndex;
+using Rank = PatchSearchIndex::Rank;
+
+patches::PatchEntry make_file(const std::string &name,
+                              const std::string &relative_path,
+                              const std::string &category = "",
+                              std::vector<std::string> tags = {}) {
+  patches::PatchEntry entry;
+  entry.name = name;
+  entry.relative_path = relative_path;
+  entry.format = "dmp";
+  entry.is_directory = false;
+  if (!category.empty() || !tags.empty()) {
+    patches::PatchMetadata metadata;
+    metadata.category = category;
+    metadata.tags = std::move(tags);
+    entry.metadata = metadata;
+  }
+  return entry;
+}
+
+/**
+ * sonic/                  (directory)
+ *   0 Bass Slap.dmp
+ *   1 Slap Bass.dmp       category "Bass"
+ *   2 Synbass.dmp
+ *   3 Lead.dmp            tags {"Bright", "basslike"}
+ *   4 Ébène.dmp
+ */
+std::vector<patches::PatchEntry> make_tree() {
+  patches::PatchEntry sonic;
+  sonic.name = "sonic";
+  sonic.relative_path = "sonic";
+  sonic.is_directory = true;
+  sonic.children.push_back(make_file("Bass Slap.dmp", "sonic/Bass Slap.dmp"));
+  sonic.children.push_back(
+      make_file("Slap Bass.dmp", "sonic/Slap Bass.dmp", "Bass"));
+  sonic.children.push_back(make_file("Synbass.dmp", "sonic/Synbass.dmp"));
+  sonic.children.push_back(
+      make_file("Lead.dmp", "sonic/Lead.dmp", "", {"Bright", "basslike"}));
+  sonic.children.push_back(make_file("Ébène.dmp", "sonic/Ébène.dmp"));
+
+  std::vector<patches::PatchEntry> tree;
+  tree.push_back(std::move(sonic));
+  return tree;
+}
+
+std::vector<PatchIndex::PatchId>
+ids_of(const std::vector<PatchSearchIndex::Hit> &hits) {
+  std::vector<PatchIndex::PatchId> ids;
+  for (const auto &hit : hits) {
+    ids.push_back(hit.patch);
+  }
+  return ids;
+}
+
+void test_hits_are_ranked_prefix_word_infix_metadata() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  const auto search = PatchSearchIndex::build(index);
+  CHECK(search.size() == 5);
+  CHECK(search.trigram_count() > 0);
+
+  const auto hits = search.search("BASS", PatchSearchIndex::kBrowserFields);
+  CHECK(ids_of(hits) == std::vector<PatchIndex::PatchId>({0, 1, 2, 3}));
+  CHECK(hits[0].rank == Rank::NamePrefix);
+  CHECK(hits[1].rank == Rank::NameWord);
+  CHECK(hits[2].rank == Rank::NameInfix);
+  CHECK(hits[3].rank == Rank::Metadata);
+}
+
+void test_paths_are_searched_only_when_asked() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  const auto search = PatchSearchIndex::build(index);
+
+  CHECK(search.search("sonic", PatchSearchIndex::kBrowserFields).empty());
+  const auto by_path = search.search("sonic");
+  CHECK(by_path.size() == 5);
+  CHECK(by_path[0].rank == Rank::Path);
+}
+
+void test_tags_and_unicode_case_fold() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  const auto search = PatchSearchIndex::build(index);
+
+  CHECK(ids_of(search.search("bright")) ==
+        std::vector<PatchIndex::PatchId>({3}));
+  CHECK(ids_of(search.search("ÉBÈNE")) ==
+        std::vector<PatchIndex::PatchId>({4}));
+  CHECK(ids_of(search.search("ébène")) ==
+        std::vector<PatchIndex::PatchId>({4}));
+}
+
+void test_short_and_missing_queries() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  const auto search = PatchSearchIndex::build(index);
+
+  // Below trigram length the pre-folded text is scanned instead.
+  const auto short_hits = search.search("sl", PatchSearchIndex::kName);
+  CHECK(ids_of(short_hits) == std::vector<PatchIndex::PatchId>({1, 0}));
+  CHECK(short_hits[0].rank == Rank::NamePrefix);
+  CHECK(short_hits[1].rank == Rank::NameWord);
+
+  CHECK(search.search("").empty());
+  CHECK(search.search("zzz").empty());
+  // Every trigram exists somewhere -- "syn" only in Synbass, "sli" only in
+  // Lead's "basslike" tag -- but not all in one patch.
+  CHECK(search.search("synbasslike").empty());
+
+  const auto empty_index = PatchIndex::build({});
+  const auto empty_search = PatchSearchIndex::build(empty_index);
+  CHECK(empty_search.search("bass").empty());
+  CHECK(empty_search.search("b").empty());
+}
+
+} // namespace
+
+int main() {
+  test_hits_are_ranked_prefix_word_infix_metadata();
+  test_paths_are_searched_only_when_asked();
+  test_tags_and_unicode_case_fold();
+  test_short_and_missing_queries();
+
+  std::cout << "All patch search index tests passed\n";
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include "patches/patch_sort_index.hpp"
+
+#include "../test_check.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using patches::PatchIndex;
+using patches::PatchSortIndex;
+using Key = PatchSortIndex::Key;
+
+patches::PatchEntry make_file(const std::string &name,
+                              const std::string &relative_path,
+                              const std::string &format, int stars,
+                              const std::string &category) {
+  patches::PatchEntry entry;
+  entry.name = name;
+  entry.relative_path = relative_path;
+  entry.format = format;
+  entry.is_directory = false;
+  patches::PatchMetadata metadata;
+  metadata.star_rating = stars;
+  metadata.category = category;
+  entry.metadata = metadata;
+  return entry;
+}
+
+/**
+ * 0 bass.opm   "B/bass.opm"  3 stars "lead"
+ * 1 Alpha.dmp  "a/Alpha.dmp" 5 stars "Bass"
+ * 2 alpha.dmp  "c/alpha.dmp" 3 stars ""
+ */
+std::vector<patches::PatchEntry> make_tree() {
+  std::vector<patches::PatchEntry> tree;
+  tree.push_back(make_file("bass.opm", "B/bass.opm", "opm", 3, "lead"));
+  tree.push_back(make_file("Alpha.dmp", "a/Alpha.dmp", "dmp", 5, "Bass"));
+  tree.push_back(make_file("alpha.dmp", "c/alpha.dmp", "dmp", 3, ""));
+  return tree;
+}
+
+std::vector<PatchIndex::PatchId>
+as_vector(std::span<const PatchIndex::PatchId> order) {
+  return {order.begin(), order.end()};
+}
+
+void test_orders_use_normalised_keys() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  PatchSortIndex orders;
+  orders.reset(index);
+
+  // Case-folded, with the raw name breaking the Alpha/alpha tie.
+  CHECK(as_vector(orders.ascending(Key::Name)) ==
+        std::vector<PatchIndex::PatchId>({1, 2, 0}));
+  CHECK(as_vector(orders.ascending(Key::Category)) ==
+        std::vector<PatchIndex::PatchId>({2, 1, 0}));
+  CHECK(as_vector(orders.ascending(Key::Path)) ==
+        std::vector<PatchIndex::PatchId>({1, 0, 2}));
+}
+
+void test_equal_keys_keep_tree_order() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  PatchSortIndex orders;
+  orders.reset(index);
+
+  CHECK(as_vector(orders.ascending(Key::StarRating)) ==
+        std::vector<PatchIndex::PatchId>({0, 2, 1}));
+  CHECK(as_vector(orders.ascending(Key::Format)) ==
+        std::vector<PatchIndex::PatchId>({1, 2, 0}));
+}
+
+void test_orders_are_computed_lazily_and_reset() {
+  const auto tree = make_tree();
+  const auto index = PatchIndex::build(tree);
+  PatchSortIndex orders;
+  CHECK(orders.ascending(Key::Name).empty());
+
+  orders.reset(index);
+  CHECK(!orders.has_order(Key::Name));
+  orders.ascending(Key::Name);
+  CHECK(orders.has_order(Key::Name));
+  CHECK(!orders.has_order(Key::Path));
+
+  const std::vector<patches::PatchEntry> nothing;
+  const auto empty = PatchIndex::build(nothing);
+  orders.reset(empty);
+  CHECK(!orders.has_order(Key::Name));
+  CHECK(orders.ascending(Key::Name).empty());
+}
+
+void test_metadata_edit_invalidates_one_order() {
+  const auto tree = make_tree();
+  auto index = PatchIndex::build(tree);
+  PatchSortIndex orders;
+  orders.reset(index);
+  orders.ascending(Key::Name);
+  orders.ascending(Key::StarRating);
+
+  auto metadata = *tree[0].metadata;
+  metadata.star_rating = 1;
+  index.set_metadata(index.patches()[0], metadata);
+  orders.invalidate(Key::StarRating);
+  CHECK(orders.has_order(Key::Name));
+  CHECK(!orders.has_order(Key::StarRating));
+  CHECK(as_vector(orders.ascending(Key::StarRating)) ==
+        std::vector<PatchIndex::PatchId>({0, 2, 1}));
+  metadata.star_rating = 4;
+  index.set_metadata(index.patches()[0], metadata);
+  orders.invalidate(Key::StarRating);
+  CHECK(as_vector(orders.ascending(Key::StarRating)) ==
+        std::vector<PatchIndex::PatchId>({2, 0, 1}));
+}
+
+} // namespace
+
+int main() {
+  test_orders_use_normalised_keys();
+  test_equal_keys_keep_tree_order();
+  test_orders_are_computed_lazily_and_reset();
+  test_metadata_edit_invalidates_one_order();
+
+  std::cout << "All patch sort index tests passed\n";
+  return 0;
+}
@@ -106,6 +106,54 @@ void test_round_trip_and_identity(const fs::path &root) {
             .has_value());
 }
 
+void test_tree_snapshot(const fs::path &root) {
+  const auto cache_path = root / "tree.json";
+  const auto container_path = (root / "bank.ginpkg").lexically_normal();
+  std::vector<patches::PatchEntry> tree;
+  tree.push_back(sample_subtree(container_path));
+
+  patches::PersistentParseCache cache;
+  cache.load(cache_path);
+  CHECK(!cache.lookup_tree("library").has_value());
+  cache.store_tree("library", tree);
+  CHECK(cache.dirty());
+  CHECK(cache.save());
+
+  patches::PersistentParseCache loaded;
+  loaded.load(cache_path);
+  CHECK(!loaded.lookup_tree("other").has_value());
+  const auto snapshot = loaded.lookup_tree("library");
+  CHECK(snapshot.has_value());
+  CHECK(snapshot->size() == 1);
+  check_subtree(snapshot->front(), tree.front());
+  CHECK(!snapshot->front().children[0].metadata.has_value());
+
+  // A walk that lists the same tree again leaves nothing to save, even when
+  // only metadata, which is not stored, differs.
+  loaded.store_tree("library", tree);
+  CHECK(!loaded.dirty());
+  auto unrated = tree;
+  unrated.front().children[0].metadata.reset();
+  loaded.store_tree("library", unrated);
+  CHECK(!loaded.dirty());
+  auto renamed = tree;
+  renamed.front().children[0].name = "Renamed";
+  loaded.store_tree("library", renamed);
+  CHECK(loaded.dirty());
+  CHECK(loaded.lookup_tree("library")->front().children[0].name == "Renamed");
+
+  // Only the newest snapshot is kept.
+  loaded.store_tree("other", {});
+  CHECK(loaded.lookup_tree("other").has_value());
+  CHECK(!loaded.lookup_tree("library").has_value());
+
+  // Files from before snapshots existed still load their entries.
+  write_text(cache_path, R"({"version":1,"entries":[]})");
+  patches::PersistentParseCache older;
+  older.load(cache_path);
+  CHECK(!older.lookup_tree("library").has_value());
+}
+
 void test_invalid_files(const fs::path &root) {
   const auto cache_path = root / "invalid.json";
   const auto container_path = root / "invalid.ginpkg";
@@ -201,6 +249,7 @@ int main() {
   CHECK(!error);
 
   test_round_trip_and_identity(root);
+  test_tree_snapshot(root);
   test_invalid_files(root);
   test_cap_eviction(root);
   test_filesystem_storage_integration(root);
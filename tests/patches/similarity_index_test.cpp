@@ -0,0 +1,145 @@
+#include "../test_check.hpp"
+#include "patches/similarity_index.hpp"
+#include "ym2612/patch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using patches::SimilarityVector;
+
+SimilarityVector vector_of(const ym2612::Patch &patch) {
+  return SimilarityVector::from(patch.packed());
+}
+
+ym2612::Patch random_patch(std::mt19937 &rng) {
+  const auto pick = [&](int top) {
+    return static_cast<std::uint8_t>(
+        std::uniform_int_distribution<int>(0, top)(rng));
+  };
+  ym2612::Patch patch;
+  patch.instrument.algorithm = pick(7);
+  patch.instrument.feedback = pick(7);
+  for (auto &op : patch.instrument.operators) {
+    op.attack_rate = pick(31);
+    op.decay_rate = pick(31);
+    op.sustain_rate = pick(31);
+    op.release_rate = pick(15);
+    op.sustain_level = pick(15);
+    op.total_level = pick(127);
+    op.key_scale = pick(3);
+    op.multiple = pick(15);
+    op.detune = pick(7);
+  }
+  return patch;
+}
+
+void test_distance() {
+  ym2612::Patch base;
+  base.instrument.algorithm = 4;
+  CHECK(patches::similarity_distance(vector_of(base), vector_of(base)) ==
+        0.0f);
+
+  // A step of total level weighs more than a step of key scale...
+  auto louder = base;
+  louder.instrument.operators[0].total_level = 127;
+  auto scaled = base;
+  scaled.instrument.operators[0].key_scale = 3;
+  const float to_louder =
+      patches::similarity_distance(vector_of(base), vector_of(louder));
+  const float to_scaled =
+      patches::similarity_distance(vector_of(base), vector_of(scaled));
+  CHECK(to_louder > to_scaled);
+  CHECK(to_louder <= patches::max_similarity_distance());
+
+  // ...and detune is signed: +1 and -1 are two steps apart, not five.
+  auto up = base;
+  up.instrument.operators[2].detune = 1;
+  auto down = base;
+  down.instrument.operators[2].detune = 5;
+  const float one_step =
+      patches::similarity_distance(vector_of(base), vector_of(up));
+  CHECK(std::abs(patches::similarity_distance(vector_of(base),
+                                              vector_of(down)) -
+                 one_step) < 1e-6f);
+  CHECK(std::abs(patches::similarity_distance(vector_of(up),
+                                              vector_of(down)) -
+                 2 * one_step) < 1e-6f);
+
+  // Every change of algorithm is the same distance.
+  auto next = base;
+  next.instrument.algorithm = 5;
+  auto far = base;
+  far.instrument.algorithm = 0;
+  CHECK(patches::similarity_distance(vector_of(base), vector_of(next)) ==
+        patches::similarity_distance(vector_of(base), vector_of(far)));
+}
+
+void test_nearest_matches_a_plain_scan() {
+  std::mt19937 rng(7);
+  std::vector<SimilarityVector> items;
+  // Not a whole number of blocks, so the padding is exercised.
+  for (int i = 0; i < 1000; ++i) {
+    items.push_back(vector_of(random_patch(rng)));
+  }
+  const auto index = patches::make_similarity_index(items);
+  CHECK(index->size() == items.size());
+
+  for (int q = 0; q < 20; ++q) {
+    const auto query = vector_of(random_patch(rng));
+    const auto matches = index->nearest(query, 10);
+    CHECK(matches.size() == 10);
+
+    std::vector<float> expected;
+    for (const auto &item : items) {
+      expected.push_back(patches::similarity_distance(query, item));
+    }
+    std::vector<float> sorted = expected;
+    std::sort(sorted.begin(), sorted.end());
+    for (std::size_t k = 0; k < matches.size(); ++k) {
+      CHECK(std::abs(matches[k].distance - sorted[k]) < 1e-4f);
+      const float direct = expected[matches[k].item];
+      CHECK(std::abs(direct - matches[k].distance) < 1e-4f);
+    }
+  }
+
+  // An item is its own nearest neighbour.
+  const auto self = index->nearest(items[123], 1);
+  CHECK(self.size() == 1);
+  CHECK(self[0].item == 123);
+  CHECK(self[0].distance == 0.0f);
+}
+
+void test_small_and_empty_sets() {
+  ym2612::Patch a;
+  auto b = a;
+  b.instrument.feedback = 7;
+  const std::vector<SimilarityVector> items = {vector_of(b), vector_of(a),
+                                               vector_of(a)};
+  const auto index = patches::make_similarity_index(items);
+  const auto matches = index->nearest(vector_of(a), 10);
+  CHECK(matches.size() == 3);
+  // Equal distances keep item order.
+  CHECK(matches[0].item == 1);
+  CHECK(matches[1].item == 2);
+  CHECK(matches[2].item == 0);
+
+  const auto empty = patches::make_similarity_index({});
+  CHECK(empty->size() == 0);
+  CHECK(empty->nearest(vector_of(a), 5).empty());
+}
+
+} // namespace
+
+int main() {
+  test_distance();
+  test_nearest_matches_a_plain_scan();
+  test_small_and_empty_sets();
+  std::cout << "similarity_index_test passed\n";
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "platform/file_view.hpp"
+#include "platform/platform_config.hpp"
+#include "platform/std_file_system.hpp"
+
+#include "../test_check.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using platform::FileView;
+
+std::vector<std::uint8_t> pattern(std::size_t size) {
+  std::vector<std::uint8_t> bytes(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<std::uint8_t>(i * 31 + 7);
+  }
+  return bytes;
+}
+
+void write_bytes(const fs::path &path, const std::vector<std::uint8_t> &bytes) {
+  std::ofstream output(path, std::ios::binary);
+  output.write(reinterpret_cast<const char *>(bytes.data()),
+               static_cast<std::streamsize>(bytes.size()));
+  CHECK(static_cast<bool>(output));
+}
+
+bool same(const FileView &view, const std::vector<std::uint8_t> &bytes) {
+  return std::equal(view.bytes().begin(), view.bytes().end(), bytes.begin(),
+                    bytes.end());
+}
+
+void test_small_file_is_buffered(const fs::path &root) {
+  const auto path = root / "small.dmp";
+  const auto bytes = pattern(100);
+  write_bytes(path, bytes);
+
+  const auto view = FileView::open(path);
+  CHECK(view.has_value());
+  CHECK(view->size() == 100);
+  CHECK(!view->mapped());
+  CHECK(same(*view, bytes));
+}
+
+void test_large_file_is_mapped(const fs::path &root) {
+  const auto path = root / "large.vgm";
+  const auto bytes = pattern(FileView::kMapThreshold * 3 + 5);
+  write_bytes(path, bytes);
+
+  auto view = FileView::open(path);
+  CHECK(view.has_value());
+  CHECK(same(*view, bytes));
+#if defined(MEGATOY_PLATFORM_DESKTOP) && !defined(_WIN32)
+  CHECK(view->mapped());
+#endif
+
+  // Moving hands over the mapping; the source is left empty.
+  const auto *data = view->data();
+  FileView moved = std::move(*view);
+  CHECK(moved.data() == data);
+  CHECK(view->empty());
+  CHECK(!view->mapped());
+  CHECK(same(moved, bytes));
+}
+
+void test_empty_and_missing(const fs::path &root) {
+  const auto empty_path = root / "empty.tfi";
+  write_bytes(empty_path, {});
+  const auto empty = FileView::open(empty_path);
+  CHECK(empty.has_value());
+  CHECK(empty->empty());
+
+  CHECK(!FileView::open(root / "missing.tfi").has_value());
+  CHECK(!FileView::open(root).has_value());
+}
+
+void test_stream_and_adopted_views(const fs::path &root) {
+  const auto bytes = pattern(40000);
+  std::istringstream stream(std::string(bytes.begin(), bytes.end()));
+  const auto read = FileView::read(stream);
+  CHECK(read.has_value());
+  CHECK(same(*read, bytes));
+
+  const auto adopted = FileView::adopt(bytes);
+  CHECK(same(adopted, bytes));
+  CHECK(!adopted.mapped());
+
+  // StdFileSystem hands out the same bytes as open_read().
+  const auto path = root / "through_vfs.gin";
+  write_bytes(path, bytes);
+  platform::StdFileSystem file_system;
+  const auto view = file_system.view(path);
+  CHECK(view.has_value());
+  CHECK(same(*view, bytes));
+  CHECK(!file_system.view(root / "missing.gin").has_value());
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() / "megatoy_file_view_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  error.clear();
+  fs::create_directories(root, error);
+  CHECK(!error);
+
+  test_small_file_is_buffered(root);
+  test_large_file_is_mapped(root);
+  test_empty_and_missing(root);
+  test_stream_and_adopted_views(root);
+
+  fs::remove_all(root, error);
+  CHECK(!error);
+  std::cout << "file_view_test passed\n";
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include "patches/patch_index.hpp"
+#include "patches/patch_repository.hpp"
+#include "patches/patch_write.hpp"
+#include "platform/std_file_system.hpp"
+#include "platform/zip_file_system.hpp"
+#include "workspace/workspace.hpp"
+
+#include "../test_check.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <miniz.h>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Entries = std::vector<std::pair<std::string, std::string>>;
+
+void write_zip(const fs::path &path, const Entries &entries) {
+  std::error_code error;
+  fs::remove(path, error);
+  mz_zip_archive zip;
+  std::memset(&zip, 0, sizeof(zip));
+  CHECK(mz_zip_writer_init_file(&zip, path.string().c_str(), 0));
+  for (const auto &[name, contents] : entries) {
+    CHECK(mz_zip_writer_add_mem(&zip, name.c_str(), contents.data(),
+                                contents.size(), MZ_DEFAULT_COMPRESSION));
+  }
+  CHECK(mz_zip_writer_finalize_archive(&zip));
+  CHECK(mz_zip_writer_end(&zip));
+}
+
+std::string read_all(std::istream &stream) {
+  return std::string(std::istreambuf_iterator<char>(stream), {});
+}
+
+std::vector<std::string>
+names(const std::vector<platform::DirectoryEntry> &in) {
+  std::vector<std::string> out;
+  for (const auto &entry : in) {
+    out.push_back(entry.path.filename().string() +
+                  (entry.is_directory ? "/" : ""));
+  }
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+using Names = std::vector<std::string>;
+
+void test_tree_and_contents(const fs::path &root) {
+  const auto archive = root / "pack.zip";
+  write_zip(archive, {{"readme.txt", "hello"},
+                      {"bass/a.dmp", "aaaa"},
+                      {"bass/deep/b.dmp", "bb"},
+                      {"lead/", ""},
+                      {"../escape.dmp", "no"}});
+
+  platform::ZipFileSystem zip(archive);
+  CHECK(zip.exists(archive));
+  CHECK(zip.is_directory(archive));
+  CHECK(names(zip.read_directory(archive)) ==
+        Names({"bass/", "lead/", "readme.txt"}));
+  CHECK(names(zip.read_directory(archive / "bass")) ==
+        Names({"a.dmp", "deep/"}));
+  CHECK(zip.read_directory(archive / "lead").empty());
+  CHECK(zip.read_directory(archive / "readme.txt").empty());
+
+  std::uintmax_t size = 0;
+  CHECK(zip.file_size(archive / "bass" / "deep" / "b.dmp", size));
+  CHECK(size == 2);
+  CHECK(!zip.file_size(archive / "bass", size));
+
+  auto stream = zip.open_read(archive / "bass" / "a.dmp");
+  CHECK(stream != nullptr);
+  CHECK(read_all(*stream) == "aaaa");
+  CHECK(zip.open_read(archive / "bass") == nullptr);
+
+  fs::file_time_type modified;
+  CHECK(zip.last_write_time(archive / "readme.txt", modified));
+  CHECK(modified == fs::last_write_time(archive));
+
+  // Nothing outside the archive, and nothing that climbed out of it.
+  CHECK(!zip.exists(archive / "missing.dmp"));
+  CHECK(!zip.exists(root / "escape.dmp"));
+  CHECK(!zip.exists(root));
+  CHECK(zip.open_write(archive / "new.dmp", std::ios::out) == nullptr);
+  CHECK(!zip.create_directories(archive / "new"));
+}
+
+void test_rewritten_archive_is_reread(const fs::path &root) {
+  const auto archive = root / "rewrite.zip";
+  write_zip(archive, {{"a.dmp", "first"}});
+
+  platform::ZipFileSystem zip(archive);
+  const auto before = zip.content_tag(archive / "a.dmp");
+  CHECK(!before.empty());
+  CHECK(zip.content_tag(archive).empty());
+
+  write_zip(archive, {{"a.dmp", "second, longer"}, {"b.dmp", "new"}});
+  // A walk starts at the root, which notices the change.
+  CHECK(names(zip.read_directory(archive)) == Names({"a.dmp", "b.dmp"}));
+  CHECK(zip.content_tag(archive / "a.dmp") != before);
+  auto stream = zip.open_read(archive / "a.dmp");
+  CHECK(stream != nullptr);
+  CHECK(read_all(*stream) == "second, longer");
+}
+
+// A central directory can claim any size; reading the entry must not
+// allocate it.
+void test_oversized_entry_is_refused(const fs::path &root) {
+  const auto archive = root / "oversized.zip";
+  write_zip(archive, {{"a.dmp", "small"}, {"b.dmp", "fine"}});
+  std::string bytes;
+  {
+    std::ifstream input(archive, std::ios::binary);
+    bytes = read_all(input);
+  }
+  // Uncompressed size of the first central directory record.
+  const auto header = bytes.find("PK\x01\x02");
+  CHECK(header != std::string::npos);
+  const std::uint32_t claimed = 0xfffffff0u;
+  std::memcpy(bytes.data() + header + 24, &claimed, sizeof(claimed));
+  {
+    std::ofstream output(archive, std::ios::binary | std::ios::trunc);
+    output.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  }
+
+  platform::ZipFileSystem zip(archive);
+  std::uintmax_t size = 0;
+  CHECK(zip.file_size(archive / "a.dmp", size));
+  CHECK(size == claimed);
+  CHECK(!zip.view(archive / "a.dmp"));
+  CHECK(zip.open_read(archive / "a.dmp") == nullptr);
+  auto stream = zip.open_read(archive / "b.dmp");
+  CHECK(stream != nullptr);
+  CHECK(read_all(*stream) == "fine");
+}
+
+void test_workspace_mounts_archive(const fs::path &root) {
+  const auto patch_path = root / "staging" / "warm.gin";
+  fs::create_directories(patch_path.parent_path());
+  ym2612::Patch patch;
+  patch.name = "warm";
+  CHECK(patches::write_patch(patch, patch_path));
+  std::ifstream input(patch_path, std::ios::binary);
+  const auto bytes = read_all(input);
+
+  const auto archive = root / "Collection.ZIP";
+  write_zip(archive, {{"pads/warm.gin", bytes}});
+  CHECK(megatoy::workspace::is_archive(archive));
+
+  megatoy::workspace::Workspace workspace;
+  CHECK(workspace.add(archive));
+  const auto &folder = workspace.folders().back();
+  CHECK(folder.archive);
+  CHECK(folder.available);
+  CHECK(!folder.writable);
+
+  platform::StdFileSystem file_system;
+  patches::PatchRepository repository(file_system, workspace);
+  CHECK(repository.index().patch_count() == 1);
+  const auto &entry =
+      repository.index().entry(repository.index().patches()[0]);
+  CHECK(entry.name == "warm");
+
+  ym2612::Patch loaded;
+  CHECK(repository.load_patch(entry, loaded));
+  CHECK(loaded.name == "warm");
+}
+
+} // namespace
+
+int main() {
+  const auto root = fs::temp_directory_path() / "megatoy_zip_file_system_test";
+  std::error_code error;
+  fs::remove_all(root, error);
+  error.clear();
+  fs::create_directories(root, error);
+  CHECK(!error);
+
+  test_tree_and_contents(root);
+  test_rewritten_archive_is_reread(root);
+  test_oversized_entry_is_refused(root);
+  test_workspace_mounts_archive(root);
+
+  fs::remove_all(root, error);
+  CHECK(!error);
+  std::cout << "zip_file_system_test passed\n";
+  return 0;
+}
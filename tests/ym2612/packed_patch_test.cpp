@@ -0,0 +1,125 @@
+#include "../test_check.hpp"
+#include "audio/audio_command.hpp"
+#include "ym2612/packed_patch.hpp"
+#include "ym2612/patch.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+namespace {
+
+ym2612::Patch make_patch(int seed) {
+  ym2612::Patch patch;
+  patch.name = "patch" + std::to_string(seed);
+  patch.global.lfo_enable = seed % 2 == 0;
+  patch.global.lfo_frequency = static_cast<std::uint8_t>(seed % 8);
+  patch.channel.left_speaker = seed % 3 != 0;
+  patch.channel.amplitude_modulation_sensitivity =
+      static_cast<std::uint8_t>(seed % 4);
+  patch.channel.frequency_modulation_sensitivity =
+      static_cast<std::uint8_t>(seed % 8);
+  patch.instrument.algorithm = static_cast<std::uint8_t>(seed % 8);
+  patch.instrument.feedback = static_cast<std::uint8_t>((seed / 8) % 8);
+  for (int i = 0; i < 4; ++i) {
+    auto &op = patch.instrument.operators[i];
+    op.attack_rate = static_cast<std::uint8_t>((seed + i) % 32);
+    op.decay_rate = static_cast<std::uint8_t>((seed * 3 + i) % 32);
+    op.sustain_rate = static_cast<std::uint8_t>((seed * 5 + i) % 32);
+    op.release_rate = static_cast<std::uint8_t>((seed + i) % 16);
+    op.sustain_level = static_cast<std::uint8_t>((seed * 7 + i) % 16);
+    op.total_level = static_cast<std::uint8_t>((seed * 11 + i) % 128);
+    op.key_scale = static_cast<std::uint8_t>((seed + i) % 4);
+    op.multiple = static_cast<std::uint8_t>((seed * 13 + i) % 16);
+    op.detune = static_cast<std::uint8_t>((seed + i) % 8);
+    op.ssg_type_envelope_control = static_cast<std::uint8_t>((seed + i) % 8);
+    op.ssg_enable = (seed + i) % 3 == 0;
+    op.amplitude_modulation_enable = (seed + i) % 2 == 0;
+    op.enable = (seed + i) % 5 != 0;
+  }
+  return patch;
+}
+
+void test_round_trip() {
+  for (int seed = 0; seed < 256; ++seed) {
+    const auto patch = make_patch(seed);
+    ym2612::Patch unpacked;
+    ym2612::unpack(patch.packed(), unpacked.global, unpacked.channel,
+                   unpacked.instrument);
+    CHECK(unpacked.global == patch.global);
+    CHECK(unpacked.channel == patch.channel);
+    CHECK(unpacked.instrument == patch.instrument);
+  }
+}
+
+void test_identity_ignores_the_name() {
+  auto a = make_patch(7);
+  auto b = a;
+  b.name = "something else";
+  CHECK(a.packed() == b.packed());
+  CHECK(a.hash() == b.hash());
+
+  b.instrument.operators[3].total_level ^= 1;
+  CHECK(!(a.packed() == b.packed()));
+  CHECK(a.hash() != b.hash());
+}
+
+void test_hash_is_stable() {
+  // These are stored in metadata and package indexes; if they change, every
+  // saved hash goes stale.
+  CHECK(ym2612::Patch{}.hash() == "cbb1302ab328bc69");
+  ym2612::Patch patch;
+  patch.instrument.algorithm = 4;
+  patch.instrument.feedback = 5;
+  patch.instrument.operators[1].total_level = 0x7f;
+  CHECK(patch.hash() == "eb8a55c4cb1714e4");
+
+  static_assert(ym2612::pack({}, {}, {}).hash() ==
+                ym2612::pack({}, {}, {}).hash());
+  CHECK(ym2612::Patch{}.packed().hash() ==
+        ym2612::pack({}, {}, {}).hash());
+}
+
+void test_distinct_sounds_hash_apart() {
+  std::unordered_set<ym2612::PackedPatch> sounds;
+  std::unordered_set<std::string> hashes;
+  for (int seed = 0; seed < 1024; ++seed) {
+    const auto patch = make_patch(seed);
+    if (sounds.insert(patch.packed()).second) {
+      CHECK(hashes.insert(patch.hash()).second);
+    }
+  }
+  CHECK(sounds.size() == hashes.size());
+  CHECK(sounds.size() > 500);
+}
+
+void test_out_of_range_fields_are_masked() {
+  auto patch = make_patch(3);
+  auto wide = patch;
+  wide.instrument.operators[0].total_level |= 0x80;
+  wide.instrument.operators[2].multiple |= 0xF0;
+  wide.channel.amplitude_modulation_sensitivity |= 0x04;
+  CHECK(wide.packed() == patch.packed());
+}
+
+void test_audio_command_carries_the_image() {
+  const auto patch = make_patch(42);
+  const auto command = audio::AudioCommand::apply_patch(
+      patch.global, patch.channel, patch.instrument);
+  CHECK(command.type == audio::AudioCommand::Type::ApplyPatch);
+  CHECK(command.patch == patch.packed());
+}
+
+} // namespace
+
+int main() {
+  test_round_trip();
+  test_identity_ignores_the_name();
+  test_hash_is_stable();
+  test_distinct_sounds_hash_apart();
+  test_out_of_range_fields_are_masked();
+  test_audio_command_carries_the_image();
+  std::cout << "packed_patch_test passed\n";
+  return 0;
+}